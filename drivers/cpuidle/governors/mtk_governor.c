@@ -19,13 +19,54 @@
 #include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include "mtk_idle_predict.h"
+
+/*
+ * By default the platform criteria in mt_idle_select() pick the state.
+ * With predict set, that pick only caps the depth and the state is
+ * chosen from the predicted idle duration, see mtk_idle_predict.h.
+ * This needs real target residencies and exit latencies in the cpuidle
+ * driver table, and the MTK tables do not have them yet: they carry
+ * target_residency 1 and one exit latency for all the deep states. On
+ * such a table predict is ignored.
+ */
+static bool predict;
+module_param(predict, bool, 0644);
+
+/* idle periods kept per cpu for tools/testing/selftests/cpuidle */
+#define MTK_IDLE_RECORDS	1024
+
+struct mtk_idle_record {
+	unsigned int        next_timer_us;
+	unsigned int        residency_us;
+	unsigned short      nr_iowaiters;
+	signed char         first_state_idx;
+	signed char         state_idx;
+};
 
 struct mtk_idle_device {
 	unsigned int        cpu;
 	int                 last_state_idx;
+	int                 first_state_idx;	/* what mt_idle_select() said */
+	int                 needs_update;
+	unsigned int        next_timer_us;
+	unsigned long       nr_iowaiters;
+	unsigned int        latency_req;
+	struct mtk_idle_predict predict;
+	struct mtk_idle_state_stat stat[CPUIDLE_STATE_MAX];
+	struct mtk_idle_record *record;
+	unsigned int        record_head;
+	unsigned int        record_count;
+	bool                table_ok;	/* see mtk_governor_table_ok() */
 };
 
 static DEFINE_PER_CPU(struct mtk_idle_device, mtk_idle_devices);
+static bool mtk_idle_recording;
 
 int __attribute__((weak)) mt_idle_select(int cpu)
 {
@@ -38,6 +79,69 @@ void __attribute__((weak)) mt_cpuidle_framework_init(void)
 
 }
 
+static void mtk_governor_params(struct cpuidle_driver *drv,
+				struct cpuidle_device *dev,
+				struct mtk_idle_state_param *s)
+{
+	int i;
+
+	for (i = 0; i < drv->state_count; i++) {
+		s[i].exit_latency = drv->states[i].exit_latency;
+		s[i].target_residency = drv->states[i].target_residency;
+		s[i].disabled = drv->states[i].disabled ||
+				dev->states_usage[i].disable;
+	}
+}
+
+/* whether predict can choose from the table, see mtk_predict_table_ok() */
+static bool mtk_governor_table_ok(struct cpuidle_driver *drv)
+{
+	struct mtk_idle_state_param s[CPUIDLE_STATE_MAX];
+	int i;
+
+	for (i = 0; i < drv->state_count; i++) {
+		s[i].exit_latency = drv->states[i].exit_latency;
+		s[i].target_residency = drv->states[i].target_residency;
+		s[i].disabled = false;
+	}
+	return mtk_predict_table_ok(s, drv->state_count);
+}
+
+/*
+ * mtk_governor_update - learns from the last idle period
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static void mtk_governor_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct mtk_idle_device *data = &__get_cpu_var(mtk_idle_devices);
+	struct mtk_idle_state_param s[CPUIDLE_STATE_MAX];
+	unsigned int residency_us = cpuidle_get_last_residency(dev);
+	int idx = data->last_state_idx;
+
+	if (idx >= drv->state_count || data->first_state_idx < 0)
+		return;
+
+	mtk_governor_params(drv, dev, s);
+	if (predict && data->table_ok)
+		mtk_predict_update(&data->predict, &s[idx], residency_us);
+	mtk_predict_account(data->stat, s, data->first_state_idx, idx,
+			    residency_us, data->latency_req);
+
+	if (data->record && mtk_idle_recording) {
+		struct mtk_idle_record *r;
+
+		r = &data->record[data->record_head++ & (MTK_IDLE_RECORDS - 1)];
+		r->next_timer_us = data->next_timer_us;
+		r->residency_us = residency_us;
+		r->nr_iowaiters = min_t(unsigned long, data->nr_iowaiters, USHRT_MAX);
+		r->first_state_idx = data->first_state_idx;
+		r->state_idx = idx;
+		if (data->record_count < MTK_IDLE_RECORDS)
+			data->record_count++;
+	}
+}
+
 /*
  * mtk_governor_select - selects the next idle state to enter
  * @drv: cpuidle driver containing state data
@@ -46,10 +150,38 @@ void __attribute__((weak)) mt_cpuidle_framework_init(void)
 static int mtk_governor_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 {
 	struct mtk_idle_device *data = &__get_cpu_var(mtk_idle_devices);
+	struct mtk_idle_state_param s[CPUIDLE_STATE_MAX];
+	unsigned int latency_req;
 	int state;
 
+	if (data->needs_update) {
+		mtk_governor_update(drv, dev);
+		data->needs_update = 0;
+	}
+
 	state = mt_idle_select(data->cpu);
 
+	data->first_state_idx = state;
+	data->last_state_idx = state;
+	if (state < 0)
+		return state;
+
+	data->next_timer_us = ktime_to_us(tick_nohz_get_sleep_length());
+	data->nr_iowaiters = nr_iowait_cpu(data->cpu);
+	data->latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+
+	if (predict && data->table_ok) {
+		latency_req = mtk_predict(&data->predict, data->next_timer_us,
+					  data->nr_iowaiters);
+		latency_req = min(latency_req, data->latency_req);
+
+		mtk_governor_params(drv, dev, s);
+		state = mtk_predict_pick(s, drv->state_count, state,
+					 data->predict.predicted_us,
+					 latency_req);
+		data->last_state_idx = state;
+	}
+
 	return state;
 }
 
@@ -63,7 +195,11 @@ static int mtk_governor_select(struct cpuidle_driver *drv, struct cpuidle_device
  */
 static void mtk_governor_reflect(struct cpuidle_device *dev, int index)
 {
-	/* TODO: implement actions for MTK governor & replace it */
+	struct mtk_idle_device *data = &__get_cpu_var(mtk_idle_devices);
+
+	data->last_state_idx = index;
+	if (index >= 0)
+		data->needs_update = 1;
 }
 
 /*
@@ -76,8 +212,16 @@ static int mtk_governor_enable_device(struct cpuidle_driver *drv,
 {
 	struct mtk_idle_device *data = &per_cpu(mtk_idle_devices, dev->cpu);
 
+	struct mtk_idle_record *record = data->record;
+
 	memset(data, 0, sizeof(struct mtk_idle_device));
 	data->cpu = dev->cpu;
+	data->record = record;
+	mtk_predict_init(&data->predict);
+	data->table_ok = mtk_governor_table_ok(drv);
+	if (!data->table_ok)
+		pr_warn_once("mtk_governor: %s has no usable target residencies, predict is ignored\n",
+			     drv->name);
 
 	return 0;
 }
@@ -91,12 +235,196 @@ static struct cpuidle_governor mtk_governor = {
 	.owner =	THIS_MODULE,
 };
 
+/*
+ * debugfs
+ *
+ * stats: per cpu and state, how many entries paid off, woke up before the
+ *        target residency or could have gone deeper. Write to reset.
+ * record: write 1 to start and 0 to stop recording idle periods, read to
+ *        get them as "cpu next_timer_us residency_us nr_iowaiters
+ *        first_state state" lines, oldest first.
+ */
+static int mtk_governor_stats_show(struct seq_file *m, void *v)
+{
+	struct cpuidle_driver *drv;
+	bool table_ok = true;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu)
+		if (per_cpu(cpuidle_devices, cpu) &&
+		    !per_cpu(mtk_idle_devices, cpu).table_ok)
+			table_ok = false;
+
+	seq_printf(m, "mode: %s\n",
+		   predict && table_ok ? "predict" : "platform");
+	if (!table_ok)
+		seq_puts(m, "table: placeholder residencies, too_deep and too_shallow are not meaningful\n");
+	seq_puts(m, "cpu state      usage        hit   too_deep too_shallow    time_us\n");
+	for_each_possible_cpu(cpu) {
+		struct mtk_idle_device *data = &per_cpu(mtk_idle_devices, cpu);
+
+		drv = cpuidle_get_cpu_driver(per_cpu(cpuidle_devices, cpu));
+		if (!drv)
+			continue;
+		for (i = 0; i < drv->state_count; i++)
+			seq_printf(m, "%3d %-8s %8lu %10lu %10lu %11lu %10llu\n",
+				   cpu, drv->states[i].name, data->stat[i].usage,
+				   data->stat[i].hit, data->stat[i].too_deep,
+				   data->stat[i].too_shallow,
+				   data->stat[i].time_us);
+	}
+	return 0;
+}
+
+static int mtk_governor_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtk_governor_stats_show, NULL);
+}
+
+static ssize_t mtk_governor_stats_write(struct file *file,
+					const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	/* racy against the idle loop, a sample may survive the reset */
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(mtk_idle_devices, cpu).stat, 0,
+		       sizeof(per_cpu(mtk_idle_devices, cpu).stat));
+	return count;
+}
+
+static const struct file_operations mtk_governor_stats_fops = {
+	.open = mtk_governor_stats_open,
+	.read = seq_read,
+	.write = mtk_governor_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * *pos walks cpu by cpu, MTK_IDLE_RECORDS slots each, and is kept in
+ * m->private for show.
+ */
+static void *mtk_governor_record_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	struct mtk_idle_device *data;
+	unsigned int cpu, n;
+
+	for (;;) {
+		cpu = *pos / MTK_IDLE_RECORDS;
+		n = *pos % MTK_IDLE_RECORDS;
+		if (cpu >= nr_cpu_ids)
+			return NULL;
+		data = &per_cpu(mtk_idle_devices, cpu);
+		if (cpu_possible(cpu) && data->record && n < data->record_count) {
+			*(loff_t *)m->private = *pos;
+			return data;
+		}
+		*pos = (loff_t)(cpu + 1) * MTK_IDLE_RECORDS;
+	}
+}
+
+static void *mtk_governor_record_start(struct seq_file *m, loff_t *pos)
+{
+	return mtk_governor_record_next(m, NULL, pos);
+}
+
+static void *mtk_governor_record_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return mtk_governor_record_next(m, v, pos);
+}
+
+static void mtk_governor_record_stop(struct seq_file *m, void *v)
+{
+}
+
+static int mtk_governor_record_show(struct seq_file *m, void *v)
+{
+	struct mtk_idle_device *data = v;
+	unsigned int n = *(loff_t *)m->private % MTK_IDLE_RECORDS;
+	struct mtk_idle_record r;
+
+	/* read while recording goes on, a line may be torn or repeated */
+	n += data->record_head - data->record_count;
+	r = data->record[n & (MTK_IDLE_RECORDS - 1)];
+	seq_printf(m, "%u %u %u %u %d %d\n", data->cpu, r.next_timer_us,
+		   r.residency_us, r.nr_iowaiters, r.first_state_idx,
+		   r.state_idx);
+	return 0;
+}
+
+static const struct seq_operations mtk_governor_record_seq_ops = {
+	.start = mtk_governor_record_start,
+	.next = mtk_governor_record_seq_next,
+	.stop = mtk_governor_record_stop,
+	.show = mtk_governor_record_show,
+};
+
+static int mtk_governor_record_open(struct inode *inode, struct file *file)
+{
+	return seq_open_private(file, &mtk_governor_record_seq_ops,
+				sizeof(loff_t));
+}
+
+static ssize_t mtk_governor_record_write(struct file *file,
+					 const char __user *buf,
+					 size_t count, loff_t *ppos)
+{
+	struct mtk_idle_device *data;
+	unsigned int enable;
+	int cpu, ret;
+
+	ret = kstrtouint_from_user(buf, count, 0, &enable);
+	if (ret)
+		return ret;
+
+	if (enable) {
+		/* kept once allocated, the idle loop never waits for us */
+		for_each_possible_cpu(cpu) {
+			data = &per_cpu(mtk_idle_devices, cpu);
+			if (data->record)
+				continue;
+			data->record = kcalloc(MTK_IDLE_RECORDS,
+					       sizeof(struct mtk_idle_record),
+					       GFP_KERNEL);
+			if (!data->record)
+				return -ENOMEM;
+		}
+	}
+	mtk_idle_recording = !!enable;
+	return count;
+}
+
+static const struct file_operations mtk_governor_record_fops = {
+	.open = mtk_governor_record_open,
+	.read = seq_read,
+	.write = mtk_governor_record_write,
+	.llseek = seq_lseek,
+	.release = seq_release_private,
+};
+
+static int __init mtk_governor_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("mtk_governor", NULL);
+	if (IS_ERR_OR_NULL(root))
+		return 0;
+	debugfs_create_file("stats", 0644, root, NULL,
+			    &mtk_governor_stats_fops);
+	debugfs_create_file("record", 0644, root, NULL,
+			    &mtk_governor_record_fops);
+	return 0;
+}
+late_initcall(mtk_governor_debugfs_init);
+
 /*
  * init_mtk_governor - initializes the governor
  */
 static int __init init_mtk_governor(void)
 {
-	/* TODO: check if debugfs_create_file() failed */
 	mt_cpuidle_framework_init();
 	return cpuidle_register_governor(&mtk_governor);
 }
@@ -0,0 +1,275 @@
+/*
+ * mtk_idle_predict.h - idle duration prediction for the MTK governor
+ *
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * The predictor follows menu.c: the distance to the next timer is scaled
+ * by a correction factor learned per order of magnitude and per I/O wait,
+ * and replaced by the average of the last intervals when those repeat.
+ * I/O waiters also tighten the latency limit.
+ *
+ * The MTK drivers list their states deepest first, and mt_idle_select()
+ * returns the deepest one the platform allows right now. The pick is the
+ * deepest state at or after that one whose residency the prediction
+ * covers and whose exit latency fits.
+ *
+ * Nothing here touches the cpuidle core so that the replay harness in
+ * tools/testing/selftests/cpuidle can build this file as it is.
+ */
+
+#ifndef __MTK_IDLE_PREDICT_H__
+#define __MTK_IDLE_PREDICT_H__
+
+#define MTK_PREDICT_BUCKETS		12
+#define MTK_PREDICT_INTERVAL_SHIFT	3
+#define MTK_PREDICT_INTERVALS		(1UL << MTK_PREDICT_INTERVAL_SHIFT)
+#define MTK_PREDICT_RESOLUTION		1024
+#define MTK_PREDICT_DECAY		8
+#define MTK_PREDICT_MAX_INTERESTING	50000
+
+struct mtk_idle_predict {
+	unsigned int	next_timer_us;
+	unsigned int	predicted_us;
+	unsigned int	bucket;
+	unsigned int	correction_factor[MTK_PREDICT_BUCKETS];
+	unsigned int	intervals[MTK_PREDICT_INTERVALS];
+	int		interval_ptr;
+};
+
+/* the part of a cpuidle state the pick looks at */
+struct mtk_idle_state_param {
+	unsigned int	exit_latency;		/* us */
+	unsigned int	target_residency;	/* us */
+	bool		disabled;
+};
+
+/*
+ * Per-state outcome of the entries: a hit paid off and no deeper allowed
+ * state would have, too_deep woke up before the target residency and
+ * too_shallow slept long enough for a deeper allowed state.
+ */
+struct mtk_idle_state_stat {
+	unsigned long	usage;
+	unsigned long	hit;
+	unsigned long	too_deep;
+	unsigned long	too_shallow;
+	unsigned long long time_us;
+};
+
+static inline void mtk_predict_init(struct mtk_idle_predict *p)
+{
+	int i;
+
+	memset(p, 0, sizeof(*p));
+	/* start out trusting the next timer */
+	for (i = 0; i < MTK_PREDICT_BUCKETS; i++)
+		p->correction_factor[i] = MTK_PREDICT_RESOLUTION *
+					  MTK_PREDICT_DECAY;
+}
+
+static inline unsigned int mtk_predict_bucket(unsigned int duration,
+					      unsigned long nr_iowaiters)
+{
+	unsigned int bucket = nr_iowaiters ? MTK_PREDICT_BUCKETS / 2 : 0;
+
+	if (duration < 10)
+		return bucket;
+	if (duration < 100)
+		return bucket + 1;
+	if (duration < 1000)
+		return bucket + 2;
+	if (duration < 10000)
+		return bucket + 3;
+	if (duration < 100000)
+		return bucket + 4;
+	return bucket + 5;
+}
+
+/*
+ * Use the average of the last intervals when they are close together,
+ * dropping the largest outliers down to 3/4 of the samples, see
+ * get_typical_interval() in menu.c.
+ */
+static inline void mtk_predict_typical(struct mtk_idle_predict *p)
+{
+	unsigned int max, thresh = UINT_MAX;
+	unsigned int i, divisor;
+	u64 avg, stddev;
+
+again:
+	max = 0;
+	avg = 0;
+	divisor = 0;
+	for (i = 0; i < MTK_PREDICT_INTERVALS; i++) {
+		unsigned int value = p->intervals[i];
+
+		if (value <= thresh) {
+			avg += value;
+			divisor++;
+			if (value > max)
+				max = value;
+		}
+	}
+	avg = div_u64(avg, divisor);
+
+	stddev = 0;
+	for (i = 0; i < MTK_PREDICT_INTERVALS; i++) {
+		unsigned int value = p->intervals[i];
+
+		if (value <= thresh) {
+			s64 diff = (s64)value - (s64)avg;
+
+			stddev += diff * diff;
+		}
+	}
+	stddev = div_u64(stddev, divisor);
+
+	if (stddev <= ULONG_MAX) {
+		stddev = int_sqrt(stddev);
+		if ((avg > stddev * 6 &&
+		     divisor * 4 >= MTK_PREDICT_INTERVALS * 3) ||
+		    stddev <= 20) {
+			if (p->next_timer_us > avg)
+				p->predicted_us = avg;
+			return;
+		}
+	}
+
+	if (divisor * 4 <= MTK_PREDICT_INTERVALS * 3)
+		return;
+
+	thresh = max - 1;
+	goto again;
+}
+
+/*
+ * Predict the coming idle period from the next timer distance and the
+ * number of tasks in I/O wait on this cpu. Returns the exit latency
+ * limit in us that the prediction allows.
+ */
+static inline unsigned int mtk_predict(struct mtk_idle_predict *p,
+				       unsigned int next_timer_us,
+				       unsigned long nr_iowaiters)
+{
+	p->next_timer_us = next_timer_us;
+	p->bucket = mtk_predict_bucket(next_timer_us, nr_iowaiters);
+	p->predicted_us = div_u64((u64)next_timer_us *
+				  p->correction_factor[p->bucket] +
+				  MTK_PREDICT_RESOLUTION * MTK_PREDICT_DECAY / 2,
+				  MTK_PREDICT_RESOLUTION * MTK_PREDICT_DECAY);
+	mtk_predict_typical(p);
+
+	/* each task waiting for I/O asks for a faster wakeup */
+	return p->predicted_us / (1 + 10 * nr_iowaiters);
+}
+
+/*
+ * Pick the deepest state from @first on, states being listed deepest
+ * first, that pays off for the prediction within @latency_req. Falls
+ * back to the shallowest usable state.
+ */
+/*
+ * A table the pick can choose from: deepest first, so target residencies
+ * strictly shrink with the index, and each residency covers the exit
+ * latency of its state. The placeholder MTK tables, with residency 1
+ * everywhere, fail this.
+ */
+static inline bool mtk_predict_table_ok(const struct mtk_idle_state_param *s,
+					int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (s[i].target_residency < s[i].exit_latency)
+			return false;
+		if (i && s[i].target_residency >= s[i - 1].target_residency)
+			return false;
+	}
+	return count > 1;
+}
+
+static inline int mtk_predict_pick(const struct mtk_idle_state_param *s,
+				   int count, int first,
+				   unsigned int predicted_us,
+				   unsigned int latency_req)
+{
+	int i, shallowest = -1;
+
+	for (i = first; i < count; i++) {
+		if (s[i].disabled)
+			continue;
+		shallowest = i;
+		if (s[i].target_residency > predicted_us)
+			continue;
+		if (s[i].exit_latency > latency_req)
+			continue;
+		return i;
+	}
+	return shallowest >= 0 ? shallowest : first;
+}
+
+/*
+ * Learn from the last idle period. @residency_us is what the cpuidle
+ * core measured in state @s, exit latency included.
+ */
+static inline void mtk_predict_update(struct mtk_idle_predict *p,
+				      const struct mtk_idle_state_param *s,
+				      unsigned int residency_us)
+{
+	unsigned int measured_us = residency_us;
+	unsigned int factor;
+
+	if (measured_us > s->exit_latency)
+		measured_us -= s->exit_latency;
+	if (measured_us > p->next_timer_us)
+		measured_us = p->next_timer_us;
+
+	factor = p->correction_factor[p->bucket];
+	factor -= factor / MTK_PREDICT_DECAY;
+	if (p->next_timer_us > 0 && measured_us < MTK_PREDICT_MAX_INTERESTING)
+		factor += div_u64((u64)MTK_PREDICT_RESOLUTION * measured_us,
+				  p->next_timer_us);
+	else
+		factor += MTK_PREDICT_RESOLUTION;
+	p->correction_factor[p->bucket] = factor;
+
+	p->intervals[p->interval_ptr++] = measured_us;
+	if (p->interval_ptr >= MTK_PREDICT_INTERVALS)
+		p->interval_ptr = 0;
+}
+
+/* classify an entry of state @idx that lasted @residency_us */
+static inline void mtk_predict_account(struct mtk_idle_state_stat *stat,
+				       const struct mtk_idle_state_param *s,
+				       int first, int idx,
+				       unsigned int residency_us,
+				       unsigned int latency_req)
+{
+	int i;
+
+	stat[idx].usage++;
+	stat[idx].time_us += residency_us;
+
+	if (residency_us < s[idx].target_residency) {
+		stat[idx].too_deep++;
+		return;
+	}
+
+	for (i = first; i < idx; i++) {
+		if (s[i].disabled || s[i].exit_latency > latency_req)
+			continue;
+		if (s[i].target_residency <= residency_us) {
+			stat[idx].too_shallow++;
+			return;
+		}
+	}
+	stat[idx].hit++;
+}
+
+#endif /* __MTK_IDLE_PREDICT_H__ */
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+/*
+ * Streaming LZ4 stage between the mini dump segments and the mrdump_write
+ * callback. Everything is allocated at boot: at panic time the stage only
+ * compresses into a static staging buffer and hands it to the writer in
+ * MRDUMP_Z_BLOCK sized pieces. See mrdump_lz4.h for the layout.
+ */
+
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/sizes.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/lz4.h>
+#include "mrdump_lz4.h"
+
+#define MRDUMP_Z_MAX_CHUNKS	1024
+/* room for a full chunk on top of less than a chunk still staged */
+#define MRDUMP_Z_STAGE_SIZE	(MRDUMP_Z_CHUNK_SIZE + MRDUMP_Z_BLOCK + \
+				 sizeof(struct mrdump_z_chunk) + \
+				 lz4_compressbound(MRDUMP_Z_CHUNK_SIZE))
+
+static u8 *stage;
+static void *wrkmem;
+static struct mrdump_z_chunk *zindex;
+
+static struct {
+	mrdump_write write;
+	loff_t base;		/* writer offset of the descriptor */
+	u64 limit;		/* stream bytes the writer has room for */
+	u64 flushed;		/* stream bytes handed to the writer */
+	u32 fill;		/* bytes staged after flushed */
+	u64 raw_size;
+	u32 nr;
+	u32 flags;
+	/* pending run of skipped pages */
+	u64 skip_off;
+	u32 skip_len;
+	/* pending run of data */
+	const u8 *run_src;
+	u64 run_off;
+	u32 run_len;
+} zs;
+
+bool mrdump_z_ready(void)
+{
+	return stage && wrkmem && zindex;
+}
+
+static void mrdump_z_flush(bool final)
+{
+	u32 n;
+	int ret;
+
+	if (final) {
+		n = ALIGN(zs.fill, MRDUMP_Z_BLOCK);
+		memset(stage + zs.fill, 0, n - zs.fill);
+	} else {
+		n = round_down(zs.fill, MRDUMP_Z_BLOCK);
+	}
+	if (!n)
+		return;
+	if (zs.flushed + n > zs.limit) {
+		zs.flags |= MRDUMP_Z_TRUNCATED;
+		zs.fill = 0;
+		return;
+	}
+	ret = zs.write(stage, zs.base + zs.flushed, n, 1);
+	if (IS_ERR(ERR_PTR(ret)))
+		pr_notice("mrdump: lz4 stream write fail %d\n", ret);
+	zs.flushed += n;
+	zs.fill -= n;
+	memmove(stage, stage + n, zs.fill);
+}
+
+static void mrdump_z_emit(u64 raw_off, const void *src, u32 raw_len, u32 type)
+{
+	struct mrdump_z_chunk hdr;
+	size_t clen = 0;
+	u8 *payload;
+
+	if (zs.flags & MRDUMP_Z_TRUNCATED)
+		return;
+	if (zs.nr >= MRDUMP_Z_MAX_CHUNKS) {
+		zs.flags |= MRDUMP_Z_TRUNCATED;
+		return;
+	}
+	if (zs.fill + sizeof(hdr) + lz4_compressbound(raw_len) >
+	    MRDUMP_Z_STAGE_SIZE) {
+		mrdump_z_flush(false);
+		if (zs.flags & MRDUMP_Z_TRUNCATED)
+			return;
+	}
+
+	payload = stage + zs.fill + sizeof(hdr);
+	if (type != MRDUMP_Z_SKIP) {
+		if (lz4_compress(src, raw_len, payload, &clen, wrkmem) ||
+		    clen >= raw_len) {
+			memcpy(payload, src, raw_len);
+			clen = raw_len;
+			type = MRDUMP_Z_RAW;
+		} else {
+			type = MRDUMP_Z_LZ4;
+		}
+	}
+
+	hdr.raw_off = raw_off;
+	hdr.stream_off = zs.flushed + zs.fill;
+	hdr.raw_len = raw_len;
+	hdr.comp_len = clen;
+	hdr.type = type;
+	hdr.reserved = 0;
+	/* the stage is only byte aligned */
+	memcpy(stage + zs.fill, &hdr, sizeof(hdr));
+	zindex[zs.nr++] = hdr;
+	zs.fill += sizeof(hdr) + clen;
+	zs.raw_size = max(zs.raw_size, raw_off + raw_len);
+}
+
+static void mrdump_z_flush_skip(void)
+{
+	if (zs.skip_len)
+		mrdump_z_emit(zs.skip_off, NULL, zs.skip_len, MRDUMP_Z_SKIP);
+	zs.skip_len = 0;
+}
+
+static void mrdump_z_flush_run(void)
+{
+	if (zs.run_len)
+		mrdump_z_emit(zs.run_off, zs.run_src, zs.run_len, MRDUMP_Z_LZ4);
+	zs.run_len = 0;
+}
+
+/* true if the page holding addr sits in a free buddy block */
+static bool mrdump_z_page_free(const void *addr)
+{
+	unsigned long pfn, head;
+	struct page *page;
+	int order;
+
+	if (!virt_addr_valid(addr))
+		return false;
+	pfn = PFN_DOWN(__pa(addr));
+	for (order = 0; order < MAX_ORDER; order++) {
+		head = pfn & ~((1UL << order) - 1);
+		if (!pfn_valid(head))
+			break;
+		page = pfn_to_page(head);
+		if (PageBuddy(page))
+			return page_private(page) >= order;
+	}
+	return false;
+}
+
+static bool mrdump_z_skippable(const void *src, u32 len)
+{
+	if (len == PAGE_SIZE && mrdump_z_page_free(src))
+		return true;
+	return !memchr_inv(src, 0, len);
+}
+
+void mrdump_z_begin(mrdump_write write, loff_t offset, u64 limit)
+{
+	struct mrdump_z_desc *desc = (struct mrdump_z_desc *)stage;
+
+	memset(&zs, 0, sizeof(zs));
+	zs.write = write;
+	zs.base = offset;
+	zs.limit = limit;
+
+	/* a placeholder, so that a dump cut short still reads as compressed */
+	memset(stage, 0, MRDUMP_Z_BLOCK);
+	desc->magic = MRDUMP_Z_MAGIC;
+	desc->version = MRDUMP_Z_VERSION;
+	desc->chunk_size = MRDUMP_Z_CHUNK_SIZE;
+	zs.fill = MRDUMP_Z_BLOCK;
+}
+
+/* add len bytes at src, found at raw_off in the uncompressed data region */
+int mrdump_z_add(u64 raw_off, const void *src, size_t len)
+{
+	const u8 *p = src;
+	u32 piece;
+
+	/* a run is one stretch of memory as well as of the raw data */
+	if (zs.run_len && (zs.run_off + zs.run_len != raw_off ||
+			   zs.run_src + zs.run_len != p))
+		mrdump_z_flush_run();
+	if (zs.skip_len && zs.skip_off + zs.skip_len != raw_off)
+		mrdump_z_flush_skip();
+
+	while (len) {
+		piece = min_t(size_t, len, PAGE_SIZE - offset_in_page(p));
+		if (mrdump_z_skippable(p, piece)) {
+			mrdump_z_flush_run();
+			if (!zs.skip_len)
+				zs.skip_off = raw_off;
+			zs.skip_len += piece;
+		} else {
+			mrdump_z_flush_skip();
+			if (zs.run_len + piece > MRDUMP_Z_CHUNK_SIZE)
+				mrdump_z_flush_run();
+			if (!zs.run_len) {
+				zs.run_src = p;
+				zs.run_off = raw_off;
+			}
+			zs.run_len += piece;
+		}
+		p += piece;
+		raw_off += piece;
+		len -= piece;
+	}
+	return (zs.flags & MRDUMP_Z_TRUNCATED) ? -ENOSPC : 0;
+}
+
+/* write out the index and the final descriptor, returns the stream size */
+int mrdump_z_end(void)
+{
+	struct mrdump_z_desc *desc;
+	u64 index_off;
+	u32 i, nr;
+
+	mrdump_z_flush_run();
+	mrdump_z_flush_skip();
+
+	nr = zs.nr;
+	index_off = zs.flushed + zs.fill;
+	for (i = 0; i < nr; i++) {
+		if (zs.fill + sizeof(*zindex) > MRDUMP_Z_STAGE_SIZE)
+			mrdump_z_flush(false);
+		memcpy(stage + zs.fill, &zindex[i], sizeof(*zindex));
+		zs.fill += sizeof(*zindex);
+	}
+	mrdump_z_flush(true);
+
+	desc = (struct mrdump_z_desc *)stage;
+	memset(stage, 0, MRDUMP_Z_BLOCK);
+	desc->magic = MRDUMP_Z_MAGIC;
+	desc->version = MRDUMP_Z_VERSION;
+	desc->chunk_size = MRDUMP_Z_CHUNK_SIZE;
+	desc->nr_chunks = nr;
+	desc->raw_size = zs.raw_size;
+	desc->flags = zs.flags;
+	/* a truncated index is useless, make tools walk the chunks instead */
+	desc->index_off = (zs.flags & MRDUMP_Z_TRUNCATED) ? 0 : index_off;
+	zs.write(stage, zs.base, MRDUMP_Z_BLOCK, 1);
+
+	if (zs.flags & MRDUMP_Z_TRUNCATED)
+		pr_notice("mrdump: lz4 stream truncated at %llu bytes\n",
+			  zs.flushed);
+	return zs.flushed;
+}
+
+int mrdump_z_init(void)
+{
+	stage = vmalloc(MRDUMP_Z_STAGE_SIZE);
+	wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	zindex = vmalloc(MRDUMP_Z_MAX_CHUNKS * sizeof(*zindex));
+	if (!mrdump_z_ready()) {
+		vfree(stage);
+		kfree(wrkmem);
+		vfree(zindex);
+		stage = NULL;
+		wrkmem = NULL;
+		zindex = NULL;
+		return -ENOMEM;
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#if !defined(__MRDUMP_LZ4_H__)
+#define __MRDUMP_LZ4_H__
+
+#include <linux/types.h>
+#include <mrdump.h>
+
+/*
+ * Compressed mini dump layout, all fields little endian:
+ *
+ *   ELF header        MRDUMP_MINI_HEADER_SIZE bytes, unchanged; p_offset of
+ *                     each PT_LOAD is its offset in the uncompressed dump
+ *   mrdump_z_desc     one 512 byte block at MRDUMP_MINI_HEADER_SIZE
+ *   chunks            mrdump_z_chunk followed by comp_len payload bytes
+ *   index             nr_chunks mrdump_z_chunk at index_off
+ *
+ * Stream offsets are relative to the descriptor. Chunks cover the data
+ * region of the uncompressed dump in raw_off order; a tool can inflate
+ * the whole region or seek through the index to the chunk holding a given
+ * offset. MRDUMP_Z_SKIP chunks carry no payload and read back as zeroes:
+ * they stand for zero pages and pages free in the buddy allocator.
+ */
+#define MRDUMP_Z_MAGIC		0x345a524d	/* "MRZ4" */
+#define MRDUMP_Z_VERSION	1
+#define MRDUMP_Z_CHUNK_SIZE	SZ_64K
+#define MRDUMP_Z_BLOCK		512
+
+#define MRDUMP_Z_RAW		0
+#define MRDUMP_Z_LZ4		1
+#define MRDUMP_Z_SKIP		2
+
+#define MRDUMP_Z_TRUNCATED	(1 << 0)
+
+struct mrdump_z_desc {
+	u32 magic;
+	u32 version;
+	u32 chunk_size;
+	u32 nr_chunks;
+	u64 raw_size;
+	u64 index_off;
+	u32 flags;
+	u32 reserved;
+};
+
+struct mrdump_z_chunk {
+	u64 raw_off;
+	u64 stream_off;
+	u32 raw_len;
+	u32 comp_len;
+	u32 type;
+	u32 reserved;
+};
+
+int mrdump_z_init(void);
+bool mrdump_z_ready(void);
+void mrdump_z_begin(mrdump_write write, loff_t offset, u64 limit);
+int mrdump_z_add(u64 raw_off, const void *src, size_t len);
+int mrdump_z_end(void);
+
+#endif /* __MRDUMP_LZ4_H__ */
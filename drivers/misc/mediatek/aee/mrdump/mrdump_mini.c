@@ -34,6 +34,9 @@
 #include "../../../../kernel/sched/sched.h"
 #include "mrdump_mini.h"
 #include "mrdump_private.h"
+#ifdef CONFIG_LZ4_COMPRESS
+#include "mrdump_lz4.h"
+#endif
 
 #define LOG_DEBUG(fmt, ...)			\
 	do {	\
@@ -60,6 +63,9 @@
 static struct mrdump_mini_elf_header *mrdump_mini_ehdr;
 
 static bool dump_all_cpus;
+#ifdef CONFIG_LZ4_COMPRESS
+static bool dump_compress;
+#endif
 
 __weak void get_android_log_buffer(unsigned long *addr, unsigned long *size, unsigned long *start,
 				   int type)
@@ -822,12 +828,52 @@ static void mrdump_mini_dump_loads(loff_t offset, mrdump_write write)
 	}
 }
 
+#ifdef CONFIG_LZ4_COMPRESS
+/*
+ * Same as mrdump_mini_dump_loads(), but the segments go through the LZ4
+ * stream. p_offset still gives the uncompressed layout, which is what the
+ * host tools rebuild from the stream. Returns the bytes used.
+ */
+static int mrdump_mini_dump_loads_lz4(loff_t offset, mrdump_write write)
+{
+	unsigned long start, size;
+	int i, stream;
+	struct elf_phdr *phdr;
+	loff_t pos = MRDUMP_MINI_HEADER_SIZE;
+
+	mrdump_z_begin(write, offset + MRDUMP_MINI_HEADER_SIZE, MRDUMP_MINI_DATA_SIZE);
+	for (i = 0; i < MRDUMP_MINI_NR_SECTION; i++) {
+		phdr = &mrdump_mini_ehdr->phdrs[i];
+		if (phdr->p_type == PT_NULL)
+			break;
+		if (phdr->p_type == PT_LOAD) {
+			start = phdr->p_vaddr;
+			size = ALIGN(phdr->p_filesz, SZ_512);
+			phdr->p_offset = pos;
+			if (mrdump_z_add(pos - MRDUMP_MINI_HEADER_SIZE, (void *)start, size))
+				LOGD("mirdump: lz4 stream full");
+			pos += size;
+		}
+	}
+	stream = mrdump_z_end();
+	LOGD("mirdump: %lld bytes compressed to %d", pos - MRDUMP_MINI_HEADER_SIZE, stream);
+	return MRDUMP_MINI_HEADER_SIZE + stream;
+}
+#endif
+
 int mrdump_mini_create_oops_dump(AEE_REBOOT_MODE reboot_mode, mrdump_write write,
 				 loff_t sd_offset, const char *msg, va_list ap)
 {
-	mrdump_mini_dump_loads(sd_offset, write);
+	int used = MRDUMP_MINI_BUF_SIZE;
+
+#ifdef CONFIG_LZ4_COMPRESS
+	if (dump_compress && mrdump_z_ready())
+		used = mrdump_mini_dump_loads_lz4(sd_offset, write);
+	else
+#endif
+		mrdump_mini_dump_loads(sd_offset, write);
 	write((void *)mrdump_mini_ehdr, sd_offset, MRDUMP_MINI_HEADER_SIZE, 1);
-	return MRDUMP_MINI_BUF_SIZE;
+	return used;
 }
 EXPORT_SYMBOL(mrdump_mini_create_oops_dump);
 
@@ -921,6 +967,11 @@ int mrdump_mini_init(void)
 	fill_elf_note_phdr(&mrdump_mini_ehdr->phdrs[1], sizeof(mrdump_mini_ehdr->misc),
 			   offsetof(struct mrdump_mini_elf_header, misc));
 
+#ifdef CONFIG_LZ4_COMPRESS
+	if (mrdump_z_init())
+		LOGE("mrdump: no memory for lz4 stream, dumping raw");
+#endif
+
 	return 0;
 }
 
@@ -946,3 +997,6 @@ RESERVEDMEM_OF_DECLARE(reserve_memory_minirdump, "mediatek,minirdump",
 		       mini_rdump_reserve_memory);
 
 module_param(dump_all_cpus, bool, S_IRUGO | S_IWUSR);
+#ifdef CONFIG_LZ4_COMPRESS
+module_param(dump_compress, bool, S_IRUGO | S_IWUSR);
+#endif
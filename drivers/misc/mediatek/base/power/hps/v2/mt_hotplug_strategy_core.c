@@ -26,6 +26,7 @@
 #include <linux/kthread.h>	/* kthread_create */
 #include <linux/wakelock.h>	/* wake_lock_init */
 #include <asm-generic/bug.h>	/* BUG_ON */
+#include <mt-plat/mtk_sampler.h>	/* mtk_sampler_register */
 
 /* local includes */
 #include "mt_hotplug_strategy_internal.h"
@@ -83,6 +84,25 @@ static int _hps_timer_callback(unsigned long data)
 	return HRTIMER_NORESTART;
 }
 
+/*
+ * hps sampler callback, the task may still be busy with the last round
+ */
+static void _hps_sample(struct mtk_sampler *s)
+{
+	if (hps_ctxt.tsk_struct_ptr)
+		wake_up_process(hps_ctxt.tsk_struct_ptr);
+}
+
+/* hotplug decisions are needed with the screen off too */
+static struct mtk_sampler hps_sampler = {
+	.name = "hps",
+	.period_ms = HPS_TIMER_INTERVAL_MS,
+	.slack_ms = HPS_TIMER_INTERVAL_MS / 4,
+	.flags = MTK_SAMPLER_SCREEN_OFF,
+	.fn = _hps_sample,
+};
+static bool hps_sampler_on;
+
 static long int hps_get_current_time_ms(void)
 {
 	struct timeval t;
@@ -252,6 +272,11 @@ HPS_WAIT_EVENT:
 				set_current_state(TASK_INTERRUPTIBLE);
 				schedule();
 			}
+		} else if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_SAMPLER) {
+			if (atomic_read(&hps_ctxt.is_ondemand) == 0) {
+				set_current_state(TASK_INTERRUPTIBLE);
+				schedule();
+			}
 		}
 
 		if (kthread_should_stop())
@@ -307,7 +332,8 @@ void hps_task_wakeup_nolock(void)
 		if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_WAIT_QUEUE)
 			wake_up(&hps_ctxt.wait_queue);
 		else if ((hps_ctxt.periodical_by == HPS_PERIODICAL_BY_TIMER)
-			 || (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_HR_TIMER))
+			 || (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_HR_TIMER)
+			 || (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_SAMPLER))
 			wake_up_process(hps_ctxt.tsk_struct_ptr);
 	}
 }
@@ -367,6 +393,8 @@ int hps_core_init(void)
 		hps_ctxt.hr_timer.function = (void *)&_hps_timer_callback;
 		hrtimer_start(&hps_ctxt.hr_timer, ktime, HRTIMER_MODE_REL);
 
+	} else if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_SAMPLER) {
+		hps_sampler_on = !mtk_sampler_register(&hps_sampler);
 	}
 	/* init and start task */
 	r = hps_task_start();
@@ -397,6 +425,9 @@ int hps_core_deinit(void)
 		r = hrtimer_cancel(&hps_ctxt.hr_timer);
 		if (r)
 			hps_error("hps hr timer delete error!\n");
+	} else if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_SAMPLER && hps_sampler_on) {
+		mtk_sampler_unregister(&hps_sampler);
+		hps_sampler_on = false;
 	}
 
 	hps_task_stop();
@@ -413,6 +444,9 @@ int hps_del_timer(void)
 		del_timer_sync(&hps_ctxt.tmr_list);
 	} else if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_HR_TIMER) {
 		hrtimer_cancel(&hps_ctxt.hr_timer);
+	} else if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_SAMPLER && hps_sampler_on) {
+		mtk_sampler_unregister(&hps_sampler);
+		hps_sampler_on = false;
 	}
 #endif
 	return 0;
@@ -457,6 +491,13 @@ int hps_restart_timer(void)
 			hps_cancel_time = 0;
 		}
 #endif
+	} else if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_SAMPLER) {
+		if (!hps_sampler_on)
+			hps_sampler_on = !mtk_sampler_register(&hps_sampler);
+		if (time_differ >= HPS_TIMER_INTERVAL_MS) {
+			hps_task_wakeup_nolock();
+			hps_cancel_time = 0;
+		}
 	}
 #endif
 	return 0;
@@ -49,6 +49,7 @@
 #define HPS_PERIODICAL_BY_WAIT_QUEUE        (1)
 #define HPS_PERIODICAL_BY_TIMER             (2)
 #define HPS_PERIODICAL_BY_HR_TIMER          (3)
+#define HPS_PERIODICAL_BY_SAMPLER           (4)	/* shared wakeups, see mtk_sampler.h */
 
 #define MAX_CPU_UP_TIMES                    (10)
 #define MAX_CPU_DOWN_TIMES                  (100)
@@ -115,6 +115,7 @@ hps_ctxt_t hps_ctxt = {
 	.tsk_struct_ptr = NULL,
 	.wait_queue = __WAIT_QUEUE_HEAD_INITIALIZER(hps_ctxt.wait_queue),
 	/*.periodical_by = HPS_PERIODICAL_BY_WAIT_QUEUE, */
+	/*.periodical_by = HPS_PERIODICAL_BY_SAMPLER, */
 	.periodical_by = HPS_PERIODICAL_BY_HR_TIMER,
 	.pdrv = {
 		 .remove = NULL,
@@ -443,7 +444,8 @@ static int hps_suspend(struct device *dev)
 
 suspend_end:
 	hps_ctxt.state = STATE_SUSPEND;
-	if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_HR_TIMER)
+	if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_HR_TIMER ||
+	    hps_ctxt.periodical_by == HPS_PERIODICAL_BY_SAMPLER)
 		hps_del_timer();
 	hps_warn("state: %u, enabled: %u, suspend_enabled: %u, rush_boost_enabled: %u\n",
 		 hps_ctxt.state, hps_ctxt.enabled,
@@ -481,7 +483,8 @@ static int hps_resume(struct device *dev)
 #endif
 resume_end:
 	hps_ctxt.state = STATE_EARLY_SUSPEND;
-	if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_HR_TIMER) {
+	if (hps_ctxt.periodical_by == HPS_PERIODICAL_BY_HR_TIMER ||
+	    hps_ctxt.periodical_by == HPS_PERIODICAL_BY_SAMPLER) {
 		hps_task_wakeup();
 		hps_restart_timer();
 	}
@@ -26,16 +26,13 @@
 #include <linux/platform_device.h>
 #include <linux/rwsem.h>
 #include <linux/sched.h>
-#include <linux/sched/rt.h>
 #include <linux/sysfs.h>
-#include <linux/kthread.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
-#include <mt_hotplug_strategy.h>
-#include <mt_hotplug_strategy_internal.h>
-#include "mt_cpufreq.h"
+#include <linux/string.h>
 #include <linux/input.h>
 #include <linux/workqueue.h>
+#include "boost_arb.h"
 #include "dynamic_boost.h"
 
 struct boost_state {
@@ -46,10 +43,7 @@ struct boost_state {
 struct dynamic_boost {
 	spinlock_t boost_lock;
 	int last_req_mode;
-	wait_queue_head_t wq;
-	struct task_struct *thread;
 	struct boost_state state[PRIO_DEFAULT];
-	atomic_t event;
 };
 
 static struct dynamic_boost dboost;
@@ -60,16 +54,94 @@ struct dboost_input_handle {
 	int prio_mode;
 };
 
-#define MAX_CORES_NUMBER nr_cpu_ids
-#define MAX_FREQUENCY 1
+#define ALL_CORES (-1)
 #define MAX_DURATION 10000
 
+/* big + little cores and frequency floor of each mode */
+static const struct {
+	int bigs;
+	int littles;
+	int max_freq;
+} dboost_modes[PRIO_RESET] = {
+	[PRIO_TWO_LITTLES]			= { 0, 2, 0 },
+	[PRIO_TWO_LITTLES_MAX_FREQ]		= { 0, 2, 1 },
+	[PRIO_ONE_BIG]				= { 1, 0, 0 },
+	[PRIO_ONE_BIG_MAX_FREQ]			= { 1, 0, 1 },
+	[PRIO_ONE_BIG_ONE_LITTLE]		= { 1, 1, 0 },
+	[PRIO_ONE_BIG_ONE_LITTLE_MAX_FREQ]	= { 1, 1, 1 },
+	[PRIO_TWO_BIGS]				= { 2, 0, 0 },
+	[PRIO_TWO_BIGS_MAX_FREQ]		= { 2, 0, 1 },
+	[PRIO_FOUR_LITTLES]			= { 0, 4, 0 },
+	[PRIO_FOUR_LITTLES_MAX_FREQ]		= { 0, 4, 1 },
+	[PRIO_TWO_BIGS_TWO_LITTLES]		= { 2, 2, 0 },
+	[PRIO_TWO_BIGS_TWO_LITTLES_MAX_FREQ]	= { 2, 2, 1 },
+	[PRIO_FOUR_BIGS]			= { 4, 0, 0 },
+	[PRIO_FOUR_BIGS_MAX_FREQ]		= { 4, 0, 1 },
+	[PRIO_MAX_CORES]			= { ALL_CORES, 0, 0 },
+	[PRIO_MAX_CORES_MAX_FREQ]		= { ALL_CORES, 0, 1 },
+};
+
 static ssize_t dynamic_boost_show(struct device *dev, struct device_attribute *attr, char *buf);
 static ssize_t dynamic_boost_store(struct device *dev, struct device_attribute *attr, const char *buf,
 	size_t n);
 static struct device_attribute dynamic_boost_attr = __ATTR(dynamic_boost, 0750,
 	dynamic_boost_show, dynamic_boost_store);
 
+/*
+ * Littles go to the first cluster and bigs to the last one, as
+ * hps_set_cpu_num_base() split them. MAX_FREQ raises every cluster.
+ */
+static void dboost_mode_limit(int mode, struct boost_limit *limit)
+{
+	int i, nr = boost_arb_nr_clusters();
+
+	memset(limit, 0, sizeof(*limit));
+	if (dboost_modes[mode].bigs == ALL_CORES) {
+		for (i = 0; i < nr; i++)
+			limit->core[i] = boost_arb_cluster_cores(i);
+	} else {
+		limit->core[0] = dboost_modes[mode].littles;
+		limit->core[nr - 1] += dboost_modes[mode].bigs;
+	}
+
+	if (dboost_modes[mode].max_freq) {
+		for (i = 0; i < nr; i++)
+			limit->freq[i] = BOOST_FREQ_MAX;
+	}
+}
+
+/*
+ * Hand the highest active mode to the boost arbiter, which owns the actual
+ * hotplug and dvfs limits. Called with boost_lock held.
+ */
+static void dboost_update(void)
+{
+	struct boost_limit limit;
+	int i, set_mode = PRIO_DEFAULT;
+
+	for (i = PRIO_DEFAULT - 1; i >= 0; i--) {
+		if (dboost.state[i].active) {
+			set_mode = i;
+			break;
+		}
+	}
+
+	if (set_mode == PRIO_RESET) {
+		for (i = PRIO_DEFAULT - 1; i >= 0; i--)
+			dboost.state[i].active = 0;
+		set_mode = PRIO_DEFAULT;
+	}
+
+	if (set_mode == PRIO_DEFAULT) {
+		boost_arb_release(BOOST_SRC_DYNAMIC);
+	} else {
+		dboost_mode_limit(set_mode, &limit);
+		boost_arb_request(BOOST_SRC_DYNAMIC, &limit, 0);
+	}
+
+	dboost.last_req_mode = set_mode;
+}
+
 static void dboost_disable_work(struct work_struct *work)
 {
 	unsigned long flags;
@@ -78,10 +150,8 @@ static void dboost_disable_work(struct work_struct *work)
 	spin_lock_irqsave(&dboost.boost_lock, flags);
 	if (state->active > 0)
 		state->active--;
+	dboost_update();
 	spin_unlock_irqrestore(&dboost.boost_lock, flags);
-
-	atomic_inc(&dboost.event);
-	wake_up(&dboost.wq);
 }
 
 /*
@@ -110,141 +180,13 @@ int set_dynamic_boost(int duration, int prio_mode)
 		state->active--;
 	else if (!mod_delayed_work(system_wq, &state->work, msecs_to_jiffies(duration)))
 		state->active++;
+	dboost_update();
 	spin_unlock_irqrestore(&dboost.boost_lock, flags);
 
-	atomic_inc(&dboost.event);
-	wake_up(&dboost.wq);
 	return 0;
 }
 EXPORT_SYMBOL(set_dynamic_boost);
 
-static int dboost_dvfs_hotplug_thread(void *ptr)
-{
-	int max_freq, cores_to_set_b, cores_to_set_l;
-	unsigned long flags;
-
-	set_user_nice(current, -10);
-
-	while (!kthread_should_stop()) {
-		int i, set_mode = PRIO_DEFAULT;
-
-		spin_lock_irqsave(&dboost.boost_lock, flags);
-		for (i = PRIO_DEFAULT - 1; i >= 0; i--) {
-			if (dboost.state[i].active) {
-				set_mode = i;
-				break;
-			}
-		}
-		spin_unlock_irqrestore(&dboost.boost_lock, flags);
-
-		switch (set_mode) {
-		case PRIO_MAX_CORES_MAX_FREQ:
-			cores_to_set_b = num_possible_big_cpus();
-			cores_to_set_l = num_possible_little_cpus();
-			max_freq = MAX_FREQUENCY;
-			break;
-		case PRIO_MAX_CORES:
-			cores_to_set_b = num_possible_big_cpus();
-			cores_to_set_l = num_possible_little_cpus();
-			max_freq = 0;
-			break;
-		case PRIO_FOUR_BIGS_MAX_FREQ:
-			cores_to_set_b = 4;
-			cores_to_set_l = 0;
-			max_freq = MAX_FREQUENCY;
-			break;
-		case PRIO_FOUR_BIGS:
-			cores_to_set_b = 4;
-			cores_to_set_l = 0;
-			max_freq = 0;
-			break;
-		case PRIO_TWO_BIGS_TWO_LITTLES_MAX_FREQ:
-			cores_to_set_b = 2;
-			cores_to_set_l = 2;
-			max_freq = MAX_FREQUENCY;
-			break;
-		case PRIO_TWO_BIGS_TWO_LITTLES:
-			cores_to_set_b = 2;
-			cores_to_set_l = 2;
-			max_freq = 0;
-			break;
-		case PRIO_FOUR_LITTLES_MAX_FREQ:
-			cores_to_set_b = 0;
-			cores_to_set_l = 4;
-			max_freq = MAX_FREQUENCY;
-			break;
-		case PRIO_FOUR_LITTLES:
-			cores_to_set_b = 0;
-			cores_to_set_l = 4;
-			max_freq = 0;
-			break;
-		case PRIO_TWO_BIGS_MAX_FREQ:
-			cores_to_set_b = 2;
-			cores_to_set_l = 0;
-			max_freq = MAX_FREQUENCY;
-			break;
-		case PRIO_TWO_BIGS:
-			cores_to_set_b = 2;
-			cores_to_set_l = 0;
-			max_freq = 0;
-			break;
-		case PRIO_ONE_BIG_ONE_LITTLE_MAX_FREQ:
-			cores_to_set_b = 1;
-			cores_to_set_l = 1;
-			max_freq = MAX_FREQUENCY;
-			break;
-		case PRIO_ONE_BIG_ONE_LITTLE:
-			cores_to_set_b = 1;
-			cores_to_set_l = 1;
-			max_freq = 0;
-			break;
-		case PRIO_ONE_BIG_MAX_FREQ:
-			cores_to_set_b = 1;
-			cores_to_set_l = 0;
-			max_freq = MAX_FREQUENCY;
-			break;
-		case PRIO_ONE_BIG:
-			cores_to_set_b = 1;
-			cores_to_set_l = 0;
-			max_freq = 0;
-			break;
-		case PRIO_TWO_LITTLES_MAX_FREQ:
-			cores_to_set_b = 0;
-			cores_to_set_l = 2;
-			max_freq = MAX_FREQUENCY;
-			break;
-		case PRIO_TWO_LITTLES:
-			cores_to_set_b = 0;
-			cores_to_set_l = 2;
-			max_freq = 0;
-			break;
-		case PRIO_RESET:
-			for (i = PRIO_DEFAULT - 1; i >= 0; i--)
-				dboost.state[i].active = 0;
-		default:
-			cores_to_set_b = 0;
-			cores_to_set_l = 0;
-			max_freq = 0;
-			break;
-		}
-
-		interactive_boost_cpu(max_freq);
-		if (!cores_to_set_l)
-			cores_to_set_l = 1;
-		hps_set_cpu_num_base(BASE_PERF_SERV, cores_to_set_l, cores_to_set_b);
-		/* printk("dynamic boost: Mode=%d cpu_min_num_big=%d cpu_min_num_little=%d\n",
-					set_mode, cores_to_set_b, cores_to_set_l);*/
-
-		dboost.last_req_mode = set_mode;
-
-		while (!atomic_read(&dboost.event))
-			wait_event(dboost.wq, atomic_read(&dboost.event));
-
-		atomic_dec(&dboost.event);
-	}
-	return 0;
-}
-
 static ssize_t dynamic_boost_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	int i;
@@ -296,8 +238,9 @@ int dboost_suspend(struct device *dev)
 		dboost.state[i].active = 0;
 		spin_unlock_irqrestore(&dboost.boost_lock, flags);
 	}
-	atomic_inc(&dboost.event);
-	wake_up(&dboost.wq);
+	spin_lock_irqsave(&dboost.boost_lock, flags);
+	dboost_update();
+	spin_unlock_irqrestore(&dboost.boost_lock, flags);
 	return 0;
 }
 
@@ -401,7 +344,6 @@ static int __init dynamic_boost_init(void)
 
 	spin_lock_init(&dboost.boost_lock);
 	dboost.last_req_mode = PRIO_DEFAULT;
-	atomic_set(&dboost.event, 0);
 
 	for (i = 0; i < ARRAY_SIZE(dboost.state); ++i) {
 		INIT_DELAYED_WORK(&dboost.state[i].work, dboost_disable_work);
@@ -412,11 +354,6 @@ static int __init dynamic_boost_init(void)
 #endif
 			dboost.state[i].active = 0;
 	}
-	init_waitqueue_head(&dboost.wq);
-
-	dboost.thread = kthread_run(dboost_dvfs_hotplug_thread, &dboost, "dynamic_boost");
-	if (IS_ERR(dboost.thread))
-		return -EINVAL;
 
 #ifdef CONFIG_TOUCH_BOOST
 	ret = input_register_handler(&dboost_input_handler);
@@ -435,7 +372,7 @@ static void __exit dynamic_boost_exit(void)
 #ifdef CONFIG_TOUCH_BOOST
 	input_unregister_handler(&dboost_input_handler);
 #endif
-	kthread_stop(dboost.thread);
+	boost_arb_release(BOOST_SRC_DYNAMIC);
 }
 
 module_exit(dynamic_boost_exit);
@@ -0,0 +1,514 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Per-process EMI bandwidth attribution. A worker reads the EMI byte count
+ * every period and charges the bytes of the window that just ended to the
+ * tasks running on the online CPUs at its end, split evenly. Each busy CPU
+ * reports its own current task from an IPI, so no other CPU's runqueue is
+ * looked at. Windows that
+ * end with all CPUs idle stay unattributed: that traffic belongs to the
+ * other bus masters (display, GPU, modem) or to tasks that slept before
+ * the boundary. Over many windows a process is charged in proportion to
+ * how often it is found running while the bus is busy.
+ *
+ * Once per report interval a worker turns the charges into bandwidth per
+ * process and per cgroup, and marks the processes that are memory bound,
+ * i.e. moved more than bound_mbps per second of CPU time while using at
+ * least bound_cpu_pct of a CPU.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/hash.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/proc_fs.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <mt-plat/mem_bw_attr.h>
+
+#define TAG "[MEM_BW_ATTR]"
+
+#define MEM_BW_TASK_BITS	7
+#define MEM_BW_TASKS		(1 << MEM_BW_TASK_BITS)
+#define MEM_BW_PROBES		8
+#define MEM_BW_CGRPS		16
+#define MEM_BW_NAME_LEN		24
+#define MEM_BW_REPORT_MS	1000
+#define MEM_BW_IDLE_REPORTS	10	/* reports without a sample before a drop */
+
+#if defined(CONFIG_CPUSETS)
+#define MEM_BW_CGRP_ID		cpuset_cgrp_id
+#elif defined(CONFIG_CGROUP_SCHED)
+#define MEM_BW_CGRP_ID		cpu_cgrp_id
+#endif
+
+struct mem_bw_ent {
+	int key;		/* tgid or cgroup id + 1, 0 for a free slot */
+	char name[MEM_BW_NAME_LEN];
+	u64 total;		/* bytes charged */
+	u64 win;		/* bytes charged this report interval */
+	u64 win_run_ns;		/* time found running this report interval */
+	unsigned int mbps;	/* last report interval */
+	unsigned int run_mbps;
+	unsigned int cpu_pct;
+	unsigned int idle;	/* report intervals without a sample */
+	bool bound;
+};
+
+/* what a CPU was running when asked, filled in by mem_bw_attr_cpu() */
+struct mem_bw_cpu {
+	pid_t tgid;		/* 0 when idle */
+	char comm[MEM_BW_NAME_LEN];
+	int cgrp_id;
+	char cgrp_name[MEM_BW_NAME_LEN];
+};
+
+static DEFINE_PER_CPU(struct mem_bw_cpu, mem_bw_cpu);
+
+static struct mem_bw_attr {
+	spinlock_t lock;	/* everything below */
+	struct delayed_work sample_work;
+	struct work_struct report_work;
+	bool on;
+	u64 last_bytes;		/* get_mem_bytes() at the window start */
+	u64 last_ns;
+	u64 report_ns;		/* start of the report interval */
+	u64 total;
+	u64 unattributed;
+	unsigned long nr_windows;
+	struct mem_bw_ent other;	/* tasks that found no slot */
+	struct mem_bw_ent task[MEM_BW_TASKS];
+	struct mem_bw_ent cgrp[MEM_BW_CGRPS];
+	int nr_cgrp;
+} mba = {
+	.lock = __SPIN_LOCK_UNLOCKED(mba.lock),
+	.other = { .key = -1, .name = "<other>" },
+};
+
+/* rebuilt table, only used under mba.lock */
+static struct mem_bw_ent mem_bw_old[MEM_BW_TASKS];
+
+static DEFINE_MUTEX(mem_bw_knob_lock);
+
+static unsigned int mem_bw_enable;
+static unsigned int mem_bw_period_ms = 10;
+static unsigned int mem_bw_bound_mbps = 1000;
+static unsigned int mem_bw_bound_cpu_pct = 10;
+
+/*--------------------FUNCTION----------------*/
+
+static struct mem_bw_ent *mem_bw_task_slot(struct mem_bw_ent *table, int tgid)
+{
+	u32 i, h = hash_32(tgid, MEM_BW_TASK_BITS);
+	struct mem_bw_ent *e;
+
+	for (i = 0; i < MEM_BW_PROBES; i++) {
+		e = &table[(h + i) & (MEM_BW_TASKS - 1)];
+		if (e->key == tgid || !e->key)
+			return e;
+	}
+	return NULL;
+}
+
+/* called with mba.lock held */
+static struct mem_bw_ent *mem_bw_task_ent(struct mem_bw_cpu *c)
+{
+	struct mem_bw_ent *e = mem_bw_task_slot(mba.task, c->tgid);
+
+	if (!e)
+		return &mba.other;
+	if (!e->key) {
+		e->key = c->tgid;
+		strlcpy(e->name, c->comm, sizeof(e->name));
+	}
+	return e;
+}
+
+/* called with mba.lock held */
+static struct mem_bw_ent *mem_bw_cgrp_ent(struct mem_bw_cpu *c)
+{
+	struct mem_bw_ent *e;
+	int i;
+
+	if (!c->cgrp_id)
+		return NULL;
+	for (i = 0; i < mba.nr_cgrp; i++)
+		if (mba.cgrp[i].key == c->cgrp_id)
+			return &mba.cgrp[i];
+	if (mba.nr_cgrp == MEM_BW_CGRPS)
+		return NULL;
+
+	e = &mba.cgrp[mba.nr_cgrp++];
+	e->key = c->cgrp_id;
+	strlcpy(e->name, c->cgrp_name, sizeof(e->name));
+	return e;
+}
+
+/*
+ * IPI handler, current cannot go away under us here. @worker is the
+ * sampling worker, which is not charged on its own CPU.
+ */
+static void mem_bw_attr_cpu(void *worker)
+{
+	struct mem_bw_cpu *c = this_cpu_ptr(&mem_bw_cpu);
+	struct task_struct *p = current;
+#ifdef MEM_BW_CGRP_ID
+	struct cgroup *cgrp;
+#endif
+
+	c->tgid = 0;
+	c->cgrp_id = 0;
+	if (is_idle_task(p) || p == worker)
+		return;
+
+	c->tgid = p->tgid;
+	strlcpy(c->comm, p->group_leader->comm, sizeof(c->comm));
+#ifdef MEM_BW_CGRP_ID
+	rcu_read_lock();
+	cgrp = task_css(p, MEM_BW_CGRP_ID)->cgroup;
+	c->cgrp_id = cgrp->id + 1;
+	if (cgroup_name(cgrp, c->cgrp_name, sizeof(c->cgrp_name)) < 0 ||
+	    !c->cgrp_name[0])
+		strlcpy(c->cgrp_name, "/", sizeof(c->cgrp_name));
+	rcu_read_unlock();
+#endif
+}
+
+static void mem_bw_charge(struct mem_bw_ent *e, u64 bytes, u64 run_ns)
+{
+	if (!e)
+		return;
+	e->total += bytes;
+	e->win += bytes;
+	e->win_run_ns += run_ns;
+}
+
+static void mem_bw_attr_sample(struct work_struct *work)
+{
+	static struct cpumask busy;
+	struct mem_bw_cpu *c;
+	u64 bytes, now, window, share;
+	int cpu, nr = 0;
+
+	/*
+	 * Only CPUs that look busy are interrupted. One that has gone idle
+	 * by the time the IPI lands reports no task.
+	 */
+	cpumask_clear(&busy);
+	for_each_online_cpu(cpu) {
+		per_cpu(mem_bw_cpu, cpu).tgid = 0;
+		if (!idle_cpu(cpu))
+			cpumask_set_cpu(cpu, &busy);
+	}
+	on_each_cpu_mask(&busy, mem_bw_attr_cpu, current, true);
+
+	spin_lock(&mba.lock);
+	if (!mba.on) {
+		spin_unlock(&mba.lock);
+		return;
+	}
+
+	now = ktime_get_ns();
+	bytes = get_mem_bytes();
+	window = now - mba.last_ns;
+	share = bytes - mba.last_bytes;
+	mba.last_ns = now;
+	mba.last_bytes = bytes;
+	mba.total += share;
+	mba.nr_windows++;
+
+	for_each_cpu(cpu, &busy)
+		if (per_cpu(mem_bw_cpu, cpu).tgid)
+			nr++;
+
+	if (nr) {
+		share = div_u64(share, nr);
+		for_each_cpu(cpu, &busy) {
+			c = &per_cpu(mem_bw_cpu, cpu);
+			if (!c->tgid)
+				continue;
+			mem_bw_charge(mem_bw_task_ent(c), share, window);
+			mem_bw_charge(mem_bw_cgrp_ent(c), share, window);
+		}
+	} else {
+		mba.unattributed += share;
+	}
+
+	if (now - mba.report_ns >= MEM_BW_REPORT_MS * NSEC_PER_MSEC)
+		schedule_work(&mba.report_work);
+
+	schedule_delayed_work(&mba.sample_work,
+			      msecs_to_jiffies(mem_bw_period_ms));
+	spin_unlock(&mba.lock);
+}
+
+static void mem_bw_ent_roll(struct mem_bw_ent *e, u64 interval)
+{
+	e->mbps = div64_u64(e->win * 1000, interval);
+	e->run_mbps = e->win_run_ns ? div64_u64(e->win * 1000, e->win_run_ns) : 0;
+	e->cpu_pct = div64_u64(e->win_run_ns * 100, interval);
+	e->idle = e->win_run_ns ? 0 : e->idle + 1;
+	e->win = 0;
+	e->win_run_ns = 0;
+}
+
+/*
+ * Close the report interval. Processes that went idle for long are
+ * dropped, and all of them are when stopping.
+ */
+static void mem_bw_attr_roll(bool stop)
+{
+	u64 now, interval;
+	int i, j;
+
+	spin_lock(&mba.lock);
+	now = ktime_get_ns();
+	interval = max_t(u64, now - mba.report_ns, 1);
+	mba.report_ns = now;
+
+	memcpy(mem_bw_old, mba.task, sizeof(mba.task));
+	memset(mba.task, 0, sizeof(mba.task));
+	for (i = 0; i < MEM_BW_TASKS; i++) {
+		struct mem_bw_ent *e = &mem_bw_old[i], *n;
+
+		if (!e->key)
+			continue;
+		mem_bw_ent_roll(e, interval);
+
+		e->bound = e->run_mbps >= mem_bw_bound_mbps &&
+			   e->cpu_pct >= mem_bw_bound_cpu_pct;
+
+		if (stop || e->idle > MEM_BW_IDLE_REPORTS)
+			continue;
+		n = mem_bw_task_slot(mba.task, e->key);
+		if (n)
+			*n = *e;
+	}
+
+	mem_bw_ent_roll(&mba.other, interval);
+	for (i = 0, j = 0; i < mba.nr_cgrp; i++) {
+		mem_bw_ent_roll(&mba.cgrp[i], interval);
+		if (stop || mba.cgrp[i].idle > MEM_BW_IDLE_REPORTS)
+			continue;
+		mba.cgrp[j++] = mba.cgrp[i];
+	}
+	memset(&mba.cgrp[j], 0, (mba.nr_cgrp - j) * sizeof(mba.cgrp[0]));
+	mba.nr_cgrp = j;
+	spin_unlock(&mba.lock);
+}
+
+static void mem_bw_attr_report(struct work_struct *work)
+{
+	mem_bw_attr_roll(false);
+}
+
+/* called with mem_bw_knob_lock held */
+static void mem_bw_attr_start(void)
+{
+	spin_lock(&mba.lock);
+	mba.on = true;
+	mba.last_bytes = get_mem_bytes();
+	mba.last_ns = ktime_get_ns();
+	mba.report_ns = mba.last_ns;
+	schedule_delayed_work(&mba.sample_work,
+			      msecs_to_jiffies(mem_bw_period_ms));
+	spin_unlock(&mba.lock);
+}
+
+/* called with mem_bw_knob_lock held */
+static void mem_bw_attr_stop(void)
+{
+	spin_lock(&mba.lock);
+	mba.on = false;
+	spin_unlock(&mba.lock);
+	cancel_delayed_work_sync(&mba.sample_work);
+	cancel_work_sync(&mba.report_work);
+
+	/* forget the processes */
+	mem_bw_attr_roll(true);
+}
+
+/*--------------------PROCFS----------------*/
+
+static void mem_bw_show_ent(struct seq_file *m, struct mem_bw_ent *e, int key)
+{
+	seq_printf(m, "%d\t%-16s\t%u\t%u\t%u\t%llu\t%d\n", key, e->name,
+		   e->mbps, e->run_mbps, e->cpu_pct, e->total >> 10, e->bound);
+}
+
+static int mem_bw_tasks_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_puts(m, "tgid\tcomm\t\t\tmbps\trun_mbps\tcpu_pct\ttotal_kb\tbound\n");
+	spin_lock(&mba.lock);
+	for (i = 0; i < MEM_BW_TASKS; i++)
+		if (mba.task[i].key)
+			mem_bw_show_ent(m, &mba.task[i], mba.task[i].key);
+	if (mba.other.total)
+		mem_bw_show_ent(m, &mba.other, -1);
+	spin_unlock(&mba.lock);
+	return 0;
+}
+
+static int mem_bw_cgroups_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_puts(m, "id\tcgroup\t\t\tmbps\trun_mbps\tcpu_pct\ttotal_kb\n");
+	spin_lock(&mba.lock);
+	for (i = 0; i < mba.nr_cgrp; i++) {
+		struct mem_bw_ent *e = &mba.cgrp[i];
+
+		seq_printf(m, "%d\t%-16s\t%u\t%u\t%u\t%llu\n", e->key - 1,
+			   e->name, e->mbps, e->run_mbps, e->cpu_pct,
+			   e->total >> 10);
+	}
+	spin_unlock(&mba.lock);
+	return 0;
+}
+
+static int mem_bw_bound_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	spin_lock(&mba.lock);
+	for (i = 0; i < MEM_BW_TASKS; i++)
+		if (mba.task[i].key && mba.task[i].bound)
+			seq_printf(m, "%d %u\n", mba.task[i].key,
+				   mba.task[i].run_mbps);
+	spin_unlock(&mba.lock);
+	return 0;
+}
+
+static int mem_bw_summary_show(struct seq_file *m, void *v)
+{
+	spin_lock(&mba.lock);
+	seq_printf(m, "windows:\t%lu\n", mba.nr_windows);
+	seq_printf(m, "total_kb:\t%llu\n", mba.total >> 10);
+	seq_printf(m, "unattributed_kb:\t%llu\n", mba.unattributed >> 10);
+	seq_printf(m, "overflow_kb:\t%llu\n", mba.other.total >> 10);
+	spin_unlock(&mba.lock);
+	return 0;
+}
+
+#define PROC_FOPS_RO(name)						\
+static int mem_bw_ ## name ## _open(struct inode *inode, struct file *file) \
+{									\
+	return single_open(file, mem_bw_ ## name ## _show, NULL);	\
+}									\
+static const struct file_operations mem_bw_ ## name ## _fops = {	\
+	.open = mem_bw_ ## name ## _open,				\
+	.read = seq_read,						\
+	.llseek = seq_lseek,						\
+	.release = single_release,					\
+}
+
+PROC_FOPS_RO(tasks);
+PROC_FOPS_RO(cgroups);
+PROC_FOPS_RO(bound);
+PROC_FOPS_RO(summary);
+
+struct mem_bw_knob {
+	const char *name;
+	unsigned int *val;
+	unsigned int min, max;
+};
+
+static const struct mem_bw_knob mem_bw_knobs[] = {
+	{ "enable", &mem_bw_enable, 0, 1 },
+	{ "period_ms", &mem_bw_period_ms, 1, 1000 },
+	{ "bound_mbps", &mem_bw_bound_mbps, 0, UINT_MAX },
+	{ "bound_cpu_pct", &mem_bw_bound_cpu_pct, 0, 100 },
+};
+
+static int mem_bw_knob_show(struct seq_file *m, void *v)
+{
+	const struct mem_bw_knob *knob = m->private;
+
+	seq_printf(m, "%u\n", *knob->val);
+	return 0;
+}
+
+static int mem_bw_knob_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mem_bw_knob_show, PDE_DATA(inode));
+}
+
+static ssize_t mem_bw_knob_write(struct file *file, const char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	const struct mem_bw_knob *knob =
+		((struct seq_file *)file->private_data)->private;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint_from_user(ubuf, count, 0, &val);
+	if (ret)
+		return ret;
+	if (val < knob->min || val > knob->max)
+		return -EINVAL;
+
+	mutex_lock(&mem_bw_knob_lock);
+	if (knob->val == &mem_bw_enable && val != mem_bw_enable) {
+		if (val)
+			mem_bw_attr_start();
+		else
+			mem_bw_attr_stop();
+	}
+	*knob->val = val;
+	mutex_unlock(&mem_bw_knob_lock);
+	return count;
+}
+
+static const struct file_operations mem_bw_knob_fops = {
+	.open = mem_bw_knob_open,
+	.read = seq_read,
+	.write = mem_bw_knob_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*--------------------INIT------------------------*/
+
+static int __init mem_bw_attr_init(void)
+{
+	struct proc_dir_entry *dir;
+	int i;
+
+	INIT_DELAYED_WORK(&mba.sample_work, mem_bw_attr_sample);
+	INIT_WORK(&mba.report_work, mem_bw_attr_report);
+
+	dir = proc_mkdir("mem_bw", NULL);
+	if (!dir) {
+		pr_err(TAG"failed to create /proc/mem_bw\n");
+		return -ENOMEM;
+	}
+
+	proc_create("tasks", 0444, dir, &mem_bw_tasks_fops);
+	proc_create("cgroups", 0444, dir, &mem_bw_cgroups_fops);
+	proc_create("bound", 0444, dir, &mem_bw_bound_fops);
+	proc_create("summary", 0444, dir, &mem_bw_summary_fops);
+	for (i = 0; i < ARRAY_SIZE(mem_bw_knobs); i++)
+		proc_create_data(mem_bw_knobs[i].name, 0644, dir,
+				 &mem_bw_knob_fops, (void *)&mem_bw_knobs[i]);
+	return 0;
+}
+module_init(mem_bw_attr_init);
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Software stand-in for the EMI bandwidth counter. Registered as the
+ * get_mem_bw() callback, it makes up the bus traffic from a base rate for
+ * the other masters plus, for every configured process, a rate per
+ * second of CPU time the process used. The traffic it made up per
+ * process is kept as the truth the attribution in /proc/mem_bw/tasks can
+ * be compared against, on boards and virtual machines without an EMI
+ * bus monitor.
+ *
+ * /proc/mem_bw/standin takes "<tgid> <MB per CPU second>" lines, tgid 0
+ * sets the base rate in MB/s and a rate of 0 removes a process.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/pid.h>
+#include <linux/proc_fs.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include "mach/mt_mem_bw.h"
+#include <mt-plat/mem_bw_attr.h>
+
+#define TAG "[MEM_BW_STANDIN]"
+
+#define STANDIN_PROCS	8
+
+struct standin_proc {
+	pid_t tgid;		/* 0 for a free slot */
+	unsigned int mbps;	/* per CPU second */
+	u64 last_runtime;	/* ns */
+	u64 bytes;		/* made up so far */
+};
+
+static DEFINE_SPINLOCK(standin_lock);
+static struct standin_proc standin_proc[STANDIN_PROCS];
+static unsigned int standin_base_mbps;
+static u64 standin_base_bytes;
+static u64 standin_last_ns;
+
+/* called with rcu_read_lock held, 0 once the process is gone */
+static u64 standin_runtime(pid_t tgid)
+{
+	struct task_struct *p, *t;
+	u64 runtime;
+
+	p = pid_task(find_pid_ns(tgid, &init_pid_ns), PIDTYPE_PID);
+	if (!p)
+		return 0;
+
+	/* exited threads plus the live ones, a tick stale at most */
+	runtime = p->signal->sum_sched_runtime;
+	for_each_thread(p, t)
+		runtime += t->se.sum_exec_runtime;
+	return runtime;
+}
+
+/* getmembw_func, MB/s since the previous call */
+static unsigned long long standin_get_mem_bw(void)
+{
+	u64 now, period, bytes, runtime, delta;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&standin_lock, flags);
+	now = sched_clock();
+	period = now - standin_last_ns;
+	standin_last_ns = now;
+
+	/* MB/s * ns / 1000 = bytes */
+	bytes = div_u64((u64)standin_base_mbps * period, 1000);
+	standin_base_bytes += bytes;
+
+	rcu_read_lock();
+	for (i = 0; i < STANDIN_PROCS; i++) {
+		struct standin_proc *sp = &standin_proc[i];
+
+		if (!sp->tgid)
+			continue;
+		runtime = standin_runtime(sp->tgid);
+		delta = runtime > sp->last_runtime ? runtime - sp->last_runtime : 0;
+		sp->last_runtime = runtime;
+
+		delta = div_u64((u64)sp->mbps * delta, 1000);
+		sp->bytes += delta;
+		bytes += delta;
+	}
+	rcu_read_unlock();
+	spin_unlock_irqrestore(&standin_lock, flags);
+
+	return period ? div64_u64(bytes * 1000, period) : 0;
+}
+
+static int standin_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_puts(m, "tgid\tmbps\ttotal_kb\n");
+	spin_lock_irq(&standin_lock);
+	seq_printf(m, "0\t%u\t%llu\n", standin_base_mbps,
+		   standin_base_bytes >> 10);
+	for (i = 0; i < STANDIN_PROCS; i++)
+		if (standin_proc[i].tgid)
+			seq_printf(m, "%d\t%u\t%llu\n", standin_proc[i].tgid,
+				   standin_proc[i].mbps,
+				   standin_proc[i].bytes >> 10);
+	spin_unlock_irq(&standin_lock);
+	return 0;
+}
+
+static int standin_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, standin_show, NULL);
+}
+
+static ssize_t standin_write(struct file *file, const char __user *ubuf,
+			     size_t count, loff_t *ppos)
+{
+	struct standin_proc *sp = NULL;
+	unsigned int mbps;
+	char buf[32];
+	pid_t tgid;
+	int i;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	if (sscanf(buf, "%d %u", &tgid, &mbps) != 2 || tgid < 0)
+		return -EINVAL;
+
+	spin_lock_irq(&standin_lock);
+	if (!tgid) {
+		standin_base_mbps = mbps;
+		goto out;
+	}
+
+	for (i = 0; i < STANDIN_PROCS; i++) {
+		if (standin_proc[i].tgid == tgid) {
+			sp = &standin_proc[i];
+			break;
+		}
+		if (!sp && !standin_proc[i].tgid)
+			sp = &standin_proc[i];
+	}
+	if (!sp) {
+		spin_unlock_irq(&standin_lock);
+		return -ENOSPC;
+	}
+
+	if (!mbps) {
+		sp->tgid = 0;
+	} else if (sp->tgid != tgid) {
+		sp->tgid = tgid;
+		sp->bytes = 0;
+		rcu_read_lock();
+		sp->last_runtime = standin_runtime(tgid);
+		rcu_read_unlock();
+	}
+	sp->mbps = mbps;
+out:
+	spin_unlock_irq(&standin_lock);
+	return count;
+}
+
+static const struct file_operations standin_fops = {
+	.open = standin_open,
+	.read = seq_read,
+	.write = standin_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init standin_init(void)
+{
+	standin_last_ns = sched_clock();
+	mt_getmembw_registerCB(standin_get_mem_bw);
+
+	if (!proc_create("mem_bw/standin", 0644, NULL, &standin_fops))
+		pr_err(TAG"failed to create /proc/mem_bw/standin\n");
+	pr_warn(TAG"EMI bandwidth is made up, not measured\n");
+	return 0;
+}
+late_initcall(standin_init);
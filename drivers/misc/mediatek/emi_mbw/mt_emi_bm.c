@@ -17,6 +17,7 @@
 #include <linux/of_address.h>
 #include <mt-plat/mt_io.h>
 #include "mach/mt_emi_bm.h"
+#include <mt-plat/mem_bw_attr.h>
 
 static unsigned char g_cBWL;
 static void __iomem *EMI_BASE_ADDR; /* not initialise statics to 0 or NULL */
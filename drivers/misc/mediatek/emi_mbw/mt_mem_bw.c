@@ -17,20 +17,34 @@
 #include <linux/delay.h>
 #include <linux/platform_device.h>
 #include <linux/sched.h>
+#include <linux/spinlock.h>
 #include "mach/mt_emi_bm.h"
 #include "mach/mt_mem_bw.h"
+#include <mt-plat/mem_bw_attr.h>
 #include <asm/div64.h>
 
 unsigned long long last_time_ns;
 long long LastWordAllCount = 0;
 
+/* serializes samples, get_mem_bw() has several users */
+static DEFINE_SPINLOCK(mem_bw_lock);
+static u64 mem_bytes;	/* EMI bytes since boot */
+static bool mem_bw_hw;	/* bus monitor found and programmed */
+
 /***********************************************
  * register / unregister g_pGetMemBW CB
  ***********************************************/
+/*
+ * The callback is called from __get_mem_bw() with mem_bw_lock held and
+ * interrupts off, so it must not sleep.
+ */
 static getmembw_func g_pGetMemBW; /* not initialise statics to 0 or NULL */
 
 void mt_getmembw_registerCB(getmembw_func pCB)
 {
+	unsigned long flags;
+
+	spin_lock_irqsave(&mem_bw_lock, flags);
 	if (pCB == NULL) {
 		/* reset last time & word all count */
 		last_time_ns = sched_clock();
@@ -41,10 +55,12 @@ void mt_getmembw_registerCB(getmembw_func pCB)
 	}
 
 	g_pGetMemBW = pCB;
+	spin_unlock_irqrestore(&mem_bw_lock, flags);
 }
 EXPORT_SYMBOL(mt_getmembw_registerCB);
 
-unsigned long long get_mem_bw(void)
+/* called with mem_bw_lock held */
+static unsigned long long __get_mem_bw(void)
 {
 	unsigned long long throughput;
 	long long WordAllCount;
@@ -57,13 +73,22 @@ unsigned long long get_mem_bw(void)
 	return 0;
 #endif
 
-	if (g_pGetMemBW)
-		return g_pGetMemBW();
+	current_time_ns = sched_clock();
+	time_period_ns = current_time_ns - last_time_ns;
+
+	if (g_pGetMemBW) {
+		throughput = g_pGetMemBW();
+		last_time_ns = current_time_ns;
+		/* MB/s * ns / 1000 = bytes */
+		mem_bytes += div_u64(throughput * time_period_ns, 1000);
+		return throughput;
+	}
+
+	if (!mem_bw_hw)
+		return 0;
 
 	emi_dcm_disable = BM_GetEmiDcm();
 	/* pr_err("[get_mem_bw]emi_dcm_disable = %d\n", emi_dcm_disable); */
-	current_time_ns = sched_clock();
-	time_period_ns = current_time_ns - last_time_ns;
 	/* pr_err("[get_mem_bw]last_time=%llu, current_time=%llu,
 	period=%llu\n", last_time_ns, current_time_ns, time_period_ns); */
 
@@ -83,6 +108,8 @@ unsigned long long get_mem_bw(void)
 	}
 
 	WordAllCount -= LastWordAllCount;
+	if (WordAllCount > 0)
+		mem_bytes += WordAllCount * 8;
 	throughput = (WordAllCount * 8 * 1000);
 
 	if (time_period_ns >= 0xFFFFFFFF) { /* uint32_t overflow */
@@ -138,9 +165,37 @@ unsigned long long get_mem_bw(void)
 	return throughput;
 }
 
+unsigned long long get_mem_bw(void)
+{
+	unsigned long long throughput;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mem_bw_lock, flags);
+	throughput = __get_mem_bw();
+	spin_unlock_irqrestore(&mem_bw_lock, flags);
+
+	return throughput;
+}
+
+u64 get_mem_bytes(void)
+{
+	unsigned long flags;
+	u64 bytes;
+
+	spin_lock_irqsave(&mem_bw_lock, flags);
+	__get_mem_bw();
+	bytes = mem_bytes;
+	spin_unlock_irqrestore(&mem_bw_lock, flags);
+
+	return bytes;
+}
+EXPORT_SYMBOL(get_mem_bytes);
+
 static int mem_bw_suspend_callback(struct device *dev)
 {
 	/*pr_err("[get_mem_bw]mem_bw_suspend_callback\n");*/
+	if (!mem_bw_hw)
+		return 0;
 	LastWordAllCount = 0;
 	BM_Pause();
 	return 0;
@@ -149,7 +204,8 @@ static int mem_bw_suspend_callback(struct device *dev)
 static int mem_bw_resume_callback(struct device *dev)
 {
 	/* pr_err("[get_mem_bw]mem_bw_resume_callback\n"); */
-	BM_Continue();
+	if (mem_bw_hw)
+		BM_Continue();
 	return 0;
 }
 
@@ -180,6 +236,10 @@ static int __init mon_kernel_init(void)
 	int emi_dcm_disable;
 
 	BM_Init();
+	if (!mt_emi_base_get()) {
+		pr_err("[MT_MEM_BW] no EMI bus monitor, get_mem_bw() needs a CB\n");
+		goto register_pdev;
+	}
 
 	/* disable_infra_dcm(); */
 	emi_dcm_disable = BM_GetEmiDcm();
@@ -206,10 +266,12 @@ static int __init mon_kernel_init(void)
 	/* start EMI monitor counting */
 	BM_Enable(1);
 	last_time_ns = sched_clock();
+	mem_bw_hw = true;
 
 	/* restore_infra_dcm(); */
 	BM_SetEmiDcm(emi_dcm_disable);	/* enable EMI dcm */
 
+register_pdev:
 	/* register platform device/driver */
 	ret = platform_device_register(&mt_mem_bw_pdev);
 	if (ret) {
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __BOOST_ARB_H__
+#define __BOOST_ARB_H__
+
+enum boost_src {
+	BOOST_SRC_TOUCH,
+	BOOST_SRC_FRAME,
+	BOOST_SRC_DYNAMIC,
+	BOOST_SRC_USB,
+	NR_BOOST_SRC
+};
+
+/* largest limits a request can carry, larger values are clamped */
+#define BOOST_CORE_MAX	(0x7f)
+#define BOOST_FREQ_MAX	(0xffffff)	/* KHz */
+
+/* clusters a request can address, cluster 0 is the little one */
+#define BOOST_CLUSTER_MAX	(3)
+
+struct boost_limit {
+	int core[BOOST_CLUSTER_MAX];	/* min online cores, 0 for no floor */
+	int freq[BOOST_CLUSTER_MAX];	/* min KHz, 0 for no floor */
+};
+
+/*
+ * Request the per-cluster floors of @limit on behalf of @src, replacing
+ * the previous request of @src. The request ends after @ms milliseconds,
+ * or on boost_arb_release() if @ms is 0. Lock free and callable from any
+ * context but NMI. Returns 1 if the request woke the arbiter, 0 if it only
+ * refreshed a live request with the same limit.
+ */
+extern int boost_arb_request(enum boost_src src, const struct boost_limit *limit,
+			     unsigned int ms);
+extern void boost_arb_release(enum boost_src src);
+extern bool boost_arb_active(enum boost_src src);
+
+/* cluster topology as seen by the arbiter, at most BOOST_CLUSTER_MAX */
+extern int boost_arb_nr_clusters(void);
+extern int boost_arb_cluster_cores(int cluster);
+
+extern int init_boost_arb(void);
+extern void boost_arb_suspend(void);
+
+#endif				/* !__BOOST_ARB_H__ */
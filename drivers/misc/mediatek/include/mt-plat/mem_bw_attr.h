@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MEM_BW_ATTR_H__
+#define __MEM_BW_ATTR_H__
+
+#include <linux/types.h>
+
+/*
+ * EMI bytes moved since boot. Every get_mem_bw() sample advances it, so
+ * callers of get_mem_bw() and get_mem_bytes() do not steal each other's
+ * windows.
+ */
+extern u64 get_mem_bytes(void);
+
+/* mapped EMI registers, NULL when the EMI node is missing */
+extern void *mt_emi_base_get(void);
+
+#endif				/* !__MEM_BW_ATTR_H__ */
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MTK_SAMPLER_H__
+#define __MTK_SAMPLER_H__
+
+#include <linux/list.h>
+
+/* keep sampling while the screen is off */
+#define MTK_SAMPLER_SCREEN_OFF	(1U << 0)
+/* never wake an idle cpu, run on the next wakeup after the period */
+#define MTK_SAMPLER_DEFERRABLE	(1U << 1)
+
+struct mtk_sampler {
+	const char *name;
+	unsigned int period_ms;
+	unsigned int slack_ms;	/* how early or late a run may be */
+	unsigned int flags;
+	void (*fn)(struct mtk_sampler *s);
+
+	/* private, under the sampler lock */
+	struct list_head node;
+	unsigned long due;	/* jiffies */
+	unsigned long runs;
+	unsigned long wakeups;	/* runs the sampler armed the timer for */
+};
+
+/*
+ * Samplers run from one work on the housekeeping cpu. Every run calls all
+ * samplers due within their slack, so samplers with close deadlines share
+ * one wakeup, non-deferrable samplers first. @fn runs in process context,
+ * should be short and must not register or unregister samplers.
+ */
+extern int mtk_sampler_register(struct mtk_sampler *s);
+extern void mtk_sampler_unregister(struct mtk_sampler *s);
+/* change the period, the next run is rescheduled from the last one */
+extern void mtk_sampler_set_period(struct mtk_sampler *s, unsigned int period_ms);
+
+#endif				/* !__MTK_SAMPLER_H__ */
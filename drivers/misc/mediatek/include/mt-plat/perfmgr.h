@@ -19,6 +19,10 @@ extern int perfmgr_touch_suspend(void);
 
 extern int  perfmgr_get_target_core(void);
 extern int  perfmgr_get_target_freq(void);
-extern void perfmgr_boost(int enable, int core, int freq);
+/*
+ * Apply per-cluster floors, BOOST_CLUSTER_MAX entries each, 0 for no
+ * floor. Called by the boost arbiter only when a floor changes.
+ */
+extern void perfmgr_boost(const int *core, const int *freq);
 
 #endif				/* !__PERFMGR_H__ */
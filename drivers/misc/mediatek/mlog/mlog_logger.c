@@ -28,6 +28,7 @@
 #include <linux/seq_file.h>
 #include <asm/uaccess.h>
 #include <linux/version.h>
+#include <mt-plat/mtk_sampler.h>
 
 
 #ifdef CONFIG_MTK_GPU_SUPPORT
@@ -129,7 +130,6 @@ static int min_adj = -1000;
 static int max_adj = 1000;
 static int limit_pid = -1;
 
-static struct timer_list mlog_timer;
 static unsigned long timer_intval = HZ;
 
 static const char **strfmt_list;
@@ -962,27 +962,32 @@ ssize_t dmlog_read(struct file *file, char __user *buf, size_t len, loff_t *ppos
 	return size;
 }
 
-static void mlog_timer_handler(unsigned long data)
+static void mlog_sample(struct mtk_sampler *s)
 {
 	mlog(MLOG_TRIGGER_TIMER);
-
-	mod_timer(&mlog_timer, round_jiffies(jiffies + timer_intval));
 }
 
+/* the log only needs to be roughly periodic, never wake a cpu for it */
+static struct mtk_sampler mlog_sampler = {
+	.name = "mlog",
+	.slack_ms = 250,
+	.flags = MTK_SAMPLER_DEFERRABLE,
+	.fn = mlog_sample,
+};
+
 static void mlog_init_logger(void)
 {
 	spin_lock_init(&mlogbuf_lock);
 	mlog_reset_format();
 	mlog_reset_buffer();
 
-	setup_timer(&mlog_timer, mlog_timer_handler, 0);
-	mlog_timer.expires = jiffies + timer_intval;
-
-	add_timer(&mlog_timer);
+	mlog_sampler.period_ms = jiffies_to_msecs(timer_intval);
+	mtk_sampler_register(&mlog_sampler);
 }
 
 static void mlog_exit_logger(void)
 {
+	mtk_sampler_unregister(&mlog_sampler);
 
 	kfree(strfmt_list);
 	strfmt_list = NULL;
@@ -1023,7 +1028,8 @@ static int do_time_intval_handler(const char *val, const struct kernel_param *kp
 {
 	const int ret = param_set_uint(val, kp);
 
-	mod_timer(&mlog_timer, jiffies + ret);
+	if (!ret)
+		mtk_sampler_set_period(&mlog_sampler, jiffies_to_msecs(timer_intval));
 	return ret;
 }
 
@@ -12,6 +12,7 @@
  */
 #include "perf_ioctl.h"
 #include "perfmgr.h"
+#include "boost_arb.h"
 
 static void notify_ui_update_timeout(void);
 static void notify_render_aware_timeout(void);
@@ -70,6 +71,20 @@ static enum hrtimer_restart mt_render_aware_timeout(struct hrtimer *timer)
 }
 
 /*--------------------FRAME HINT OP------------------------*/
+static void perf_ioctl_boost(void)
+{
+	/* the target core and freq are those of the little cluster */
+	struct boost_limit limit = {
+		.core = { tboost_core },
+		.freq = { tboost_freq },
+	};
+
+	if (is_render_aware_boost | is_touch_boost)
+		boost_arb_request(BOOST_SRC_FRAME, &limit, 0);
+	else
+		boost_arb_release(BOOST_SRC_FRAME);
+}
+
 static void notify_touch(int action)
 {
 	/* lock is mandatory*/
@@ -81,12 +96,12 @@ static void notify_touch(int action)
 		is_touch_boost = 1;
 		disable_render_aware_timer();
 		pr_debug(TAG"enable UI boost, touch down, is_touch_boost:%d\n", is_touch_boost);
-		perfmgr_boost(is_render_aware_boost | is_touch_boost, tboost_core, tboost_freq);
+		perf_ioctl_boost();
 	} else if (action == 0) {
 		enable_render_aware_timer();
 		is_touch_boost = 0;
 		pr_debug(TAG"enable UI boost, touch up, is_touch_boost:%d\n", is_touch_boost);
-		perfmgr_boost(is_render_aware_boost | is_touch_boost, tboost_core, tboost_freq);
+		perf_ioctl_boost();
 	}
 }
 
@@ -97,7 +112,7 @@ static void notify_ui_update_timeout(void)
 	render_aware_valid = 0;
 	is_render_aware_boost = 0;
 	pr_debug(TAG"enable UI boost, frame noupdate, is_render_aware_boost:%d\n", is_render_aware_boost);
-	perfmgr_boost(is_render_aware_boost | is_touch_boost, tboost_core, tboost_freq);
+	perf_ioctl_boost();
 
 	mutex_unlock(&notify_lock);
 
@@ -109,7 +124,7 @@ static void notify_render_aware_timeout(void)
 	render_aware_valid = 0;
 	is_render_aware_boost = 0;
 	pr_debug(TAG"enable UI boost, render aware time out, is_render_aware_boost:%d\n", is_render_aware_boost);
-	perfmgr_boost(is_render_aware_boost | is_touch_boost, tboost_core, tboost_freq);
+	perf_ioctl_boost();
 
 	mutex_unlock(&notify_lock);
 }
@@ -125,7 +140,7 @@ void notify_frame_complete(long frame_time)
 	enable_ui_update_timer();
 	is_render_aware_boost = 1;
 	pr_debug(TAG"enable UI boost, frame update, is_render_aware_boost:%d", is_render_aware_boost);
-	perfmgr_boost(is_render_aware_boost | is_touch_boost, tboost_core, tboost_freq);
+	perf_ioctl_boost();
 }
 
 /*--------------------DEV OP------------------------*/
@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Boost arbitration. Every boost source (touch, frame hints, dynamic_boost,
+ * usb_boost) owns one row of a request table, one slot per cluster, and
+ * publishes its request with an atomic store per slot. One worker folds
+ * the live slots into the largest core and frequency floor of each
+ * cluster and applies them with one perfmgr_boost() call, so a touch seen
+ * by several sources costs one PPM update.
+ */
+
+#include <linux/atomic.h>
+#include <linux/cpumask.h>
+#include <linux/jiffies.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/topology.h>
+#include <linux/wait.h>
+
+#include "perfmgr.h"
+#include "boost_arb.h"
+
+#undef TAG
+#define TAG "[BOOST_ARB]"
+
+/*
+ * Slot layout: bit 63 hold (no deadline), bits 62-56 cores, bits 55-32
+ * freq in KHz, bits 31-0 deadline in jiffies. Zero is an idle slot.
+ */
+#define SLOT_HOLD		(1ULL << 63)
+#define SLOT_CORE_SHIFT		56
+#define SLOT_FREQ_SHIFT		32
+#define SLOT_LIMIT_SHIFT	SLOT_FREQ_SHIFT
+
+#define slot_core(v)		((int)(((v) >> SLOT_CORE_SHIFT) & BOOST_CORE_MAX))
+#define slot_freq(v)		((int)(((v) >> SLOT_FREQ_SHIFT) & BOOST_FREQ_MAX))
+#define slot_deadline(v)	((u32)(v))
+
+static atomic64_t boost_slot[NR_BOOST_SRC][BOOST_CLUSTER_MAX];
+static atomic_t boost_kicks[NR_BOOST_SRC];
+
+static const char * const boost_src_name[NR_BOOST_SRC] = {
+	"touch",
+	"frame",
+	"dynamic",
+	"usb",
+};
+
+static struct boost_arb {
+	struct mutex lock;	/* serializes applying the limit */
+	wait_queue_head_t wq;
+	struct task_struct *thread;
+	atomic_t event;
+	atomic64_t pending;	/* ktime of the oldest unserved request */
+	int core[BOOST_CLUSTER_MAX];	/* limit applied to PPM */
+	int freq[BOOST_CLUSTER_MAX];
+	/* under lock */
+	unsigned long nr_update;
+	unsigned long nr_apply;
+	u64 lat_last;		/* ns from request to PPM update */
+	u64 lat_max;
+	u64 lat_total;
+	unsigned long nr_lat;
+} arb = {
+	.lock = __MUTEX_INITIALIZER(arb.lock),
+	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(arb.wq),
+	.event = ATOMIC_INIT(0),
+	.pending = ATOMIC64_INIT(0),
+};
+
+/*--------------------FUNCTION----------------*/
+
+static inline bool slot_live(u64 v, u32 now)
+{
+	if (!v)
+		return false;
+	if (v & SLOT_HOLD)
+		return true;
+	return (s32)(slot_deadline(v) - now) > 0;
+}
+
+/* @new leaves the applied limit and the worker's next deadline alone */
+static inline bool slot_refresh(u64 old, u64 new, u32 now)
+{
+	if (!new)
+		return !slot_live(old, now);
+
+	/*
+	 * Same limit, still live and not ending earlier: the worker either
+	 * sleeps until a deadline at or before ours or not at all, and will
+	 * see the new deadline when it gets there.
+	 */
+	return slot_live(old, now) &&
+	       (old >> SLOT_LIMIT_SHIFT) == (new >> SLOT_LIMIT_SHIFT) &&
+	       ((new & SLOT_HOLD) ||
+		(s32)(slot_deadline(new) - slot_deadline(old)) >= 0);
+}
+
+static void boost_arb_kick(enum boost_src src)
+{
+	atomic_inc(&boost_kicks[src]);
+	atomic64_cmpxchg(&arb.pending, 0, ktime_to_ns(ktime_get()));
+	atomic_set(&arb.event, 1);
+	wake_up(&arb.wq);
+}
+
+/*
+ * The slots of a request are stored one by one. The worker may fold a
+ * request that is half written, but the kick at the end makes it fold
+ * again once the whole request is visible.
+ */
+int boost_arb_request(enum boost_src src, const struct boost_limit *limit,
+		      unsigned int ms)
+{
+	u32 now = (u32)jiffies;
+	bool refresh = true;
+	u64 stamp, old, new;
+	int i, core, freq;
+
+	if (src >= NR_BOOST_SRC)
+		return -EINVAL;
+
+	stamp = ms ? (u32)(now + msecs_to_jiffies(ms)) : SLOT_HOLD;
+
+	for (i = 0; i < BOOST_CLUSTER_MAX; i++) {
+		core = clamp(limit->core[i], 0, BOOST_CORE_MAX);
+		freq = clamp(limit->freq[i], 0, BOOST_FREQ_MAX);
+		new = 0;
+		if (core || freq)
+			new = (u64)core << SLOT_CORE_SHIFT |
+			      (u64)freq << SLOT_FREQ_SHIFT | stamp;
+
+		old = atomic64_xchg(&boost_slot[src][i], new);
+		if (!slot_refresh(old, new, now))
+			refresh = false;
+	}
+
+	if (refresh)
+		return 0;
+
+	boost_arb_kick(src);
+	return 1;
+}
+EXPORT_SYMBOL(boost_arb_request);
+
+void boost_arb_release(enum boost_src src)
+{
+	u32 now = (u32)jiffies;
+	bool live = false;
+	int i;
+
+	if (src >= NR_BOOST_SRC)
+		return;
+
+	for (i = 0; i < BOOST_CLUSTER_MAX; i++)
+		if (slot_live(atomic64_xchg(&boost_slot[src][i], 0), now))
+			live = true;
+
+	if (live)
+		boost_arb_kick(src);
+}
+EXPORT_SYMBOL(boost_arb_release);
+
+bool boost_arb_active(enum boost_src src)
+{
+	u32 now = (u32)jiffies;
+	int i;
+
+	if (src >= NR_BOOST_SRC)
+		return false;
+
+	for (i = 0; i < BOOST_CLUSTER_MAX; i++)
+		if (slot_live(atomic64_read(&boost_slot[src][i]), now))
+			return true;
+	return false;
+}
+EXPORT_SYMBOL(boost_arb_active);
+
+int boost_arb_nr_clusters(void)
+{
+	return clamp(arch_get_nr_clusters(), 1, BOOST_CLUSTER_MAX);
+}
+EXPORT_SYMBOL(boost_arb_nr_clusters);
+
+int boost_arb_cluster_cores(int cluster)
+{
+	struct cpumask cpus;
+
+	arch_get_cluster_cpus(&cpus, cluster);
+	return cpumask_weight(&cpus);
+}
+EXPORT_SYMBOL(boost_arb_cluster_cores);
+
+static void boost_arb_apply(const int *core, const int *freq)
+{
+#ifdef MTK_BOOST_SUPPORT
+	perfmgr_boost(core, freq);
+#endif
+}
+
+/* fold the live slots into one limit, returns jiffies to the next deadline */
+static long boost_arb_update(void)
+{
+	long timeout = MAX_SCHEDULE_TIMEOUT;
+	int core[BOOST_CLUSTER_MAX] = { 0 };
+	int freq[BOOST_CLUSTER_MAX] = { 0 };
+	u32 now = (u32)jiffies;
+	int i, c;
+	s64 start;
+	u64 v, old;
+
+	for (i = 0; i < NR_BOOST_SRC; i++) {
+		for (c = 0; c < BOOST_CLUSTER_MAX; c++) {
+			v = atomic64_read(&boost_slot[i][c]);
+
+			/* retire expired slots unless the owner refreshed them meanwhile */
+			while (v && !slot_live(v, now)) {
+				old = atomic64_cmpxchg(&boost_slot[i][c], v, 0);
+				v = (old == v) ? 0 : old;
+			}
+			if (!v)
+				continue;
+
+			core[c] = max(core[c], slot_core(v));
+			freq[c] = max(freq[c], slot_freq(v));
+			if (!(v & SLOT_HOLD))
+				timeout = min_t(long, timeout, (s32)(slot_deadline(v) - now));
+		}
+	}
+
+	start = atomic64_xchg(&arb.pending, 0);
+
+	mutex_lock(&arb.lock);
+	arb.nr_update++;
+	if (memcmp(core, arb.core, sizeof(core)) || memcmp(freq, arb.freq, sizeof(freq))) {
+		boost_arb_apply(core, freq);
+		memcpy(arb.core, core, sizeof(core));
+		memcpy(arb.freq, freq, sizeof(freq));
+		arb.nr_apply++;
+
+		if (start) {
+			arb.lat_last = ktime_to_ns(ktime_get()) - start;
+			arb.lat_max = max(arb.lat_max, arb.lat_last);
+			arb.lat_total += arb.lat_last;
+			arb.nr_lat++;
+		}
+	}
+	mutex_unlock(&arb.lock);
+
+	return timeout;
+}
+
+static int boost_arb_thread(void *ptr)
+{
+	long timeout;
+
+	set_user_nice(current, -10);
+
+	while (!kthread_should_stop()) {
+		/* requests from here on are seen by this update or wake the next */
+		atomic_xchg(&arb.event, 0);
+		timeout = boost_arb_update();
+
+		wait_event_timeout(arb.wq,
+				   atomic_read(&arb.event) || kthread_should_stop(),
+				   timeout);
+	}
+	return 0;
+}
+
+void boost_arb_suspend(void)
+{
+	static const int none[BOOST_CLUSTER_MAX];
+	int i, c;
+
+	for (i = 0; i < NR_BOOST_SRC; i++)
+		for (c = 0; c < BOOST_CLUSTER_MAX; c++)
+			atomic64_set(&boost_slot[i][c], 0);
+
+	mutex_lock(&arb.lock);
+	if (memcmp(arb.core, none, sizeof(none)) || memcmp(arb.freq, none, sizeof(none))) {
+		boost_arb_apply(none, none);
+		memset(arb.core, 0, sizeof(arb.core));
+		memset(arb.freq, 0, sizeof(arb.freq));
+	}
+	mutex_unlock(&arb.lock);
+}
+
+static int boost_arb_stat_show(struct seq_file *m, void *v)
+{
+	u32 now = (u32)jiffies;
+	bool live;
+	u64 slot;
+	int i, c;
+
+	mutex_lock(&arb.lock);
+	for (c = 0; c < BOOST_CLUSTER_MAX; c++)
+		seq_printf(m, "cluster%d:\tcore %d\tfreq %d\n", c, arb.core[c], arb.freq[c]);
+	seq_printf(m, "updates:\t%lu\n", arb.nr_update);
+	seq_printf(m, "applied:\t%lu\n", arb.nr_apply);
+	seq_printf(m, "latency_last_us:\t%llu\n", div_u64(arb.lat_last, NSEC_PER_USEC));
+	seq_printf(m, "latency_avg_us:\t%llu\n",
+		   arb.nr_lat ? div_u64(div_u64(arb.lat_total, arb.nr_lat), NSEC_PER_USEC) : 0);
+	seq_printf(m, "latency_max_us:\t%llu\n", div_u64(arb.lat_max, NSEC_PER_USEC));
+	mutex_unlock(&arb.lock);
+
+	seq_puts(m, "\nsource\t\trequests\tcluster\tcore\tfreq\texpire_ms\n");
+	for (i = 0; i < NR_BOOST_SRC; i++) {
+		live = false;
+		for (c = 0; c < BOOST_CLUSTER_MAX; c++) {
+			slot = atomic64_read(&boost_slot[i][c]);
+			if (!slot_live(slot, now))
+				continue;
+			live = true;
+			seq_printf(m, "%-8s\t%d\t\t%d\t%d\t%d\t", boost_src_name[i],
+				   atomic_read(&boost_kicks[i]), c, slot_core(slot), slot_freq(slot));
+			if (slot & SLOT_HOLD)
+				seq_puts(m, "hold\n");
+			else
+				seq_printf(m, "%u\n", jiffies_to_msecs(slot_deadline(slot) - now));
+		}
+		if (!live)
+			seq_printf(m, "%-8s\t%d\t\t-\t-\t-\t-\n", boost_src_name[i],
+				   atomic_read(&boost_kicks[i]));
+	}
+	return 0;
+}
+
+static int boost_arb_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boost_arb_stat_show, inode->i_private);
+}
+
+static const struct file_operations boost_arb_stat_fops = {
+	.open = boost_arb_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*--------------------INIT------------------------*/
+
+int init_boost_arb(void)
+{
+	struct proc_dir_entry *boost_dir = NULL;
+
+	boost_dir = proc_mkdir("perfmgr/boost", NULL);
+	proc_create("stat", 0444, boost_dir, &boost_arb_stat_fops);
+
+	/* requests made before this point are picked up by the first update */
+	arb.thread = kthread_run(boost_arb_thread, &arb, "boost_arb");
+	if (IS_ERR(arb.thread)) {
+		pr_err(TAG"failed to start boost_arb thread\n");
+		return PTR_ERR(arb.thread);
+	}
+
+	return 0;
+}
@@ -22,13 +22,21 @@
 #include <linux/platform_device.h>
 #include <mach/mt_lbc.h>
 
+#include "perfmgr.h"
+#include "boost_arb.h"
+
 /*--------------DEFAULT SETTING-------------------*/
 
 #define TARGET_CORE (3)
 #define TARGET_FREQ (819000)
+#define CLUSTER_NUM (1)
 
 /*-----------------------------------------------*/
 
+#if CLUSTER_NUM > BOOST_CLUSTER_MAX
+#error "CLUSTER_NUM exceeds BOOST_CLUSTER_MAX"
+#endif
+
 int perfmgr_get_target_core(void)
 {
 	return TARGET_CORE;
@@ -39,23 +47,20 @@ int perfmgr_get_target_freq(void)
 	return TARGET_FREQ;
 }
 
-void perfmgr_boost(int enable, int core, int freq)
+/* per-cluster floors from the boost arbiter, 0 is no floor */
+void perfmgr_boost(const int *core, const int *freq)
 {
-	struct ppm_limit_data core_to_set, freq_to_set;
-
-	if (enable) {
-		core_to_set.min = core;
-		core_to_set.max = -1;
-		freq_to_set.min = freq;
-		freq_to_set.max = -1;
-	} else {
-		core_to_set.min = -1;
-		core_to_set.max = -1;
-		freq_to_set.min = -1;
-		freq_to_set.max = -1;
+	struct ppm_limit_data core_to_set[CLUSTER_NUM];
+	struct ppm_limit_data freq_to_set[CLUSTER_NUM];
+	int i;
+
+	for (i = 0; i < CLUSTER_NUM; i++) {
+		core_to_set[i].min = core[i] ? core[i] : -1;
+		core_to_set[i].max = -1;
+		freq_to_set[i].min = freq[i] ? freq[i] : -1;
+		freq_to_set[i].max = -1;
 	}
 
-	update_userlimit_cpu_core(PPM_KIR_PERF_KERN, 1, &core_to_set);
-	update_userlimit_cpu_freq(PPM_KIR_PERF_KERN, 1, &freq_to_set);
+	update_userlimit_cpu_core(PPM_KIR_PERF_KERN, CLUSTER_NUM, core_to_set);
+	update_userlimit_cpu_freq(PPM_KIR_PERF_KERN, CLUSTER_NUM, freq_to_set);
 }
-
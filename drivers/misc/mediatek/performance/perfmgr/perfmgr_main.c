@@ -17,6 +17,7 @@
 
 #include <linux/platform_device.h>
 #include "perfmgr.h"
+#include "boost_arb.h"
 
 /*--------------------prototype--------------------*/
 
@@ -37,6 +38,7 @@ int perfmgr_suspend(struct device *dev)
 #ifdef MTK_TOUCH_BOOST
 	perfmgr_touch_suspend();
 #endif
+	boost_arb_suspend();
 	return 0;
 }
 
@@ -73,6 +75,7 @@ static int __init init_perfmgr(void)
 
 
 	hps_dir = proc_mkdir("perfmgr", NULL);
+	init_boost_arb();
 #ifdef MTK_TOUCH_BOOST
 	init_perfmgr_touch();
 #endif
@@ -22,11 +22,11 @@
 #include <linux/string.h>
 #include <linux/notifier.h>
 #include <linux/slab.h>
-#include <linux/kthread.h>
 #include <linux/input.h>
 
 #include <linux/platform_device.h>
 #include "perfmgr.h"
+#include "boost_arb.h"
 
 /*--------------------------------------------*/
 
@@ -43,17 +43,9 @@
 #define MAX_CORE (8)
 #define MAX_FREQ (20000000)
 
-struct touch_boost {
-	spinlock_t touch_lock;
-	wait_queue_head_t wq;
-	struct task_struct *thread;
-	int touch_event;
-	atomic_t event;
-};
-
 /*--------------------------------------------*/
 
-static struct touch_boost tboost;
+static DEFINE_SPINLOCK(touch_lock);
 
 static int perf_mgr_touch_enable = 1;
 static int perf_mgr_touch_core = 1;
@@ -61,31 +53,6 @@ static int perf_mgr_touch_freq = 1;
 
 /*--------------------FUNCTION----------------*/
 
-static int tboost_thread(void *ptr)
-{
-	int event, core, freq;
-	unsigned long flags;
-
-	set_user_nice(current, -10);
-
-	while (!kthread_should_stop()) {
-
-		while (!atomic_read(&tboost.event))
-			wait_event(tboost.wq, atomic_read(&tboost.event));
-		atomic_dec(&tboost.event);
-
-		spin_lock_irqsave(&tboost.touch_lock, flags);
-		event = tboost.touch_event;
-		core = perf_mgr_touch_core;
-		freq = perf_mgr_touch_freq;
-		spin_unlock_irqrestore(&tboost.touch_lock, flags);
-#ifdef MTK_BOOST_SUPPORT
-		perfmgr_boost(event, core, freq);
-#endif
-	}
-	return 0;
-}
-
 static ssize_t perfmgr_tb_enable_write(struct file *filp, const char *ubuf,
 		size_t cnt, loff_t *data)
 {
@@ -107,9 +74,9 @@ static ssize_t perfmgr_tb_enable_write(struct file *filp, const char *ubuf,
 	if (val > 1)
 		return -1;
 
-	spin_lock_irqsave(&tboost.touch_lock, flags);
+	spin_lock_irqsave(&touch_lock, flags);
 	perf_mgr_touch_enable = val;
-	spin_unlock_irqrestore(&tboost.touch_lock, flags);
+	spin_unlock_irqrestore(&touch_lock, flags);
 
 	return cnt;
 }
@@ -154,9 +121,9 @@ static ssize_t perfmgr_tb_core_write(struct file *filp, const char *ubuf,
 	if (val > MAX_CORE)
 		return -1;
 
-	spin_lock_irqsave(&tboost.touch_lock, flags);
+	spin_lock_irqsave(&touch_lock, flags);
 	perf_mgr_touch_core = val;
-	spin_unlock_irqrestore(&tboost.touch_lock, flags);
+	spin_unlock_irqrestore(&touch_lock, flags);
 
 	return cnt;
 }
@@ -201,9 +168,9 @@ static ssize_t perfmgr_tb_freq_write(struct file *filp, const char *ubuf,
 	if (val > MAX_FREQ)
 		return -1;
 
-	spin_lock_irqsave(&tboost.touch_lock, flags);
+	spin_lock_irqsave(&touch_lock, flags);
 	perf_mgr_touch_freq = val;
-	spin_unlock_irqrestore(&tboost.touch_lock, flags);
+	spin_unlock_irqrestore(&touch_lock, flags);
 
 	return cnt;
 }
@@ -230,6 +197,11 @@ static const struct file_operations perfmgr_tb_freq_fops = {
 static void dbs_input_event(struct input_handle *handle, unsigned int type,
 			    unsigned int code, int value)
 {
+	/* the target core and freq are those of the little cluster */
+	struct boost_limit limit = {
+		.core = { perf_mgr_touch_core },
+		.freq = { perf_mgr_touch_freq },
+	};
 	unsigned long flags;
 
 	if (!perf_mgr_touch_enable)
@@ -237,12 +209,13 @@ static void dbs_input_event(struct input_handle *handle, unsigned int type,
 
 	if ((type == EV_KEY) && (code == BTN_TOUCH)) {
 		pr_debug(TAG"input cb, type:%d, code:%d, value:%d\n", type, code, value);
-		spin_lock_irqsave(&tboost.touch_lock, flags);
-		tboost.touch_event = value;
-		spin_unlock_irqrestore(&tboost.touch_lock, flags);
-
-		atomic_inc(&tboost.event);
-		wake_up(&tboost.wq);
+		/* held from touch down to touch up */
+		spin_lock_irqsave(&touch_lock, flags);
+		if (value)
+			boost_arb_request(BOOST_SRC_TOUCH, &limit, 0);
+		else
+			boost_arb_release(BOOST_SRC_TOUCH);
+		spin_unlock_irqrestore(&touch_lock, flags);
 	}
 }
 
@@ -318,13 +291,6 @@ int init_perfmgr_touch(void)
 	proc_create("tb_core", 0644, touch_dir, &perfmgr_tb_core_fops);
 	proc_create("tb_freq", 0644, touch_dir, &perfmgr_tb_freq_fops);
 
-	spin_lock_init(&tboost.touch_lock);
-	init_waitqueue_head(&tboost.wq);
-	atomic_set(&tboost.event, 0);
-	tboost.thread = (struct task_struct *)kthread_run(tboost_thread, &tboost, "touch_boost");
-	if (IS_ERR(tboost.thread))
-		return -EINVAL;
-
 	handle = input_register_handler(&dbs_input_handler);
 
 	return 0;
@@ -333,9 +299,7 @@ int init_perfmgr_touch(void)
 int perfmgr_touch_suspend(void)
 {
 	/*pr_debug(TAG"perfmgr_touch_suspend\n");*/
-#ifdef MTK_BOOST_SUPPORT
-	perfmgr_boost(0, 0, 0);
-#endif
+	boost_arb_release(BOOST_SRC_TOUCH);
 	return 0;
 }
 
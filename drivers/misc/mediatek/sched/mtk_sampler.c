@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Shared scheduler for the periodic kernel samplers (mlog, the thermal
+ * monitor, HPS). Each of them used to arm a timer of its own and wake a
+ * cpu out of deep idle on its own schedule. Here one work on the
+ * housekeeping cpu runs every sampler that is due within its slack, so
+ * samplers with close deadlines share a wakeup.
+ *
+ * Of the current users only mlog pauses with the screen off and never
+ * wakes an idle cpu. Thermal sysinfo keeps sampling with the screen off,
+ * and HPS only runs from here in HPS_PERIODICAL_BY_SAMPLER mode; its
+ * default stays its own hrtimer. GED and rq_stats keep their own timers.
+ *
+ * Two works are armed: a deferrable one at the earliest deadline, which
+ * is served whenever the cpu is awake anyway, and a normal one at the
+ * latest time the most urgent non-deferrable sampler may run. In a run
+ * the non-deferrable samplers are called first. Samplers without
+ * MTK_SAMPLER_SCREEN_OFF pause while the screen is off.
+ *
+ * /proc/mtk_sampler shows runs and timer wakeups per second since the
+ * last write to it.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/fb.h>
+#include <linux/jiffies.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+
+#include <mt-plat/mtk_sampler.h>
+
+#define TAG "[SAMPLER]"
+
+static void sampler_fn(struct work_struct *work);
+
+static DEFINE_MUTEX(sampler_lock);
+static LIST_HEAD(sampler_list);
+static DECLARE_DELAYED_WORK(sampler_work, sampler_fn);
+static DECLARE_DEFERRABLE_WORK(sampler_defer_work, sampler_fn);
+
+/* under sampler_lock */
+static struct mtk_sampler *sampler_owner;	/* sampler_work is armed for */
+static bool sampler_screen_off;
+static unsigned long sampler_passes;
+static unsigned long sampler_wakeups;
+static unsigned long sampler_stat_start;
+
+static int sampler_cpu;
+module_param(sampler_cpu, int, S_IRUGO);
+MODULE_PARM_DESC(sampler_cpu, "housekeeping cpu the samplers run on");
+
+static bool sampler_active(struct mtk_sampler *s)
+{
+	return !sampler_screen_off || (s->flags & MTK_SAMPLER_SCREEN_OFF);
+}
+
+static void sampler_queue(struct delayed_work *dwork, unsigned long when)
+{
+	unsigned long now = jiffies;
+	int cpu = cpu_online(sampler_cpu) ? sampler_cpu : WORK_CPU_UNBOUND;
+
+	mod_delayed_work_on(cpu, system_freezable_wq, dwork,
+			    time_after(when, now) ? when - now : 0);
+}
+
+/* arm the works for the next deadlines, under sampler_lock */
+static void sampler_arm(void)
+{
+	struct mtk_sampler *s, *first = NULL;
+	unsigned long latest = 0;
+
+	sampler_owner = NULL;
+	list_for_each_entry(s, &sampler_list, node) {
+		unsigned long late;
+
+		if (!sampler_active(s))
+			continue;
+		if (!first || time_before(s->due, first->due))
+			first = s;
+		if (s->flags & MTK_SAMPLER_DEFERRABLE)
+			continue;
+		late = s->due + msecs_to_jiffies(s->slack_ms);
+		if (!sampler_owner || time_before(late, latest)) {
+			sampler_owner = s;
+			latest = late;
+		}
+	}
+
+	if (first)
+		sampler_queue(&sampler_defer_work, first->due);
+	else
+		cancel_delayed_work(&sampler_defer_work);
+
+	if (sampler_owner)
+		sampler_queue(&sampler_work, latest);
+	else
+		cancel_delayed_work(&sampler_work);
+}
+
+static void sampler_fn(struct work_struct *work)
+{
+	struct mtk_sampler *s;
+	unsigned long now;
+
+	mutex_lock(&sampler_lock);
+	now = jiffies;
+	sampler_passes++;
+	if (work == &sampler_work.work) {
+		sampler_wakeups++;
+		if (sampler_owner)
+			sampler_owner->wakeups++;
+	}
+
+	list_for_each_entry(s, &sampler_list, node) {
+		if (!sampler_active(s))
+			continue;
+		if (time_before(now + msecs_to_jiffies(s->slack_ms), s->due))
+			continue;
+		s->fn(s);
+		s->runs++;
+		s->due = now + msecs_to_jiffies(s->period_ms);
+	}
+
+	sampler_arm();
+	mutex_unlock(&sampler_lock);
+}
+
+int mtk_sampler_register(struct mtk_sampler *s)
+{
+	if (!s->fn || !s->period_ms)
+		return -EINVAL;
+
+	mutex_lock(&sampler_lock);
+	s->due = jiffies + msecs_to_jiffies(s->period_ms);
+	s->runs = 0;
+	s->wakeups = 0;
+	/* deferrable samplers go last, they must not delay the others */
+	if (s->flags & MTK_SAMPLER_DEFERRABLE)
+		list_add_tail(&s->node, &sampler_list);
+	else
+		list_add(&s->node, &sampler_list);
+	sampler_arm();
+	mutex_unlock(&sampler_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(mtk_sampler_register);
+
+void mtk_sampler_unregister(struct mtk_sampler *s)
+{
+	mutex_lock(&sampler_lock);
+	list_del(&s->node);
+	sampler_arm();
+	mutex_unlock(&sampler_lock);
+}
+EXPORT_SYMBOL_GPL(mtk_sampler_unregister);
+
+void mtk_sampler_set_period(struct mtk_sampler *s, unsigned int period_ms)
+{
+	if (!period_ms)
+		return;
+
+	mutex_lock(&sampler_lock);
+	s->due += msecs_to_jiffies(period_ms) - msecs_to_jiffies(s->period_ms);
+	s->period_ms = period_ms;
+	sampler_arm();
+	mutex_unlock(&sampler_lock);
+}
+EXPORT_SYMBOL_GPL(mtk_sampler_set_period);
+
+static int sampler_fb_event(struct notifier_block *nb, unsigned long event,
+			    void *data)
+{
+	struct fb_event *fb_event = data;
+	bool off;
+
+	if (event != FB_EVENT_BLANK)
+		return NOTIFY_DONE;
+
+	off = *(int *)fb_event->data != FB_BLANK_UNBLANK;
+	mutex_lock(&sampler_lock);
+	if (sampler_screen_off != off) {
+		sampler_screen_off = off;
+		sampler_arm();
+	}
+	mutex_unlock(&sampler_lock);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block sampler_fb_notifier = {
+	.notifier_call = sampler_fb_event,
+};
+
+/* hundredths are enough to tell 1Hz from 25Hz */
+static void sampler_show_rate(struct seq_file *m, unsigned long count,
+			      unsigned int ms)
+{
+	u64 rate = ms ? div_u64((u64)count * 100000, ms) : 0;
+	u32 frac = do_div(rate, 100);
+
+	seq_printf(m, "%7llu.%02u", rate, frac);
+}
+
+static int sampler_show(struct seq_file *m, void *v)
+{
+	struct mtk_sampler *s;
+	unsigned int ms;
+
+	mutex_lock(&sampler_lock);
+	ms = jiffies_to_msecs(jiffies - sampler_stat_start);
+	seq_printf(m, "%-20s %9s %8s %5s %10s %10s\n", "name", "period_ms",
+		   "slack_ms", "flags", "runs/s", "wakeups/s");
+	list_for_each_entry(s, &sampler_list, node) {
+		seq_printf(m, "%-20s %9u %8u    %c%c", s->name, s->period_ms,
+			   s->slack_ms,
+			   s->flags & MTK_SAMPLER_SCREEN_OFF ? 's' : '-',
+			   s->flags & MTK_SAMPLER_DEFERRABLE ? 'd' : '-');
+		sampler_show_rate(m, s->runs, ms);
+		sampler_show_rate(m, s->wakeups, ms);
+		seq_puts(m, "\n");
+	}
+	seq_printf(m, "%-20s %24s", "total", "");
+	sampler_show_rate(m, sampler_passes, ms);
+	sampler_show_rate(m, sampler_wakeups, ms);
+	seq_printf(m, "\ncpu %d, screen %s, %u ms sampled\n", sampler_cpu,
+		   sampler_screen_off ? "off" : "on", ms);
+	mutex_unlock(&sampler_lock);
+
+	return 0;
+}
+
+static int sampler_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sampler_show, NULL);
+}
+
+static void sampler_reset_stats(void)
+{
+	struct mtk_sampler *s;
+
+	mutex_lock(&sampler_lock);
+	list_for_each_entry(s, &sampler_list, node) {
+		s->runs = 0;
+		s->wakeups = 0;
+	}
+	sampler_passes = 0;
+	sampler_wakeups = 0;
+	sampler_stat_start = jiffies;
+	mutex_unlock(&sampler_lock);
+}
+
+/* any write restarts the statistics */
+static ssize_t sampler_write(struct file *file, const char __user *ubuf,
+			     size_t count, loff_t *ppos)
+{
+	sampler_reset_stats();
+	return count;
+}
+
+static const struct file_operations sampler_fops = {
+	.open = sampler_open,
+	.read = seq_read,
+	.write = sampler_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init mtk_sampler_init(void)
+{
+	sampler_reset_stats();
+	fb_register_client(&sampler_fb_notifier);
+	if (!proc_create("mtk_sampler", 0644, NULL, &sampler_fops))
+		pr_err(TAG"failed to create /proc/mtk_sampler\n");
+	return 0;
+}
+late_initcall(mtk_sampler_init);
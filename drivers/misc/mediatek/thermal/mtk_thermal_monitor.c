@@ -33,11 +33,16 @@
 #include <linux/time.h>
 #include <linux/string.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/seqlock.h>
+#include <linux/atomic.h>
+#include <linux/jiffies.h>
 #include <linux/bug.h>
 #include <linux/workqueue.h>
 #include <linux/slab.h>
 #include <mt-plat/mtk_thermal_monitor.h>
 #include <mt-plat/mtk_thermal_platform.h>
+#include <mt-plat/mtk_sampler.h>
 #include <linux/uidgid.h>
 /*#ifdef CONFIG_MD32_SUPPORT
 #define CONFIG_MTK_THERMAL_EXT_CONTROL
@@ -104,6 +109,7 @@ struct mtk_thermal_tz_data {
 	/* to store the Tfake, range from -275000 to MAX positive of int...
 	-275000 is a special number to turn off Tfake */
 	struct mutex ma_lock;	/* protect moving avg. vars... */
+	int sensor;		/* MTK_THERMAL_SENSOR_ID of this tz, -1 if none */
 };
 
 struct proc_dir_entry *mtk_thermal_get_proc_drv_therm_dir_entry(void);
@@ -111,6 +117,32 @@ struct proc_dir_entry *mtk_thermal_get_proc_drv_therm_dir_entry(void);
 static DEFINE_MUTEX(MTM_GET_TEMP_LOCK);
 static int *tz_last_values[MTK_THERMAL_SENSOR_COUNT] = { NULL };
 
+#define MTK_THERMAL_INVALID_TEMP (-127000)
+
+/**
+ *  Sampling layer: the last temperature of every sensor and when its
+ *  sensor was last read, one slot per sensor under a seqcount. Readers of
+ *  mtk_thermal_get_temp() never block, and a zone evaluated again within
+ *  mtm_sample_period_ms (passive/polling overlap, sysfs reads, trip
+ *  triggers) reuses the sample instead of reading the sensor once more.
+ *  A zone polling faster than that only reuses samples younger than its
+ *  own polling or passive delay, so each of its polls still sees a new
+ *  reading.
+ */
+struct mtk_thermal_sample {
+	seqcount_t seq;		/* writers hold mtm_sample_lock */
+	int temp;
+	unsigned long stamp;	/* jiffies, 0 if never read */
+};
+
+static struct mtk_thermal_sample mtm_samples[MTK_THERMAL_SENSOR_COUNT] = {
+	[0 ... MTK_THERMAL_SENSOR_COUNT - 1] = { .temp = MTK_THERMAL_INVALID_TEMP },
+};
+static DEFINE_SPINLOCK(mtm_sample_lock);	/* serializes sample writers */
+static unsigned int mtm_sample_period_ms = 200;
+static atomic_long_t mtm_sample_reads = ATOMIC_LONG_INIT(0);
+static atomic_long_t mtm_sample_hits = ATOMIC_LONG_INIT(0);
+
 /* ************************************ */
 /* Global Variable */
 /* ************************************ */
@@ -146,7 +178,6 @@ static DEFINE_MUTEX(MTM_COOLER_PROC_DIR_LOCK);
 static DEFINE_MUTEX(MTM_TZ_PROC_DIR_LOCK);
 static DEFINE_MUTEX(MTM_DRV_THERM_PROC_DIR_LOCK);
 
-static struct delayed_work _mtm_sysinfo_poll_queue;
 static kuid_t uid = KUIDT_INIT(0);
 static kgid_t gid = KGIDT_INIT(1000);
 
@@ -299,6 +330,80 @@ static long int _get_current_time_us(void)
 }
 #endif
 
+/* last temp of sensor and the jiffies it was read at */
+static void mtk_thermal_sample_get(int sensor, int *temp, unsigned long *stamp)
+{
+	struct mtk_thermal_sample *s = &mtm_samples[sensor];
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&s->seq);
+		*temp = s->temp;
+		*stamp = s->stamp;
+	} while (read_seqcount_retry(&s->seq, seq));
+}
+
+/* how old a sample tz may reuse: capped by its polling and passive delay */
+static unsigned int mtk_thermal_sample_max_age(struct thermal_zone_device *tz)
+{
+	unsigned int age_ms = mtm_sample_period_ms;
+
+	if (tz->polling_delay > 0)
+		age_ms = min_t(unsigned int, age_ms, tz->polling_delay);
+	if (tz->passive_delay > 0)
+		age_ms = min_t(unsigned int, age_ms, tz->passive_delay);
+	return age_ms;
+}
+
+/* temp of sensor if it was read recently enough for tz to reuse it */
+static bool mtk_thermal_sample_fresh(struct thermal_zone_device *tz, int sensor, int *temp)
+{
+	unsigned long stamp;
+	unsigned int age_ms;
+	int t;
+
+	if (sensor < 0 || sensor >= MTK_THERMAL_SENSOR_COUNT)
+		return false;
+
+	age_ms = mtk_thermal_sample_max_age(tz);
+	if (!age_ms)
+		return false;
+
+#ifdef CONFIG_MTK_THERMAL_TIME_BASE_PROTECTION
+	/* the battery wake lock is only released on a real read */
+	if (sensor == MTK_THERMAL_SENSOR_BATTERY)
+		return false;
+#endif
+
+	mtk_thermal_sample_get(sensor, &t, &stamp);
+	if (!stamp || !time_before(jiffies, stamp + msecs_to_jiffies(age_ms)))
+		return false;
+
+	*temp = t;
+	atomic_long_inc(&mtm_sample_hits);
+	return true;
+}
+
+/* store a new temp of sensor, sampled tells whether the sensor was read */
+static void mtk_thermal_sample_put(int sensor, int temp, bool sampled)
+{
+	struct mtk_thermal_sample *s;
+
+	if (sensor < 0 || sensor >= MTK_THERMAL_SENSOR_COUNT)
+		return;
+
+	s = &mtm_samples[sensor];
+	spin_lock(&mtm_sample_lock);
+	write_seqcount_begin(&s->seq);
+	s->temp = temp;
+	s->stamp = sampled ? (jiffies ? jiffies : 1) : 0;
+	write_seqcount_end(&s->seq);
+	spin_unlock(&mtm_sample_lock);
+
+	if (sampled)
+		atomic_long_inc(&mtm_sample_reads);
+}
+
 #ifdef CONFIG_MTK_THERMAL_EXT_CONTROL
 #include "md32_ipi.h"
 #include "md32_helper.h"
@@ -484,9 +589,22 @@ static void mtk_thermal_ext_update_tz_threshold(int tzidx, int temperature)
 	mtk_thermal_ext_set_tz_threshold(&mtk_thermal_ext_tz_values[tzidx], tzidx);
 }
 
+/*
+ * Thermal core reads polling_delay under tz->lock. Must be called without
+ * mtk_thermal_ext_control_lock held: get_temp takes that lock under tz->lock.
+ */
+static void mtk_thermal_ext_set_polling(struct thermal_zone_device *tz, int delay)
+{
+	mutex_lock(&tz->lock);
+	tz->polling_delay = delay;
+	mutex_unlock(&tz->lock);
+}
+
 static void mtk_thermal_ext_switch_control_back(void)
 {
-	int i;
+	struct thermal_zone_device *tzs[MTK_THERMAL_EXT_SENSOR_COUNT];
+	int delays[MTK_THERMAL_EXT_SENSOR_COUNT];
+	int i, n = 0;
 
 	/* Switch state from interrupt mode to polling mode */
 	mutex_lock(&mtk_thermal_ext_control_lock);
@@ -494,14 +612,18 @@ static void mtk_thermal_ext_switch_control_back(void)
 		for (i = 0; i < MTK_THERMAL_EXT_SENSOR_COUNT; i++) {
 			if (mtk_thermal_ext_tz_values[i].set
 			    && mtk_thermal_ext_tz_values[i].polling_delay > 0) {
-				schedule_delayed_work(&
-						      (mtk_thermal_ext_tz_values[i].tz->poll_queue),
-						      0);
+				tzs[n] = mtk_thermal_ext_tz_values[i].tz;
+				delays[n++] = mtk_thermal_ext_tz_values[i].polling_delay;
 			}
 		}
 		g_controlState = MTK_THERMAL_CONTROL_STATE_POLLING;
 	}
 	mutex_unlock(&mtk_thermal_ext_control_lock);
+
+	for (i = 0; i < n; i++) {
+		mtk_thermal_ext_set_polling(tzs[i], delays[i]);
+		schedule_delayed_work(&(tzs[i]->poll_queue), 0);
+	}
 }
 
 static void mtk_thermal_ext_switch_control_out(void)
@@ -539,20 +661,31 @@ static void mtk_thermal_ext_ipi_msg_handler(int id, void *data, uint len)
 
 	case THERMAL_MD32_IPI_MSG_MD32_START_ACK:
 		{
-			mutex_lock(&mtk_thermal_ext_control_lock);
-			if (g_controlState != MTK_THERMAL_CONTROL_STATE_SWITCHING)
-				break;
+			struct thermal_zone_device *tzs[MTK_THERMAL_EXT_SENSOR_COUNT];
+			int n = 0;
 
-			for (i = 0; i < MTK_THERMAL_EXT_SENSOR_COUNT; i++) {
-				if (mtk_thermal_ext_tz_values[i].set) {
-					/* [Warning] Can not use cancel_delayed_work_sync() here
-					* because it will cause kernel warning (LockProve Warning) */
-					if (cancel_delayed_work(&(mtk_thermal_ext_tz_values[i].tz->poll_queue)) == 0)
-						THRML_ERROR_LOG("%s work (tz %d) is running\n", __func__, i);
+			mutex_lock(&mtk_thermal_ext_control_lock);
+			if (g_controlState == MTK_THERMAL_CONTROL_STATE_SWITCHING) {
+				for (i = 0; i < MTK_THERMAL_EXT_SENSOR_COUNT; i++) {
+					if (mtk_thermal_ext_tz_values[i].set)
+						tzs[n++] = mtk_thermal_ext_tz_values[i].tz;
 				}
+				g_controlState = MTK_THERMAL_CONTROL_STATE_INTERRUPT;
 			}
-			g_controlState = MTK_THERMAL_CONTROL_STATE_INTERRUPT;
 			mutex_unlock(&mtk_thermal_ext_control_lock);
+
+			for (i = 0; i < n; i++) {
+				/*
+				 * MD32 reports threshold crossings from now on, so keep
+				 * thermal core from re-arming the poll after each update.
+				 */
+				mtk_thermal_ext_set_polling(tzs[i], 0);
+				/* [Warning] Can not use cancel_delayed_work_sync() here
+				* because it will cause kernel warning (LockProve Warning) */
+				if (cancel_delayed_work(&(tzs[i]->poll_queue)) == 0)
+					THRML_ERROR_LOG("%s work (%s) is running\n", __func__,
+							tzs[i]->type);
+			}
 			break;
 		}
 
@@ -576,15 +709,12 @@ static void mtk_thermal_ext_ipi_msg_handler(int id, void *data, uint len)
 			}
 			/* mutex_unlock(&mtk_thermal_ext_control_lock); */
 
-			if (tz != NULL) {
+			/*
+			 * polling_delay is 0 in interrupt mode, so the update only
+			 * re-arms the poll while the zone is in passive cooling
+			 */
+			if (tz != NULL)
 				thermal_zone_device_update(tz);
-				/* [Warning] Can not use cancel_delayed_work_sync() here
-				because it will cause kernel warning (LockProve Warning) */
-				if (cancel_delayed_work(&(tz->poll_queue)) == 0) {
-					THRML_ERROR_LOG("%s work (tz %d) is running\n", __func__,
-							tzidx);
-				}
-			}
 			break;
 		}
 	}
@@ -906,7 +1036,7 @@ static int mtk_sysinfo_get_info(unsigned int mask)
 
 static int _mtm_interval;
 
-static void _mtm_update_sysinfo(struct work_struct *work)
+static void _mtm_update_sysinfo(struct mtk_sampler *sampler)
 {
 	if (true == enable_ThermalMonitor)
 		mtk_sysinfo_get_info(THERMAL_SYS_INFO_ALL);
@@ -920,16 +1050,19 @@ static void _mtm_update_sysinfo(struct work_struct *work)
 
 		mtk_sysinfo_get_info(mask);
 	}
-
-	cancel_delayed_work(&_mtm_sysinfo_poll_queue);
-
-	if (_mtm_interval != 0)
-		queue_delayed_work(system_freezable_wq, &_mtm_sysinfo_poll_queue,
-				   msecs_to_jiffies(_mtm_interval));
 }
 
+/* statistics for the logs and the policies, kept up with the screen off too */
+static struct mtk_sampler _mtm_sysinfo_sampler = {
+	.name = "thermal_sysinfo",
+	.slack_ms = 250,
+	.flags = MTK_SAMPLER_SCREEN_OFF,
+	.fn = _mtm_update_sysinfo,
+};
+
 static void _mtm_decide_new_delay(void)
 {
+	static DEFINE_MUTEX(interval_lock);
 	int new_interval = 0;
 
 	if (true == enable_ThermalMonitor) {
@@ -946,12 +1079,18 @@ static void _mtm_decide_new_delay(void)
 			new_interval = 1000;
 	}
 
+	mutex_lock(&interval_lock);
 	if (_mtm_interval == 0 && new_interval != 0) {
-		_mtm_interval = new_interval;
 		_mtm_update_sysinfo(NULL);
-	} else {
-		_mtm_interval = new_interval;
+		_mtm_sysinfo_sampler.period_ms = new_interval;
+		mtk_sampler_register(&_mtm_sysinfo_sampler);
+	} else if (_mtm_interval != 0 && new_interval == 0) {
+		mtk_sampler_unregister(&_mtm_sysinfo_sampler);
+	} else if (_mtm_interval != new_interval) {
+		mtk_sampler_set_period(&_mtm_sysinfo_sampler, new_interval);
 	}
+	_mtm_interval = new_interval;
+	mutex_unlock(&interval_lock);
 }
 
 /* ************************************ */
@@ -1527,6 +1666,62 @@ static const struct file_operations _mtkthermal_indicator_fops = {
 	.release = single_release,
 };
 
+/* Read */
+static int _mtm_sample_read(struct seq_file *m, void *v)
+{
+	unsigned long stamp;
+	int i, temp;
+
+	seq_printf(m, "period_ms: %u\nsensor reads: %ld\ncached reads: %ld\n",
+		   mtm_sample_period_ms, atomic_long_read(&mtm_sample_reads),
+		   atomic_long_read(&mtm_sample_hits));
+
+	for (i = 0; i < MTK_THERMAL_SENSOR_COUNT; i++) {
+		mtk_thermal_sample_get(i, &temp, &stamp);
+		if (stamp)
+			seq_printf(m, "sensor %d: %d, %u ms ago\n", i, temp,
+				   jiffies_to_msecs(jiffies - stamp));
+	}
+
+	return 0;
+}
+
+/* Write */
+static ssize_t _mtm_sample_write(struct file *file, const char __user *buffer, size_t count,
+				 loff_t *data)
+{
+	int len = 0;
+	unsigned int period_ms;
+	char desc[32];
+
+	len = (count < (sizeof(desc) - 1)) ? count : (sizeof(desc) - 1);
+	if (copy_from_user(desc, buffer, len))
+		return 0;
+
+	desc[len] = '\0';
+
+	/* 0 reads the sensor on every evaluation */
+	if (kstrtouint(desc, 10, &period_ms) == 0 && period_ms <= 10000) {
+		mtm_sample_period_ms = period_ms;
+		return count;
+	}
+	return -EINVAL;
+}
+
+static int _mtm_sample_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, _mtm_sample_read, NULL);
+}
+
+static const struct file_operations _mtm_sample_fops = {
+	.owner = THIS_MODULE,
+	.open = _mtm_sample_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.write = _mtm_sample_write,
+	.release = single_release,
+};
+
 /* Read */
 static int _mtm_scen_call_read(struct seq_file *m, void *v)
 {
@@ -1581,12 +1776,15 @@ static const struct file_operations _mtm_scen_call_fops = {
 /* Init */
 static int __init mtkthermal_init(void)
 {
-	int err = 0;
+	int err = 0, i;
 	struct proc_dir_entry *entry;
 	struct proc_dir_entry *dir_entry = mtk_thermal_get_proc_drv_therm_dir_entry();
 
 	THRML_LOG("%s\n", __func__);
 
+	for (i = 0; i < MTK_THERMAL_SENSOR_COUNT; i++)
+		seqcount_init(&mtm_samples[i].seq);
+
 	entry = proc_create("mtm_monitor", S_IRUGO | S_IWUSR | S_IWGRP, dir_entry, &mtkthermal_fops);
 	if (!entry)
 		THRML_ERROR_LOG("%s Can not create mtm_monitor\n", __func__);
@@ -1603,6 +1801,12 @@ static int __init mtkthermal_init(void)
 	else
 		proc_set_user(entry, uid, gid);
 
+	entry = proc_create("mtm_sample", S_IRUGO | S_IWUSR | S_IWGRP, dir_entry, &_mtm_sample_fops);
+	if (!entry)
+		THRML_ERROR_LOG("%s Can not create mtm_sample\n", __func__);
+	else
+		proc_set_user(entry, uid, gid);
+
 	/* create /proc/cooler folder */
 	/* WARNING! This is not gauranteed to be invoked before mtk_ts_cpu's functions... */
 	proc_cooler_dir_entry =
@@ -1636,7 +1840,6 @@ static int __init mtkthermal_init(void)
 	md32_register_notify(&mtk_thermal_ext_nb);
 #endif
 
-	INIT_DELAYED_WORK(&_mtm_sysinfo_poll_queue, _mtm_update_sysinfo);
 	_mtm_update_sysinfo(NULL);
 
 	return err;
@@ -1646,6 +1849,8 @@ static int __init mtkthermal_init(void)
 static void __exit mtkthermal_exit(void)
 {
 	THRML_LOG("%s\n", __func__);
+	if (_mtm_interval)
+		mtk_sampler_unregister(&_mtm_sysinfo_sampler);
 #if defined(CONFIG_MTK_THERMAL_TIME_BASE_PROTECTION)
 	wake_lock_destroy(&mtm_wake_lock);
 #endif
@@ -1792,6 +1997,7 @@ static int mtk_thermal_wrapper_get_temp
 (struct thermal_zone_device *thermal, unsigned long *temperature) {
 	int ret = 0;
 	struct thermal_zone_device_ops *ops;
+	struct mtk_thermal_tz_data *tzdata = thermal->devdata;
 	int nTemperature;
 	unsigned long raw_temp = 0;
 #if MTK_THERMAL_MONITOR_MEASURE_GET_TEMP_OVERHEAD
@@ -1806,10 +2012,19 @@ static int mtk_thermal_wrapper_get_temp
 		return 1;
 	}
 #ifndef CONFIG_MTK_THERMAL_EXT_CONTROL
+	if (mtk_thermal_sample_fresh(thermal, tzdata->sensor, &nTemperature)) {
+		*temperature = nTemperature;
+		return 0;
+	}
 	if (ops->get_temp)
 		ret = ops->get_temp(thermal, &raw_temp);
 #else
+	/* in interrupt mode the temp comes from the MD32 threshold IPI */
 	if (mtk_thermal_ext_get_temp(thermal, &raw_temp) < 0) {
+		if (mtk_thermal_sample_fresh(thermal, tzdata->sensor, &nTemperature)) {
+			*temperature = nTemperature;
+			return 0;
+		}
 		if (ops->get_temp)
 			ret = ops->get_temp(thermal, &raw_temp);
 	}
@@ -1842,6 +2057,7 @@ static int mtk_thermal_wrapper_get_temp
 	if (0 == ret) {
 		*temperature = _mtkthermal_update_and_get_sma(thermal->devdata, raw_temp);
 		/* No strong type cast... */
+		mtk_thermal_sample_put(tzdata->sensor, (int)*temperature, true);
 	} else {
 		THRML_ERROR_LOG("[.get_temp] tz: %s invalid temp\n", thermal->type);
 		*temperature = nTemperature;
@@ -2045,6 +2261,7 @@ int tc1, int tc2, int passive_delay, int polling_delay) {
 	tzdata->ma_len = 1;
 	tzdata->ma_counter = 0;
 	tzdata->fake_temp = -275000;	/* init to -275000 */
+	tzdata->sensor = mtk_thermal_get_tz_idx(type);
 #if (MAX_STEP_MA_LEN > 1)
 	tzdata->curr_idx_ma_len = 0;
 	tzdata->ma_lens[0] = 1;
@@ -2073,6 +2290,8 @@ int tc1, int tc2, int passive_delay, int polling_delay) {
 #ifdef CONFIG_MTK_THERMAL_EXT_CONTROL
 	tzidx = mtk_thermal_ext_get_tz_idx(type);
 	if (tzidx >= 0 && tzidx < MTK_THERMAL_EXT_SENSOR_COUNT) {
+		bool stop_polling = false;
+
 		mutex_lock(&mtk_thermal_ext_control_lock);
 
 		mtk_thermal_ext_tz_values[tzidx].tz = tz;
@@ -2100,16 +2319,19 @@ int tc1, int tc2, int passive_delay, int polling_delay) {
 			/* Set TZ high/low threshold to MD32 */
 			mtk_thermal_ext_set_tz_threshold(&mtk_thermal_ext_tz_values[tzidx], tzidx);
 
-			/* [Warning] Can not use cancel_delayed_work_sync() here
-			because it will cause kernel warning (LockProve Warning) */
-			if (g_controlState == MTK_THERMAL_CONTROL_STATE_INTERRUPT &&
-			    cancel_delayed_work(&(tz->poll_queue)) == 0) {
-				THRML_ERROR_LOG("%s cancel tz %d work, work is running\n", __func__,
-						type);
-			}
+			stop_polling = (g_controlState == MTK_THERMAL_CONTROL_STATE_INTERRUPT);
 		}
 
 		mutex_unlock(&mtk_thermal_ext_control_lock);
+
+		if (stop_polling) {
+			mtk_thermal_ext_set_polling(tz, 0);
+			/* [Warning] Can not use cancel_delayed_work_sync() here
+			because it will cause kernel warning (LockProve Warning) */
+			if (cancel_delayed_work(&(tz->poll_queue)) == 0)
+				THRML_ERROR_LOG("%s cancel tz %s work, work is running\n",
+						__func__, type);
+		}
 	}
 #endif				/* CONFIG_MTK_THERMAL_EXT_CONTROL */
 
@@ -2170,6 +2392,7 @@ void mtk_thermal_zone_device_unregister_wrapper(struct thermal_zone_device *tz)
 			tz_last_values[tzidx] = NULL;
 	}
 	mutex_unlock(&MTM_GET_TEMP_LOCK);
+	mtk_thermal_sample_put(tzidx, MTK_THERMAL_INVALID_TEMP, false);
 
 	THRML_LOG("%s+ tz : %s\n", __func__, type);
 
@@ -2555,20 +2778,14 @@ EXPORT_SYMBOL(mtk_thermal_zone_bind_trigger_trip);
 
 int mtk_thermal_get_temp(MTK_THERMAL_SENSOR_ID id)
 {
-	int ret = 0;
+	unsigned long stamp;
+	int temp;
 
 	if (id < 0 || id >= MTK_THERMAL_SENSOR_COUNT)
-		return -127000;
+		return MTK_THERMAL_INVALID_TEMP;
 
-	mutex_lock(&MTM_GET_TEMP_LOCK);
-	if (tz_last_values[id] == NULL) {
-		mutex_unlock(&MTM_GET_TEMP_LOCK);
-		return -127000;
-	}
-
-	ret = *tz_last_values[id];
-	mutex_unlock(&MTM_GET_TEMP_LOCK);
-	return ret;
+	mtk_thermal_sample_get(id, &temp, &stamp);
+	return temp;
 }
 EXPORT_SYMBOL(mtk_thermal_get_temp);
 
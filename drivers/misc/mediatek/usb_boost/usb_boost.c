@@ -19,9 +19,11 @@
 #include <linux/types.h>
 #include <linux/device.h>
 #include <linux/version.h>
-#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/string.h>
 #include <linux/kdev_t.h>
 
+#include "boost_arb.h"
 #include "usb_boost.h"
 #define USB_BOOST_CLASS_NAME "usb_boost"
 enum{
@@ -80,7 +82,6 @@ static char *type_name[_TYPE_MAXID] = {
 	"cpu_freq",
 	"cpu_core",
 };
-#define MAX_LEN_WQ_NAME 32
 static int trigger_cnt_disabled;
 static int enabled;
 static int inited;
@@ -90,7 +91,6 @@ static int cpu_core_dft_para[_ATTR_PARA_RW_MAXID] = {1, 3, 300, 0};
 static void __usb_boost_empty(void) { return; }
 static void __usb_boost_cnt(void) { trigger_cnt_disabled++; return; }
 static void __usb_boost_by_id_empty(int id) { return; }
-static void __request_empty(int id) { return; }
 
 struct boost_ops {
 	void (*boost)(void);
@@ -103,33 +103,34 @@ struct boost_ops __the_boost_ops = {
 	{__usb_boost_by_id_empty,
 	 __usb_boost_by_id_empty} };
 
-/* -1 denote not used*/
+/* -1 denote not used, freq in KHz, above the top OPP means the top OPP */
 static struct act_arg_obj cpu_freq_dft_arg = {1000000000, -1, -1};
 static struct act_arg_obj cpu_core_dft_arg = {2, -1, -1};
 static int test_diff_sec, test_diff_usec;
 
-struct control_ops {
-	int (*act[_ACT_MAXID]) (struct act_arg_obj *arg);
-};
+/*
+ * The boost itself is held by the boost arbiter under BOOST_SRC_USB: every
+ * usb_boost() call renews the request for another timeout seconds, which
+ * costs no wakeup while the limit stays the same. poll_intval and raw are
+ * left over from the polling worker and kept for the sysfs ABI only.
+ */
 static struct mtk_usb_boost {
-	struct control_ops ops;
 	struct device_attribute attr[_ATTR_MAXID];
 	int para[_ATTR_PARA_RW_MAXID];
-	struct work_struct	work;
-	struct workqueue_struct	*wq;
+	struct boost_limit limit;	/* floors of this type, from arg1 */
+	unsigned long expires;		/* jiffies, end of the boost */
 	int id;
 	struct device *dev;
 	int cmd;
-	int is_running;
 	struct timeval tv_ref_time;
 	int work_cnt;
 	struct act_arg_obj act_arg;
-	void (*request_func)(int);
 } boost_inst[_TYPE_MAXID];
 
 static int update_time(int id);
-static bool check_timeout(int id);
 static void __usb_boost_by_id(int id);
+static void usb_boost_set_limit(int id);
+static void usb_boost_request(unsigned long ids);
 
 /* public to IP platform level */
 void usb_boost_set_para_and_arg(int id, int *para, int para_range, struct act_arg_obj *act_arg)
@@ -151,12 +152,15 @@ void usb_boost_set_para_and_arg(int id, int *para, int para_range, struct act_ar
 	boost_inst[id].act_arg.arg1 = act_arg->arg1;
 	boost_inst[id].act_arg.arg2 = act_arg->arg2;
 	boost_inst[id].act_arg.arg3 = act_arg->arg3;
+	usb_boost_set_limit(id);
 
 	/* hook callback by enable flag */
-	if (para[0])
+	if (para[0]) {
 		__the_boost_ops.boost_by_id[id] = __usb_boost_by_id;
-	else
+	} else {
 		__the_boost_ops.boost_by_id[id] = __usb_boost_by_id_empty;
+		usb_boost_request(0);
+	}
 }
 
 void usb_boost(void)
@@ -169,40 +173,102 @@ void usb_boost_by_id(int id)
 	__the_boost_ops.boost_by_id[id](id);
 }
 
-void register_usb_boost_act(int type_id, int action_id, int (*func) (struct act_arg_obj *arg))
+/*
+ * The freq type raises every cluster to arg1 KHz. The core type asks for
+ * arg1 cores, filling the clusters from the little one up, the way PPM
+ * sysboost spread its core count.
+ */
+static void usb_boost_set_limit(int id)
 {
-	boost_inst[type_id].ops.act[action_id] = func;
+	struct mtk_usb_boost *ptr_inst = &boost_inst[id];
+	int i, nr = boost_arb_nr_clusters();
+	int cores = ptr_inst->act_arg.arg1;
+
+	memset(&ptr_inst->limit, 0, sizeof(ptr_inst->limit));
+	for (i = 0; i < nr; i++) {
+		if (id == TYPE_CPU_FREQ) {
+			ptr_inst->limit.freq[i] = ptr_inst->act_arg.arg1;
+		} else if (cores > 0) {
+			ptr_inst->limit.core[i] = (i == nr - 1) ? cores :
+				min(cores, boost_arb_cluster_cores(i));
+			cores -= ptr_inst->limit.core[i];
+		}
+	}
 }
 
-static void __request_it(int id)
+static bool usb_boost_live(int id, unsigned long now)
 {
-	USB_BOOST_DBG("ID<%d>, WQ<%p>, WORK<%p>\n", id, boost_inst[id].wq, &(boost_inst[id].work));
-	queue_work(boost_inst[id].wq, &(boost_inst[id].work));
-	USB_BOOST_DBG("\n");
+	return boost_inst[id].para[ATTR_ENABLE] && time_before(now, boost_inst[id].expires);
 }
 
-static void __usb_boost_by_id(int id)
+/*
+ * Both types share the BOOST_SRC_USB request, which carries the floors
+ * of every live type until the latest of their timeouts. @ids are the
+ * types just renewed, their work_cnt counts the renewals that changed
+ * the request.
+ */
+static void usb_boost_request(unsigned long ids)
+{
+	unsigned long now = jiffies, left = 0;
+	struct boost_limit limit;
+	int id, i;
+
+	memset(&limit, 0, sizeof(limit));
+	for (id = 0; id < _TYPE_MAXID; id++) {
+		if (!usb_boost_live(id, now))
+			continue;
+		left = max(left, boost_inst[id].expires - now);
+		for (i = 0; i < BOOST_CLUSTER_MAX; i++) {
+			limit.core[i] = max(limit.core[i], boost_inst[id].limit.core[i]);
+			limit.freq[i] = max(limit.freq[i], boost_inst[id].limit.freq[i]);
+		}
+	}
+
+	if (!left) {
+		boost_arb_release(BOOST_SRC_USB);
+		return;
+	}
+
+	/* a refresh of a running boost returns 0 */
+	if (boost_arb_request(BOOST_SRC_USB, &limit, jiffies_to_msecs(left)) <= 0)
+		return;
+	for (id = 0; id < _TYPE_MAXID; id++)
+		if (ids & BIT(id))
+			boost_inst[id].work_cnt++;
+}
+
+static void usb_boost_renew(int id)
 {
 	update_time(id);
-	boost_inst[id].request_func(id);
+	boost_inst[id].expires = jiffies +
+		msecs_to_jiffies(boost_inst[id].para[ATTR_TIMEOUT] * MSEC_PER_SEC);
+}
+
+static void __usb_boost_by_id(int id)
+{
+	usb_boost_renew(id);
+	usb_boost_request(BIT(id));
 }
 
 static void __usb_boost(void)
 {
+	unsigned long ids = 0;
 	int id;
 
 	USB_BOOST_DBG("\n");
-	for (id = 0; id < _TYPE_MAXID; id++)
-		usb_boost_by_id(id);
+	for (id = 0; id < _TYPE_MAXID; id++) {
+		if (boost_inst[id].para[ATTR_ENABLE]) {
+			usb_boost_renew(id);
+			ids |= BIT(id);
+		}
+	}
+	if (ids)
+		usb_boost_request(ids);
 }
 
-static void __boost_act(int type_id, int action_id)
+static bool usb_boost_running(int id)
 {
-	int (*func)(struct act_arg_obj *arg) = boost_inst[type_id].ops.act[action_id];
-	struct act_arg_obj *arg = &boost_inst[type_id].act_arg;
-
-	if (func)
-		func(arg);
+	return usb_boost_live(id, jiffies) && boost_arb_active(BOOST_SRC_USB);
 }
 
 static void dump_info(int id)
@@ -219,7 +285,8 @@ static void dump_info(int id)
 	USB_BOOST_NOTICE("id<%d>, attr<%s>, val<%d,%d>\n", id, attr_name[ATTR_RO_REF_TIME],
 			(unsigned int)boost_inst[id].tv_ref_time.tv_sec,
 			(unsigned int)boost_inst[id].tv_ref_time.tv_usec);
-	USB_BOOST_NOTICE("id<%d>, attr<%s>, val<%d>\n", id, attr_name[ATTR_RO_IS_RUNNING], boost_inst[id].is_running);
+	USB_BOOST_NOTICE("id<%d>, attr<%s>, val<%d>\n", id, attr_name[ATTR_RO_IS_RUNNING],
+			usb_boost_running(id));
 	USB_BOOST_NOTICE("id<%d>, attr<%s>, val<%d>\n", id, attr_name[ATTR_RO_WORK_CNT], boost_inst[id].work_cnt);
 
 	/* ARG */
@@ -236,68 +303,6 @@ static int update_time(int id)
 	return 1;
 }
 
-static bool check_timeout(int id)
-{
-	struct timeval tv, *ref;
-	int diff_sec;
-
-	ref = &boost_inst[id].tv_ref_time;
-	do_gettimeofday(&tv);
-	diff_sec = tv.tv_sec - ref->tv_sec;
-	if (diff_sec >= boost_inst[id].para[ATTR_TIMEOUT]) {
-		USB_BOOST_DBG("id<%d>, cur<%d,%d>, ref<%d,%d>\n",
-				id, (int)tv.tv_sec, (int)tv.tv_usec, (int)ref->tv_sec, (int)ref->tv_usec);
-		return true;
-	}
-	USB_BOOST_DBG("id<%d>, cur<%d,%d>, ref<%d,%d>\n",
-			id, (int)tv.tv_sec, (int)tv.tv_usec, (int)ref->tv_sec, (int)ref->tv_usec);
-	return false;
-}
-
-static void boost_work(struct work_struct *work_struct)
-{
-	struct mtk_usb_boost *ptr_inst = container_of(work_struct, struct mtk_usb_boost, work);
-	int id = ptr_inst->id;
-	int raw = ptr_inst->para[ATTR_RAW];
-	int poll_intval = ptr_inst->para[ATTR_POLLING_INTVAL];
-
-	ptr_inst->is_running = true;
-	boost_inst[id].request_func = __request_empty;
-	ptr_inst->work_cnt++;
-	USB_BOOST_NOTICE("id:%d, begin of work\n", id);
-
-	/* dump_info(id); */
-	__boost_act(id, ACT_HOLD);
-	/* dump_info(id); */
-	while (1) {
-		int timeout;
-
-		USB_BOOST_NOTICE("id:%d, running of work\n", id);
-		if (!ptr_inst->para[ATTR_ENABLE]) {
-			/* dump_info(id); */
-			break;
-		}
-		timeout = check_timeout(id);
-		if (timeout) {
-			/* dump_info(id); */
-			break;
-		}
-
-		if (raw)
-			__boost_act(id, ACT_HOLD);
-
-		msleep(poll_intval);
-
-	}
-
-	/* dump_info(id); */
-	__boost_act(id, ACT_RELEASE);
-	boost_inst[id].request_func = __request_it;
-	ptr_inst->is_running = false;
-	USB_BOOST_NOTICE("id:%d, end of work\n", id);
-	/* dump_info(id); */
-}
-
 static void default_setting(void)
 {
 	usb_boost_set_para_and_arg(TYPE_CPU_FREQ, cpu_freq_dft_para,
@@ -368,6 +373,9 @@ static ssize_t attr_store(struct device *dev, struct device_attribute *attr,
 		else
 			__the_boost_ops.boost_by_id[i] = __usb_boost_by_id_empty;
 		boost_inst[i].para[idx] = (int)tmp;
+		/* drop a disabled type from the request */
+		if (!tmp)
+			usb_boost_request(0);
 		break;
 	case ATTR_TIMEOUT:
 	case ATTR_POLLING_INTVAL:
@@ -412,6 +420,7 @@ static ssize_t attr_store(struct device *dev, struct device_attribute *attr,
 	/* ARG usage */
 	case ATTR_ARG1:
 		boost_inst[i].act_arg.arg1 = (int)tmp;
+		usb_boost_set_limit(i);
 		break;
 	case ATTR_ARG2:
 		boost_inst[i].act_arg.arg2 = (int)tmp;
@@ -477,7 +486,7 @@ static ssize_t attr_show(struct device *dev, struct device_attribute *attr, char
 				(int)boost_inst[i].tv_ref_time.tv_sec, (int)boost_inst[i].tv_ref_time.tv_usec);
 		break;
 	case ATTR_RO_IS_RUNNING:
-		count = sprintf(buf, "%s\n", boost_inst[i].is_running ? "true" : "false");
+		count = sprintf(buf, "%s\n", usb_boost_running(i) ? "true" : "false");
 		break;
 	case ATTR_RO_WORK_CNT:
 		count = sprintf(buf, "%d\n", boost_inst[i].work_cnt);
@@ -539,18 +548,10 @@ int usb_boost_init(void)
 
 	test_loops(-1);
 	for (id = 0; id < _TYPE_MAXID; id++) {
-		int count;
-		char wq_name[MAX_LEN_WQ_NAME];
-
-		count = sprintf(wq_name, "%s_wq", type_name[id]);
-		wq_name[count] = '\0';
 		test_loops(id);
 		boost_inst[id].id  = id;
 		update_time(id);
-		boost_inst[id].wq  = create_singlethread_workqueue(wq_name);
-		INIT_WORK(&boost_inst[id].work, boost_work);
-		USB_BOOST_DBG("ID<%d>, WQ<%p>, WORK<%p>\n", id, boost_inst[id].wq, &(boost_inst[id].work));
-		boost_inst[id].request_func = __request_it;
+		boost_inst[id].expires = jiffies;
 	}
 	/* hook workable interface */
 	__the_boost_ops.boost = __usb_boost;
@@ -19,12 +19,6 @@ enum{
 	_TYPE_MAXID
 };
 
-enum{
-	ACT_HOLD,
-	ACT_RELEASE,
-	_ACT_MAXID
-};
-
 struct act_arg_obj {
 	int arg1;
 	int arg2;
@@ -35,7 +29,6 @@ void usb_boost_set_para_and_arg(int id, int *para, int para_range, struct act_ar
 void usb_boost_by_id(int id);
 void usb_boost(void);
 int usb_boost_init(void);
-void register_usb_boost_act(int type_id, int action_id, int (*func) (struct act_arg_obj *arg));
 
 /* #define USB_BOOST_DBG_ENABLE */
 #define USB_BOOST_NOTICE(fmt, args...) pr_warn("USB_BOOST, <%s(), %d> " fmt, __func__, __LINE__, ## args)
@@ -11,7 +11,6 @@
  * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
  */
 #include <linux/module.h>
-#include "mt_ppm_api.h"
 #include "usb_boost.h"
 
 /* platform specific parameter here */
@@ -29,31 +28,6 @@ struct act_arg_obj cpu_freq_test_arg = {1500000000, -1, -1};
 struct act_arg_obj cpu_core_test_arg = {4, -1, -1};
 #endif
 
-static int freq_hold(struct act_arg_obj *arg)
-{
-	USB_BOOST_DBG("\n");
-	mt_ppm_sysboost_freq(BOOST_BY_USB, arg->arg1);
-	return 0;
-}
-static int freq_release(struct act_arg_obj *arg)
-{
-	USB_BOOST_DBG("\n");
-	mt_ppm_sysboost_freq(BOOST_BY_USB, 0);
-	return 0;
-}
-static int core_hold(struct act_arg_obj *arg)
-{
-	USB_BOOST_DBG("\n");
-	mt_ppm_sysboost_core(BOOST_BY_USB, arg->arg1);
-	return 0;
-}
-static int core_release(struct act_arg_obj *arg)
-{
-	USB_BOOST_DBG("\n");
-	mt_ppm_sysboost_core(BOOST_BY_USB, 0);
-	return 0;
-}
-
 static int __init init(void)
 {
 
@@ -65,12 +39,6 @@ static int __init init(void)
 			sizeof(cpu_freq_test_para)/sizeof(int), &cpu_freq_test_arg);
 	usb_boost_set_para_and_arg(TYPE_CPU_CORE, cpu_core_test_para,
 			sizeof(cpu_core_test_para)/sizeof(int), &cpu_core_test_arg);
-
-	/* mandatory, hook callback depends on platform */
-	register_usb_boost_act(TYPE_CPU_FREQ, ACT_HOLD, freq_hold);
-	register_usb_boost_act(TYPE_CPU_FREQ, ACT_RELEASE, freq_release);
-	register_usb_boost_act(TYPE_CPU_CORE, ACT_HOLD, core_hold);
-	register_usb_boost_act(TYPE_CPU_CORE, ACT_RELEASE, core_release);
 	return 0;
 }
 module_init(init);
@@ -363,6 +363,54 @@ exit:
 }
 #endif
 
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+static ssize_t cmdq_sched_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_cmdq_sched *s = &md->queue.cmdq_sched;
+	struct request_queue *q = md->queue.queue;
+	ssize_t ret;
+
+	spin_lock_irq(q->queue_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+		"write_starve_max %u\npending_reads %u\npending_writes %u\n"
+		"dispatched_reads %lu\ndispatched_writes %lu\n"
+		"starved_writes %lu\nmerged_writes %lu\n",
+		s->write_starve_max, s->nr_reads, s->nr_writes,
+		s->dispatched_reads, s->dispatched_writes,
+		s->starved_writes, s->merged_writes);
+	spin_unlock_irq(q->queue_lock);
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t cmdq_sched_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct request_queue *q = md->queue.queue;
+	unsigned int set;
+
+	if (kstrtouint(buf, 0, &set) || !set) {
+		mmc_blk_put(md);
+		return -EINVAL;
+	}
+
+	spin_lock_irq(q->queue_lock);
+	md->queue.cmdq_sched.write_starve_max = set;
+	spin_unlock_irq(q->queue_lock);
+
+	mmc_blk_put(md);
+	return count;
+}
+
+static const DEVICE_ATTR(cmdq_sched, S_IRUGO | S_IWUSR,
+	cmdq_sched_show, cmdq_sched_store);
+#endif
+
 #ifdef CONFIG_MMC_SIMULATE_MAX_SPEED
 
 static int max_read_speed, max_write_speed, cache_size = 4;
@@ -3414,6 +3462,10 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 			device_remove_file(disk_to_dev(md->disk),
 						&dev_attr_cache_size);
 #endif
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+			device_remove_file(disk_to_dev(md->disk),
+						&dev_attr_cmdq_sched);
+#endif
 
 			del_gendisk(md->disk);
 		}
@@ -3467,6 +3519,11 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto cache_size_fail;
 #endif
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+	ret = device_create_file(disk_to_dev(md->disk), &dev_attr_cmdq_sched);
+	if (ret)
+		goto cmdq_sched_fail;
+#endif
 
 	if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
 	     card->ext_csd.boot_ro_lockable) {
@@ -3506,6 +3563,10 @@ bkops_check_threshold_fails:
 	device_remove_file(disk_to_dev(md->disk), &md->power_ro_lock);
 #endif
 power_ro_lock_fail:
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+	device_remove_file(disk_to_dev(md->disk), &dev_attr_cmdq_sched);
+cmdq_sched_fail:
+#endif
 #ifdef CONFIG_MMC_SIMULATE_MAX_SPEED
 	device_remove_file(disk_to_dev(md->disk), &dev_attr_cache_size);
 cache_size_fail:
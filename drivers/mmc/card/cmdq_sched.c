@@ -0,0 +1,175 @@
+/*
+ *  linux/drivers/mmc/card/cmdq_sched.c
+ *
+ *  Read-first request dispatcher for eMMC command queueing.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+#include <linux/blkdev.h>
+
+#include "cmdq_sched.h"
+
+/* Requests carrying any of these are never merged by the dispatcher */
+#define MMC_CMDQ_SCHED_NOMERGE	\
+	(REQ_DISCARD | REQ_FLUSH | REQ_FUA | REQ_NOMERGE | REQ_SECURE)
+
+/* Requests carrying any of these are not reordered with any other */
+#define MMC_CMDQ_SCHED_BARRIER	(REQ_DISCARD | REQ_FLUSH)
+
+void mmc_cmdq_sched_init(struct mmc_cmdq_sched *s)
+{
+	memset(s, 0, sizeof(*s));
+	INIT_LIST_HEAD(&s->read_list);
+	INIT_LIST_HEAD(&s->write_list);
+	s->write_starve_max = MMC_CMDQ_SCHED_WRITE_STARVE;
+	s->max_pending = MMC_CMDQ_SCHED_MAX_PENDING;
+	s->merge_max_sectors = MMC_CMDQ_SCHED_MERGE_SECTORS;
+}
+
+/*
+ * Start a request taken off the dispatch queue with list_del_init() after
+ * blk_peek_request(). blk_start_request() dequeues the request itself, so
+ * put it back at the head first; its timeout and the in-flight accounting
+ * start here.
+ */
+static void mmc_cmdq_sched_start(struct request *req)
+{
+	list_add(&req->queuelist, &req->q->queue_head);
+	blk_start_request(req);
+}
+
+/*
+ * Append the bios of @next to @prev. Both requests have already left the
+ * dispatch queue, so the elevator cannot merge them any more; this does
+ * what attempt_merge() would have done and completes the emptied @next.
+ */
+static bool mmc_cmdq_sched_merge(struct mmc_cmdq_sched *s,
+				 struct request *prev, struct request *next)
+{
+	struct request_queue *q = next->q;
+
+	if (blk_rq_sectors(next) > s->merge_max_sectors)
+		return false;
+	if ((prev->cmd_flags | next->cmd_flags) & MMC_CMDQ_SCHED_NOMERGE)
+		return false;
+	if ((prev->cmd_flags ^ next->cmd_flags) & (REQ_WRITE | REQ_META))
+		return false;
+	if (prev->rq_disk != next->rq_disk || !prev->bio || !next->bio)
+		return false;
+	if (req_get_ioprio(prev) != req_get_ioprio(next))
+		return false;
+	if (blk_rq_pos(prev) + blk_rq_sectors(prev) != blk_rq_pos(next))
+		return false;
+	if (blk_rq_sectors(prev) + blk_rq_sectors(next) >
+	    queue_max_hw_sectors(q))
+		return false;
+	if (prev->nr_phys_segments + next->nr_phys_segments >
+	    queue_max_segments(q))
+		return false;
+
+	prev->biotail->bi_next = next->bio;
+	prev->biotail = next->biotail;
+	prev->__data_len += blk_rq_bytes(next);
+	prev->nr_phys_segments += next->nr_phys_segments;
+	if (time_after(prev->start_time, next->start_time))
+		prev->start_time = next->start_time;
+
+	next->bio = NULL;
+	next->biotail = NULL;
+	next->__data_len = 0;
+	mmc_cmdq_sched_start(next);
+	__blk_end_request_all(next, 0);
+
+	s->merged_writes++;
+	return true;
+}
+
+/**
+ * mmc_cmdq_sched_add - queue a peeked request for dispatch
+ * @s: dispatcher
+ * @req: request returned by blk_peek_request(), already taken off the
+ *	dispatch queue with list_del_init() but not started
+ *
+ * Called with the queue lock held. @req may be completed immediately if
+ * it could be merged into the previous write.
+ */
+void mmc_cmdq_sched_add(struct mmc_cmdq_sched *s, struct request *req)
+{
+	struct request *prev;
+
+	if (req->cmd_flags & MMC_CMDQ_SCHED_BARRIER) {
+		list_add_tail(&req->queuelist, &s->write_list);
+		s->nr_writes++;
+		s->nr_barriers++;
+		return;
+	}
+
+	if (rq_data_dir(req) == READ) {
+		list_add_tail(&req->queuelist, &s->read_list);
+		s->nr_reads++;
+		return;
+	}
+
+	if (s->nr_writes) {
+		prev = list_last_entry(&s->write_list, struct request,
+				       queuelist);
+		if (mmc_cmdq_sched_merge(s, prev, req))
+			return;
+	}
+	list_add_tail(&req->queuelist, &s->write_list);
+	s->nr_writes++;
+}
+
+/**
+ * mmc_cmdq_sched_peek - return the request that should be tagged next
+ * @s: dispatcher
+ *
+ * The request stays queued until mmc_cmdq_sched_dispatch() is called, so
+ * the caller can back off if the card has no free tag for it. While a
+ * barrier is held the reads, which all came before it, go first and the
+ * writes follow in order, so the barrier goes last.
+ */
+struct request *mmc_cmdq_sched_peek(struct mmc_cmdq_sched *s)
+{
+	if (s->nr_writes && (!s->nr_reads ||
+	    (!s->nr_barriers && s->starved >= s->write_starve_max)))
+		return list_first_entry(&s->write_list, struct request,
+					queuelist);
+	if (s->nr_reads)
+		return list_first_entry(&s->read_list, struct request,
+					queuelist);
+	return NULL;
+}
+
+/**
+ * mmc_cmdq_sched_dispatch - remove a peeked request and start it
+ * @s: dispatcher
+ * @req: request returned by mmc_cmdq_sched_peek()
+ *
+ * Called with the queue lock held, once the card has a tag for @req.
+ */
+void mmc_cmdq_sched_dispatch(struct mmc_cmdq_sched *s, struct request *req)
+{
+	list_del_init(&req->queuelist);
+	mmc_cmdq_sched_start(req);
+
+	if (req->cmd_flags & MMC_CMDQ_SCHED_BARRIER)
+		s->nr_barriers--;
+
+	if (rq_data_dir(req) == READ) {
+		s->nr_reads--;
+		s->dispatched_reads++;
+		if (s->nr_writes)
+			s->starved++;
+		return;
+	}
+
+	s->nr_writes--;
+	s->dispatched_writes++;
+	if (s->nr_reads && s->starved >= s->write_starve_max)
+		s->starved_writes++;
+	s->starved = 0;
+}
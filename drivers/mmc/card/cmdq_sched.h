@@ -0,0 +1,66 @@
+#ifndef MMC_CMDQ_SCHED_H
+#define MMC_CMDQ_SCHED_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+
+struct request;
+
+/*
+ * Read-first dispatcher for command queue capable cards.
+ *
+ * Requests are taken off the dispatch queue into a read list and a write
+ * list without being started; they are started when they are dispatched,
+ * i.e. once the card has a tag for them. Reads are handed out first so
+ * foreground reads do not wait behind a full hardware queue of writeback,
+ * but once write_starve_max reads have gone out ahead of a waiting write
+ * the oldest write is dispatched. Small writes that are contiguous with the
+ * tail of the write list are merged into it before a task tag is assigned.
+ *
+ * Flush and discard requests are ordering barriers. Nothing is taken in
+ * behind one, and the requests held before it are all dispatched before it.
+ *
+ * The caller serializes all calls with the request queue lock.
+ */
+struct mmc_cmdq_sched {
+	struct list_head	read_list;
+	struct list_head	write_list;
+	unsigned int		nr_reads;
+	unsigned int		nr_writes;
+	unsigned int		nr_barriers;
+	unsigned int		starved;
+
+	/* tunables */
+	unsigned int		write_starve_max;
+	unsigned int		max_pending;
+	unsigned int		merge_max_sectors;
+
+	/* statistics */
+	unsigned long		dispatched_reads;
+	unsigned long		dispatched_writes;
+	unsigned long		starved_writes;
+	unsigned long		merged_writes;
+};
+
+#define MMC_CMDQ_SCHED_WRITE_STARVE	8
+#define MMC_CMDQ_SCHED_MAX_PENDING	64
+#define MMC_CMDQ_SCHED_MERGE_SECTORS	64	/* 32 KiB */
+
+extern void mmc_cmdq_sched_init(struct mmc_cmdq_sched *);
+extern void mmc_cmdq_sched_add(struct mmc_cmdq_sched *, struct request *);
+extern struct request *mmc_cmdq_sched_peek(struct mmc_cmdq_sched *);
+extern void mmc_cmdq_sched_dispatch(struct mmc_cmdq_sched *,
+				    struct request *);
+
+static inline bool mmc_cmdq_sched_empty(struct mmc_cmdq_sched *s)
+{
+	return !s->nr_reads && !s->nr_writes;
+}
+
+/* true if no more requests should be added for now */
+static inline bool mmc_cmdq_sched_full(struct mmc_cmdq_sched *s)
+{
+	return s->nr_barriers || s->nr_reads + s->nr_writes >= s->max_pending;
+}
+
+#endif
@@ -92,6 +92,40 @@ int mmc_is_cmdq_full(struct mmc_host *host, int rt)
 }
 #endif
 
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+/*
+ * Move peeked requests into the read-first dispatcher and return the one
+ * that should be tagged next, started, or NULL if there is none or the
+ * card has no free tag for it. Requests are only started once they are
+ * dispatched, so their timeout does not run while they wait here. Called
+ * with the queue lock held.
+ */
+static struct request *mmc_cmdq_sched_fetch(struct mmc_queue *mq,
+					    int *cmdq_full)
+{
+	struct mmc_cmdq_sched *s = &mq->cmdq_sched;
+	struct request *req;
+
+	while (mq->card->ext_csd.cmdq_mode_en && !mmc_cmdq_sched_full(s)) {
+		req = blk_peek_request(mq->queue);
+		if (!req)
+			break;
+		list_del_init(&req->queuelist);
+		mmc_cmdq_sched_add(s, req);
+	}
+
+	req = mmc_cmdq_sched_peek(s);
+	if (!req)
+		return NULL;
+	if (mmc_is_cmdq_full(mq->card->host, IS_RT_CLASS_REQ(req))) {
+		*cmdq_full = 1;
+		return NULL;
+	}
+	mmc_cmdq_sched_dispatch(s, req);
+	return req;
+}
+#endif
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -127,6 +161,17 @@ static int mmc_queue_thread(void *d)
 #endif
 		set_current_state(TASK_INTERRUPTIBLE);
 #ifdef CONFIG_MTK_EMMC_CQ_SUPPORT
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+		/*
+		 * Requests already held by the dispatcher are drained even
+		 * if command queue mode has been switched off meanwhile.
+		 */
+		if (mq->card->ext_csd.cmdq_mode_en ||
+		    !mmc_cmdq_sched_empty(&mq->cmdq_sched)) {
+			req = mmc_cmdq_sched_fetch(mq, &cmdq_full);
+			goto fetch_done;
+		}
+#endif
 		req = blk_peek_request(q);
 		if (!req)
 			goto fetch_done;
@@ -193,7 +238,11 @@ fetch_done:
 			}
 #endif
 		} else {
-			if (kthread_should_stop()) {
+			if (kthread_should_stop()
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+			    && mmc_cmdq_sched_empty(&mq->cmdq_sched)
+#endif
+			    ) {
 				set_current_state(TASK_RUNNING);
 				break;
 			}
@@ -351,6 +400,9 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mq->mqrq_cur = mqrq_cur;
 	mq->mqrq_prev = mqrq_prev;
 	mq->queue->queuedata = mq;
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+	mmc_cmdq_sched_init(&mq->cmdq_sched);
+#endif
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
@@ -1,6 +1,10 @@
 #ifndef MMC_QUEUE_H
 #define MMC_QUEUE_H
 
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+#include "cmdq_sched.h"
+#endif
+
 #define MMC_REQ_SPECIAL_MASK	(REQ_DISCARD | REQ_FLUSH)
 
 struct request;
@@ -71,6 +75,9 @@ struct mmc_queue {
 #endif
 	struct mmc_queue_req	*mqrq_cur;
 	struct mmc_queue_req	*mqrq_prev;
+#ifdef CONFIG_MMC_CMDQ_READ_PRIO
+	struct mmc_cmdq_sched	cmdq_sched;
+#endif
 #ifdef CONFIG_MMC_SIMULATE_MAX_SPEED
 	atomic_t max_write_speed;
 	atomic_t max_read_speed;
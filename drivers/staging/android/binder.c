@@ -56,6 +56,7 @@
 #include <linux/file.h>
 #include <linux/freezer.h>
 #include <linux/fs.h>
+#include <linux/hash.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
@@ -71,9 +72,12 @@
 #include <linux/security.h>
 #include <linux/spinlock.h>
 #include <linux/ratelimit.h>
+#include <linux/vmalloc.h>
 #include "binder.h"
 #include "binder_alloc.h"
+#include "binder_latency.h"
 #include "binder_trace.h"
+#include "dbitmap.h"
 
 static HLIST_HEAD(binder_deferred_list);
 static DEFINE_MUTEX(binder_deferred_lock);
@@ -433,8 +437,10 @@ struct binder_ref_data {
 /**
  * struct binder_ref - struct to track references on nodes
  * @data:        binder_ref_data containing id, handle, and current refcounts
- * @rb_node_desc: node for lookup by @data.desc in proc's rb_tree
- * @rb_node_node: node for lookup by @node in proc's rb_tree
+ * @rb_node_desc: node for @data.desc ordered walks of proc's rb_tree
+ * @rb_node_node: node for @node ordered walks of proc's rb_tree
+ * @hnode_desc:  node for lookup by @data.desc in proc's ref hash
+ * @hnode_node:  node for lookup by @node in proc's ref hash
  * @node_entry:  list entry for node->refs list in target node
  *               (protected by @node->lock)
  * @proc:        binder_proc containing ref
@@ -455,12 +461,34 @@ struct binder_ref {
 	struct binder_ref_data data;
 	struct rb_node rb_node_desc;
 	struct rb_node rb_node_node;
+	struct hlist_node hnode_desc;
+	struct hlist_node hnode_node;
 	struct hlist_node node_entry;
 	struct binder_proc *proc;
 	struct binder_node *node;
 	struct binder_ref_death *death;
 };
 
+#define BINDER_REF_HASH_MIN_BITS	4
+#define BINDER_REF_HASH_GROW_BITS	2
+
+/**
+ * struct binder_ref_hash - hash index of a proc's refs
+ * @desc:        buckets for lookup by ref->data.desc
+ * @node:        buckets for lookup by ref->node
+ * @bits:        log2 of the number of buckets in each table
+ *
+ * Starts with the buckets embedded in the proc and grows by a factor of
+ * 1 << BINDER_REF_HASH_GROW_BITS once the proc holds more refs than
+ * buckets, so chains stay short for procs holding thousands of refs.
+ * It never shrinks.
+ */
+struct binder_ref_hash {
+	struct hlist_head *desc;
+	struct hlist_head *node;
+	unsigned int bits;
+};
+
 enum binder_deferred_state {
 	BINDER_DEFERRED_PUT_FILES    = 0x01,
 	BINDER_DEFERRED_FLUSH        = 0x02,
@@ -495,6 +523,13 @@ struct binder_priority {
  *                        (protected by @outer_lock)
  * @refs_by_node:         rbtree of refs ordered by ref->node
  *                        (protected by @outer_lock)
+ * @ref_hash:             hash of refs by ref->desc and by ref->node
+ *                        (protected by @outer_lock)
+ * @ref_hash_min:         initial buckets of @ref_hash
+ * @nr_refs:              number of refs in @ref_hash
+ *                        (protected by @outer_lock)
+ * @dmap:                 bitmap of descriptors in use
+ *                        (protected by @outer_lock)
  * @waiting_threads:      threads currently waiting for proc work
  *                        (protected by @inner_lock)
  * @pid                   PID of group_leader of process
@@ -546,6 +581,10 @@ struct binder_proc {
 	struct rb_root nodes;
 	struct rb_root refs_by_desc;
 	struct rb_root refs_by_node;
+	struct binder_ref_hash ref_hash;
+	struct hlist_head ref_hash_min[2][1 << BINDER_REF_HASH_MIN_BITS];
+	unsigned int nr_refs;
+	struct dbitmap dmap;
 	struct list_head waiting_threads;
 	int pid;
 	struct task_struct *tsk;
@@ -611,6 +650,9 @@ enum {
  *                        when outstanding transactions are cleaned up
  *                        (protected by @proc->inner_lock)
  * @task:                 struct task_struct for this thread
+ * @lat:                  time of the last wakeup for work, for the
+ *                        latency histograms
+ *                        (protected by @proc->inner_lock)
  *
  * Bookkeeping structure for binder threads.
  */
@@ -630,6 +672,7 @@ struct binder_thread {
 	atomic_t tmp_ref;
 	bool is_dead;
 	struct task_struct *task;
+	struct binder_thread_stamp lat;
 };
 
 struct binder_transaction {
@@ -650,6 +693,7 @@ struct binder_transaction {
 	struct binder_priority	saved_priority;
 	bool    set_priority_called;
 	kuid_t	sender_euid;
+	struct binder_txn_stamp lat;
 	/**
 	 * @lock:  protects @from, @to_proc, and @to_thread
 	 *
@@ -1044,6 +1088,7 @@ static void binder_wakeup_thread_ilocked(struct binder_proc *proc,
 	assert_spin_locked(&proc->inner_lock);
 
 	if (thread) {
+		binder_latency_woken(&thread->lat);
 		if (sync)
 			wake_up_interruptible_sync(&thread->wait);
 		else
@@ -1538,29 +1583,191 @@ static void binder_put_node(struct binder_node *node)
 	binder_dec_node_tmpref(node);
 }
 
-static struct binder_ref *binder_get_ref_olocked(struct binder_proc *proc,
-						 u32 desc, bool need_strong_ref)
+static inline struct hlist_head *
+binder_ref_hash_desc(struct binder_proc *proc, u32 desc)
 {
-	struct rb_node *n = proc->refs_by_desc.rb_node;
+	return &proc->ref_hash.desc[hash_32(desc, proc->ref_hash.bits)];
+}
+
+static inline struct hlist_head *
+binder_ref_hash_node(struct binder_proc *proc, struct binder_node *node)
+{
+	return &proc->ref_hash.node[hash_ptr(node, proc->ref_hash.bits)];
+}
+
+static void binder_init_ref_hash(struct binder_proc *proc)
+{
+	proc->ref_hash.desc = proc->ref_hash_min[0];
+	proc->ref_hash.node = proc->ref_hash_min[1];
+	proc->ref_hash.bits = BINDER_REF_HASH_MIN_BITS;
+}
+
+static struct hlist_head *binder_alloc_ref_hash(unsigned int bits)
+{
+	size_t size = sizeof(struct hlist_head) << bits;
+	struct hlist_head *buckets;
+
+	buckets = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+	if (!buckets)
+		buckets = vzalloc(size);
+	return buckets;
+}
+
+static void binder_free_ref_hash(struct binder_proc *proc,
+				 struct binder_ref_hash *hash)
+{
+	if (hash->desc == proc->ref_hash_min[0])
+		return;
+	kvfree(hash->desc);
+	kvfree(hash->node);
+}
+
+/**
+ * binder_grow_ref_hash() - grow the ref hash of a proc if it is too full
+ * @proc:	proc to check
+ *
+ * The buckets are allocated without the outer lock held. If that fails
+ * the proc keeps the old buckets, lookups just walk longer chains.
+ */
+static void binder_grow_ref_hash(struct binder_proc *proc)
+{
+	struct binder_ref_hash new, old;
 	struct binder_ref *ref;
+	struct rb_node *n;
+	bool grow;
 
-	while (n) {
+	binder_proc_lock(proc);
+	new.bits = proc->ref_hash.bits + BINDER_REF_HASH_GROW_BITS;
+	grow = proc->nr_refs > 1U << proc->ref_hash.bits;
+	binder_proc_unlock(proc);
+	if (!grow)
+		return;
+
+	new.desc = binder_alloc_ref_hash(new.bits);
+	new.node = binder_alloc_ref_hash(new.bits);
+	if (!new.desc || !new.node) {
+		kvfree(new.desc);
+		kvfree(new.node);
+		return;
+	}
+
+	binder_proc_lock(proc);
+	if (proc->ref_hash.bits >= new.bits) {
+		/* somebody else grew it meanwhile */
+		binder_proc_unlock(proc);
+		binder_free_ref_hash(proc, &new);
+		return;
+	}
+	old = proc->ref_hash;
+	proc->ref_hash = new;
+	for (n = rb_first(&proc->refs_by_desc); n != NULL; n = rb_next(n)) {
 		ref = rb_entry(n, struct binder_ref, rb_node_desc);
+		hlist_add_head(&ref->hnode_desc,
+			       binder_ref_hash_desc(proc, ref->data.desc));
+		hlist_add_head(&ref->hnode_node,
+			       binder_ref_hash_node(proc, ref->node));
+	}
+	binder_proc_unlock(proc);
+	binder_free_ref_hash(proc, &old);
+}
 
-		if (desc < ref->data.desc) {
-			n = n->rb_left;
-		} else if (desc > ref->data.desc) {
-			n = n->rb_right;
-		} else if (need_strong_ref && !ref->data.strong) {
+static struct binder_ref *binder_get_ref_olocked(struct binder_proc *proc,
+						 u32 desc, bool need_strong_ref)
+{
+	struct binder_ref *ref;
+
+	hlist_for_each_entry(ref, binder_ref_hash_desc(proc, desc),
+			     hnode_desc) {
+		if (ref->data.desc != desc)
+			continue;
+		if (need_strong_ref && !ref->data.strong) {
 			binder_user_error("tried to use weak ref as strong ref\n");
 			return NULL;
-		} else {
-			return ref;
 		}
+		return ref;
 	}
 	return NULL;
 }
 
+/* Find the lowest unused desc by walking all the refs */
+static u32 slow_desc_lookup_olocked(struct binder_proc *proc, u32 offset)
+{
+	struct binder_ref *ref;
+	struct rb_node *n;
+	u32 desc;
+
+	desc = offset;
+	for (n = rb_first(&proc->refs_by_desc); n; n = rb_next(n)) {
+		ref = rb_entry(n, struct binder_ref, rb_node_desc);
+		if (ref->data.desc > desc)
+			break;
+		desc = ref->data.desc + 1;
+	}
+	return desc;
+}
+
+/*
+ * Find an available reference descriptor ID. The proc->outer_lock might
+ * be released in the process, in which case -EAGAIN is returned and the
+ * @desc should be considered invalid.
+ */
+static int get_ref_desc_olocked(struct binder_proc *proc,
+				struct binder_node *node,
+				u32 *desc)
+{
+	struct dbitmap *dmap = &proc->dmap;
+	unsigned long *new, bit;
+	unsigned int nbits;
+	u32 offset;
+
+	/* 0 is reserved for the context manager */
+	offset = (node == proc->context->binder_context_mgr_node) ? 0 : 1;
+
+	if (!dbitmap_enabled(dmap)) {
+		*desc = slow_desc_lookup_olocked(proc, offset);
+		return 0;
+	}
+
+	if (dbitmap_acquire_next_zero_bit(dmap, offset, &bit) == 0) {
+		*desc = bit;
+		return 0;
+	}
+
+	/*
+	 * The dbitmap is full and needs to grow. The proc->outer_lock
+	 * is briefly released to allocate the new bitmap safely.
+	 */
+	nbits = dbitmap_grow_nbits(dmap);
+	binder_proc_unlock(proc);
+	new = dbitmap_alloc(nbits);
+	binder_proc_lock(proc);
+	dbitmap_grow(dmap, new, nbits);
+
+	return -EAGAIN;
+}
+
+/**
+ * binder_try_shrink_dmap() - shrink the desc bitmap of a proc if mostly unused
+ * @proc:	proc to check
+ */
+static void binder_try_shrink_dmap(struct binder_proc *proc)
+{
+	unsigned long *new;
+	unsigned int nbits;
+
+	binder_proc_lock(proc);
+	nbits = dbitmap_shrink_nbits(&proc->dmap);
+	binder_proc_unlock(proc);
+
+	if (!nbits)
+		return;
+
+	new = dbitmap_alloc(nbits);
+	binder_proc_lock(proc);
+	dbitmap_shrink(&proc->dmap, new, nbits);
+	binder_proc_unlock(proc);
+}
+
 /**
  * binder_get_ref_for_node_olocked() - get the ref associated with given node
  * @proc:	binder_proc that owns the ref
@@ -1571,7 +1778,9 @@ static struct binder_ref *binder_get_ref_olocked(struct binder_proc *proc,
  *
  * If it doesn't exist and the caller provides a newly allocated
  * ref, initialize the fields of the newly allocated ref and insert
- * into the given proc rb_trees and node refs list.
+ * into the given proc rb_trees, ref hash and node refs list. The
+ * proc->outer_lock may be dropped and retaken while allocating a
+ * desc in that case.
  *
  * Return:	the ref for node. It is possible that another thread
  *		allocated/initialized the ref first in which case the
@@ -1584,25 +1793,32 @@ static struct binder_ref *binder_get_ref_for_node_olocked(
 					struct binder_node *node,
 					struct binder_ref *new_ref)
 {
-	struct binder_context *context = proc->context;
-	struct rb_node **p = &proc->refs_by_node.rb_node;
+	struct rb_node **p;
 	struct rb_node *parent = NULL;
 	struct binder_ref *ref;
-	struct rb_node *n;
+	u32 desc;
+
+retry:
+	hlist_for_each_entry(ref, binder_ref_hash_node(proc, node), hnode_node)
+		if (ref->node == node)
+			return ref;
+	if (!new_ref)
+		return NULL;
 
+	/* might release the proc->outer_lock while growing the dbitmap */
+	if (get_ref_desc_olocked(proc, node, &desc) == -EAGAIN)
+		goto retry;
+
+	p = &proc->refs_by_node.rb_node;
 	while (*p) {
 		parent = *p;
 		ref = rb_entry(parent, struct binder_ref, rb_node_node);
 
 		if (node < ref->node)
 			p = &(*p)->rb_left;
-		else if (node > ref->node)
-			p = &(*p)->rb_right;
 		else
-			return ref;
+			p = &(*p)->rb_right;
 	}
-	if (!new_ref)
-		return NULL;
 
 	binder_stats_created(BINDER_STAT_REF);
 	new_ref->data.debug_id = atomic_inc_return(&binder_last_id);
@@ -1611,15 +1827,9 @@ static struct binder_ref *binder_get_ref_for_node_olocked(
 	rb_link_node(&new_ref->rb_node_node, parent, p);
 	rb_insert_color(&new_ref->rb_node_node, &proc->refs_by_node);
 
-	new_ref->data.desc = (node == context->binder_context_mgr_node) ? 0 : 1;
-	for (n = rb_first(&proc->refs_by_desc); n != NULL; n = rb_next(n)) {
-		ref = rb_entry(n, struct binder_ref, rb_node_desc);
-		if (ref->data.desc > new_ref->data.desc)
-			break;
-		new_ref->data.desc = ref->data.desc + 1;
-	}
-
+	new_ref->data.desc = desc;
 	p = &proc->refs_by_desc.rb_node;
+	parent = NULL;
 	while (*p) {
 		parent = *p;
 		ref = rb_entry(parent, struct binder_ref, rb_node_desc);
@@ -1634,6 +1844,10 @@ static struct binder_ref *binder_get_ref_for_node_olocked(
 	rb_link_node(&new_ref->rb_node_desc, parent, p);
 	rb_insert_color(&new_ref->rb_node_desc, &proc->refs_by_desc);
 
+	hlist_add_head(&new_ref->hnode_desc, binder_ref_hash_desc(proc, desc));
+	hlist_add_head(&new_ref->hnode_node, binder_ref_hash_node(proc, node));
+	proc->nr_refs++;
+
 	binder_node_lock(node);
 	hlist_add_head(&new_ref->node_entry, &node->refs);
 
@@ -1654,8 +1868,12 @@ static void binder_cleanup_ref_olocked(struct binder_ref *ref)
 		      ref->proc->pid, ref->data.debug_id, ref->data.desc,
 		      ref->node->debug_id);
 
+	dbitmap_clear_bit(&ref->proc->dmap, ref->data.desc);
 	rb_erase(&ref->rb_node_desc, &ref->proc->refs_by_desc);
 	rb_erase(&ref->rb_node_node, &ref->proc->refs_by_node);
+	hlist_del(&ref->hnode_desc);
+	hlist_del(&ref->hnode_node);
+	ref->proc->nr_refs--;
 
 	binder_node_inner_lock(ref->node);
 	if (ref->data.strong)
@@ -1850,8 +2068,10 @@ static int binder_update_ref_for_handle(struct binder_proc *proc,
 		*rdata = ref->data;
 	binder_proc_unlock(proc);
 
-	if (delete_ref)
+	if (delete_ref) {
 		binder_free_ref(ref);
+		binder_try_shrink_dmap(proc);
+	}
 	return ret;
 
 err_no_ref:
@@ -1919,6 +2139,8 @@ static int binder_inc_ref_for_node(struct binder_proc *proc,
 		 * free the one we allocated
 		 */
 		kfree(new_ref);
+	else if (new_ref)
+		binder_grow_ref_hash(proc);
 	return ret;
 }
 
@@ -3201,8 +3423,11 @@ static void binder_transaction(struct binder_proc *proc,
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	binder_enqueue_work(proc, tcomplete, &thread->todo);
 	t->work.type = BINDER_WORK_TRANSACTION;
+	binder_latency_queued(&t->lat);
 
 	if (reply) {
+		binder_latency_replied(&in_reply_to->lat, proc->pid,
+				       in_reply_to->code);
 		binder_inner_proc_lock(target_proc);
 		if (target_thread->is_dead) {
 			binder_inner_proc_unlock(target_proc);
@@ -3830,6 +4055,7 @@ static int binder_wait_for_work(struct binder_thread *thread,
 
 	freezer_do_not_count();
 	binder_inner_proc_lock(proc);
+	binder_latency_sleep(&thread->lat);
 	for (;;) {
 		prepare_to_wait(&thread->wait, &wait, TASK_INTERRUPTIBLE);
 		if (binder_has_work_ilocked(thread, do_proc_work))
@@ -3935,8 +4161,11 @@ retry:
 
 		switch (w->type) {
 		case BINDER_WORK_TRANSACTION: {
-			binder_inner_proc_unlock(proc);
 			t = container_of(w, struct binder_transaction, work);
+			if (t->buffer->target_node)
+				binder_latency_picked(&t->lat, &thread->lat,
+						      proc->pid, t->code);
+			binder_inner_proc_unlock(proc);
 		} break;
 		case BINDER_WORK_RETURN_ERROR: {
 			struct binder_error *e = container_of(
@@ -4328,6 +4557,8 @@ static void binder_free_proc(struct binder_proc *proc)
 	binder_alloc_deferred_release(&proc->alloc);
 	put_task_struct(proc->tsk);
 	binder_stats_deleted(BINDER_STAT_PROC);
+	binder_free_ref_hash(proc, &proc->ref_hash);
+	dbitmap_free(&proc->dmap);
 	kfree(proc);
 }
 
@@ -4770,6 +5001,9 @@ static int binder_open(struct inode *nodp, struct file *filp)
 				  miscdev);
 	proc->context = &binder_dev->context;
 	binder_alloc_init(&proc->alloc);
+	binder_init_ref_hash(proc);
+	/* without the bitmap descs are found by walking the refs */
+	dbitmap_init(&proc->dmap);
 
 	binder_stats_created(BINDER_STAT_PROC);
 	proc->pid = current->group_leader->pid;
@@ -5657,6 +5891,7 @@ static int __init binder_init(void)
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
 	}
+	binder_latency_init(binder_debugfs_dir_entry_root);
 
 	/*
 	 * Copy the module_parameter string, because we don't want to
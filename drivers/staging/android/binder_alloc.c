@@ -28,6 +28,7 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include "binder_alloc.h"
+#include "binder_latency.h"
 #include "binder_trace.h"
 
 static DEFINE_MUTEX(binder_alloc_mmap_lock);
@@ -436,11 +437,13 @@ struct binder_buffer *binder_alloc_new_buf(struct binder_alloc *alloc,
 					   int is_async)
 {
 	struct binder_buffer *buffer;
+	u64 start = binder_latency_now();
 
 	mutex_lock(&alloc->mutex);
 	buffer = binder_alloc_new_buf_locked(alloc, data_size, offsets_size,
 					     extra_buffers_size, is_async);
 	mutex_unlock(&alloc->mutex);
+	binder_latency_alloc(start);
 	return buffer;
 }
 
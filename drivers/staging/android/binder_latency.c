@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Transaction latency histograms. Every CPU owns a small open addressed
+ * table of (target pid, code) records and only ever writes its own table
+ * with preemption disabled, so accounting a sample takes no lock and no
+ * atomic. Readers sum the tables of all CPUs; a sample racing with a read
+ * may or may not be counted. Clearing bumps a generation, each CPU wipes
+ * its own table on its next sample and readers skip tables of an older
+ * generation. Records are never evicted: once its probes are all taken, a
+ * (pid, code) pair lands in the overflow record and is counted as dropped,
+ * so a reader can tell when the table was too small.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/atomic.h>
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/jhash.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include "binder_latency.h"
+#include "binder_trace.h"
+
+#define BINDER_LATENCY_SLOTS_BITS	6
+#define BINDER_LATENCY_SLOTS		(1 << BINDER_LATENCY_SLOTS_BITS)
+#define BINDER_LATENCY_PROBES		8
+
+struct binder_latency_cpu {
+	unsigned int gen;
+	u32 dropped;
+	u32 alloc[BINDER_LATENCY_BUCKETS];
+	/* slot[BINDER_LATENCY_SLOTS] is the overflow record */
+	struct binder_latency_record slot[BINDER_LATENCY_SLOTS + 1];
+};
+
+static struct binder_latency_cpu __percpu *binder_latency_cpu;
+static atomic_t binder_latency_gen = ATOMIC_INIT(1);
+
+static inline int binder_latency_bucket(u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	return min_t(int, fls64(us), BINDER_LATENCY_BUCKETS - 1);
+}
+
+/* called with preemption disabled */
+static struct binder_latency_cpu *binder_latency_this_cpu(void)
+{
+	struct binder_latency_cpu *lc = this_cpu_ptr(binder_latency_cpu);
+	unsigned int gen = atomic_read(&binder_latency_gen);
+
+	if (unlikely(lc->gen != gen)) {
+		lc->gen = 0;
+		smp_wmb();
+		lc->dropped = 0;
+		memset(lc->alloc, 0, sizeof(lc->alloc));
+		memset(lc->slot, 0, sizeof(lc->slot));
+		lc->slot[BINDER_LATENCY_SLOTS].pid = -1;
+		smp_wmb();
+		lc->gen = gen;
+	}
+	return lc;
+}
+
+static struct binder_latency_record *
+binder_latency_lookup(struct binder_latency_cpu *lc, int pid, u32 code)
+{
+	struct binder_latency_record *rec;
+	u32 i, h = jhash_2words(pid, code, 0);
+
+	for (i = 0; i < BINDER_LATENCY_PROBES; i++) {
+		rec = &lc->slot[(h + i) & (BINDER_LATENCY_SLOTS - 1)];
+		if (rec->pid == pid && rec->code == code)
+			return rec;
+		if (!rec->pid) {
+			/* readers check pid before trusting code */
+			rec->code = code;
+			smp_wmb();
+			WRITE_ONCE(rec->pid, pid);
+			return rec;
+		}
+	}
+	lc->dropped++;
+	return &lc->slot[BINDER_LATENCY_SLOTS];
+}
+
+static void binder_latency_add(int pid, u32 code, u64 delta[])
+{
+	struct binder_latency_record *rec;
+	struct binder_latency_cpu *lc;
+	int kind;
+
+	for (kind = 0; kind < BINDER_LATENCY_KINDS; kind++)
+		if (delta[kind] != U64_MAX)
+			trace_binder_latency(pid, code, kind, delta[kind]);
+
+	if (!binder_latency_cpu)
+		return;
+
+	preempt_disable();
+	lc = binder_latency_this_cpu();
+	rec = binder_latency_lookup(lc, pid, code);
+	for (kind = 0; kind < BINDER_LATENCY_KINDS; kind++)
+		if (delta[kind] != U64_MAX)
+			rec->hist[kind][binder_latency_bucket(delta[kind])]++;
+	preempt_enable();
+}
+
+/**
+ * binder_latency_picked() - account a transaction taken off a todo list
+ * @ts:     stamps of the transaction
+ * @ws:     stamp of the thread that picked it
+ * @pid:    pid of the target process
+ * @code:   transaction code
+ *
+ * If the thread was woken after the transaction was queued, the time up
+ * to the wakeup is the queueing delay and the rest the wakeup delay.
+ * Otherwise the thread found the work on its way back into the driver
+ * and the whole time is queueing delay. Called with the target
+ * proc->inner_lock held.
+ */
+void binder_latency_picked(struct binder_txn_stamp *ts,
+			   struct binder_thread_stamp *ws,
+			   int pid, u32 code)
+{
+	u64 delta[BINDER_LATENCY_KINDS] = { U64_MAX, U64_MAX, U64_MAX };
+	u64 now = ktime_get_ns();
+	u64 woken = ws->woken;
+
+	ws->woken = 0;
+	ts->picked = now;
+	if (!ts->queued)
+		return;
+
+	if (woken >= ts->queued) {
+		delta[BINDER_LATENCY_QUEUE] = woken - ts->queued;
+		delta[BINDER_LATENCY_WAKEUP] = now - woken;
+	} else {
+		delta[BINDER_LATENCY_QUEUE] = now - ts->queued;
+	}
+	binder_latency_add(pid, code, delta);
+}
+
+/**
+ * binder_latency_replied() - account the reply to a transaction
+ * @ts:     stamps of the transaction being replied to
+ * @pid:    pid of the replying (target) process
+ * @code:   code of the transaction being replied to
+ */
+void binder_latency_replied(struct binder_txn_stamp *ts, int pid, u32 code)
+{
+	u64 delta[BINDER_LATENCY_KINDS] = { U64_MAX, U64_MAX, U64_MAX };
+
+	if (!ts->picked)
+		return;
+
+	delta[BINDER_LATENCY_REPLY] = ktime_get_ns() - ts->picked;
+	binder_latency_add(pid, code, delta);
+}
+
+/**
+ * binder_latency_alloc() - account a buffer allocation
+ * @start:  binder_latency_now() before the allocation
+ */
+void binder_latency_alloc(u64 start)
+{
+	struct binder_latency_cpu *lc;
+	int bucket = binder_latency_bucket(ktime_get_ns() - start);
+
+	if (!binder_latency_cpu)
+		return;
+
+	preempt_disable();
+	lc = binder_latency_this_cpu();
+	lc->alloc[bucket]++;
+	preempt_enable();
+}
+
+struct binder_latency_snapshot {
+	size_t size;
+	struct binder_latency_header hdr;
+	struct binder_latency_record rec[0];
+};
+
+static void binder_latency_merge(struct binder_latency_snapshot *s,
+				 const struct binder_latency_record *src)
+{
+	struct binder_latency_record *dst;
+	int pid = READ_ONCE(src->pid);
+	u32 i, code;
+
+	if (!pid)
+		return;
+	smp_rmb();
+	code = src->code;
+
+	for (i = 0; i < s->hdr.nr_records; i++)
+		if (s->rec[i].pid == pid && s->rec[i].code == code)
+			break;
+	dst = &s->rec[i];
+	if (i == s->hdr.nr_records) {
+		memset(dst, 0, sizeof(*dst));
+		dst->pid = pid;
+		dst->code = code;
+		s->hdr.nr_records++;
+	}
+	for (i = 0; i < BINDER_LATENCY_KINDS * BINDER_LATENCY_BUCKETS; i++)
+		(&dst->hist[0][0])[i] += READ_ONCE((&src->hist[0][0])[i]);
+}
+
+static int binder_latency_open(struct inode *inode, struct file *file)
+{
+	unsigned int gen = atomic_read(&binder_latency_gen);
+	struct binder_latency_snapshot *s;
+	struct binder_latency_cpu *lc;
+	size_t max;
+	int cpu, i;
+
+	if (!binder_latency_cpu)
+		return -ENODEV;
+
+	/* a write-only open only clears */
+	if (!(file->f_mode & FMODE_READ))
+		return nonseekable_open(inode, file);
+
+	max = (size_t)num_possible_cpus() * (BINDER_LATENCY_SLOTS + 1);
+	s = vzalloc(sizeof(*s) + max * sizeof(s->rec[0]));
+	if (!s)
+		return -ENOMEM;
+
+	s->hdr.magic = BINDER_LATENCY_MAGIC;
+	s->hdr.version = BINDER_LATENCY_VERSION;
+	s->hdr.header_size = sizeof(s->hdr);
+	s->hdr.nr_buckets = BINDER_LATENCY_BUCKETS;
+	s->hdr.nr_kinds = BINDER_LATENCY_KINDS;
+	s->hdr.record_size = sizeof(s->rec[0]);
+
+	for_each_possible_cpu(cpu) {
+		lc = per_cpu_ptr(binder_latency_cpu, cpu);
+		if (READ_ONCE(lc->gen) != gen)
+			continue;
+		smp_rmb();
+		s->hdr.nr_dropped += READ_ONCE(lc->dropped);
+		for (i = 0; i < BINDER_LATENCY_BUCKETS; i++)
+			s->hdr.alloc[i] += READ_ONCE(lc->alloc[i]);
+		for (i = 0; i <= BINDER_LATENCY_SLOTS; i++)
+			binder_latency_merge(s, &lc->slot[i]);
+	}
+
+	s->size = sizeof(s->hdr) + s->hdr.nr_records * sizeof(s->rec[0]);
+	file->private_data = s;
+	return nonseekable_open(inode, file);
+}
+
+static ssize_t binder_latency_read(struct file *file, char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	struct binder_latency_snapshot *s = file->private_data;
+
+	return simple_read_from_buffer(ubuf, count, ppos, &s->hdr, s->size);
+}
+
+static ssize_t binder_latency_write(struct file *file,
+				    const char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	/* skip 0, the generation of a wiped table */
+	if (!atomic_inc_return(&binder_latency_gen))
+		atomic_inc(&binder_latency_gen);
+	return count;
+}
+
+static int binder_latency_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations binder_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = binder_latency_open,
+	.read = binder_latency_read,
+	.write = binder_latency_write,
+	.llseek = no_llseek,
+	.release = binder_latency_release,
+};
+
+void binder_latency_init(struct dentry *root)
+{
+	int cpu;
+
+	binder_latency_cpu = alloc_percpu(struct binder_latency_cpu);
+	if (!binder_latency_cpu) {
+		pr_err("failed to allocate latency histograms\n");
+		return;
+	}
+	for_each_possible_cpu(cpu) {
+		struct binder_latency_cpu *lc = per_cpu_ptr(binder_latency_cpu,
+							    cpu);
+
+		lc->gen = atomic_read(&binder_latency_gen);
+		lc->slot[BINDER_LATENCY_SLOTS].pid = -1;
+	}
+
+	if (root)
+		debugfs_create_file("latency", S_IRUGO | S_IWUSR, root, NULL,
+				    &binder_latency_fops);
+}
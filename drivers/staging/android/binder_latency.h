@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_BINDER_LATENCY_H
+#define _LINUX_BINDER_LATENCY_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+struct dentry;
+
+/*
+ * Layout of the debugfs "latency" file, native endian:
+ *
+ *   struct binder_latency_header
+ *   nr_records x struct binder_latency_record
+ *
+ * Bucket 0 counts samples below 1us, bucket i (i > 0) samples in
+ * [2^(i-1), 2^i) us, the last bucket everything above. Records are summed
+ * over all CPUs at read time. The record with pid -1 collects the samples
+ * that found no free slot, nr_dropped counts them. Writing anything to the
+ * file clears the histograms.
+ */
+#define BINDER_LATENCY_MAGIC	0x4c424e42	/* "BNBL" */
+#define BINDER_LATENCY_VERSION	2
+#define BINDER_LATENCY_BUCKETS	20
+
+enum {
+	BINDER_LATENCY_QUEUE,	/* queued until a thread was woken or picked it */
+	BINDER_LATENCY_WAKEUP,	/* thread woken until it picked the work */
+	BINDER_LATENCY_REPLY,	/* picked until the reply was queued */
+	BINDER_LATENCY_KINDS,
+};
+
+struct binder_latency_header {
+	__u32 magic;
+	__u16 version;
+	__u16 header_size;
+	__u32 nr_buckets;
+	__u32 nr_kinds;
+	__u32 record_size;
+	__u32 nr_records;
+	__u32 nr_dropped;	/* samples without a record of their own */
+	__u32 alloc[BINDER_LATENCY_BUCKETS];	/* binder_alloc_new_buf() */
+};
+
+struct binder_latency_record {
+	__s32 pid;		/* target process */
+	__u32 code;		/* transaction code */
+	__u32 hist[BINDER_LATENCY_KINDS][BINDER_LATENCY_BUCKETS];
+};
+
+#ifdef CONFIG_ANDROID_BINDER_LATENCY_STATS
+
+/* per-transaction stamps, protected by the target proc->inner_lock */
+struct binder_txn_stamp {
+	u64 queued;
+	u64 picked;
+};
+
+/* per-thread stamp, protected by proc->inner_lock */
+struct binder_thread_stamp {
+	u64 woken;
+};
+
+void binder_latency_picked(struct binder_txn_stamp *ts,
+			   struct binder_thread_stamp *ws,
+			   int pid, u32 code);
+void binder_latency_replied(struct binder_txn_stamp *ts, int pid, u32 code);
+void binder_latency_alloc(u64 start);
+void binder_latency_init(struct dentry *root);
+
+static inline u64 binder_latency_now(void)
+{
+	return ktime_get_ns();
+}
+
+static inline void binder_latency_queued(struct binder_txn_stamp *ts)
+{
+	ts->queued = ktime_get_ns();
+	ts->picked = 0;
+}
+
+static inline void binder_latency_woken(struct binder_thread_stamp *ws)
+{
+	ws->woken = ktime_get_ns();
+}
+
+static inline void binder_latency_sleep(struct binder_thread_stamp *ws)
+{
+	ws->woken = 0;
+}
+
+#else
+
+struct binder_txn_stamp { };
+struct binder_thread_stamp { };
+
+static inline void binder_latency_picked(struct binder_txn_stamp *ts,
+					 struct binder_thread_stamp *ws,
+					 int pid, u32 code) { }
+static inline void binder_latency_replied(struct binder_txn_stamp *ts,
+					  int pid, u32 code) { }
+static inline void binder_latency_alloc(u64 start) { }
+static inline void binder_latency_init(struct dentry *root) { }
+static inline u64 binder_latency_now(void) { return 0; }
+static inline void binder_latency_queued(struct binder_txn_stamp *ts) { }
+static inline void binder_latency_woken(struct binder_thread_stamp *ws) { }
+static inline void binder_latency_sleep(struct binder_thread_stamp *ws) { }
+
+#endif /* CONFIG_ANDROID_BINDER_LATENCY_STATS */
+
+#endif /* _LINUX_BINDER_LATENCY_H */
@@ -291,6 +291,30 @@ TRACE_EVENT(binder_update_page_range,
 		  __entry->offset, __entry->size)
 );
 
+TRACE_EVENT(binder_latency,
+	TP_PROTO(int proc, unsigned int code, int kind, u64 delta),
+	TP_ARGS(proc, code, kind, delta),
+	TP_STRUCT__entry(
+		__field(int, proc)
+		__field(unsigned int, code)
+		__field(int, kind)
+		__field(u64, delta)
+	),
+	TP_fast_assign(
+		__entry->proc = proc;
+		__entry->code = code;
+		__entry->kind = kind;
+		__entry->delta = delta;
+	),
+	TP_printk("proc=%d code=%u %s=%llu ns",
+		  __entry->proc, __entry->code,
+		  __print_symbolic(__entry->kind,
+				   { 0, "queue" },
+				   { 1, "wakeup" },
+				   { 2, "reply" }),
+		  __entry->delta)
+);
+
 TRACE_EVENT(binder_command,
 	TP_PROTO(uint32_t cmd),
 	TP_ARGS(cmd),
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2017 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Dynamic bitmap for handle allocation. A set bit is a handle in use, so
+ * the lowest free handle is one find_next_zero_bit() away instead of a
+ * walk over all the refs. The bitmap doubles when it is full and halves
+ * when the upper three quarters are unused.
+ *
+ * The caller serializes all calls. Memory is allocated by the caller
+ * without its lock held and handed in, and every call that swaps the map
+ * first checks that it is still needed since the lock was dropped. If an
+ * allocation fails while growing, the bitmap is disabled for good and
+ * the caller falls back to its slow path.
+ */
+
+#ifndef _LINUX_DBITMAP_H
+#define _LINUX_DBITMAP_H
+
+#include <linux/bitmap.h>
+#include <linux/slab.h>
+
+#define NBITS_MIN BITS_PER_LONG
+
+struct dbitmap {
+	unsigned int nbits;
+	unsigned long *map;
+};
+
+static inline unsigned long *dbitmap_alloc(unsigned int nbits)
+{
+	return kcalloc(BITS_TO_LONGS(nbits), sizeof(unsigned long),
+		       GFP_KERNEL);
+}
+
+static inline int dbitmap_enabled(struct dbitmap *dmap)
+{
+	return !!dmap->nbits;
+}
+
+static inline void dbitmap_free(struct dbitmap *dmap)
+{
+	dmap->nbits = 0;
+	kfree(dmap->map);
+	dmap->map = NULL;
+}
+
+/* Returns the nbits the bitmap should shrink to, 0 if it should not */
+static inline unsigned int dbitmap_shrink_nbits(struct dbitmap *dmap)
+{
+	unsigned int bit;
+
+	if (dmap->nbits <= NBITS_MIN)
+		return 0;
+
+	bit = find_last_bit(dmap->map, dmap->nbits);
+	if (bit == dmap->nbits)
+		return NBITS_MIN;
+
+	if (unlikely(bit <= (dmap->nbits >> 2)))
+		return dmap->nbits >> 1;
+
+	return 0;
+}
+
+static inline void
+dbitmap_replace(struct dbitmap *dmap, unsigned long *new, unsigned int nbits)
+{
+	bitmap_copy(new, dmap->map, min(dmap->nbits, nbits));
+	kfree(dmap->map);
+	dmap->map = new;
+	dmap->nbits = nbits;
+}
+
+static inline void
+dbitmap_shrink(struct dbitmap *dmap, unsigned long *new, unsigned int nbits)
+{
+	if (!new)
+		return;
+
+	/* the bitmap changed while the lock was dropped */
+	if (!dbitmap_enabled(dmap) || nbits != dbitmap_shrink_nbits(dmap)) {
+		kfree(new);
+		return;
+	}
+
+	dbitmap_replace(dmap, new, nbits);
+}
+
+static inline unsigned int dbitmap_grow_nbits(struct dbitmap *dmap)
+{
+	return dmap->nbits << 1;
+}
+
+static inline void
+dbitmap_grow(struct dbitmap *dmap, unsigned long *new, unsigned int nbits)
+{
+	/* somebody else grew or disabled the bitmap meanwhile */
+	if (!dbitmap_enabled(dmap) || nbits <= dmap->nbits) {
+		kfree(new);
+		return;
+	}
+
+	/* revert to the slow path if the allocation failed */
+	if (!new) {
+		dbitmap_free(dmap);
+		return;
+	}
+
+	dbitmap_replace(dmap, new, nbits);
+}
+
+/*
+ * Finds and sets the first zero bit at or after @offset. Returns -ENOSPC
+ * if the bitmap is full and needs to grow.
+ */
+static inline int
+dbitmap_acquire_next_zero_bit(struct dbitmap *dmap, unsigned long offset,
+			      unsigned long *bit)
+{
+	unsigned long n;
+
+	n = find_next_zero_bit(dmap->map, dmap->nbits, offset);
+	if (n == dmap->nbits)
+		return -ENOSPC;
+
+	*bit = n;
+	set_bit(n, dmap->map);
+
+	return 0;
+}
+
+static inline void
+dbitmap_clear_bit(struct dbitmap *dmap, unsigned long bit)
+{
+	/* a disabled bitmap has nothing to clear */
+	if (bit < dmap->nbits)
+		clear_bit(bit, dmap->map);
+}
+
+static inline int dbitmap_init(struct dbitmap *dmap)
+{
+	dmap->map = dbitmap_alloc(NBITS_MIN);
+	if (!dmap->map) {
+		dmap->nbits = 0;
+		return -ENOMEM;
+	}
+
+	dmap->nbits = NBITS_MIN;
+
+	return 0;
+}
+
+#endif /* _LINUX_DBITMAP_H */
@@ -58,9 +58,27 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
+static const unsigned long ion_page_pool_age_limits[ION_POOL_AGE_BUCKETS - 1] = {
+	HZ / 10, HZ, 10 * HZ, 60 * HZ, 600 * HZ
+};
+
+/* page->private holds the jiffies the page entered the pool at */
+static void ion_page_pool_age(struct page *page, unsigned long *hist)
+{
+	unsigned long age = jiffies - page_private(page);
+	int i;
+
+	for (i = 0; i < ION_POOL_AGE_BUCKETS - 1; i++)
+		if (age < ion_page_pool_age_limits[i])
+			break;
+	hist[i]++;
+	set_page_private(page, 0);
+}
+
 static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
 	mutex_lock(&pool->mutex);
+	set_page_private(page, jiffies);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -101,6 +119,8 @@ struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
 		page = ion_page_pool_remove(pool, true);
 	else if (pool->low_count)
 		page = ion_page_pool_remove(pool, false);
+	if (page)
+		ion_page_pool_age(page, pool->reused);
 	mutex_unlock(&pool->mutex);
 
 	if (!page)
@@ -166,6 +186,7 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 			mutex_unlock(&pool->mutex);
 			break;
 		}
+		ion_page_pool_age(page, pool->freed);
 		mutex_unlock(&pool->mutex);
 		ion_page_pool_free_pages(pool, page);
 	}
@@ -187,6 +208,8 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 	INIT_LIST_HEAD(&pool->high_items);
 	pool->gfp_mask = gfp_mask | __GFP_COMP;
 	pool->order = order;
+	memset(pool->reused, 0, sizeof(pool->reused));
+	memset(pool->freed, 0, sizeof(pool->freed));
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
 
@@ -441,6 +441,9 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * invalidated from the cache, provides a significant performance benefit on
  * many systems */
 
+/* pool residency buckets: <100ms, <1s, <10s, <1min, <10min and older */
+#define ION_POOL_AGE_BUCKETS	6
+
 /**
  * struct ion_page_pool - pagepool struct
  * @high_count:		number of highmem items in the pool
@@ -452,6 +455,8 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
+ * @reused:		pages taken by an allocation, by time spent in the pool
+ * @freed:		pages given back to the system, by time spent in the pool
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -467,6 +472,8 @@ struct ion_page_pool {
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	unsigned long reused[ION_POOL_AGE_BUCKETS];
+	unsigned long freed[ION_POOL_AGE_BUCKETS];
 };
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
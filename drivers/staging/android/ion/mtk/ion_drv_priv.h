@@ -52,6 +52,7 @@ struct ion_buffer *ion_drv_file_to_buffer(struct file *file);
 
 #ifdef CONFIG_PM
 extern void shrink_ion_by_scenario(int need_lock);
+extern void shrink_ion_by_scenario_sync(int need_lock);
 #endif
 
 #endif
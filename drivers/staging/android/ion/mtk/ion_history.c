@@ -32,173 +32,165 @@
 
 #include <linux/delay.h>
 #include <linux/time.h>
+#include <linux/dcache.h>
+#include <linux/hash.h>
+#include <linux/atomic.h>
+#include <linux/rculist.h>
+#include <linux/sort.h>
 /* ============================================== */
 /* history record */
 /* ============================================== */
 
+/*
+ * The records live in one ring. A writer claims the slot at the head with
+ * an atomic increment and owns it, with preemption disabled, until it puts
+ * the record back, so recording takes no lock. The seq of a slot is odd
+ * while it is written and even once it is complete. Readers copy the slots
+ * and keep those whose seq stayed the same, after taking the references
+ * the record holds with get_record(). Two writers only meet on a slot if
+ * the whole ring is claimed while one of them still holds its slot.
+ */
+struct history_slot {
+	unsigned long seq;
+	u64 stamp;
+	unsigned long long record[0];
+};
+
 struct history_record {
-	void *record;
-	unsigned int record_num;
+	void *record;		/* ring_size slots */
+	atomic_long_t head;	/* slots taken so far */
+	unsigned int ring_size;
+	unsigned int slot_size;
 	unsigned int record_size;
-	unsigned int top;
-	unsigned int wrapped;
-	spinlock_t lock;
 	const char *name;
 	struct dentry *debug_file;
 	int (*show)(struct seq_file *seq, void *record, void *priv);
+	int (*get_record)(void *record, void *priv);
 	int (*destroy_record)(void *record, void *priv);
 	void *private;
-	unsigned long bitmap_busy[0];
 };
 
-static inline unsigned long history_record_test_busy(
-		struct history_record *history_record, unsigned int index) {
-	unsigned long *p = history_record->bitmap_busy + index / BITS_PER_LONG;
-	int bit_mask = 1UL << (index % BITS_PER_LONG);
-
-	return *p & bit_mask;
-}
-
-static inline void history_record_set_busy(
-		struct history_record *history_record, unsigned int index) {
-	unsigned long *p = history_record->bitmap_busy + index / BITS_PER_LONG;
-	int bit_mask = 1UL << (index % BITS_PER_LONG);
-	*p |= bit_mask;
-}
-
-static inline void history_record_clear_busy(
-		struct history_record *history_record, unsigned int index) {
-	unsigned long *p = history_record->bitmap_busy + index / BITS_PER_LONG;
-	int bit_mask = 1UL << (index % BITS_PER_LONG);
-	*p &= ~bit_mask;
-}
-
-static inline void history_record_dump_busy(struct seq_file *seq,
-		struct history_record *history_record) {
-	unsigned long longs = BITS_TO_LONGS(history_record->record_num);
-	unsigned long i;
-
-	for (i = 0; i < longs; i++) {
-		if (seq)
-			seq_printf(seq, "0x%lx, ", history_record->bitmap_busy[i]);
-		else
-			IONMSG("0x%lx, ", history_record->bitmap_busy[i]);
-	}
-	if (seq)
-		seq_puts(seq, "\n");
-	else
-		IONMSG("\n");
+static inline struct history_slot *history_slot(
+		struct history_record *history_record, unsigned long index) {
+	index &= history_record->ring_size - 1;
+	return history_record->record + history_record->slot_size * index;
 }
 
 void *history_record_get_record(struct history_record *history_record)
 {
-	unsigned int index;
-	void *record;
-
-	spin_lock(&history_record->lock);
-
-	index = history_record->top;
-	history_record->top++;
-	if (history_record->top >= history_record->record_num) {
-		history_record->top = 0;
-		history_record->wrapped = 1;
-	}
-
-	if (history_record_test_busy(history_record, index)) {
-		IONMSG("%s: error to get record %d, bitmap is:\n", __func__, index);
-		history_record_dump_busy(NULL, history_record);
-		spin_unlock(&history_record->lock);
-		return NULL;
-	}
+	struct history_slot *slot;
+	unsigned long index, old_seq;
 
-	record = history_record->record + history_record->record_size * index;
+	preempt_disable();
+	index = atomic_long_inc_return(&history_record->head) - 1;
+	slot = history_slot(history_record, index);
 
-	if (history_record->wrapped && history_record->destroy_record)
-		history_record->destroy_record(record, history_record->private);
+	old_seq = slot->seq;
+	WRITE_ONCE(slot->seq, 2 * index + 1);
+	smp_wmb();
 
-	history_record_set_busy(history_record, index);
+	/* the record being overwritten drops what it held */
+	if (old_seq && history_record->destroy_record)
+		history_record->destroy_record(slot->record,
+				history_record->private);
 
-	spin_unlock(&history_record->lock);
+	slot->stamp = local_clock();
+	memset(slot->record, 0, history_record->record_size);
 
-	return record;
+	return slot->record;
 }
+
 void history_record_put_record(struct history_record *history_record,
 		void *record) {
-	unsigned int index = (record - history_record->record)
-			/ history_record->record_size;
-	spin_lock(&history_record->lock);
-	history_record_clear_busy(history_record, index);
-	spin_unlock(&history_record->lock);
+	struct history_slot *slot = container_of(record, struct history_slot,
+			record);
+
+	smp_wmb();
+	WRITE_ONCE(slot->seq, slot->seq + 1);
+	preempt_enable();
 }
 
 struct history_seq_priv {
 	struct history_record *history_record;
-	unsigned int start;
+	void *snap;		/* copied slots, oldest first */
 	unsigned int num;
 };
 
-int history_record_show(struct seq_file *seq, void *record)
+static int history_slot_cmp(const void *a, const void *b)
 {
-	struct history_seq_priv *seq_priv = seq->private;
-	struct history_record *history_record = seq_priv->history_record;
-	unsigned int index = (record - history_record->record)
-			/ history_record->record_size;
-	spin_lock(&history_record->lock);
+	const struct history_slot *sa = a, *sb = b;
 
-	if (history_record_test_busy(history_record, index)) {
-		spin_unlock(&history_record->lock);
+	if (sa->stamp == sb->stamp)
 		return 0;
-	}
-
-	history_record->show(seq, record, history_record->private);
-
-	spin_unlock(&history_record->lock);
-	return 0;
+	return sa->stamp < sb->stamp ? -1 : 1;
 }
 
-static void *history_seq_start(struct seq_file *p, loff_t *pos)
+static int history_record_snapshot(struct history_seq_priv *seq_priv)
 {
-	struct history_seq_priv *seq_priv = p->private;
 	struct history_record *history_record = seq_priv->history_record;
-	unsigned int index;
-
-	if (*pos == 0) {
-		spin_lock(&history_record->lock);
-		if (!history_record->wrapped) {
-			seq_priv->start = 0;
-			seq_priv->num = history_record->top;
-		} else {
-			seq_priv->start = history_record->top;
-			seq_priv->num = history_record->record_num;
+	unsigned int total = history_record->ring_size;
+	unsigned int size = history_record->slot_size;
+	struct history_slot *slot, *copy;
+	unsigned long seq;
+	unsigned int i;
+
+	seq_priv->snap = vmalloc(total * size);
+	if (!seq_priv->snap)
+		return -ENOMEM;
+
+	rcu_read_lock();
+	for (i = 0; i < total; i++) {
+		slot = history_record->record + size * i;
+		copy = seq_priv->snap + size * seq_priv->num;
+
+		seq = READ_ONCE(slot->seq);
+		if (!seq || (seq & 1))
+			continue;
+		smp_rmb();
+		memcpy(copy, slot, size);
+		if (history_record->get_record &&
+		    history_record->get_record(copy->record,
+				history_record->private))
+			continue;
+		smp_rmb();
+		if (READ_ONCE(slot->seq) != seq) {
+			if (history_record->get_record)
+				history_record->destroy_record(copy->record,
+						history_record->private);
+			continue;
 		}
-		spin_unlock(&history_record->lock);
+		seq_priv->num++;
 	}
+	rcu_read_unlock();
 
-	if (*pos >= seq_priv->num)
-		return NULL;
+	sort(seq_priv->snap, seq_priv->num, size, history_slot_cmp, NULL);
+	return 0;
+}
 
-	index = seq_priv->start + *pos;
-	if (index >= history_record->record_num)
-		index -= history_record->record_num;
+int history_record_show(struct seq_file *seq, void *v)
+{
+	struct history_seq_priv *seq_priv = seq->private;
+	struct history_record *history_record = seq_priv->history_record;
+	struct history_slot *slot = v;
 
-	return history_record->record + history_record->record_size * index;
+	return history_record->show(seq, slot->record,
+			history_record->private);
 }
 
-static void *history_seq_next(struct seq_file *p, void *v, loff_t *pos)
+static void *history_seq_start(struct seq_file *p, loff_t *pos)
 {
 	struct history_seq_priv *seq_priv = p->private;
-	struct history_record *history_record = seq_priv->history_record;
-	unsigned int index;
 
-	++*pos;
 	if (*pos >= seq_priv->num)
 		return NULL;
 
-	index = seq_priv->start + *pos;
-	if (index >= history_record->record_num)
-		index -= history_record->record_num;
+	return seq_priv->snap + seq_priv->history_record->slot_size * *pos;
+}
 
-	return history_record->record + history_record->record_size * index;
+static void *history_seq_next(struct seq_file *p, void *v, loff_t *pos)
+{
+	++*pos;
+	return history_seq_start(p, pos);
 }
 
 static void history_seq_stop(struct seq_file *p, void *v)
@@ -216,17 +208,20 @@ static int history_record_open(struct inode *inode, struct file *file)
 {
 	struct history_record *history_record = inode->i_private;
 	struct history_seq_priv *seq_priv;
-	int res = -ENOMEM;
+	int res;
 
-	res = seq_open(file, &seq_op);
-	if (res) {
+	seq_priv = __seq_open_private(file, &seq_op, sizeof(*seq_priv));
+	if (!seq_priv) {
 		IONMSG("%s fail\n", __func__);
-		return res;
+		return -ENOMEM;
 	}
 
-	seq_priv = kzalloc(sizeof(*seq_priv), GFP_KERNEL);
 	seq_priv->history_record = history_record;
-	((struct seq_file *) file->private_data)->private = seq_priv;
+	res = history_record_snapshot(seq_priv);
+	if (res) {
+		seq_release_private(inode, file);
+		return res;
+	}
 
 	return 0;
 }
@@ -235,10 +230,19 @@ static int history_record_release(struct inode *inode, struct file *file)
 {
 	struct history_seq_priv *seq_priv =
 			((struct seq_file *) file->private_data)->private;
+	struct history_record *history_record = seq_priv->history_record;
+	struct history_slot *slot;
+	unsigned int i;
 
-	kfree(seq_priv);
+	/* drop the references the snapshot took */
+	for (i = 0; history_record->get_record && i < seq_priv->num; i++) {
+		slot = seq_priv->snap + history_record->slot_size * i;
+		history_record->destroy_record(slot->record,
+				history_record->private);
+	}
+	vfree(seq_priv->snap);
 
-	return seq_release(inode, file);
+	return seq_release_private(inode, file);
 }
 
 static const struct file_operations history_record_fops = {
@@ -248,47 +252,45 @@ static const struct file_operations history_record_fops = {
 		.release = history_record_release,
 };
 
+/*
+ * @get_record takes the references a record holds for a reader, under
+ * rcu_read_lock(), and fails if they are already going away.
+ * @destroy_record drops them again.
+ */
 struct history_record *history_record_create(unsigned int record_num,
 		unsigned int record_size,
 		int (*show)(struct seq_file *seq, void *record, void *priv),
+		int (*get_record)(void *record, void *priv),
 		int (*destroy_record)(void *record, void *priv), void *priv,
 		const char *name, struct dentry *debugfs_parent) {
 	struct history_record *history_record;
-	int num_align;
-	size_t size_align;
-	int bitmap_bytes;
-
-	/*	as vmalloc is page align.
-	 we will enlarge record_num to num_align
-	 to get the utmost of memory allocated
-	 */
-	size_align = record_num * record_size;
-	size_align = ALIGN(size_align, PAGE_SIZE);
-	num_align = size_align / record_size;
-
-	bitmap_bytes = BITS_TO_LONGS(num_align) * sizeof(unsigned long);
-
-	history_record = kzalloc(sizeof(struct history_record) + bitmap_bytes,
-			GFP_KERNEL);
+	size_t size;
+
+	history_record = kzalloc(sizeof(struct history_record), GFP_KERNEL);
 	if (!history_record) {
 		IONMSG("%s error to kzalloc %zd.\n", __func__,
 				sizeof(struct history_record));
 		return ERR_PTR(-ENOMEM);
 	}
 
-	history_record->record = vzalloc(size_align);
+	history_record->ring_size = roundup_pow_of_two(record_num);
+	history_record->slot_size = ALIGN(sizeof(struct history_slot) +
+			record_size, sizeof(unsigned long long));
+	size = (size_t)history_record->slot_size * history_record->ring_size;
+
+	history_record->record = vzalloc(size);
 	if (!history_record->record) {
-		IONMSG("%s error to valloc %zu.\n", __func__, size_align);
+		IONMSG("%s error to valloc %zu.\n", __func__, size);
 		kfree(history_record);
 		return ERR_PTR(-ENOMEM);
 	}
 
-	history_record->record_num = num_align;
 	history_record->record_size = record_size;
 	history_record->show = show;
+	history_record->get_record = get_record;
 	history_record->destroy_record = destroy_record;
+	history_record->private = priv;
 	history_record->name = name;
-	spin_lock_init(&history_record->lock);
 
 	history_record->debug_file = debugfs_create_file(name, 0644, debugfs_parent,
 			history_record, &history_record_fops);
@@ -296,123 +298,117 @@ struct history_record *history_record_create(unsigned int record_num,
 	return history_record;
 }
 
+/* no writer may be left */
 void history_record_destroy(struct history_record *history_record)
 {
-	int busy;
-	unsigned int i, bitmap_longs = BITS_TO_LONGS(history_record->record_num);
-	unsigned int end;
+	unsigned int i, total = history_record->ring_size;
+	struct history_slot *slot;
 
 	debugfs_remove(history_record->debug_file);
 
-	/* wait until no busy */
-	do {
-		busy = 0;
-		spin_lock(&history_record->lock);
-		for (i = 0; i < bitmap_longs; i++) {
-			if (history_record->bitmap_busy[i]) {
-				/* busy ! */
-				IONMSG("warning: %s when busy %d\n", __func__, i);
-				busy = 1;
-				cond_resched();
-				break;
-			}
-		}
-		spin_unlock(&history_record->lock);
-	} while (busy);
-	/* we have history_record->lock locked here */
-
-	if (!history_record->wrapped)
-		end = history_record->top;
-	else
-		end = history_record->record_num;
-
-	for (i = 0; i < end; i++)
-		history_record->destroy_record(
-				history_record->record + i * history_record->record_num,
-				history_record->private);
+	for (i = 0; history_record->destroy_record && i < total; i++) {
+		slot = history_record->record + history_record->slot_size * i;
+		if (slot->seq)
+			history_record->destroy_record(slot->record,
+					history_record->private);
+	}
 
 	vfree(history_record->record);
-	history_record->record = NULL;
 	kfree(history_record);
 }
 
 /* ====== string hash ============== */
+
+/*
+ * Interned names. Lookups run under rcu_read_lock(), and only adding a
+ * name that is not there yet and dropping the last reference take
+ * ion_str_hash_lock. A string is freed after a grace period so that
+ * readers of the history can still take a reference to it.
+ */
 struct string_struct {
-	unsigned int ref;
+	atomic_t ref;
 	struct hlist_node list;
+	struct rcu_head rcu;
 	char str[0];
 };
 
-#define STR_HASH_BUCKET_NUM 32
-static struct hlist_head ion_str_hash[STR_HASH_BUCKET_NUM];
-DEFINE_SPINLOCK(ion_str_hash_lock);
+#define STR_HASH_BITS 8
+static struct hlist_head ion_str_hash[1 << STR_HASH_BITS];
+static DEFINE_SPINLOCK(ion_str_hash_lock);
 
-/* as tested, simple add hash is better than RS_hash & BKDR_hash ! */
-static unsigned int ADDHash(char *str, unsigned int len)
+static struct hlist_head *string_hash_head(const char *str, unsigned int len)
 {
-	unsigned int hash = 0, i;
+	return &ion_str_hash[hash_32(full_name_hash((const unsigned char *)str, len),
+			STR_HASH_BITS)];
+}
 
-	for (i = 0; i < len; i++)
-		hash += str[i];
+static struct string_struct *string_hash_find(struct hlist_head *head,
+		const char *str)
+{
+	struct string_struct *string;
 
-	return hash % STR_HASH_BUCKET_NUM;
+	hlist_for_each_entry_rcu(string, head, list) {
+		if (!strcmp(str, string->str) && atomic_inc_not_zero(&string->ref))
+			return string;
+	}
+	return NULL;
 }
 
 static struct string_struct *string_hash_get(const char *str)
 {
 	struct hlist_head *head;
-	struct string_struct *string;
-	unsigned int len = strlen(str);
-	unsigned int hash;
-
-	hash = ADDHash((char *) str, len);
-	head = &ion_str_hash[hash];
+	struct string_struct *string, *new;
+	unsigned int len;
 
-	spin_lock(&ion_str_hash_lock);
-	hlist_for_each_entry(string, head, list) {
-		if (!strcmp(str, string->str))
-			break;
-	}
+	if (!str)
+		return NULL;
+	len = strlen(str);
+	head = string_hash_head(str, len);
 
+	rcu_read_lock();
+	string = string_hash_find(head, str);
+	rcu_read_unlock();
 	if (string)
-		string->ref++;
-	else {
-		/* add string */
-		string = kzalloc(sizeof(*string) + len + 1, GFP_ATOMIC);
-		if (!string) {
-			IONMSG("%s: kzalloc fail size=%zd.\n", __func__,
-					sizeof(*string) + len + 1);
-			goto out;
-		}
-		string->ref = 1;
-		INIT_HLIST_NODE(&string->list);
-		memcpy(string->str, str, len);
-		string->str[len] = '\0';
-		hlist_add_head(&string->list, head);
+		return string;
+
+	/* add string */
+	new = kzalloc(sizeof(*new) + len + 1, GFP_ATOMIC);
+	if (!new) {
+		IONMSG("%s: kzalloc fail size=%zd.\n", __func__,
+				sizeof(*new) + len + 1);
+		return NULL;
 	}
-out:
-	spin_unlock(&ion_str_hash_lock);
-	return string;
-}
+	atomic_set(&new->ref, 1);
+	memcpy(new->str, str, len);
 
-static int string_hash_put(struct string_struct *string)
-{
 	spin_lock(&ion_str_hash_lock);
+	/* somebody may have added it meanwhile */
+	string = string_hash_find(head, str);
+	if (!string)
+		hlist_add_head_rcu(&new->list, head);
+	spin_unlock(&ion_str_hash_lock);
 
-	if (!string->ref) {
-		IONMSG("error %s string_ref is 0!!!\n", __func__);
-		spin_unlock(&ion_str_hash_lock);
-		return -EINVAL;
+	if (string) {
+		kfree(new);
+		return string;
 	}
-	string->ref--;
+	return new;
+}
 
-	if (!string->ref) {
-		hlist_del(&string->list);
-		kfree(string);
-	}
+/* for readers under rcu_read_lock(), fails once the string is going away */
+static bool string_hash_tryget(struct string_struct *string)
+{
+	return atomic_inc_not_zero(&string->ref);
+}
+
+static void string_hash_put(struct string_struct *string)
+{
+	if (!atomic_dec_and_lock(&string->ref, &ion_str_hash_lock))
+		return;
 
+	hlist_del_rcu(&string->list);
 	spin_unlock(&ion_str_hash_lock);
-	return 0;
+	kfree_rcu(string, rcu);
 }
 
 int string_hash_debug_show(struct seq_file *seq, void *unused)
@@ -421,19 +417,21 @@ int string_hash_debug_show(struct seq_file *seq, void *unused)
 	struct string_struct *string;
 	unsigned int hash, num;
 
-	spin_lock(&ion_str_hash_lock);
+	rcu_read_lock();
 
-	for (hash = 0; hash < STR_HASH_BUCKET_NUM; hash++) {
+	for (hash = 0; hash < ARRAY_SIZE(ion_str_hash); hash++) {
 		head = &ion_str_hash[hash];
 		num = 0;
-		hlist_for_each_entry(string, head, list) {
-			seq_printf(seq, "\t%s : %d\n", string->str, string->ref);
+		hlist_for_each_entry_rcu(string, head, list) {
+			seq_printf(seq, "\t%s : %d\n", string->str,
+					atomic_read(&string->ref));
 			num++;
 		}
-		seq_printf(seq, "hash %d : %d strings\n", hash, num);
+		if (num)
+			seq_printf(seq, "hash %d : %d strings\n", hash, num);
 	}
 
-	spin_unlock(&ion_str_hash_lock);
+	rcu_read_unlock();
 	return 0;
 
 }
@@ -500,6 +498,26 @@ static int ion_client_record_show(struct seq_file *seq, void *record,
 	return 0;
 }
 
+static int ion_client_get_record(void *record, void *priv)
+{
+	struct ion_client_record *client_record = record;
+
+	if (client_record->address <= CLIENT_ADDRESS_FLAG_MAX)
+		return 0;
+
+	if (client_record->client_name &&
+	    !string_hash_tryget(client_record->client_name))
+		return -EAGAIN;
+	if (client_record->dbg_name &&
+	    !string_hash_tryget(client_record->dbg_name)) {
+		if (client_record->client_name)
+			string_hash_put(client_record->client_name);
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
 static int ion_client_destroy_record(void *record, void *priv)
 {
 	struct ion_client_record *client_record = record;
@@ -654,7 +672,8 @@ int ion_history_init(void)
 
 	g_client_history = history_record_create(3072,
 			sizeof(struct ion_client_record), ion_client_record_show,
-			ion_client_destroy_record, NULL, "client_history",
+			ion_client_get_record, ion_client_destroy_record, NULL,
+			"client_history",
 			g_ion_device->debug_root);
 
 	if (IS_ERR_OR_NULL(g_client_history)) {
@@ -26,6 +26,7 @@
 #include <linux/debugfs.h>
 #include <linux/kthread.h>
 #include <linux/fdtable.h>
+#include <linux/workqueue.h>
 #include "mtk/mtk_ion.h"
 #include "ion_profile.h"
 #include "ion_drv_priv.h"
@@ -83,10 +84,52 @@ static unsigned int order_to_size(int order)
 	return PAGE_SIZE << order;
 }
 
+/*
+ * Freeing all of a camera's pool pages at once stalls whoever asked for
+ * it, so shrink_ion_by_scenario() only sets a target and the drain work
+ * returns the pages to the buddy allocator in batches: the deferred free
+ * list first, then the pools highest order first so that 64K blocks go
+ * back whole. The batch size and the pause between batches follow how
+ * short memory is.
+ */
+enum ion_drain_level {
+	ION_DRAIN_LOW,
+	ION_DRAIN_MEDIUM,
+	ION_DRAIN_CRITICAL,
+	ION_DRAIN_LEVELS,
+};
+
+static const struct {
+	int batch;		/* pages */
+	unsigned int pause;	/* ms */
+} ion_drain_rate[ION_DRAIN_LEVELS] = {
+	[ION_DRAIN_LOW]		= { 256, 20 },
+	[ION_DRAIN_MEDIUM]	= { 1024, 5 },
+	[ION_DRAIN_CRITICAL]	= { 4096, 0 },
+};
+
+enum ion_drain_source {
+	ION_DRAIN_ASYNC,
+	ION_DRAIN_INLINE,
+	ION_DRAIN_SYNC,
+	ION_DRAIN_SOURCES,
+};
+
+struct ion_mm_drain {
+	struct delayed_work work;
+	atomic_t target;		/* pages left to free */
+	unsigned long kicked;		/* jiffies */
+	unsigned int last_ms;		/* kick to target reached */
+	unsigned long kicks;
+	atomic_long_t freed[ION_DRAIN_SOURCES];
+	atomic_long_t batches[ION_DRAIN_LEVELS];
+};
+
 struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool **pools;
 	struct ion_page_pool **cached_pools;
+	struct ion_mm_drain drain;
 };
 
 struct page_info {
@@ -100,6 +143,137 @@ unsigned int caller_pid;
 unsigned int caller_tid;
 unsigned long long alloc_large_fail_ts;
 
+/*
+ * vmpressure only reports to memcg eventfds, so estimate its level from
+ * the free pages against the zone watermarks: below low kswapd is
+ * already reclaiming, below twice high it is about to be woken.
+ */
+static enum ion_drain_level ion_drain_level(void)
+{
+	unsigned long free = global_page_state(NR_FREE_PAGES);
+	unsigned long low = 0, high = 0;
+	struct zone *zone;
+
+	for_each_populated_zone(zone) {
+		low += low_wmark_pages(zone);
+		high += high_wmark_pages(zone);
+	}
+
+	if (free < low)
+		return ION_DRAIN_CRITICAL;
+	if (free < 2 * high)
+		return ION_DRAIN_MEDIUM;
+	return ION_DRAIN_LOW;
+}
+
+static int ion_mm_drain_pages(struct ion_system_heap *heap)
+{
+	int i, total = 0;
+
+	for (i = 0; i < num_orders; i++) {
+		total += ion_page_pool_shrink(heap->pools[i], __GFP_HIGHMEM, 0);
+		total += ion_page_pool_shrink(heap->cached_pools[i], __GFP_HIGHMEM, 0);
+	}
+	if (heap->heap.flags & ION_HEAP_FLAG_DEFER_FREE)
+		total += ion_heap_freelist_size(&heap->heap) >> PAGE_SHIFT;
+
+	return total;
+}
+
+static int ion_mm_drain_pool(struct ion_page_pool *pool, int budget)
+{
+	int nr = DIV_ROUND_UP(budget, 1 << pool->order);
+
+	return ion_page_pool_shrink(pool, __GFP_HIGHMEM, nr) << pool->order;
+}
+
+/* free up to about @budget pages, returns how many were freed */
+static int ion_mm_drain_batch(struct ion_system_heap *heap, int budget,
+			      bool freelist)
+{
+	int i, freed = 0;
+
+	if (freelist && (heap->heap.flags & ION_HEAP_FLAG_DEFER_FREE))
+		freed = ion_heap_freelist_shrink(&heap->heap,
+						 (size_t)budget << PAGE_SHIFT) >> PAGE_SHIFT;
+
+	for (i = 0; i < num_orders && freed < budget; i++) {
+		freed += ion_mm_drain_pool(heap->pools[i], budget - freed);
+		if (freed < budget)
+			freed += ion_mm_drain_pool(heap->cached_pools[i],
+						   budget - freed);
+	}
+
+	return freed;
+}
+
+static void ion_mm_drain_account(struct ion_mm_drain *drain, int freed,
+				 enum ion_drain_source source)
+{
+	atomic_long_add(freed, &drain->freed[source]);
+	if (atomic_read(&drain->target) > 0 &&
+	    atomic_sub_return(freed, &drain->target) <= 0) {
+		atomic_set(&drain->target, 0);
+		drain->last_ms = jiffies_to_msecs(jiffies - drain->kicked);
+	}
+}
+
+static void ion_mm_drain_work(struct work_struct *work)
+{
+	struct ion_mm_drain *drain = container_of(to_delayed_work(work),
+						  struct ion_mm_drain, work);
+	struct ion_system_heap *heap = container_of(drain,
+						    struct ion_system_heap, drain);
+	enum ion_drain_level level = ion_drain_level();
+	int freed;
+
+	if (atomic_read(&drain->target) <= 0)
+		return;
+
+	freed = ion_mm_drain_batch(heap, ion_drain_rate[level].batch, true);
+	atomic_long_inc(&drain->batches[level]);
+	if (!freed) {
+		/* allocations took what was left */
+		atomic_set(&drain->target, 0);
+		drain->last_ms = jiffies_to_msecs(jiffies - drain->kicked);
+		return;
+	}
+	ion_mm_drain_account(drain, freed, ION_DRAIN_ASYNC);
+
+	if (atomic_read(&drain->target) > 0)
+		queue_delayed_work(system_unbound_wq, &drain->work,
+				   msecs_to_jiffies(ion_drain_rate[level].pause));
+}
+
+static void ion_mm_drain_kick(struct ion_system_heap *heap)
+{
+	struct ion_mm_drain *drain = &heap->drain;
+
+	drain->kicked = jiffies;
+	drain->kicks++;
+	atomic_set(&drain->target, ion_mm_drain_pages(heap));
+	mod_delayed_work(system_unbound_wq, &drain->work, 0);
+}
+
+/*
+ * An allocation that could not get a page from its pool or the buddy
+ * allocator frees pool pages itself only while the drain still has
+ * pages to free, otherwise the shrinker is in charge of the pools.
+ */
+static int ion_mm_drain_inline(struct ion_system_heap *heap)
+{
+	struct ion_mm_drain *drain = &heap->drain;
+	int freed;
+
+	if (atomic_read(&drain->target) <= 0)
+		return 0;
+
+	freed = ion_mm_drain_batch(heap, ion_drain_rate[ion_drain_level()].batch,
+				   false);
+	ion_mm_drain_account(drain, freed, ION_DRAIN_INLINE);
+	return freed;
+}
+
 static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 		struct ion_buffer *buffer, unsigned long order) {
 	bool cached = ion_buffer_cached(buffer);
@@ -113,6 +287,8 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 		pool = heap->cached_pools[order_to_index(order)];
 
 	page = ion_page_pool_alloc(pool);
+	if (!page && ion_mm_drain_inline(heap))
+		page = ion_page_pool_alloc(pool);
 
 	if (!page) {
 		pr_err_ratelimited("[ion_dbg] alloc_pages order=%lu cache=%d\n", order, cached);
@@ -517,6 +693,37 @@ static int ion_dump_all_share_fds(struct seq_file *s)
 	return 0;
 }
 
+static void ion_mm_pool_age_show(struct seq_file *s, struct ion_page_pool *pool,
+				 const char *name)
+{
+	unsigned long *h;
+
+	h = pool->reused;
+	ION_PRINT_LOG_OR_SEQ(s, "%-11s order %u reused %7lu %7lu %7lu %7lu %7lu %7lu\n",
+			     name, pool->order, h[0], h[1], h[2], h[3], h[4], h[5]);
+	h = pool->freed;
+	ION_PRINT_LOG_OR_SEQ(s, "%-11s order %u freed  %7lu %7lu %7lu %7lu %7lu %7lu\n",
+			     name, pool->order, h[0], h[1], h[2], h[3], h[4], h[5]);
+}
+
+static void ion_mm_drain_show(struct seq_file *s, struct ion_mm_drain *drain)
+{
+	ION_PRINT_LOG_OR_SEQ(s,
+			     "drain: level %d, %d pages left, %lu kicks, last took %u ms\n",
+			     ion_drain_level(), atomic_read(&drain->target),
+			     drain->kicks, drain->last_ms);
+	ION_PRINT_LOG_OR_SEQ(s,
+			     "drain: freed %ld async, %ld inline, %ld sync pages\n",
+			     atomic_long_read(&drain->freed[ION_DRAIN_ASYNC]),
+			     atomic_long_read(&drain->freed[ION_DRAIN_INLINE]),
+			     atomic_long_read(&drain->freed[ION_DRAIN_SYNC]));
+	ION_PRINT_LOG_OR_SEQ(s,
+			     "drain: batches %ld low, %ld medium, %ld critical\n",
+			     atomic_long_read(&drain->batches[ION_DRAIN_LOW]),
+			     atomic_long_read(&drain->batches[ION_DRAIN_MEDIUM]),
+			     atomic_long_read(&drain->batches[ION_DRAIN_CRITICAL]));
+}
+
 static int ion_mm_heap_debug_show(struct ion_heap *heap, struct seq_file *s, void *unused)
 {
 	struct ion_system_heap
@@ -552,6 +759,14 @@ static int ion_mm_heap_debug_show(struct ion_heap *heap, struct seq_file *s, voi
 	else
 		ION_PRINT_LOG_OR_SEQ(s, "mm_heap defer free disabled\n");
 
+	ION_PRINT_LOG_OR_SEQ(s, "pool age %19s %7s %7s %7s %7s %7s\n",
+			     "<100ms", "<1s", "<10s", "<1min", "<10min", "older");
+	for (i = 0; i < num_orders; i++) {
+		ion_mm_pool_age_show(s, sys_heap->pools[i], "pool");
+		ion_mm_pool_age_show(s, sys_heap->cached_pools[i], "cached_pool");
+	}
+	ion_mm_drain_show(s, &sys_heap->drain);
+
 
 	ION_PRINT_LOG_OR_SEQ(s, "----------------------------------------------------\n");
 	ION_PRINT_LOG_OR_SEQ(s,
@@ -859,6 +1074,7 @@ struct ion_heap *ion_mm_heap_create(struct ion_platform_heap *unused)
 		heap->cached_pools[i] = pool;
 	}
 
+	INIT_DELAYED_WORK(&heap->drain.work, ion_mm_drain_work);
 	heap->heap.debug_show = ion_mm_heap_debug_show;
 	return &heap->heap;
 
@@ -885,6 +1101,7 @@ void ion_mm_heap_destroy(struct ion_heap *heap)
 	*sys_heap = container_of(heap, struct ion_system_heap, heap);
 	int i;
 
+	cancel_delayed_work_sync(&sys_heap->drain.work);
 	for (i = 0; i < num_orders; i++)
 		ion_page_pool_destroy(sys_heap->pools[i]);
 	kfree(sys_heap->pools);
@@ -1132,24 +1349,39 @@ long ion_mm_ioctl(struct ion_client *client, unsigned int cmd, unsigned long arg
 }
 
 #ifdef CONFIG_PM
+/* screen off or camera closed, hand the camera pools to the drain work */
 void shrink_ion_by_scenario(int need_lock)
 {
-	int nr_to_reclaim, nr_reclaimed;
-	int nr_to_try = 3;
+	struct ion_heap *movable_ion_heap = ion_drv_get_heap(g_ion_device, ION_HEAP_TYPE_MULTIMEDIA_FOR_CAMERA,
+							     need_lock);
 
+	if (!movable_ion_heap)
+		return;
+	ion_mm_drain_kick(container_of(movable_ion_heap, struct ion_system_heap, heap));
+}
+
+/*
+ * The secure heap is carved out of the memory the camera pools sit on,
+ * its allocation cannot wait for the drain work.
+ */
+void shrink_ion_by_scenario_sync(int need_lock)
+{
 	struct ion_heap *movable_ion_heap = ion_drv_get_heap(g_ion_device, ION_HEAP_TYPE_MULTIMEDIA_FOR_CAMERA,
 							     need_lock);
+	struct ion_system_heap *sys_heap;
+	int nr_freed, nr_left;
 
-	do {
-		nr_to_reclaim = ion_mm_heap_shrink(movable_ion_heap, __GFP_HIGHMEM | __GFP_CMA, 0);
-		nr_reclaimed = ion_mm_heap_shrink(movable_ion_heap,
-				 __GFP_HIGHMEM | __GFP_CMA, nr_to_reclaim);
+	if (!movable_ion_heap)
+		return;
+	sys_heap = container_of(movable_ion_heap, struct ion_system_heap, heap);
 
-		if (nr_to_reclaim == nr_reclaimed)
-			break;
-	} while (--nr_to_try != 0);
+	do {
+		nr_freed = ion_mm_drain_batch(sys_heap, ion_drain_rate[ION_DRAIN_CRITICAL].batch, false);
+		ion_mm_drain_account(&sys_heap->drain, nr_freed, ION_DRAIN_SYNC);
+	} while (nr_freed);
 
-	if (nr_to_reclaim != nr_reclaimed)
-		IONMSG("%s: remaining (%d)\n", __func__, nr_to_reclaim - nr_reclaimed);
+	nr_left = ion_mm_heap_pool_total(movable_ion_heap);
+	if (nr_left)
+		IONMSG("%s: remaining (%d)\n", __func__, nr_left);
 }
 #endif
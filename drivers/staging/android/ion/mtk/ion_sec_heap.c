@@ -87,7 +87,7 @@ static int ion_sec_heap_allocate(struct ion_heap *heap,
 
 #ifdef CONFIG_PM
 	if (sec_heap_total_memory <= 0)
-		shrink_ion_by_scenario(0);
+		shrink_ion_by_scenario_sync(0);
 #endif
 	caller_pid = (unsigned int)current->pid;
 	caller_tid = (unsigned int)current->tgid;
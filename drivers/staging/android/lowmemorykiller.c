@@ -93,6 +93,7 @@ static DEFINE_SPINLOCK(lowmem_shrink_lock);
 #include "trace/lowmemorykiller.h"
 
 static uint32_t lowmem_debug_level = 1;
+static uint32_t lowmem_oom_reaper = 1;
 static short lowmem_adj[9] = {
 	0,
 	1,
@@ -574,6 +575,9 @@ log_again:
 #endif
 
 		send_sig(SIGKILL, selected, 0);
+		/* do not wait for the victim to get to exit_mmap() */
+		if (lowmem_oom_reaper)
+			wake_oom_reaper(selected);
 		rem += selected_tasksize;
 	} else {
 		if (d_state_is_found == 1)
@@ -778,6 +782,7 @@ module_param_array_named(adj, lowmem_adj, short, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(oom_reaper, lowmem_oom_reaper, uint, S_IRUGO | S_IWUSR);
 
 #ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_AUTODETECT_OOM_ADJ_VALUES
 static int debug_adj_set(const char *val, const struct kernel_param *kp)
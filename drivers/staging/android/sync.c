@@ -31,6 +31,15 @@
 #define CREATE_TRACE_POINTS
 #include "trace/sync.h"
 
+/*
+ * Fences made by sync_fence_create() and by merging two single point
+ * fences, i.e. nearly all of them, come from this cache. Larger merges
+ * fall back to kmalloc.
+ */
+#define SYNC_FENCE_CACHED_PTS	2
+
+static struct kmem_cache *sync_fence_cache;
+
 static const struct fence_ops android_fence_ops;
 static const struct file_operations sync_fence_fops;
 
@@ -104,17 +113,23 @@ EXPORT_SYMBOL(sync_timeline_destroy);
 void sync_timeline_signal(struct sync_timeline *obj)
 {
 	unsigned long flags;
-	LIST_HEAD(signaled_pts);
 	struct sync_pt *pt, *next;
 
 	trace_sync_timeline(obj);
 
 	spin_lock_irqsave(&obj->child_list_lock, flags);
 
+	/*
+	 * The active list is in signal order. When the timeline promises
+	 * that pts signal in that order, everything after the first
+	 * pending pt is pending too. A destroyed timeline checks them all.
+	 */
 	list_for_each_entry_safe(pt, next, &obj->active_list_head,
 				 active_list) {
 		if (fence_is_signaled_locked(&pt->base))
 			list_del_init(&pt->active_list);
+		else if (obj->ops->signal_in_order && !obj->destroyed)
+			break;
 	}
 
 	spin_unlock_irqrestore(&obj->child_list_lock, flags);
@@ -150,11 +165,26 @@ void sync_pt_free(struct sync_pt *pt)
 }
 EXPORT_SYMBOL(sync_pt_free);
 
-static struct sync_fence *sync_fence_alloc(int size, const char *name)
+static void sync_fence_kfree(struct sync_fence *fence)
+{
+	if (fence->cached)
+		kmem_cache_free(sync_fence_cache, fence);
+	else
+		kfree(fence);
+}
+
+static struct sync_fence *sync_fence_alloc(int num_fences, const char *name)
 {
 	struct sync_fence *fence;
 
-	fence = kzalloc(size, GFP_KERNEL);
+	if (num_fences <= SYNC_FENCE_CACHED_PTS && sync_fence_cache) {
+		fence = kmem_cache_zalloc(sync_fence_cache, GFP_KERNEL);
+		if (fence)
+			fence->cached = true;
+	} else {
+		fence = kzalloc(offsetof(struct sync_fence, cbs[num_fences]),
+				GFP_KERNEL);
+	}
 	if (fence == NULL)
 		return NULL;
 
@@ -171,7 +201,7 @@ static struct sync_fence *sync_fence_alloc(int size, const char *name)
 	return fence;
 
 err:
-	kfree(fence);
+	sync_fence_kfree(fence);
 	return NULL;
 }
 
@@ -192,7 +222,7 @@ struct sync_fence *sync_fence_create(const char *name, struct sync_pt *pt)
 {
 	struct sync_fence *fence;
 
-	fence = sync_fence_alloc(offsetof(struct sync_fence, cbs[1]), name);
+	fence = sync_fence_alloc(1, name);
 	if (fence == NULL)
 		return NULL;
 
@@ -259,9 +289,8 @@ struct sync_fence *sync_fence_merge(const char *name,
 	int num_fences = a->num_fences + b->num_fences;
 	struct sync_fence *fence;
 	int i, i_a, i_b;
-	unsigned long size = offsetof(struct sync_fence, cbs[num_fences]);
 
-	fence = sync_fence_alloc(size, name);
+	fence = sync_fence_alloc(num_fences, name);
 	if (fence == NULL)
 		return NULL;
 
@@ -381,6 +410,13 @@ int sync_fence_wait(struct sync_fence *fence, long timeout)
 	trace_sync_wait(fence, 1);
 	for (i = 0; i < fence->num_fences; ++i)
 		trace_sync_pt(fence->cbs[i].sync_pt);
+
+	/* nothing to wait for, e.g. a buffer that is already idle */
+	if (atomic_read(&fence->status) <= 0) {
+		trace_sync_wait(fence, 0);
+		goto out;
+	}
+
 	ret = wait_event_interruptible_timeout(fence->wq,
 					       atomic_read(&fence->status) <= 0,
 					       timeout);
@@ -397,6 +433,7 @@ int sync_fence_wait(struct sync_fence *fence, long timeout)
 		return -ETIME;
 	}
 
+out:
 	ret = atomic_read(&fence->status);
 	if (ret) {
 		pr_info("fence error %ld on [%p]\n", ret, fence);
@@ -453,6 +490,19 @@ static bool android_fence_signaled(struct fence *fence)
 	return ret;
 }
 
+/* keep the active list in the order the pts will signal */
+static void sync_timeline_add_active(struct sync_timeline *obj,
+				     struct sync_pt *pt)
+{
+	struct sync_pt *pos;
+
+	/* new pts usually signal last, search from the tail */
+	list_for_each_entry_reverse(pos, &obj->active_list_head, active_list)
+		if (obj->ops->compare(pos, pt) <= 0)
+			break;
+	list_add(&pt->active_list, &pos->active_list);
+}
+
 static bool android_fence_enable_signaling(struct fence *fence)
 {
 	struct sync_pt *pt = container_of(fence, struct sync_pt, base);
@@ -461,7 +511,7 @@ static bool android_fence_enable_signaling(struct fence *fence)
 	if (android_fence_signaled(fence))
 		return false;
 
-	list_add_tail(&pt->active_list, &parent->active_list_head);
+	sync_timeline_add_active(parent, pt);
 	return true;
 }
 
@@ -534,7 +584,7 @@ static void sync_fence_free(struct kref *kref)
 		fence_put(fence->cbs[i].sync_pt);
 	}
 
-	kfree(fence);
+	sync_fence_kfree(fence);
 }
 
 static int sync_fence_release(struct inode *inode, struct file *file)
@@ -733,3 +783,13 @@ static const struct file_operations sync_fence_fops = {
 	.compat_ioctl = sync_fence_ioctl,
 };
 
+static int __init sync_fence_cache_init(void)
+{
+	sync_fence_cache = kmem_cache_create("sync_fence",
+			offsetof(struct sync_fence, cbs[SYNC_FENCE_CACHED_PTS]),
+			0, SLAB_HWCACHE_ALIGN, NULL);
+	if (!sync_fence_cache)
+		pr_warn("sync: no fence cache, using kmalloc\n");
+	return 0;
+}
+core_initcall(sync_fence_cache_init);
@@ -47,6 +47,9 @@ struct sync_fence;
  *			  to userspace by SYNC_IOC_FENCE_INFO.
  * @timeline_value_str: fill str with the value of the sync_timeline's counter
  * @pt_value_str:	fill str with the value of the sync_pt
+ * @signal_in_order:	pts never signal out of @compare order, so
+ *			  sync_timeline_signal() may stop at the first
+ *			  pending one
  */
 struct sync_timeline_ops {
 	const char *driver_name;
@@ -75,6 +78,8 @@ struct sync_timeline_ops {
 
 	/* optional */
 	void (*pt_value_str)(struct sync_pt *pt, char *str, int size);
+
+	bool signal_in_order;
 };
 
 /**
@@ -86,7 +91,8 @@ struct sync_timeline_ops {
  * @child_list_head:	list of children sync_pts for this sync_timeline
  * @child_list_lock:	lock protecting @child_list_head, destroyed, and
  *			  sync_pt.status
- * @active_list_head:	list of active (unsignaled/errored) sync_pts
+ * @active_list_head:	list of active (unsignaled/errored) sync_pts, in the
+ *			  order ops->compare says they signal
  * @sync_timeline_list:	membership in global sync_timeline_list
  */
 struct sync_timeline {
@@ -147,6 +153,7 @@ struct sync_fence_cb {
  * @pt_list_head:	list of sync_pts in the fence.  immutable once fence
  *			  is created
  * @status:		0: signaled, >0:active, <0: error
+ * @cached:		allocated from the sync_fence cache
  *
  * @wq:			wait queue for fence signaling
  * @sync_fence_list:	membership in global fence list
@@ -159,6 +166,7 @@ struct sync_fence {
 	struct list_head	sync_fence_list;
 #endif
 	int num_fences;
+	bool cached;
 
 	wait_queue_head_t	wq;
 	atomic_t		status;
@@ -30,6 +30,10 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/pagemap.h>
+#include <linux/scatterlist.h>
+#include <linux/sizes.h>
+#include <linux/uio.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -61,6 +65,48 @@
 #define RX_REQ_MAX 2
 #define INTR_REQ_MAX 5
 
+/*
+ * Deep queue mode for MTP_SEND_FILE* and MTP_RECEIVE_FILE: up to
+ * queue_depth requests of req_size bytes are in flight while the worker
+ * reads ahead or writes back the ones before them. On gadgets that take
+ * scatter-gather requests the file is sent straight from its page cache
+ * pages and received into pages written out with one vfs_writev() per
+ * request, otherwise each request has a contiguous buffer.
+ */
+#define MTP_DQ_DEPTH_MAX	16
+#define MTP_DQ_REQ_SIZE_MAX	SZ_1M
+
+static bool deep_queue;
+module_param(deep_queue, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(deep_queue, "Use deep queues of large requests for file transfers");
+
+static unsigned int queue_depth = 8;
+module_param(queue_depth, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(queue_depth, "Requests in flight per deep queue transfer, 2 to 16");
+
+static unsigned int req_size = SZ_256K;
+module_param(req_size, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(req_size, "Bytes per deep queue request, 16K to 1M");
+
+struct mtp_dq_req {
+	struct usb_request *req;
+	/* scatter-gather gadgets only */
+	struct scatterlist *sg;
+	struct iovec *iov;
+	/* own pages when receiving, page cache pages held when sending */
+	struct page **pages;
+	int nr_pages;
+	bool done;
+};
+
+struct mtp_dq {
+	int depth;		/* 0 while not allocated */
+	unsigned int size;
+	bool sg;
+	int nents;
+	struct mtp_dq_req r[MTP_DQ_DEPTH_MAX];
+};
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -117,6 +163,11 @@ struct mtp_dev {
 	uint32_t xfer_transaction_id;
 	int xfer_result;
 
+	/* deep queue mode, see mtp_dq_send() and mtp_dq_receive() */
+	struct mtp_dq dq_in;
+	struct mtp_dq dq_out;
+	struct mtp_data_header *dq_hdr;
+
 	struct work_struct device_reset_work;
 	int fileTransferSend;
 	char usb_functions[32];
@@ -758,6 +809,509 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+static void mtp_dq_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	struct mtp_dev *dev = _mtp_dev;
+	struct mtp_dq_req *r = req->context;
+
+	/*
+	 * Our own dequeues after a cancel or a short packet are no error,
+	 * and a disconnect gives back the requests after going offline.
+	 */
+	if (req->status != 0 && req->status != -ECONNRESET &&
+	    dev->state != STATE_OFFLINE)
+		dev->state = STATE_ERROR;
+
+	r->done = true;
+	if (ep == dev->ep_in)
+		wake_up(&dev->write_wq);
+	else
+		wake_up(&dev->read_wq);
+}
+
+static void mtp_dq_free(struct mtp_dq *dq, struct usb_ep *ep)
+{
+	struct mtp_dq_req *r;
+	int i;
+
+	for (i = 0; i < dq->depth; i++) {
+		r = &dq->r[i];
+		if (r->req) {
+			if (!dq->sg)
+				kfree(r->req->buf);
+			usb_ep_free_request(ep, r->req);
+		}
+		while (r->nr_pages)
+			put_page(r->pages[--r->nr_pages]);
+		kfree(r->sg);
+		kfree(r->iov);
+		kfree(r->pages);
+		memset(r, 0, sizeof(*r));
+	}
+	dq->depth = 0;
+}
+
+static int mtp_dq_alloc(struct mtp_dev *dev, struct mtp_dq *dq,
+			struct usb_ep *ep)
+{
+	int depth = clamp_t(int, queue_depth, 2, MTP_DQ_DEPTH_MAX);
+	unsigned int size = clamp_t(unsigned int, req_size,
+				    MTP_BULK_BUFFER_SIZE, MTP_DQ_REQ_SIZE_MAX);
+	bool sg = dev->cdev->gadget->sg_supported;
+	bool in = ep == dev->ep_in;
+	gfp_t gfp = GFP_KERNEL;
+	struct mtp_dq_req *r;
+	int i, j;
+
+	size = round_down(size, PAGE_SIZE);
+	if (dq->depth == depth && dq->size == size && dq->sg == sg)
+		return 0;
+	mtp_dq_free(dq, ep);
+
+#if defined(CONFIG_64BIT) && defined(CONFIG_MTK_LM_MODE)
+	gfp |= GFP_DMA;
+#endif
+	dq->depth = depth;
+	dq->size = size;
+	dq->sg = sg;
+	/* sending may need a page more for an unaligned offset, and the header */
+	dq->nents = size / PAGE_SIZE + (in ? 2 : 0);
+
+	for (i = 0; i < depth; i++) {
+		r = &dq->r[i];
+		r->req = usb_ep_alloc_request(ep, GFP_KERNEL);
+		if (!r->req)
+			goto fail;
+		r->req->complete = mtp_dq_complete;
+		r->req->context = r;
+
+		if (!sg) {
+			r->req->buf = kmalloc(size, gfp | __GFP_NOWARN);
+			if (!r->req->buf)
+				goto fail;
+			continue;
+		}
+
+		r->sg = kcalloc(dq->nents, sizeof(*r->sg), GFP_KERNEL);
+		r->pages = kcalloc(dq->nents, sizeof(*r->pages), GFP_KERNEL);
+		if (!r->sg || !r->pages)
+			goto fail;
+		/* sending maps page cache pages, receiving has its own */
+		if (in)
+			continue;
+		r->iov = kcalloc(dq->nents, sizeof(*r->iov), GFP_KERNEL);
+		if (!r->iov)
+			goto fail;
+		for (j = 0; j < dq->nents; j++) {
+			r->pages[j] = alloc_page(gfp);
+			if (!r->pages[j])
+				goto fail;
+			r->nr_pages++;
+		}
+	}
+	return 0;
+
+fail:
+	pr_warn("mtp: could not allocate %d requests of %u bytes\n",
+		depth, size);
+	mtp_dq_free(dq, ep);
+	return -ENOMEM;
+}
+
+static bool mtp_dq_mappable(struct file *filp)
+{
+	struct address_space *mapping = filp->f_mapping;
+
+	return S_ISREG(file_inode(filp)->i_mode) &&
+	       mapping->a_ops->readpage &&
+	       !(filp->f_flags & O_DIRECT) && (filp->f_mode & FMODE_READ);
+}
+
+/*
+ * Whether to transfer @count bytes in deep queue mode. The queues are
+ * freed once the mode has been switched off.
+ */
+static bool mtp_dq_usable(struct mtp_dev *dev, struct mtp_dq *dq,
+			  struct usb_ep *ep, struct file *filp, int64_t count)
+{
+	bool in = ep == dev->ep_in;
+
+	if (!deep_queue) {
+		mtp_dq_free(dq, ep);
+		return false;
+	}
+	if (count <= MTP_BULK_BUFFER_SIZE)
+		return false;
+
+	if (in) {
+		if (dev->cdev->gadget->sg_supported && !mtp_dq_mappable(filp))
+			return false;
+		if (!dev->dq_hdr)
+			dev->dq_hdr = kmalloc(sizeof(*dev->dq_hdr), GFP_KERNEL);
+		if (!dev->dq_hdr)
+			return false;
+	}
+	return !mtp_dq_alloc(dev, dq, ep);
+}
+
+/* drop the page cache pages a sent request held */
+static void mtp_dq_unmap(struct mtp_dq_req *r)
+{
+	while (r->nr_pages)
+		put_page(r->pages[--r->nr_pages]);
+}
+
+/* start reading @len bytes at @offset unless they are cached already */
+static void mtp_dq_readahead(struct file *filp, loff_t offset,
+			     unsigned int len)
+{
+	struct address_space *mapping = filp->f_mapping;
+	pgoff_t index = offset >> PAGE_CACHE_SHIFT;
+	struct page *page;
+
+	page = find_get_page(mapping, index);
+	if (page) {
+		page_cache_release(page);
+		return;
+	}
+	page_cache_sync_readahead(mapping, &filp->f_ra, filp, index,
+				  DIV_ROUND_UP(len, PAGE_CACHE_SIZE));
+}
+
+/*
+ * Set @r up to send @len bytes of @filp from *@offset after @hdr_size
+ * bytes of header. Returns the length of the request, shorter at the end
+ * of the file.
+ */
+static int mtp_dq_fill_in(struct mtp_dev *dev, struct mtp_dq_req *r,
+			  struct file *filp, loff_t *offset, int len,
+			  int hdr_size)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct usb_request *req = r->req;
+	unsigned int poff, bytes;
+	struct page *page;
+	loff_t isize;
+	int n = 0, ret;
+
+	if (!dev->dq_in.sg) {
+		ret = vfs_read(filp, req->buf + hdr_size, len, offset);
+		if (ret <= 0)
+			return ret ? ret : -EIO;
+		req->length = hdr_size + ret;
+		return req->length;
+	}
+
+	isize = i_size_read(mapping->host);
+	if (*offset >= isize)
+		return -EIO;
+	if (len > isize - *offset)
+		len = isize - *offset;
+
+	mtp_dq_readahead(filp, *offset, len);
+	/* and the next request, to be read while this one is sent */
+	mtp_dq_readahead(filp, *offset + len, dev->dq_in.size);
+
+	sg_init_table(r->sg, dev->dq_in.nents);
+	if (hdr_size)
+		sg_set_buf(&r->sg[n++], dev->dq_hdr, hdr_size);
+	req->length = hdr_size;
+
+	while (len) {
+		poff = *offset & ~PAGE_CACHE_MASK;
+		bytes = min_t(unsigned int, PAGE_CACHE_SIZE - poff, len);
+		page = read_mapping_page(mapping, *offset >> PAGE_CACHE_SHIFT,
+					 filp);
+		if (IS_ERR(page)) {
+			mtp_dq_unmap(r);
+			return PTR_ERR(page);
+		}
+		r->pages[r->nr_pages++] = page;
+		sg_set_page(&r->sg[n++], page, bytes, poff);
+		*offset += bytes;
+		len -= bytes;
+		req->length += bytes;
+	}
+	sg_mark_end(&r->sg[n - 1]);
+	req->buf = NULL;
+	req->sg = r->sg;
+	req->num_sgs = n;
+	return req->length;
+}
+
+/* the zero length packet that ends a transfer of whole packets */
+static void mtp_dq_fill_zlp(struct mtp_dev *dev, struct mtp_dq_req *r)
+{
+	struct usb_request *req = r->req;
+
+	if (dev->dq_in.sg) {
+		req->buf = dev->dq_hdr;
+		req->sg = NULL;
+		req->num_sgs = 0;
+	}
+	req->length = 0;
+}
+
+static void mtp_dq_fill_out(struct mtp_dq *dq, struct mtp_dq_req *r,
+			    unsigned int len)
+{
+	struct usb_request *req = r->req;
+	unsigned int bytes;
+	int n;
+
+	req->length = len;
+	if (!dq->sg)
+		return;
+
+	sg_init_table(r->sg, dq->nents);
+	for (n = 0; len; n++) {
+		bytes = min_t(unsigned int, len, PAGE_SIZE);
+		sg_set_page(&r->sg[n], r->pages[n], bytes, 0);
+		len -= bytes;
+	}
+	sg_mark_end(&r->sg[n - 1]);
+	req->sg = r->sg;
+	req->num_sgs = n;
+}
+
+/* write what @r received to @filp at *@offset */
+static int mtp_dq_write_out(struct mtp_dev *dev, struct mtp_dq_req *r,
+			    struct file *filp, loff_t *offset)
+{
+	struct mtp_dq *dq = &dev->dq_out;
+	struct usb_request *req = r->req;
+	unsigned int left = req->actual;
+	ssize_t ret;
+	int n;
+
+	if (!dq->sg) {
+		ret = vfs_write(filp, req->buf, left, offset);
+	} else {
+		for (n = 0; left; n++) {
+			r->iov[n].iov_base = page_address(r->pages[n]);
+			r->iov[n].iov_len = min_t(unsigned int, left, PAGE_SIZE);
+			left -= r->iov[n].iov_len;
+		}
+		/* like vfs_write() above, fine in our kernel context */
+		ret = vfs_writev(filp, (const struct iovec __user *)r->iov, n,
+				 offset);
+	}
+	DBG(dev->cdev, "vfs_write %zd\n", ret);
+	return ret == req->actual ? 0 : -EIO;
+}
+
+/*
+ * Take back the @inflight requests from @head on after an error, a cancel
+ * or a short packet, and wait for them to be given back. A request the UDC
+ * still owns must not be reused or freed, so one that is slow to come back
+ * is dequeued again until it is.
+ */
+static void mtp_dq_drain(struct mtp_dev *dev, struct mtp_dq *dq,
+			 struct usb_ep *ep, int head, int inflight)
+{
+	wait_queue_head_t *wq = ep == dev->ep_in ? &dev->write_wq :
+						   &dev->read_wq;
+	struct mtp_dq_req *r;
+	int i;
+
+	for (i = 0; i < inflight; i++) {
+		r = &dq->r[(head + i) % dq->depth];
+		if (!r->done)
+			usb_ep_dequeue(ep, r->req);
+	}
+	for (i = 0; i < inflight; i++) {
+		r = &dq->r[(head + i) % dq->depth];
+		while (!wait_event_timeout(*wq, r->done, HZ)) {
+			pr_err("mtp: %s request %p not given back, dequeuing again\n",
+			       ep->name, r->req);
+			usb_ep_dequeue(ep, r->req);
+		}
+		r->req->short_not_ok = 0;
+		if (ep == dev->ep_in)
+			mtp_dq_unmap(r);
+	}
+}
+
+/* send_file_work() with up to dq->depth requests in flight */
+static int mtp_dq_send(struct mtp_dev *dev, struct file *filp, loff_t offset,
+		       int64_t count, int hdr_size)
+{
+	struct mtp_dq *dq = &dev->dq_in;
+	struct mtp_data_header *header;
+	struct mtp_dq_req *r;
+	int head = 0, tail = 0, inflight = 0;
+	int xfer, ret, err = 0;
+	int sendZLP = 0;
+
+	/* we need to send a zero length packet to signal the end of transfer
+	 * if the transfer size is aligned to a packet boundary.
+	 */
+	if ((count & (dev->ep_in->maxpacket - 1)) == 0)
+		sendZLP = 1;
+
+	while (count > 0 || sendZLP || inflight) {
+		if (dev->state != STATE_BUSY) {
+			err = dev->state == STATE_CANCELED ? -ECANCELED : -EIO;
+			break;
+		}
+
+		if ((count > 0 || sendZLP) && inflight < dq->depth) {
+			r = &dq->r[tail];
+			if (count == 0) {
+				mtp_dq_fill_zlp(dev, r);
+				sendZLP = 0;
+			} else {
+				xfer = min_t(int64_t, count, dq->size);
+				if (hdr_size) {
+					/* prepend MTP data header */
+					header = dq->sg ? dev->dq_hdr :
+							  r->req->buf;
+					header->length = __cpu_to_le32(count);
+					header->type = __cpu_to_le16(2);
+					header->command =
+						__cpu_to_le16(dev->xfer_command);
+					header->transaction_id =
+					__cpu_to_le32(dev->xfer_transaction_id);
+				}
+				ret = mtp_dq_fill_in(dev, r, filp, &offset,
+						     xfer - hdr_size, hdr_size);
+				if (ret < 0) {
+					err = ret;
+					break;
+				}
+				hdr_size = 0;
+				count -= ret;
+			}
+
+			r->done = false;
+			usb_boost();
+			ret = usb_ep_queue(dev->ep_in, r->req, GFP_KERNEL);
+			if (ret < 0) {
+				DBG(dev->cdev, "mtp_dq_send: xfer error %d\n",
+				    ret);
+				mtp_dq_unmap(r);
+				dev->state = STATE_ERROR;
+				err = -EIO;
+				break;
+			}
+			tail = (tail + 1) % dq->depth;
+			inflight++;
+			continue;
+		}
+
+		/* wait for the oldest request to complete */
+		r = &dq->r[head];
+		ret = wait_event_interruptible(dev->write_wq,
+			r->done || dev->state != STATE_BUSY);
+		if (ret < 0) {
+			err = ret;
+			break;
+		}
+		if (!r->done)
+			continue;
+		if (r->req->status) {
+			err = -EIO;
+			break;
+		}
+		mtp_dq_unmap(r);
+		head = (head + 1) % dq->depth;
+		inflight--;
+	}
+
+	mtp_dq_drain(dev, dq, dev->ep_in, head, inflight);
+	if (dq->sg)
+		file_accessed(filp);
+	return err;
+}
+
+/* receive_file_work() with up to dq->depth requests in flight */
+static int mtp_dq_receive(struct mtp_dev *dev, struct file *filp,
+			  loff_t offset, int64_t count)
+{
+	struct mtp_dq *dq = &dev->dq_out;
+	struct usb_request *req;
+	struct mtp_dq_req *r;
+	/* if xfer_file_length is 0xFFFFFFFF, then we read until
+	 * we get a zero length packet
+	 */
+	bool unbounded = count == 0xFFFFFFFF;
+	int64_t queued = 0;
+	int head = 0, tail = 0, inflight = 0;
+	int ret, err = 0;
+	unsigned int len;
+
+	while (unbounded || queued < count || inflight) {
+		if (dev->state != STATE_BUSY) {
+			err = dev->state == STATE_CANCELED ? -ECANCELED : -EIO;
+			break;
+		}
+
+		if ((unbounded || queued < count) && inflight < dq->depth) {
+			r = &dq->r[tail];
+			req = r->req;
+			len = unbounded ? dq->size :
+				min_t(int64_t, count - queued, dq->size);
+			mtp_dq_fill_out(dq, r, len);
+
+			/* as receive_file_work() does, by the bytes queued */
+			if (queued >= 0xFFFFFFFF)
+				req->short_not_ok = 0;
+			else
+				req->short_not_ok =
+					!(len % dev->ep_out->maxpacket);
+
+			r->done = false;
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
+			if (ret < 0) {
+				req->short_not_ok = 0;
+				dev->state = STATE_ERROR;
+				err = -EIO;
+				break;
+			}
+			queued += len;
+			tail = (tail + 1) % dq->depth;
+			inflight++;
+			continue;
+		}
+
+		/* wait for the oldest request and write it out */
+		r = &dq->r[head];
+		req = r->req;
+		ret = wait_event_interruptible(dev->read_wq,
+			r->done || dev->state != STATE_BUSY);
+		if (ret < 0) {
+			err = ret;
+			break;
+		}
+		if (!r->done)
+			continue;
+		req->short_not_ok = 0;
+		if (req->status) {
+			err = -EIO;
+			break;
+		}
+
+		usb_boost();
+		DBG(dev->cdev, "rx %p %d\n", req, req->actual);
+		if (mtp_dq_write_out(dev, r, filp, &offset)) {
+			dev->state = STATE_ERROR;
+			err = -EIO;
+			break;
+		}
+		head = (head + 1) % dq->depth;
+		inflight--;
+
+		/* a short packet ends the data, the host waits for our response */
+		if (req->actual < req->length) {
+			DBG(dev->cdev, "got short packet\n");
+			break;
+		}
+	}
+
+	mtp_dq_drain(dev, dq, dev->ep_out, head, inflight);
+	return err;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
@@ -799,6 +1353,11 @@ static void send_file_work(struct work_struct *data)
 	if ((count & (dev->ep_in->maxpacket - 1)) == 0)
 		sendZLP = 1;
 
+	if (mtp_dq_usable(dev, &dev->dq_in, dev->ep_in, filp, count)) {
+		r = mtp_dq_send(dev, filp, offset, count, hdr_size);
+		goto out;
+	}
+
 	while (count > 0 || sendZLP) {
 		/* so we exit after sending ZLP */
 		if (count == 0)
@@ -861,6 +1420,7 @@ static void send_file_work(struct work_struct *data)
 	if (req)
 		mtp_req_put(dev, &dev->tx_idle, req);
 
+out:
 	DBG(cdev, "send_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -895,6 +1455,11 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
+	if (mtp_dq_usable(dev, &dev->dq_out, dev->ep_out, filp, count)) {
+		r = mtp_dq_receive(dev, filp, offset, count);
+		goto out;
+	}
+
 	while (count > 0 || write_req) {
 		if (count > 0) {
 			/* queue a request */
@@ -980,6 +1545,7 @@ static void receive_file_work(struct work_struct *data)
 			read_req->short_not_ok = 0;
 	}
 
+out:
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1351,6 +1917,10 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
+	mtp_dq_free(&dev->dq_in, dev->ep_in);
+	mtp_dq_free(&dev->dq_out, dev->ep_out);
+	kfree(dev->dq_hdr);
+	dev->dq_hdr = NULL;
 	dev->state = STATE_OFFLINE;
 	kfree(f->os_desc_table);
 	f->os_desc_n = 0;
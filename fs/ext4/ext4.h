@@ -1232,6 +1232,12 @@ struct ext4_super_block {
 /* Number of quota types we support */
 #define EXT4_MAXQUOTAS 2
 
+/*
+ * Buckets of the groups-scanned-per-allocation histogram: bucket n counts
+ * requests that scanned [2^n, 2^(n+1)) groups, the last one everything above.
+ */
+#define EXT4_MB_SCAN_HIST 8
+
 /*
  * fourth extended-fs super-block data in memory
  */
@@ -1328,6 +1334,10 @@ struct ext4_sb_info {
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
 	unsigned int s_max_dir_size_kb;
+	unsigned int s_mb_optimize_scan;
+	/* groups indexed by the order of their largest free extent */
+	struct list_head *s_mb_largest_free_orders;
+	rwlock_t *s_mb_largest_free_orders_locks;
 	/* where last allocation was done - for stream allocation */
 	unsigned long s_mb_last_group;
 	unsigned long s_mb_last_start;
@@ -1340,6 +1350,9 @@ struct ext4_sb_info {
 	atomic_t s_bal_goals;	/* goal hits */
 	atomic_t s_bal_breaks;	/* too long searches */
 	atomic_t s_bal_2orders;	/* 2^order hits */
+	atomic_t s_bal_groups_scanned;	/* total groups scanned */
+	atomic_t s_bal_optimized;	/* reqs served from order lists */
+	atomic_t s_bal_scan_hist[EXT4_MB_SCAN_HIST];	/* groups/req, log2 */
 	spinlock_t s_bal_lock;
 	unsigned long s_mb_buddies_generated;
 	unsigned long long s_mb_generation_time;
@@ -2685,7 +2698,10 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_group_t	bb_group;	/* group number */
 	struct          list_head bb_prealloc_list;
+	struct          list_head bb_largest_free_order_node;
+	ext4_grpblk_t	bb_order_list;	/* order list we are on, -1 if none */
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
 #endif
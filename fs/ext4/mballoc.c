@@ -696,9 +696,39 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 	}
 }
 
+/*
+ * Move @grp to the s_mb_largest_free_orders list of @order, or take it off
+ * the lists if @order is negative.  bb_order_list is only changed under the
+ * lock of the list the group leaves or joins, so a reader holding a list
+ * lock can tell whether the group is still on that list.
+ */
+static void mb_set_order_list(struct ext4_sb_info *sbi,
+			      struct ext4_group_info *grp, int order)
+{
+	int old = grp->bb_order_list;
+
+	if (old == order)
+		return;
+	if (old >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		grp->bb_order_list = -1;
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	}
+	if (order >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[order]);
+		grp->bb_order_list = order;
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+	}
+}
+
 /*
  * Cache the order of the largest free extent we have available in this block
- * group.
+ * group, and keep the group on the matching s_mb_largest_free_orders list so
+ * that the allocator can find candidate groups without scanning them all.
+ * Must be called with the group lock held.
  */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
@@ -715,6 +745,9 @@ mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 			break;
 		}
 	}
+
+	mb_set_order_list(EXT4_SB(sb), grp,
+			  grp->bb_free ? grp->bb_largest_free_order : -1);
 }
 
 static noinline_for_stack
@@ -2061,6 +2094,11 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	case 1:
 		if ((free / fragments) >= ac->ac_g_ex.fe_len)
 			return 1;
+		/* a group picked by its largest free order is good enough */
+		if (EXT4_SB(ac->ac_sb)->s_mb_optimize_scan &&
+		    grp->bb_largest_free_order >= 0 &&
+		    (1 << grp->bb_largest_free_order) >= ac->ac_g_ex.fe_len)
+			return 1;
 		break;
 	case 2:
 		if (free >= ac->ac_g_ex.fe_len)
@@ -2075,11 +2113,122 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Load the buddy of @group and scan it with criteria @cr if the group
+ * looks good enough for the request.
+ */
+static int ext4_mb_scan_group(struct ext4_allocation_context *ac,
+			      ext4_group_t group, int cr)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_buddy e4b;
+	int err;
+
+	/* This now checks without needing the buddy page */
+	if (!ext4_mb_good_group(ac, group, cr))
+		return 0;
+
+	err = ext4_mb_load_buddy(sb, group, &e4b);
+	if (err)
+		return err;
+
+	ext4_lock_group(sb, group);
+
+	/*
+	 * We need to check again after locking the
+	 * block group
+	 */
+	if (!ext4_mb_good_group(ac, group, cr))
+		goto out;
+
+	ac->ac_groups_scanned++;
+	if (cr == 0 && ac->ac_2order < sb->s_blocksize_bits+2)
+		ext4_mb_simple_scan_group(ac, &e4b);
+	else if (cr == 1 && sbi->s_stripe &&
+			!(ac->ac_g_ex.fe_len % sbi->s_stripe))
+		ext4_mb_scan_aligned(ac, &e4b);
+	else
+		ext4_mb_complex_scan_group(ac, &e4b);
+out:
+	ext4_unlock_group(sb, group);
+	ext4_mb_unload_buddy(&e4b);
+	return 0;
+}
+
+/* groups picked from an order list per lock hold */
+#define MB_ORDER_LIST_BATCH	16
+
+/*
+ * Scan the groups whose largest free extent is at least 2^@order, smallest
+ * sufficient order first so that the big free extents stay intact.  Group
+ * numbers are picked in batches under the list lock and scanned after it
+ * is dropped, since loading the buddy may sleep.  The next batch resumes
+ * after the last group picked while that group is still on the list, else
+ * from the head again, and at most ngroups are picked per order.  Scanning
+ * moves groups between lists, so a batch may miss or revisit a group; the
+ * linear scan of the later criteria covers anything missed here.  The goal
+ * group has been tried by the caller and is skipped.
+ */
+static int ext4_mb_scan_order_lists(struct ext4_allocation_context *ac,
+				    int order, int cr, ext4_group_t ngroups)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_group_t batch[MB_ORDER_LIST_BATCH];
+	struct ext4_group_info *grp, *cursor;
+	struct list_head *head;
+	rwlock_t *lock;
+	ext4_group_t picked;
+	int i, n, err;
+
+	for (; order <= sb->s_blocksize_bits + 1; order++) {
+		head = &sbi->s_mb_largest_free_orders[order];
+		lock = &sbi->s_mb_largest_free_orders_locks[order];
+		cursor = NULL;
+		picked = 0;
+		do {
+			n = 0;
+			read_lock(lock);
+			if (cursor && cursor->bb_order_list == order)
+				grp = cursor;
+			else
+				grp = list_entry(head, struct ext4_group_info,
+						 bb_largest_free_order_node);
+			list_for_each_entry_continue(grp, head,
+					bb_largest_free_order_node) {
+				batch[n++] = grp->bb_group;
+				cursor = grp;
+				if (n == MB_ORDER_LIST_BATCH)
+					break;
+			}
+			read_unlock(lock);
+			picked += n;
+
+			for (i = 0; i < n; i++) {
+				/* restricted ngroups for non-extent files */
+				if (batch[i] >= ngroups ||
+				    batch[i] == ac->ac_g_ex.fe_group)
+					continue;
+				cond_resched();
+				err = ext4_mb_scan_group(ac, batch[i], cr);
+				if (err)
+					return err;
+				if (ac->ac_status != AC_STATUS_CONTINUE) {
+					ac->ac_optimized = 1;
+					return 0;
+				}
+			}
+		} while (n == MB_ORDER_LIST_BATCH && picked < ngroups);
+	}
+	return 0;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
 	ext4_group_t ngroups, group, i;
-	int cr;
+	int cr, order;
 	int err = 0;
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
@@ -2146,6 +2295,31 @@ repeat:
 		 */
 		group = ac->ac_g_ex.fe_group;
 
+		/*
+		 * For the first two criteria the groups able to satisfy
+		 * the request are known from their largest free order, so
+		 * only look at those and leave the full walk to cr 2/3.
+		 * The goal group still comes first, to keep locality.
+		 */
+		if (cr < 2 && sbi->s_mb_optimize_scan) {
+			order = cr == 0 ? ac->ac_2order :
+					  fls(ac->ac_g_ex.fe_len - 1);
+			if (order <= sb->s_blocksize_bits + 1) {
+				if (group < ngroups) {
+					err = ext4_mb_scan_group(ac, group, cr);
+					if (err)
+						goto out;
+					if (ac->ac_status != AC_STATUS_CONTINUE)
+						continue;
+				}
+				err = ext4_mb_scan_order_lists(ac, order, cr,
+							       ngroups);
+				if (err)
+					goto out;
+				continue;
+			}
+		}
+
 		for (i = 0; i < ngroups; group++, i++) {
 			cond_resched();
 			/*
@@ -2155,38 +2329,10 @@ repeat:
 			if (group >= ngroups)
 				group = 0;
 
-			/* This now checks without needing the buddy page */
-			if (!ext4_mb_good_group(ac, group, cr))
-				continue;
-
-			err = ext4_mb_load_buddy(sb, group, &e4b);
+			err = ext4_mb_scan_group(ac, group, cr);
 			if (err)
 				goto out;
 
-			ext4_lock_group(sb, group);
-
-			/*
-			 * We need to check again after locking the
-			 * block group
-			 */
-			if (!ext4_mb_good_group(ac, group, cr)) {
-				ext4_unlock_group(sb, group);
-				ext4_mb_unload_buddy(&e4b);
-				continue;
-			}
-
-			ac->ac_groups_scanned++;
-			if (cr == 0 && ac->ac_2order < sb->s_blocksize_bits+2)
-				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 && sbi->s_stripe &&
-					!(ac->ac_g_ex.fe_len % sbi->s_stripe))
-				ext4_mb_scan_aligned(ac, &e4b);
-			else
-				ext4_mb_complex_scan_group(ac, &e4b);
-
-			ext4_unlock_group(sb, group);
-			ext4_mb_unload_buddy(&e4b);
-
 			if (ac->ac_status != AC_STATUS_CONTINUE)
 				break;
 		}
@@ -2327,6 +2473,44 @@ static const struct file_operations ext4_mb_seq_groups_fops = {
 	.release	= seq_release,
 };
 
+static int ext4_mb_seq_stats_show(struct seq_file *seq, void *v)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int reqs = atomic_read(&sbi->s_bal_reqs);
+	unsigned int scanned = atomic_read(&sbi->s_bal_groups_scanned);
+	int i;
+
+	if (!sbi->s_mb_stats) {
+		seq_puts(seq, "mb_stats disabled\n");
+		return 0;
+	}
+	seq_printf(seq, "reqs: %u\n", reqs);
+	seq_printf(seq, "success: %u\n", atomic_read(&sbi->s_bal_success));
+	seq_printf(seq, "groups_scanned: %u\n", scanned);
+	seq_printf(seq, "groups_per_req: %u\n", reqs ? scanned / reqs : 0);
+	seq_printf(seq, "optimized_reqs: %u\n",
+		   atomic_read(&sbi->s_bal_optimized));
+	seq_puts(seq, "groups_scanned_hist:");
+	for (i = 0; i < EXT4_MB_SCAN_HIST; i++)
+		seq_printf(seq, " %u", atomic_read(&sbi->s_bal_scan_hist[i]));
+	seq_putc(seq, '\n');
+	return 0;
+}
+
+static int ext4_mb_seq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_mb_seq_stats_show, PDE_DATA(inode));
+}
+
+static const struct file_operations ext4_mb_seq_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_mb_seq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct kmem_cache *get_groupinfo_cache(int blocksize_bits)
 {
 	int cache_index = blocksize_bits - EXT4_MIN_BLOCK_LOG_SIZE;
@@ -2422,9 +2606,25 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_order_list = -1;
+	meta_group_info[i]->bb_group = group;
+
+	/*
+	 * Until its buddy is generated, file the group by the order of its
+	 * free count, an upper bound of its largest free extent, so that the
+	 * order list scans find it; scanning it initializes it and moves it
+	 * to the right list.
+	 */
+	if (meta_group_info[i]->bb_free) {
+		int order = fls(meta_group_info[i]->bb_free) - 1;
+
+		mb_set_order_list(sbi, meta_group_info[i],
+				  min_t(int, order, sb->s_blocksize_bits + 1));
+	}
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2574,6 +2774,21 @@ int ext4_mb_init(struct super_block *sb)
 		goto out;
 	}
 
+	i = sb->s_blocksize_bits + 2;
+	sbi->s_mb_largest_free_orders =
+		kmalloc(i * sizeof(struct list_head), GFP_KERNEL);
+	sbi->s_mb_largest_free_orders_locks =
+		kmalloc(i * sizeof(rwlock_t), GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders ||
+	    !sbi->s_mb_largest_free_orders_locks) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	while (i--) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		rwlock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+
 	ret = ext4_groupinfo_create_slab(sb->s_blocksize);
 	if (ret < 0)
 		goto out;
@@ -2603,6 +2818,7 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
 	/*
 	 * The default group preallocation is 512, which for 4k block
 	 * sizes translates to 2 megabytes.  However for bigalloc file
@@ -2649,9 +2865,12 @@ int ext4_mb_init(struct super_block *sb)
 	if (ret != 0)
 		goto out_free_locality_groups;
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
 				 &ext4_mb_seq_groups_fops, sb);
+		proc_create_data("mb_stats", S_IRUGO, sbi->s_proc,
+				 &ext4_mb_seq_stats_fops, sb);
+	}
 
 	return 0;
 
@@ -2659,6 +2878,10 @@ out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
 out:
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2693,8 +2916,10 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct kmem_cache *cachep = get_groupinfo_cache(sb->s_blocksize_bits);
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
+		remove_proc_entry("mb_stats", sbi->s_proc);
 		remove_proc_entry("mb_groups", sbi->s_proc);
+	}
 
 	if (sbi->s_group_info) {
 		for (i = 0; i < ngroups; i++) {
@@ -2716,6 +2941,8 @@ int ext4_mb_release(struct super_block *sb)
 	}
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 	if (sbi->s_buddy_cache)
 		iput(sbi->s_buddy_cache);
 	if (sbi->s_mb_stats) {
@@ -2732,6 +2959,10 @@ int ext4_mb_release(struct super_block *sb)
 				atomic_read(&sbi->s_bal_2orders),
 				atomic_read(&sbi->s_bal_breaks),
 				atomic_read(&sbi->s_mb_lost_chunks));
+		ext4_msg(sb, KERN_INFO,
+		       "mballoc: %u groups scanned, %u reqs from order lists",
+				atomic_read(&sbi->s_bal_groups_scanned),
+				atomic_read(&sbi->s_bal_optimized));
 		ext4_msg(sb, KERN_INFO,
 		       "mballoc: %lu generated and it took %Lu",
 				sbi->s_mb_buddies_generated,
@@ -3206,6 +3437,13 @@ static void ext4_mb_collect_stats(struct ext4_allocation_context *ac)
 			atomic_inc(&sbi->s_bal_goals);
 		if (ac->ac_found > sbi->s_mb_max_to_scan)
 			atomic_inc(&sbi->s_bal_breaks);
+		atomic_add(ac->ac_groups_scanned, &sbi->s_bal_groups_scanned);
+		if (ac->ac_optimized)
+			atomic_inc(&sbi->s_bal_optimized);
+		if (ac->ac_groups_scanned)
+			atomic_inc(&sbi->s_bal_scan_hist[min_t(int,
+				fls(ac->ac_groups_scanned) - 1,
+				EXT4_MB_SCAN_HIST - 1)]);
 	}
 
 	if (ac->ac_op == EXT4_MB_HISTORY_ALLOC)
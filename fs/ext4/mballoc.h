@@ -84,6 +84,12 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_ORDER2_REQS		2
 
+/*
+ * pick cr 0/1 candidate groups from the per-order lists of largest free
+ * extents instead of walking every group from the goal
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
 /*
  * default group prealloc size 512 blocks
  */
@@ -185,6 +191,7 @@ struct ext4_allocation_context {
 	__u8 ac_2order;		/* if request is to allocate 2^N blocks and
 				 * N > 0, the field stores N, otherwise 0 */
 	__u8 ac_op;		/* operation, for history only */
+	__u8 ac_optimized;	/* found through the largest free order lists */
 	struct page *ac_bitmap_page;
 	struct page *ac_buddy_page;
 	struct ext4_prealloc_space *ac_pa;
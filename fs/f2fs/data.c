@@ -834,6 +834,22 @@ static inline void __do_map_lock(struct f2fs_sb_info *sbi, int flag, bool lock)
 	}
 }
 
+/*
+ * For F2FS_GET_BLOCK_PRECACHE, cache the part of the run that was mapped
+ * from the current dnode while its page is still locked, so that truncate
+ * or a block move cannot change it in between.
+ */
+static void f2fs_precache_dnode(struct dnode_of_data *dn,
+			struct f2fs_map_blocks *map, unsigned int *cached)
+{
+	if (!(map->m_flags & F2FS_MAP_MAPPED) || map->m_len <= *cached)
+		return;
+
+	f2fs_update_extent_cache_range(dn, map->m_lblk + *cached,
+			map->m_pblk + *cached, map->m_len - *cached);
+	*cached = map->m_len;
+}
+
 /*
  * f2fs_map_blocks() now supported readahead/bmap/rw direct_IO with
  * f2fs_map_blocks structure.
@@ -853,6 +869,7 @@ int f2fs_map_blocks(struct inode *inode, struct f2fs_map_blocks *map,
 	pgoff_t pgofs, end_offset, end;
 	int err = 0, ofs = 1;
 	unsigned int ofs_in_node, last_ofs_in_node;
+	unsigned int cached = 0;
 	blkcnt_t prealloc;
 	struct extent_info ei = {0,0,0};
 	block_t blkaddr;
@@ -930,6 +947,9 @@ next_block:
 				if (map->m_next_pgofs)
 					*map->m_next_pgofs = pgofs + 1;
 			}
+			if (flag == F2FS_GET_BLOCK_PRECACHE &&
+					map->m_next_pgofs && !map->m_len)
+				*map->m_next_pgofs = pgofs + 1;
 			if (flag != F2FS_GET_BLOCK_FIEMAP ||
 						blkaddr != NEW_ADDR)
 				goto sync_out;
@@ -983,6 +1003,8 @@ skip:
 	else if (dn.ofs_in_node < end_offset)
 		goto next_block;
 
+	if (flag == F2FS_GET_BLOCK_PRECACHE)
+		f2fs_precache_dnode(&dn, map, &cached);
 	f2fs_put_dnode(&dn);
 
 	if (create) {
@@ -992,6 +1014,8 @@ skip:
 	goto next_dnode;
 
 sync_out:
+	if (flag == F2FS_GET_BLOCK_PRECACHE)
+		f2fs_precache_dnode(&dn, map, &cached);
 	f2fs_put_dnode(&dn);
 unlock_out:
 	if (create) {
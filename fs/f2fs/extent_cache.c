@@ -410,6 +410,9 @@ static bool f2fs_lookup_extent_tree(struct inode *inode, pgoff_t pgofs,
 	ret = true;
 out:
 	stat_inc_total_hit(sbi);
+	percpu_counter_inc(&sbi->ext_lookups);
+	if (ret)
+		percpu_counter_inc(&sbi->ext_hits);
 	read_unlock(&et->lock);
 
 	trace_f2fs_lookup_extent_tree_end(inode, pgofs, ei);
@@ -785,6 +788,149 @@ void f2fs_update_extent_cache_range(struct dnode_of_data *dn,
 	f2fs_update_extent_tree_range(dn->inode, fofs, blkaddr, len);
 }
 
+/*
+ * Walk the whole node tree of @inode once and insert every mapped run into
+ * its extent tree, so that later reads and readahead of a fragmented file
+ * are mapped from the extent cache instead of get_dnode_of_data().
+ */
+static int f2fs_precache_extents(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct extent_tree *et = F2FS_I(inode)->extent_tree;
+	struct f2fs_map_blocks map;
+	pgoff_t next_pgofs, end;
+	int err = 0;
+
+	if (!et || f2fs_has_inline_data(inode))
+		return 0;
+
+	/*
+	 * A file that gave up its extent cache because of small overwrites
+	 * gets another chance once nobody has it open for write anymore.
+	 */
+	if (is_inode_flag_set(inode, FI_NO_EXTENT)) {
+		if (atomic_read(&inode->i_writecount) > 0)
+			return 0;
+		write_lock(&et->lock);
+		clear_inode_flag(inode, FI_NO_EXTENT);
+		write_unlock(&et->lock);
+	}
+
+	end = DIV_ROUND_UP(i_size_read(inode), PAGE_SIZE);
+	map.m_lblk = 0;
+	map.m_next_pgofs = &next_pgofs;
+
+	while (map.m_lblk < end) {
+		map.m_len = end - map.m_lblk;
+		next_pgofs = map.m_lblk + 1;
+
+		/* keep GC from moving blocks while they are being cached */
+		mutex_lock(&sbi->gc_mutex);
+		err = f2fs_map_blocks(inode, &map, 0, F2FS_GET_BLOCK_PRECACHE);
+		mutex_unlock(&sbi->gc_mutex);
+		if (err || is_inode_flag_set(inode, FI_NO_EXTENT))
+			break;
+
+		if (map.m_flags & F2FS_MAP_MAPPED)
+			map.m_lblk += map.m_len;
+		else
+			map.m_lblk = next_pgofs;
+		cond_resched();
+	}
+
+	/* keep the cache within budget, coldest entries go first */
+	if (sbi->max_extent_nodes &&
+		atomic_read(&sbi->total_ext_node) > sbi->max_extent_nodes)
+		f2fs_shrink_extent_tree(sbi,
+			atomic_read(&sbi->total_ext_node) -
+						sbi->max_extent_nodes);
+	return err;
+}
+
+static void f2fs_precache_extents_work(struct work_struct *work)
+{
+	struct f2fs_sb_info *sbi = container_of(work, struct f2fs_sb_info,
+							precache_work);
+	struct f2fs_inode_info *fi;
+	struct inode *inode;
+
+	spin_lock(&sbi->precache_lock);
+	while (!list_empty(&sbi->precache_list)) {
+		fi = list_first_entry(&sbi->precache_list,
+					struct f2fs_inode_info, precache_list);
+		list_del_init(&fi->precache_list);
+		spin_unlock(&sbi->precache_lock);
+
+		inode = &fi->vfs_inode;
+		if (!f2fs_precache_extents(inode))
+			sbi->precached_files++;
+		iput(inode);
+
+		spin_lock(&sbi->precache_lock);
+	}
+	spin_unlock(&sbi->precache_lock);
+}
+
+/*
+ * Called on every successful open of a regular file. Once a file has been
+ * opened for read precache_opens times, building its extent map is queued
+ * to the background worker.
+ */
+void f2fs_precache_extents_open(struct inode *inode, struct file *filp)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	unsigned int opens = sbi->precache_opens;
+
+	if (!opens || !S_ISREG(inode->i_mode) ||
+			!(filp->f_mode & FMODE_READ) ||
+			(filp->f_mode & FMODE_WRITE))
+		return;
+	if (!test_opt(sbi, EXTENT_CACHE) || !fi->extent_tree)
+		return;
+	if (atomic_inc_return(&fi->read_opens) < opens)
+		return;
+	atomic_set(&fi->read_opens, 0);
+
+	/* our caller holds a reference, so this cannot fail */
+	ihold(inode);
+
+	spin_lock(&sbi->precache_lock);
+	if (!list_empty(&fi->precache_list) ||
+			is_sbi_flag_set(sbi, SBI_IS_CLOSE)) {
+		spin_unlock(&sbi->precache_lock);
+		iput(inode);
+		return;
+	}
+	list_add_tail(&fi->precache_list, &sbi->precache_list);
+	spin_unlock(&sbi->precache_lock);
+
+	queue_work(system_unbound_wq, &sbi->precache_work);
+}
+
+/*
+ * Called before the superblock is killed, so that no inode stays pinned
+ * by the precache list when the VFS evicts inodes at umount.
+ */
+void f2fs_stop_precache_extents(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_inode_info *fi;
+	LIST_HEAD(pending);
+
+	spin_lock(&sbi->precache_lock);
+	list_splice_init(&sbi->precache_list, &pending);
+	spin_unlock(&sbi->precache_lock);
+
+	cancel_work_sync(&sbi->precache_work);
+
+	while (!list_empty(&pending)) {
+		fi = list_first_entry(&pending, struct f2fs_inode_info,
+							precache_list);
+		list_del_init(&fi->precache_list);
+		iput(&fi->vfs_inode);
+	}
+}
+
 void init_extent_cache_info(struct f2fs_sb_info *sbi)
 {
 	INIT_RADIX_TREE(&sbi->extent_tree_root, GFP_NOIO);
@@ -795,6 +941,13 @@ void init_extent_cache_info(struct f2fs_sb_info *sbi)
 	INIT_LIST_HEAD(&sbi->zombie_list);
 	atomic_set(&sbi->total_zombie_tree, 0);
 	atomic_set(&sbi->total_ext_node, 0);
+
+	INIT_LIST_HEAD(&sbi->precache_list);
+	spin_lock_init(&sbi->precache_lock);
+	INIT_WORK(&sbi->precache_work, f2fs_precache_extents_work);
+	sbi->precache_opens = 0;
+	sbi->max_extent_nodes = 0;
+	sbi->precached_files = 0;
 }
 
 int __init create_extent_cache(void)
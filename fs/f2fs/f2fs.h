@@ -238,6 +238,8 @@ enum {
 		(BATCHED_TRIM_SEGMENTS(sbi) << (sbi)->log_blocks_per_seg)
 #define MAX_DISCARD_BLOCKS(sbi)		BLKS_PER_SEC(sbi)
 #define DISCARD_ISSUE_RATE		8
+#define DEF_MIN_DISCARD_INTERVAL	20	/* 20 ms */
+#define DEF_MAX_DISCARD_INTERVAL	1000	/* 1 sec */
 #define DEF_CP_INTERVAL			60	/* 60 secs */
 #define DEF_IDLE_INTERVAL		5	/* 5 secs */
 
@@ -297,6 +299,20 @@ enum {
 	D_DONE,
 };
 
+/* discard issue policies */
+enum {
+	DPOLICY_BG,		/* background, only while the device is idle */
+	DPOLICY_FORCE,		/* umount, issue everything unconditionally */
+	MAX_DPOLICY,
+};
+
+struct discard_policy_stat {
+	unsigned long long nr_batches;	/* # of issue batches run */
+	unsigned long long nr_cmds;	/* # of discard commands issued */
+	unsigned long long nr_blks;	/* # of blocks discarded */
+	unsigned long long nr_paused;	/* # of batches deferred for I/O */
+};
+
 struct discard_info {
 	block_t lstart;			/* logical start address */
 	block_t len;			/* length */
@@ -336,6 +352,15 @@ struct discard_cmd_control {
 	atomic_t issing_discard;		/* # of issing discard */
 	atomic_t discard_cmd_cnt;		/* # of cached cmd count */
 	struct rb_root root;			/* root of discard rb-tree */
+
+	/* background issue policy, see issue_discard_thread() */
+	unsigned int max_merge_blks;		/* merge bound, device limit */
+	unsigned int discard_batch;		/* # of cmds issued per batch */
+	unsigned int discard_granularity;	/* min. blocks issued in bg */
+	unsigned int min_discard_interval;	/* ms between busy batches */
+	unsigned int max_discard_interval;	/* max. ms of back off */
+	unsigned long long nr_merged;		/* # of merged ranges */
+	struct discard_policy_stat stat[MAX_DPOLICY];	/* per policy */
 };
 
 /* for the list of fsync inodes, used only during recovery */
@@ -575,6 +600,7 @@ struct f2fs_map_blocks {
 #define F2FS_GET_BLOCK_BMAP		3
 #define F2FS_GET_BLOCK_PRE_DIO		4
 #define F2FS_GET_BLOCK_PRE_AIO		5
+#define F2FS_GET_BLOCK_PRECACHE		6
 
 /*
  * i_advise uses FADVISE_XXX_BIT. We can add additional hints later.
@@ -626,6 +652,8 @@ struct f2fs_inode_info {
 	struct task_struct *inmem_task;	/* store inmemory task */
 	struct mutex inmem_lock;	/* lock for inmemory pages */
 	struct extent_tree *extent_tree;	/* cached extent_tree entry */
+	struct list_head precache_list;	/* linked in extent precache list */
+	atomic_t read_opens;		/* # of read opens since precaching */
 	struct rw_semaphore dio_rwsem[2];/* avoid racing between dio and gc */
 	struct rw_semaphore i_mmap_sem;
 };
@@ -1043,6 +1071,16 @@ struct f2fs_sb_info {
 	struct list_head zombie_list;		/* extent zombie tree list */
 	atomic_t total_zombie_tree;		/* extent zombie tree count */
 	atomic_t total_ext_node;		/* extent info count */
+	struct percpu_counter ext_lookups;	/* # of extent cache lookups */
+	struct percpu_counter ext_hits;		/* # of extent cache hits */
+
+	/* for building full extent maps of frequently read files */
+	struct list_head precache_list;		/* inodes waiting for precache */
+	spinlock_t precache_lock;		/* locking precache list */
+	struct work_struct precache_work;	/* background precache work */
+	unsigned int precache_opens;		/* read opens to trigger, 0: off */
+	unsigned int max_extent_nodes;		/* extent node budget, 0: none */
+	unsigned int precached_files;		/* # of files precached */
 
 	/* basic filesystem units */
 	unsigned int log_sectors_per_block;	/* log2 sectors per block */
@@ -2794,6 +2832,8 @@ bool f2fs_lookup_extent_cache(struct inode *inode, pgoff_t pgofs,
 void f2fs_update_extent_cache(struct dnode_of_data *dn);
 void f2fs_update_extent_cache_range(struct dnode_of_data *dn,
 			pgoff_t fofs, block_t blkaddr, unsigned int len);
+void f2fs_precache_extents_open(struct inode *inode, struct file *filp);
+void f2fs_stop_precache_extents(struct f2fs_sb_info *sbi);
 void init_extent_cache_info(struct f2fs_sb_info *sbi);
 int __init create_extent_cache(void);
 void destroy_extent_cache(void);
@@ -462,6 +462,8 @@ static int f2fs_file_open(struct inode *inode, struct file *filp)
 		return -EPERM;
 	}
 	dput(dir);
+	if (!ret)
+		f2fs_precache_extents_open(inode, filp);
 	return ret;
 }
 
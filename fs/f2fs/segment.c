@@ -774,7 +774,7 @@ static int __blkdev_issue_discard(struct block_device *bdev, sector_t sector,
 {
 	struct request_queue *q = bdev_get_queue(bdev);
 	struct bio *bio = *biop;
-	unsigned int granularity;
+	unsigned int granularity, max_discard_sectors;
 	int op = REQ_WRITE | REQ_DISCARD;
 	int alignment;
 	sector_t bs_mask;
@@ -785,6 +785,11 @@ static int __blkdev_issue_discard(struct block_device *bdev, sector_t sector,
 	if (!blk_queue_discard(q))
 		return -EOPNOTSUPP;
 
+	/* the block layer here does not split discard bios for us */
+	max_discard_sectors = min(q->limits.max_discard_sectors, UINT_MAX >> 9);
+	if (!max_discard_sectors)
+		max_discard_sectors = UINT_MAX >> 9;
+
 	if (flags & BLKDEV_DISCARD_SECURE) {
 		if (!blk_queue_secdiscard(q))
 			return -EOPNOTSUPP;
@@ -804,7 +809,7 @@ static int __blkdev_issue_discard(struct block_device *bdev, sector_t sector,
 		sector_t end_sect, tmp;
 
 		/* Make sure bi_size doesn't overflow */
-		req_sects = min_t(sector_t, nr_sects, UINT_MAX >> 9);
+		req_sects = min_t(sector_t, nr_sects, max_discard_sectors);
 
 		/**
 		 * If splitting a request, and the next starting sector would be
@@ -1026,8 +1031,10 @@ static void __update_discard_tree_range(struct f2fs_sb_info *sbi,
 
 		if (prev_dc && prev_dc->state == D_PREP &&
 			prev_dc->bdev == bdev &&
+			prev_dc->len + di.len <= dcc->max_merge_blks &&
 			__is_discard_back_mergeable(&di, &prev_dc->di)) {
 			prev_dc->di.len += di.len;
+			dcc->nr_merged++;
 			dcc->undiscard_blks += di.len;
 			__relocate_discard_cmd(dcc, prev_dc);
 			di = prev_dc->di;
@@ -1037,7 +1044,9 @@ static void __update_discard_tree_range(struct f2fs_sb_info *sbi,
 
 		if (next_dc && next_dc->state == D_PREP &&
 			next_dc->bdev == bdev &&
+			next_dc->len + di.len <= dcc->max_merge_blks &&
 			__is_discard_front_mergeable(&di, &next_dc->di)) {
+			dcc->nr_merged++;
 			next_dc->di.lstart = di.lstart;
 			next_dc->di.len += di.len;
 			next_dc->di.start = di.start;
@@ -1080,32 +1089,83 @@ static int __queue_discard_cmd(struct f2fs_sb_info *sbi,
 	return 0;
 }
 
-static void __issue_discard_cmd(struct f2fs_sb_info *sbi, bool issue_cond)
+/*
+ * Whether background discards may be sent: no foreground request is
+ * allocated or in flight on the main device. Our own submitted discards
+ * are left out so that one batch does not make the next one look busy;
+ * a discard split into several requests still reads as busy, which only
+ * errs towards waiting. Called with cmd_lock held.
+ */
+static bool __discard_idle(struct f2fs_sb_info *sbi)
 {
 	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct block_device *bdev = sbi->sb->s_bdev;
+	struct request_queue *q = bdev_get_queue(bdev);
+	struct request_list *rl = &q->root_rl;
+	struct discard_cmd *dc;
+	unsigned int own = 0;
+
+	list_for_each_entry(dc, &dcc->wait_list, list)
+		if (dc->bdev == bdev && dc->state == D_SUBMIT)
+			own++;
+
+	if (rl->count[BLK_RW_SYNC] + rl->count[BLK_RW_ASYNC] > own ||
+			queue_in_flight(q) > own)
+		return false;
+
+	return f2fs_time_over(sbi, REQ_TIME);
+}
+
+/*
+ * Issue pending discards, largest first. With DPOLICY_BG at most
+ * discard_batch commands of at least discard_granularity blocks are sent,
+ * and only if no foreground I/O is on the queue when the batch starts.
+ * Returns the number of commands issued, or -EBUSY if the device was busy.
+ */
+static int __issue_discard_cmd(struct f2fs_sb_info *sbi, int type)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_policy_stat *stat = &dcc->stat[type];
 	struct list_head *pend_list;
 	struct discard_cmd *dc, *tmp;
 	struct blk_plug plug;
-	int i, iter = 0;
+	int i, min_idx = 0, issued = 0;
+	bool busy = false;
+
+	if (type == DPOLICY_BG && dcc->discard_granularity > 1)
+		min_idx = plist_idx(dcc->discard_granularity);
 
 	mutex_lock(&dcc->cmd_lock);
 	f2fs_bug_on(sbi,
 		!__check_rb_tree_consistence(sbi, &dcc->root));
+	stat->nr_batches++;
 	blk_start_plug(&plug);
-	for (i = MAX_PLIST_NUM - 1; i >= 0; i--) {
+	if (type == DPOLICY_BG && !__discard_idle(sbi)) {
+		busy = true;
+		goto out;
+	}
+	for (i = MAX_PLIST_NUM - 1; i >= min_idx; i--) {
 		pend_list = &dcc->pend_list[i];
 		list_for_each_entry_safe(dc, tmp, pend_list, list) {
 			f2fs_bug_on(sbi, dc->state != D_PREP);
 
-			if (!issue_cond || is_idle(sbi))
-				__submit_discard_cmd(sbi, dc);
-			if (issue_cond && iter++ > DISCARD_ISSUE_RATE)
+			if (type == DPOLICY_BG && issued >= dcc->discard_batch)
 				goto out;
+
+			stat->nr_blks += dc->len;
+			__submit_discard_cmd(sbi, dc);
+			issued++;
 		}
 	}
 out:
 	blk_finish_plug(&plug);
+	stat->nr_cmds += issued;
+	if (busy && !issued) {
+		stat->nr_paused++;
+		issued = -EBUSY;
+	}
 	mutex_unlock(&dcc->cmd_lock);
+	return issued;
 }
 
 static void __wait_one_discard_bio(struct f2fs_sb_info *sbi,
@@ -1189,15 +1249,23 @@ void stop_discard_thread(struct f2fs_sb_info *sbi)
 /* This comes from f2fs_put_super */
 void f2fs_wait_discard_bios(struct f2fs_sb_info *sbi)
 {
-	__issue_discard_cmd(sbi, false);
+	__issue_discard_cmd(sbi, DPOLICY_FORCE);
 	__wait_discard_cmd(sbi, false);
 }
 
+/*
+ * Discards are only sent while the device has no foreground requests.
+ * While it stays busy the thread backs off exponentially from
+ * min_discard_interval up to max_discard_interval, so a long burst of
+ * foreground I/O does not keep polling the queue.
+ */
 static int issue_discard_thread(void *data)
 {
 	struct f2fs_sb_info *sbi = data;
 	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
 	wait_queue_head_t *q = &dcc->discard_wait_queue;
+	unsigned int wait_ms = dcc->min_discard_interval;
+	int issued;
 
 	set_freezable();
 
@@ -1210,10 +1278,16 @@ static int issue_discard_thread(void *data)
 		if (kthread_should_stop())
 			return 0;
 
-		__issue_discard_cmd(sbi, true);
+		issued = __issue_discard_cmd(sbi, DPOLICY_BG);
 		__wait_discard_cmd(sbi, true);
 
-		congestion_wait(BLK_RW_SYNC, HZ/50);
+		if (issued <= 0)
+			wait_ms = min(wait_ms << 1, dcc->max_discard_interval);
+		else
+			wait_ms = dcc->min_discard_interval;
+
+		schedule_timeout_interruptible(
+				msecs_to_jiffies(max(wait_ms, 1U)));
 	} while (!kthread_should_stop());
 	return 0;
 }
@@ -1521,6 +1595,15 @@ static int create_discard_cmd_control(struct f2fs_sb_info *sbi)
 	dcc->undiscard_blks = 0;
 	dcc->root = RB_ROOT;
 
+	dcc->max_merge_blks = bdev_get_queue(sbi->sb->s_bdev)->
+		limits.max_discard_sectors >> sbi->log_sectors_per_block;
+	if (!dcc->max_merge_blks)
+		dcc->max_merge_blks = MAX_DISCARD_BLOCKS(sbi);
+	dcc->discard_batch = DISCARD_ISSUE_RATE;
+	dcc->discard_granularity = 1;
+	dcc->min_discard_interval = DEF_MIN_DISCARD_INTERVAL;
+	dcc->max_discard_interval = DEF_MAX_DISCARD_INTERVAL;
+
 	init_waitqueue_head(&dcc->discard_wait_queue);
 	SM_I(sbi)->dcc_info = dcc;
 init_thread:
@@ -104,8 +104,12 @@ unsigned long f2fs_shrink_scan(struct shrinker *shrink,
 
 		sbi->shrinker_run_no = run_no;
 
-		/* shrink extent cache entries */
-		freed += f2fs_shrink_extent_tree(sbi, nr >> 1);
+		/*
+		 * shrink extent cache entries, unless full extent maps are
+		 * being built; then they are the last thing to give back
+		 */
+		if (!sbi->precache_opens)
+			freed += f2fs_shrink_extent_tree(sbi, nr >> 1);
 
 		/* shrink clean nat cache entries */
 		if (freed < nr)
@@ -115,6 +119,9 @@ unsigned long f2fs_shrink_scan(struct shrinker *shrink,
 		if (freed < nr)
 			freed += try_to_free_nids(sbi, nr - freed);
 
+		if (sbi->precache_opens && freed < nr)
+			freed += f2fs_shrink_extent_tree(sbi, nr - freed);
+
 		spin_lock(&f2fs_list_lock);
 		p = p->next;
 		list_move_tail(&sbi->s_list, &f2fs_list);
@@ -407,6 +407,8 @@ static struct inode *f2fs_alloc_inode(struct super_block *sb)
 	INIT_LIST_HEAD(&fi->gdirty_list);
 	INIT_LIST_HEAD(&fi->inmem_pages);
 	mutex_init(&fi->inmem_lock);
+	INIT_LIST_HEAD(&fi->precache_list);
+	atomic_set(&fi->read_opens, 0);
 	init_rwsem(&fi->dio_rwsem[READ]);
 	init_rwsem(&fi->dio_rwsem[WRITE]);
 	init_rwsem(&fi->i_mmap_sem);
@@ -533,6 +535,8 @@ static void destroy_percpu_info(struct f2fs_sb_info *sbi)
 {
 	percpu_counter_destroy(&sbi->alloc_valid_block_count);
 	percpu_counter_destroy(&sbi->total_valid_inode_count);
+	percpu_counter_destroy(&sbi->ext_lookups);
+	percpu_counter_destroy(&sbi->ext_hits);
 }
 
 static void destroy_device_list(struct f2fs_sb_info *sbi)
@@ -1335,8 +1339,16 @@ static int init_percpu_info(struct f2fs_sb_info *sbi)
 	if (err)
 		return err;
 
-	return percpu_counter_init(&sbi->total_valid_inode_count, 0,
+	err = percpu_counter_init(&sbi->total_valid_inode_count, 0,
 								GFP_KERNEL);
+	if (err)
+		return err;
+
+	err = percpu_counter_init(&sbi->ext_lookups, 0, GFP_KERNEL);
+	if (err)
+		return err;
+
+	return percpu_counter_init(&sbi->ext_hits, 0, GFP_KERNEL);
 }
 
 #ifdef CONFIG_BLK_DEV_ZONED
@@ -1971,6 +1983,7 @@ static void kill_f2fs_super(struct super_block *sb)
 		set_sbi_flag(F2FS_SB(sb), SBI_IS_CLOSE);
 		stop_gc_thread(F2FS_SB(sb));
 		stop_discard_thread(F2FS_SB(sb));
+		f2fs_stop_precache_extents(F2FS_SB(sb));
 	}
 	kill_block_super(sb);
 }
@@ -75,6 +75,22 @@ static ssize_t lifetime_write_kbytes_show(struct f2fs_attr *a,
 			BD_PART_WRITTEN(sbi)));
 }
 
+static ssize_t extent_cache_hit_ratio_show(struct f2fs_attr *a,
+		struct f2fs_sb_info *sbi, char *buf)
+{
+	s64 lookups = percpu_counter_sum_positive(&sbi->ext_lookups);
+	s64 hits = percpu_counter_sum_positive(&sbi->ext_hits);
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+		lookups ? div64_u64(min(hits, lookups) * 100, lookups) : 0);
+}
+
+static ssize_t precached_files_show(struct f2fs_attr *a,
+		struct f2fs_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", sbi->precached_files);
+}
+
 static ssize_t f2fs_sbi_show(struct f2fs_attr *a,
 			struct f2fs_sb_info *sbi, char *buf)
 {
@@ -177,6 +193,13 @@ F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_no_gc_sleep_time, no_gc_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_idle, gc_idle);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, reclaim_segments, rec_prefree_segments);
 F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, max_small_discards, max_discards);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_batch, discard_batch);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_granularity,
+					discard_granularity);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, min_discard_interval,
+					min_discard_interval);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, max_discard_interval,
+					max_discard_interval);
 F2FS_RW_ATTR(RESERVED_BLOCKS, f2fs_sb_info, reserved_blocks, reserved_blocks);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, batched_trim_sections, trim_sections);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, ipu_policy, ipu_policy);
@@ -190,11 +213,15 @@ F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_victim_search, max_victim_search);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, dir_level, dir_level);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, cp_interval, interval_time[CP_TIME]);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, idle_interval, interval_time[REQ_TIME]);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, extent_precache_opens, precache_opens);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_extent_nodes, max_extent_nodes);
 #ifdef CONFIG_F2FS_FAULT_INJECTION
 F2FS_RW_ATTR(FAULT_INFO_RATE, f2fs_fault_info, inject_rate, inject_rate);
 F2FS_RW_ATTR(FAULT_INFO_TYPE, f2fs_fault_info, inject_type, inject_type);
 #endif
 F2FS_GENERAL_RO_ATTR(lifetime_write_kbytes);
+F2FS_GENERAL_RO_ATTR(extent_cache_hit_ratio);
+F2FS_GENERAL_RO_ATTR(precached_files);
 
 #define ATTR_LIST(name) (&f2fs_attr_##name.attr)
 static struct attribute *f2fs_attrs[] = {
@@ -204,6 +231,10 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(gc_idle),
 	ATTR_LIST(reclaim_segments),
 	ATTR_LIST(max_small_discards),
+	ATTR_LIST(discard_batch),
+	ATTR_LIST(discard_granularity),
+	ATTR_LIST(min_discard_interval),
+	ATTR_LIST(max_discard_interval),
 	ATTR_LIST(batched_trim_sections),
 	ATTR_LIST(ipu_policy),
 	ATTR_LIST(min_ipu_util),
@@ -216,11 +247,15 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(dirty_nats_ratio),
 	ATTR_LIST(cp_interval),
 	ATTR_LIST(idle_interval),
+	ATTR_LIST(extent_precache_opens),
+	ATTR_LIST(max_extent_nodes),
 #ifdef CONFIG_F2FS_FAULT_INJECTION
 	ATTR_LIST(inject_rate),
 	ATTR_LIST(inject_type),
 #endif
 	ATTR_LIST(lifetime_write_kbytes),
+	ATTR_LIST(extent_cache_hit_ratio),
+	ATTR_LIST(precached_files),
 	ATTR_LIST(reserved_blocks),
 	NULL,
 };
@@ -287,6 +322,35 @@ static int segment_bits_seq_show(struct seq_file *seq, void *offset)
 	return 0;
 }
 
+static int discard_stat_seq_show(struct seq_file *seq, void *offset)
+{
+	struct super_block *sb = seq->private;
+	struct f2fs_sb_info *sbi = F2FS_SB(sb);
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	static const char * const policy[MAX_DPOLICY] = {
+		[DPOLICY_BG]	= "background",
+		[DPOLICY_FORCE]	= "force",
+	};
+	int i;
+
+	if (!dcc)
+		return 0;
+
+	mutex_lock(&dcc->cmd_lock);
+	seq_printf(seq, "pending: %d cmds, %u blocks, merged: %llu, "
+			"max merge: %u blocks\n",
+			atomic_read(&dcc->discard_cmd_cnt),
+			dcc->undiscard_blks, dcc->nr_merged,
+			dcc->max_merge_blks);
+	seq_puts(seq, "format: policy|batches|cmds|blocks|paused\n");
+	for (i = 0; i < MAX_DPOLICY; i++)
+		seq_printf(seq, "%-10s %llu %llu %llu %llu\n", policy[i],
+				dcc->stat[i].nr_batches, dcc->stat[i].nr_cmds,
+				dcc->stat[i].nr_blks, dcc->stat[i].nr_paused);
+	mutex_unlock(&dcc->cmd_lock);
+	return 0;
+}
+
 #define F2FS_PROC_FILE_DEF(_name)					\
 static int _name##_open_fs(struct inode *inode, struct file *file)	\
 {									\
@@ -302,6 +366,7 @@ static const struct file_operations f2fs_seq_##_name##_fops = {		\
 
 F2FS_PROC_FILE_DEF(segment_info);
 F2FS_PROC_FILE_DEF(segment_bits);
+F2FS_PROC_FILE_DEF(discard_stat);
 
 int __init f2fs_register_sysfs(void)
 {
@@ -332,6 +397,8 @@ int f2fs_init_sysfs(struct f2fs_sb_info *sbi)
 				 &f2fs_seq_segment_info_fops, sb);
 		proc_create_data("segment_bits", S_IRUGO, sbi->s_proc,
 				 &f2fs_seq_segment_bits_fops, sb);
+		proc_create_data("discard_stat", S_IRUGO, sbi->s_proc,
+				 &f2fs_seq_discard_stat_fops, sb);
 	}
 
 	sbi->s_kobj.kset = f2fs_kset;
@@ -345,6 +412,7 @@ err_out:
 	if (sbi->s_proc) {
 		remove_proc_entry("segment_info", sbi->s_proc);
 		remove_proc_entry("segment_bits", sbi->s_proc);
+		remove_proc_entry("discard_stat", sbi->s_proc);
 		remove_proc_entry(sb->s_id, f2fs_proc_root);
 	}
 	return err;
@@ -359,6 +427,7 @@ void f2fs_exit_sysfs(struct f2fs_sb_info *sbi)
 	if (sbi->s_proc) {
 		remove_proc_entry("segment_info", sbi->s_proc);
 		remove_proc_entry("segment_bits", sbi->s_proc);
+		remove_proc_entry("discard_stat", sbi->s_proc);
 		remove_proc_entry(sbi->sb->s_id, f2fs_proc_root);
 	}
 }
@@ -504,6 +504,7 @@ struct mem_size_stats {
 	u64 pswap_zndswap;
 #endif
 	u64 swap_pss;
+	u64 pss_locked;		/* smaps_rollup only */
 };
 
 #ifdef CONFIG_SWAP
@@ -824,6 +825,221 @@ const struct file_operations proc_tid_smaps_operations = {
 	.release	= proc_map_release,
 };
 
+/*
+ * /proc/pid/smaps_rollup: the smaps counters summed over all mappings, from
+ * one pass over the page tables and without formatting every vma.
+ *
+ * With vm.smaps_rollup_cache_ms set, the totals are kept with the mm and
+ * handed out again while none of the rss counters, the number of mappings
+ * or the mapped size has changed and the result is younger than that many
+ * milliseconds. Pages faulted in and zapped in between, or the number of
+ * sharers of a page changing, go unnoticed until then, so Pss may be off
+ * by up to the age limit.
+ */
+int sysctl_smaps_rollup_cache_ms __read_mostly;
+
+enum {
+	SMAPS_ROLLUP_FILEPAGES,
+	SMAPS_ROLLUP_ANONPAGES,
+	SMAPS_ROLLUP_SWAPENTS,
+	SMAPS_ROLLUP_MAP_COUNT,
+	SMAPS_ROLLUP_TOTAL_VM,
+	NR_SMAPS_ROLLUP_KEYS,
+};
+
+struct smaps_rollup_cache {
+	spinlock_t lock;
+	unsigned long key[NR_SMAPS_ROLLUP_KEYS];
+	unsigned long stamp;	/* jiffies */
+	unsigned long start;
+	unsigned long end;
+	struct mem_size_stats mss;
+};
+
+static void smaps_rollup_key(struct mm_struct *mm, unsigned long *key)
+{
+	key[SMAPS_ROLLUP_FILEPAGES] = get_mm_counter(mm, MM_FILEPAGES);
+	key[SMAPS_ROLLUP_ANONPAGES] = get_mm_counter(mm, MM_ANONPAGES);
+	key[SMAPS_ROLLUP_SWAPENTS] = get_mm_counter(mm, MM_SWAPENTS);
+	key[SMAPS_ROLLUP_MAP_COUNT] = mm->map_count;
+	key[SMAPS_ROLLUP_TOTAL_VM] = mm->total_vm;
+}
+
+static bool smaps_rollup_lookup(struct mm_struct *mm, unsigned long *key,
+				struct mem_size_stats *mss,
+				unsigned long *start, unsigned long *end)
+{
+	struct smaps_rollup_cache *cache = ACCESS_ONCE(mm->smaps_rollup);
+	unsigned long max_age = msecs_to_jiffies(sysctl_smaps_rollup_cache_ms);
+	bool hit = false;
+
+	if (!cache)
+		return false;
+
+	spin_lock(&cache->lock);
+	if (time_before(jiffies, cache->stamp + max_age) &&
+	    !memcmp(cache->key, key, sizeof(cache->key))) {
+		*mss = cache->mss;
+		*start = cache->start;
+		*end = cache->end;
+		hit = true;
+	}
+	spin_unlock(&cache->lock);
+
+	return hit;
+}
+
+static void smaps_rollup_store(struct mm_struct *mm, unsigned long *key,
+			       struct mem_size_stats *mss,
+			       unsigned long start, unsigned long end)
+{
+	struct smaps_rollup_cache *cache = ACCESS_ONCE(mm->smaps_rollup);
+
+	if (!cache) {
+		struct smaps_rollup_cache *old;
+
+		cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+		if (!cache)
+			return;
+		spin_lock_init(&cache->lock);
+		/* readers only hold mmap_sem for read, one of them wins */
+		old = cmpxchg(&mm->smaps_rollup, NULL, cache);
+		if (old) {
+			kfree(cache);
+			cache = old;
+		}
+	}
+
+	spin_lock(&cache->lock);
+	memcpy(cache->key, key, sizeof(cache->key));
+	cache->stamp = jiffies;
+	cache->start = start;
+	cache->end = end;
+	cache->mss = *mss;
+	spin_unlock(&cache->lock);
+}
+
+static int show_smaps_rollup(struct seq_file *m, void *v)
+{
+	struct mm_struct *mm = m->private;
+	struct vm_area_struct *vma;
+	struct mem_size_stats mss;
+	struct mm_walk smaps_walk = {
+		.pmd_entry = smaps_pte_range,
+		.mm = mm,
+		.private = &mss,
+	};
+	unsigned long key[NR_SMAPS_ROLLUP_KEYS];
+	unsigned long start = 0, end = 0;
+	bool cached = sysctl_smaps_rollup_cache_ms > 0;
+
+	if (!mm || !atomic_inc_not_zero(&mm->mm_users))
+		return 0;
+
+	memset(&mss, 0, sizeof(mss));
+	down_read(&mm->mmap_sem);
+	smaps_rollup_key(mm, key);
+	if (cached && smaps_rollup_lookup(mm, key, &mss, &start, &end))
+		goto out;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		u64 pss = mss.pss;
+
+		if (vma == mm->mmap)
+			start = vma->vm_start;
+		end = vma->vm_end;
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		mss.vma = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &smaps_walk);
+		if (vma->vm_flags & VM_LOCKED)
+			mss.pss_locked += mss.pss - pss;
+	}
+	mss.vma = NULL;
+
+	if (cached)
+		smaps_rollup_store(mm, key, &mss, start, end);
+out:
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	seq_setwidth(m, 25 + sizeof(void *) * 6 - 1);
+	seq_printf(m, "%08lx-%08lx ---p 00000000 00:00 0 ", start, end);
+	seq_pad(m, ' ');
+	seq_puts(m, "[rollup]\n");
+
+	seq_printf(m,
+		   "Rss:            %8lu kB\n"
+		   "Pss:            %8lu kB\n"
+		   "Shared_Clean:   %8lu kB\n"
+		   "Shared_Dirty:   %8lu kB\n"
+		   "Private_Clean:  %8lu kB\n"
+		   "Private_Dirty:  %8lu kB\n"
+		   "Referenced:     %8lu kB\n"
+		   "Anonymous:      %8lu kB\n"
+		   "AnonHugePages:  %8lu kB\n"
+		   "Swap:           %8lu kB\n"
+#ifdef CONFIG_SWAP
+		   "PSwap:          %8lu kB\n"
+#endif
+#ifdef CONFIG_ZNDSWAP
+		   "PSwap_zndswap:  %8lu kB\n"
+#endif
+		   "SwapPss:        %8lu kB\n"
+		   "Locked:         %8lu kB\n",
+		   mss.resident >> 10,
+		   (unsigned long)(mss.pss >> (10 + PSS_SHIFT)),
+		   mss.shared_clean  >> 10,
+		   mss.shared_dirty  >> 10,
+		   mss.private_clean >> 10,
+		   mss.private_dirty >> 10,
+		   mss.referenced >> 10,
+		   mss.anonymous >> 10,
+		   mss.anonymous_thp >> 10,
+		   mss.swap >> 10,
+#ifdef CONFIG_SWAP
+		   (unsigned long)(mss.pswap >> (10 + PSS_SHIFT)),
+#endif
+#ifdef CONFIG_ZNDSWAP
+		   (unsigned long)(mss.pswap_zndswap >> (10 + PSS_SHIFT)),
+#endif
+		   (unsigned long)(mss.swap_pss >> (10 + PSS_SHIFT)),
+		   (unsigned long)(mss.pss_locked >> (10 + PSS_SHIFT)));
+
+	return 0;
+}
+
+static int smaps_rollup_open(struct inode *inode, struct file *file)
+{
+	struct mm_struct *mm = proc_mem_open(inode, PTRACE_MODE_READ);
+	int ret;
+
+	if (IS_ERR(mm))
+		return PTR_ERR(mm);
+
+	ret = single_open(file, show_smaps_rollup, mm);
+	if (ret && mm)
+		mmdrop(mm);
+	return ret;
+}
+
+static int smaps_rollup_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *seq = file->private_data;
+	struct mm_struct *mm = seq->private;
+
+	if (mm)
+		mmdrop(mm);
+	return single_release(inode, file);
+}
+
+const struct file_operations proc_pid_smaps_rollup_operations = {
+	.open		= smaps_rollup_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= smaps_rollup_release,
+};
+
 /*
  * We do not want to have constant page-shift bits sitting in
  * pagemap entries and are about to reuse them some time soon.
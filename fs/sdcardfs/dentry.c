@@ -118,6 +118,8 @@ static int sdcardfs_d_revalidate(struct dentry *dentry, unsigned int flags)
 		if (!data || data->abandoned) {
 			d_drop(dentry);
 			err = 0;
+		} else if (derived_state_stale(data)) {
+			revalidate_derived_permission(dentry);
 		}
 		if (data)
 			data_put(data);
@@ -68,6 +68,12 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	struct qstr q_obb = QSTR_LITERAL("obb");
 	struct qstr q_media = QSTR_LITERAL("media");
 	struct qstr q_cache = QSTR_LITERAL("cache");
+	int gen = atomic_read(&packagelist_gen);
+
+	/* Pairs with the barrier in packagelist_changed(): a package list
+	 * update racing with us leaves a stale gen behind, not a stale d_uid.
+	 */
+	smp_rmb();
 
 	/* By default, each inode inherits from its parent.
 	 * the properties are maintained on its private fields
@@ -78,6 +84,7 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	 */
 
 	inherit_derived_state(parent->d_inode, dentry->d_inode);
+	info->data->gen = gen;
 
 	/* Files don't get special labels */
 	if (!S_ISDIR(dentry->d_inode->i_mode))
@@ -347,6 +354,43 @@ inline void update_derived_permission_lock(struct dentry *dentry)
 	fixup_tmp_permissions(dentry->d_inode);
 }
 
+/* Lazy counterpart of fixup_perms_recursive(), used once the package list
+ * has changed: walk up from dentry to the package directory its top data
+ * belongs to and derive that directory's state again.
+ */
+void revalidate_derived_permission(struct dentry *dentry)
+{
+	struct sdcardfs_inode_data *top;
+	struct dentry *cur, *parent;
+
+	if (!dentry->d_inode)
+		return;
+	top = top_data_get(SDCARDFS_I(dentry->d_inode));
+	if (!top)
+		return;
+	if (!derived_state_stale(top)) {
+		data_put(top);
+		return;
+	}
+
+	cur = dget(dentry);
+	while (!IS_ROOT(cur) && cur->d_inode &&
+			SDCARDFS_I(cur->d_inode)->data != top) {
+		parent = dget_parent(cur);
+		dput(cur);
+		cur = parent;
+	}
+	if (!IS_ROOT(cur) && cur->d_inode &&
+			SDCARDFS_I(cur->d_inode)->data == top) {
+		parent = dget_parent(cur);
+		get_derived_permission(parent, cur);
+		fixup_tmp_permissions(cur->d_inode);
+		dput(parent);
+	}
+	dput(cur);
+	data_put(top);
+}
+
 int need_graft_path(struct dentry *dentry)
 {
 	int ret = 0;
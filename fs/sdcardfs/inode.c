@@ -626,6 +626,24 @@ static int sdcardfs_permission(struct vfsmount *mnt, struct inode *inode, int ma
 	if (!top)
 		return -EINVAL;
 
+	/*
+	 * The package list changed since top was derived. Lookups through
+	 * it revalidate it, but an open directory or cwd below it does not.
+	 */
+	if (derived_state_stale(top)) {
+		struct dentry *dentry;
+
+		if (mask & MAY_NOT_BLOCK) {
+			data_put(top);
+			return -ECHILD;
+		}
+		dentry = d_find_alias(inode);
+		if (dentry) {
+			revalidate_derived_permission(dentry);
+			dput(dentry);
+		}
+	}
+
 	/*
 	 * Permission check on sdcardfs inode.
 	 * Calling process should have AID_SDCARD_RW permission
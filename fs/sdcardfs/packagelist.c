@@ -45,6 +45,19 @@ static DEFINE_HASHTABLE(ext_to_groupid, 8);
 
 static struct kmem_cache *hashtable_entry_cachep;
 
+/*
+ * Bumped on every change of the package list. Package directories remember
+ * the generation they were derived at and are derived again on their next
+ * use once it moves on, see revalidate_derived_permission().
+ */
+atomic_t packagelist_gen = ATOMIC_INIT(0);
+
+/*
+ * In lazy mode a package list change only bumps packagelist_gen instead of
+ * walking every mounted tree under sdcardfs_super_list_lock.
+ */
+static bool lazy_fixup;
+
 static unsigned int full_name_case_hash(const unsigned char *name, unsigned int len)
 {
 	unsigned long hash = init_name_hash();
@@ -250,6 +263,15 @@ static int insert_userid_exclude_entry_locked(const struct qstr *key, userid_t v
 	return 0;
 }
 
+/* returns true if the eager fixup of the mounted trees can be skipped */
+static bool packagelist_changed(void)
+{
+	/* publish the hashtable update before the new generation */
+	smp_mb__before_atomic();
+	atomic_inc(&packagelist_gen);
+	return READ_ONCE(lazy_fixup);
+}
+
 static void fixup_all_perms_name(const struct qstr *key)
 {
 	struct sdcardfs_sb_info *sbinfo;
@@ -257,6 +279,9 @@ static void fixup_all_perms_name(const struct qstr *key)
 		.flags = BY_NAME,
 		.name = QSTR_INIT(key->name, key->len),
 	};
+
+	if (packagelist_changed())
+		return;
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo_has_sdcard_magic(sbinfo))
 			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
@@ -271,6 +296,9 @@ static void fixup_all_perms_name_userid(const struct qstr *key, userid_t userid)
 		.name = QSTR_INIT(key->name, key->len),
 		.userid = userid,
 	};
+
+	if (packagelist_changed())
+		return;
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo_has_sdcard_magic(sbinfo))
 			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
@@ -284,6 +312,9 @@ static void fixup_all_perms_userid(userid_t userid)
 		.flags = BY_USERID,
 		.userid = userid,
 	};
+
+	if (packagelist_changed())
+		return;
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo_has_sdcard_magic(sbinfo))
 			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
@@ -793,12 +824,34 @@ static ssize_t packages_remove_userid_store(struct packages *packages,
 	return count;
 }
 
+static ssize_t packages_lazy_fixup_show(struct packages *packages,
+					char *page)
+{
+	return scnprintf(page, PAGE_SIZE, "%d\n", READ_ONCE(lazy_fixup));
+}
+
+static ssize_t packages_lazy_fixup_store(struct packages *packages,
+				       const char *page, size_t count)
+{
+	bool tmp;
+	int ret;
+
+	ret = strtobool(page, &tmp);
+	if (ret)
+		return ret;
+	WRITE_ONCE(lazy_fixup, tmp);
+	return count;
+}
+
 struct packages_attribute packages_attr_packages_gid_list = __CONFIGFS_ATTR_RO(packages_gid.list, packages_list_show);
 PACKAGES_ATTR(remove_userid, S_IWUGO, NULL, packages_remove_userid_store);
+PACKAGES_ATTR(lazy_fixup, S_IRUGO | S_IWUSR, packages_lazy_fixup_show,
+		packages_lazy_fixup_store);
 
 static struct configfs_attribute *packages_attrs[] = {
 	&packages_attr_packages_gid_list.attr,
 	&packages_attr_remove_userid.attr,
+	&packages_attr_lazy_fixup.attr,
 	NULL,
 };
 
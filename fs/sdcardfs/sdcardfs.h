@@ -192,6 +192,8 @@ struct sdcardfs_inode_data {
 	bool under_android;
 	bool under_cache;
 	bool under_obb;
+	/* packagelist_gen this state was derived at */
+	int gen;
 };
 
 /* sdcardfs inode data in memory */
@@ -411,6 +413,19 @@ static inline void set_top(struct sdcardfs_inode_info *info,
 		data_put(old_top);
 }
 
+extern atomic_t packagelist_gen;
+
+/*
+ * Only package directories derive their state from the package list; their
+ * subtrees use them as top. Returns true if that state predates the last
+ * package list change.
+ */
+static inline bool derived_state_stale(struct sdcardfs_inode_data *data)
+{
+	return data->perm == PERM_ANDROID_PACKAGE &&
+		data->gen != atomic_read(&packagelist_gen);
+}
+
 static inline int get_gid(struct vfsmount *mnt,
 		struct sdcardfs_inode_data *data)
 {
@@ -519,6 +534,7 @@ extern void get_derived_permission_new(struct dentry *parent, struct dentry *den
 extern void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit);
 
 extern void update_derived_permission_lock(struct dentry *dentry);
+extern void revalidate_derived_permission(struct dentry *dentry);
 void fixup_lower_ownership(struct dentry *dentry, const char *name);
 extern int need_graft_path(struct dentry *dentry);
 extern int is_base_obbpath(struct dentry *dentry);
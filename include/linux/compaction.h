@@ -28,6 +28,10 @@ extern int sysctl_compaction_handler(struct ctl_table *table, int write,
 extern int sysctl_extfrag_threshold;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
+extern int sysctl_compaction_proactive_orders;
+extern int sysctl_compaction_proactive_threshold;
+extern int sysctl_compaction_proactive_interval;
+extern int sysctl_compaction_proactive_batch;
 
 extern int fragmentation_index(struct zone *zone, unsigned int order);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
@@ -35,6 +39,9 @@ extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			enum migrate_mode mode, int *contended,
 			struct zone **candidate_zone);
 extern void compact_pgdat(pg_data_t *pgdat, int order);
+extern int kcompactd_run(int nid);
+extern void kcompactd_stop(int nid);
+extern void wakeup_kcompactd(pg_data_t *pgdat, int order);
 extern void reset_isolation_suitable(pg_data_t *pgdat);
 extern unsigned long compaction_suitable(struct zone *zone, int order);
 
@@ -112,6 +119,19 @@ static inline void compact_pgdat(pg_data_t *pgdat, int order)
 {
 }
 
+static inline int kcompactd_run(int nid)
+{
+	return 0;
+}
+
+static inline void kcompactd_stop(int nid)
+{
+}
+
+static inline void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+}
+
 static inline void reset_isolation_suitable(pg_data_t *pgdat)
 {
 }
@@ -2211,6 +2211,10 @@ int drop_caches_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
 #endif
 
+#ifdef CONFIG_PROC_PAGE_MONITOR
+extern int sysctl_smaps_rollup_cache_ms;
+#endif
+
 unsigned long shrink_slab(struct shrink_control *shrink,
 			  unsigned long nr_pages_scanned,
 			  unsigned long lru_pages);
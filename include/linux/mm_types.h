@@ -307,6 +307,10 @@ struct vm_area_struct {
 	struct file * vm_file;		/* File we map to (can be NULL). */
 	void * vm_private_data;		/* was vm_pte (shared mem) */
 
+#ifdef CONFIG_SWAP
+	/* last swap fault address, readahead window and hits, see swap_state.c */
+	atomic_long_t swap_readahead_info;
+#endif
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
 #endif
@@ -347,6 +351,7 @@ struct mm_rss_stat {
 };
 
 struct kioctx_table;
+struct smaps_rollup_cache;
 struct mm_struct {
 	struct vm_area_struct *mmap;		/* list of VMAs */
 	struct rb_root mm_rb;
@@ -459,6 +464,10 @@ struct mm_struct {
 	bool tlb_flush_pending;
 #endif
 	struct uprobes_state uprobes_state;
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	/* last /proc/pid/smaps_rollup result, see fs/proc/task_mmu.c */
+	struct smaps_rollup_cache *smaps_rollup;
+#endif
 };
 
 static inline void mm_init_cpumask(struct mm_struct *mm)
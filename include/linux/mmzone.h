@@ -218,6 +218,11 @@ struct zone_reclaim_stat {
 struct lruvec {
 	struct list_head lists[NR_LRU_LISTS];
 	struct zone_reclaim_stat reclaim_stat;
+	/* file refaults, see lruvec_file_protect() in vmscan.c */
+	atomic_long_t refaults;
+	unsigned long refault_avg;
+	unsigned long refault_stamp;
+	unsigned int file_protect;
 #ifdef CONFIG_MEMCG
 	struct zone *zone;
 #endif
@@ -761,6 +766,12 @@ typedef struct pglist_data {
 					   mem_hotplug_begin/end() */
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;	/* Protected by
+					   mem_hotplug_begin/end() */
+	int kcompactd_max_order;	/* order of a pending wakeup */
+#endif
 #ifdef CONFIG_NUMA_BALANCING
 	/* Lock serializing the migrate rate limiting window */
 	spinlock_t numabalancing_migrate_lock;
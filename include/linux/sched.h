@@ -469,6 +469,7 @@ static inline int get_dumpable(struct mm_struct *mm)
 
 #define MMF_HAS_UPROBES		19	/* has uprobes */
 #define MMF_RECALC_UPROBES	20	/* MMF_HAS_UPROBES can be wrong */
+#define MMF_OOM_REAPED		21	/* private memory zapped by oom_reaper */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -1331,14 +1332,19 @@ enum perf_event_task_context {
 };
 
 #ifdef CONFIG_MTK_SCHED_CMP_TGS
+/*
+ * The group leader keeps one of these per CPU. A CPU's slot is only
+ * written under its runqueue lock, so enqueue and dequeue need no lock
+ * of their own. tg_info_fold() sums the slots of a cluster for readers.
+ */
 struct thread_group_info_t {
-	/* # of cfs threas in the thread group per cluster*/
+	/* # of cfs threas in the thread group per cpu */
 	unsigned long cfs_nr_running;
-	/* # of threads in the thread group per cluster */
+	/* # of threads in the thread group per cpu */
 	unsigned long nr_running;
-	/* runnable contrib of the thread group per cluster */
+	/* runnable contrib of the thread group per cpu */
 	unsigned long loadwop_avg_contrib;
-};
+} ____cacheline_aligned_in_smp;
 
 #endif
 
@@ -1483,8 +1489,7 @@ struct task_struct {
 	struct task_struct *group_leader;	/* threadgroup leader */
 
 #ifdef CONFIG_MTK_SCHED_CMP_TGS
-	raw_spinlock_t thread_group_info_lock;
-	struct thread_group_info_t *thread_group_info;
+	struct thread_group_info_t *thread_group_info;	/* nr_cpu_ids slots */
 #endif
 
 	/*
@@ -1745,6 +1750,12 @@ struct task_struct {
 
 	struct page_frag task_frag;
 
+#ifdef CONFIG_MMU
+	/* see wake_oom_reaper() */
+	struct task_struct *oom_reaper_list;
+	u64 oom_reaper_queued;	/* ns, 0 if not queued */
+#endif
+
 #ifdef	CONFIG_TASK_DELAY_ACCT
 	struct task_delay_info *delays;
 #endif
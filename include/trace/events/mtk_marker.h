@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2015 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mtk_marker
+
+#if !defined(_TRACE_MTK_MARKER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MTK_MARKER_H
+
+#include <linux/tracepoint.h>
+
+#ifndef _MTK_MARKER_PRINT
+#define _MTK_MARKER_PRINT
+const char *mtk_marker_print(struct trace_seq *p, char type, int tgid,
+			     u32 id, int value);
+#endif
+
+/*
+ * Binary form of the kernel marker, printed in the same "B|tgid|name",
+ * "C|tgid|name|value" and "E" format trace_marker writes use, so that
+ * systrace parses it unchanged. id refers to a name announced by
+ * tracing_mark_name.
+ */
+TRACE_EVENT(tracing_mark_write,
+
+	TP_PROTO(char type, int tgid, u32 id, int value),
+
+	TP_ARGS(type, tgid, id, value),
+
+	TP_STRUCT__entry(
+		__field(char, type)
+		__field(int, tgid)
+		__field(u32, id)
+		__field(int, value)
+	),
+
+	TP_fast_assign(
+		__entry->type = type;
+		__entry->tgid = tgid;
+		__entry->id = id;
+		__entry->value = value;
+	),
+
+	TP_printk("%s", mtk_marker_print(p, __entry->type, __entry->tgid,
+					 __entry->id, __entry->value))
+);
+
+/* Interned marker name, recorded once per buffer before its first use */
+TRACE_EVENT(tracing_mark_name,
+
+	TP_PROTO(u32 id, const char *name),
+
+	TP_ARGS(id, name),
+
+	TP_STRUCT__entry(
+		__field(u32, id)
+		__string(name, name)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__assign_str(name, name);
+	),
+
+	TP_printk("id=%u name=%s", __entry->id, __get_str(name))
+);
+
+#endif /* _TRACE_MTK_MARKER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -197,10 +197,7 @@ void thread_info_cache_init(void)
  */
 static inline struct thread_group_info_t *alloc_thread_group_info_node(struct task_struct *tsk, int node)
 {
-	int num_cluster;
-
-	num_cluster = arch_get_nr_clusters();
-	return kmalloc(sizeof(struct thread_group_info_t) * num_cluster, GFP_KERNEL);
+	return kmalloc(sizeof(struct thread_group_info_t) * nr_cpu_ids, GFP_KERNEL);
 }
 
 static inline void free_thread_group_info(struct thread_group_info_t *tg)
@@ -417,6 +414,10 @@ static struct task_struct *dup_task_struct(struct task_struct *orig)
 #endif
 	tsk->splice_pipe = NULL;
 	tsk->task_frag.page = NULL;
+#ifdef CONFIG_MMU
+	tsk->oom_reaper_list = NULL;
+	tsk->oom_reaper_queued = 0;
+#endif
 
 	account_kernel_stack(ti, 1);
 
@@ -644,6 +645,9 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p)
 #if defined(CONFIG_TRANSPARENT_HUGEPAGE) && !USE_SPLIT_PMD_PTLOCKS
 	mm->pmd_huge_pte = NULL;
 #endif
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	mm->smaps_rollup = NULL;
+#endif
 
 	if (current->mm) {
 		mm->flags = current->mm->flags & MMF_INIT_MASK;
@@ -711,6 +715,9 @@ void __mmdrop(struct mm_struct *mm)
 	destroy_context(mm);
 	mmu_notifier_mm_destroy(mm);
 	check_mm(mm);
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	kfree(mm->smaps_rollup);
+#endif
 	free_mm(mm);
 }
 EXPORT_SYMBOL_GPL(__mmdrop);
@@ -1253,12 +1260,9 @@ init_task_pid(struct task_struct *task, enum pid_type type, struct pid *pid)
 #ifdef CONFIG_MTK_SCHED_CMP_TGS
 static void mt_init_thread_group(struct task_struct *p)
 {
-	int i, num_cluster;
-
-	raw_spin_lock_init(&p->thread_group_info_lock);
-	num_cluster = arch_get_nr_clusters();
+	int i;
 
-	for (i = 0; i < num_cluster; i++) {
+	for (i = 0; i < nr_cpu_ids; i++) {
 		p->thread_group_info[i].cfs_nr_running = 0;
 		p->thread_group_info[i].nr_running = 0;
 		p->thread_group_info[i].loadwop_avg_contrib = 0;
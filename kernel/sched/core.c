@@ -849,6 +849,7 @@ static void set_load_weight(struct task_struct *p)
 static void tgs_log(struct rq *rq, struct task_struct *p)
 {
 	struct task_struct *tg = p->group_leader;
+	struct thread_group_info_t info;
 	int i, num_cluster;
 
 	if (group_leader_is_empty(p))
@@ -859,30 +860,25 @@ static void tgs_log(struct rq *rq, struct task_struct *p)
 	mt_sched_printf(sched_cmp, "%d:%s %d:%s ", tg->pid, tg->comm, p->pid, p->comm);
 
 	for (i = 0; i < num_cluster; i++) {
+		tg_info_fold(tg, i, &info);
 		mt_sched_printf(sched_cmp, "cluster %d: %lu %lu %lu ",
 			i,
-			tg->thread_group_info[i].nr_running,
-			tg->thread_group_info[i].cfs_nr_running,
-			tg->thread_group_info[i].loadwop_avg_contrib);
+			info.nr_running,
+			info.cfs_nr_running,
+			info.loadwop_avg_contrib);
 	}
 }
 #endif /* CONFIG_MT_SCHED_TRACE_DETAIL */
 
+/* rq->lock serializes the updates of this cpu's slot */
 static void sched_tg_enqueue(struct rq *rq, struct task_struct *p)
 {
-	int id;
-	unsigned long flags;
 	struct task_struct *tg = p->group_leader;
 
 	if (group_leader_is_empty(p))
 		return;
-	id = arch_get_cluster_id(rq->cpu);
-	if (unlikely(WARN_ON(id < 0)))
-		return;
 
-	raw_spin_lock_irqsave(&tg->thread_group_info_lock, flags);
-	tg->thread_group_info[id].nr_running++;
-	raw_spin_unlock_irqrestore(&tg->thread_group_info_lock, flags);
+	tg->thread_group_info[rq->cpu].nr_running++;
 
 #ifdef CONFIG_MT_SCHED_TRACE_DETAIL
 	tgs_log(rq, p);
@@ -891,20 +887,13 @@ static void sched_tg_enqueue(struct rq *rq, struct task_struct *p)
 
 static void sched_tg_dequeue(struct rq *rq, struct task_struct *p)
 {
-	int id;
-	unsigned long flags;
 	struct task_struct *tg = p->group_leader;
 
 	if (group_leader_is_empty(p))
 		return;
-	id = arch_get_cluster_id(rq->cpu);
-	if (unlikely(WARN_ON(id < 0)))
-		return;
 
-	raw_spin_lock_irqsave(&tg->thread_group_info_lock, flags);
-	/* WARN_ON(!tg->thread_group_info[id].nr_running); */
-	tg->thread_group_info[id].nr_running--;
-	raw_spin_unlock_irqrestore(&tg->thread_group_info_lock, flags);
+	/* WARN_ON(!tg->thread_group_info[rq->cpu].nr_running); */
+	tg->thread_group_info[rq->cpu].nr_running--;
 
 #ifdef CONFIG_MT_SCHED_TRACE_DETAIL
 	tgs_log(rq, p);
@@ -2844,12 +2844,37 @@ int group_leader_is_empty(struct task_struct *p)
 	return 0;
 }
 
+/*
+ * Sum the per-cpu slots of @tg's thread group over a cluster. The slots
+ * are read without their runqueue locks, like the per-cluster counters
+ * were, so the result is a snapshot that may be slightly stale.
+ */
+void tg_info_fold(struct task_struct *tg, int cluster_id,
+		  struct thread_group_info_t *info)
+{
+	struct thread_group_info_t *slot;
+	struct cpumask cls_cpus;
+	int cpu;
+
+	info->cfs_nr_running = 0;
+	info->nr_running = 0;
+	info->loadwop_avg_contrib = 0;
+
+	arch_get_cluster_cpus(&cls_cpus, cluster_id);
+	for_each_cpu(cpu, &cls_cpus) {
+		slot = &tg->thread_group_info[cpu];
+		info->cfs_nr_running += READ_ONCE(slot->cfs_nr_running);
+		info->nr_running += READ_ONCE(slot->nr_running);
+		info->loadwop_avg_contrib += READ_ONCE(slot->loadwop_avg_contrib);
+	}
+}
+
 static inline void update_tg_info(struct cfs_rq *cfs_rq, struct sched_entity *se, long ratio_delta)
 {
 	struct task_struct *p = task_of(se);
 	struct task_struct *tg;
-	int id;
-	unsigned long flags;
+	struct thread_group_info_t *slot;
+	int cpu;
 
 	if (!entity_is_task(se))
 		return;
@@ -2859,21 +2884,17 @@ static inline void update_tg_info(struct cfs_rq *cfs_rq, struct sched_entity *se
 
 	tg = p->group_leader;
 
-	id = arch_get_cluster_id(cpu_of(rq_of(cfs_rq)));
-	if (unlikely(WARN_ON(id < 0)))
-		return;
-
-	raw_spin_lock_irqsave(&tg->thread_group_info_lock, flags);
-	tg->thread_group_info[id].loadwop_avg_contrib += ratio_delta;
-	raw_spin_unlock_irqrestore(&tg->thread_group_info_lock, flags);
+	/* serialized by the lock of the rq cfs_rq belongs to */
+	cpu = cpu_of(rq_of(cfs_rq));
+	slot = &tg->thread_group_info[cpu];
+	slot->loadwop_avg_contrib += ratio_delta;
 
-	mt_sched_printf(sched_cmp_info, "[%s] %d:%s %d:%s %ld %ld %d %d %lu:%lu:%lu update", __func__,
+	mt_sched_printf(sched_cmp_info, "[%s] %d:%s %d:%s %ld %ld %d %lu:%lu:%lu update", __func__,
 	   tg->pid, tg->comm, p->pid, p->comm,
-	   se->avg.loadwop_avg_contrib, ratio_delta,
-	   cfs_rq->rq->cpu, id,
-	   tg->thread_group_info[id].nr_running,
-	   tg->thread_group_info[id].cfs_nr_running,
-	   tg->thread_group_info[id].loadwop_avg_contrib);
+	   se->avg.loadwop_avg_contrib, ratio_delta, cpu,
+	   slot->nr_running,
+	   slot->cfs_nr_running,
+	   slot->loadwop_avg_contrib);
 }
 #endif
 
@@ -4409,38 +4430,25 @@ unsigned int cmp_down_threshold = 256;
 #endif /* CONFIG_MTK_SCHED_CMP */
 
 #ifdef CONFIG_MTK_SCHED_CMP_TGS
+/* rq->lock serializes the updates of this cpu's slot */
 static void sched_tg_enqueue_fair(struct rq *rq, struct task_struct *p)
 {
-	int id;
-	unsigned long flags;
 	struct task_struct *tg = p->group_leader;
 
 	if (group_leader_is_empty(p))
 		return;
-	id = arch_get_cluster_id(rq->cpu);
-	if (unlikely(WARN_ON(id < 0)))
-		return;
 
-	raw_spin_lock_irqsave(&tg->thread_group_info_lock, flags);
-	tg->thread_group_info[id].cfs_nr_running++;
-	raw_spin_unlock_irqrestore(&tg->thread_group_info_lock, flags);
+	tg->thread_group_info[rq->cpu].cfs_nr_running++;
 }
 
 static void sched_tg_dequeue_fair(struct rq *rq, struct task_struct *p)
 {
-	int id;
-	unsigned long flags;
 	struct task_struct *tg = p->group_leader;
 
 	if (group_leader_is_empty(p))
 		return;
-	id = arch_get_cluster_id(rq->cpu);
-	if (unlikely(WARN_ON(id < 0)))
-		return;
 
-	raw_spin_lock_irqsave(&tg->thread_group_info_lock, flags);
-	tg->thread_group_info[id].cfs_nr_running--;
-	raw_spin_unlock_irqrestore(&tg->thread_group_info_lock, flags);
+	tg->thread_group_info[rq->cpu].cfs_nr_running--;
 }
 
 #endif
@@ -5443,6 +5451,7 @@ static int cmp_select_task_rq_fair(struct task_struct *p, int prev_cpu)
 	int max_idle_cnt, idle_cnt;
 	struct cpumask max_idle_mask, idle_mask;
 	struct cpumask cls_cpus, allowed_mask;
+	struct thread_group_info_t tginfo;
 	int num_cluster;
 
 	in_prev = 0;
@@ -5474,7 +5483,8 @@ static int cmp_select_task_rq_fair(struct task_struct *p, int prev_cpu)
 		if (group_leader_is_empty(p))
 			continue;
 
-		tg_cnt = p->group_leader->thread_group_info[i].nr_running;
+		tg_info_fold(p->group_leader, i, &tginfo);
+		tg_cnt = tginfo.nr_running;
 		mt_sched_printf(sched_cmp,
 			"wakeup pid=%d name=%s load=%ld, cluster=%d allowed_cpu=%02lx, idle_cpu=%02lx",
 			p->pid, p->comm, p->se.avg.loadwop_avg_contrib, i, *cpumask_bits(&allowed_mask),
@@ -6578,13 +6588,15 @@ static int cmp_can_migrate_task(struct task_struct *p, struct lb_env *env)
 
 #ifdef CONFIG_MTK_SCHED_CMP_TGS_WAKEUP
 		if (!thread_group_empty(p)) {
-			struct thread_group_info_t *src_tginfo, *dst_tginfo;
+			struct thread_group_info_t src_info, dst_info;
+			struct thread_group_info_t *src_tginfo = &src_info;
+			struct thread_group_info_t *dst_tginfo = &dst_info;
 
 			if (group_leader_is_empty(p))
 				return 0;
 
-			src_tginfo = &p->group_leader->thread_group_info[src_clid];
-			dst_tginfo = &p->group_leader->thread_group_info[dst_clid];
+			tg_info_fold(p->group_leader, src_clid, src_tginfo);
+			tg_info_fold(p->group_leader, dst_clid, dst_tginfo);
 
 			mt_sched_printf(sched_cmp_info,
 				"check rule0: pid=%d comm=%s load=%ld src:clid=%d src_tg->nr_running=%ld nr_cpus=%d dst_tg->nr_running=%ld",
@@ -6646,7 +6658,7 @@ static int need_migrate_task_immediately(struct task_struct *p,
 	if (arch_is_multi_cluster() && (sd->flags & SD_BALANCE_TG)) {
 		int src_clid, dst_clid;
 		int src_nr_cpus;
-		struct thread_group_info_t *src_tginfo, *dst_tginfo;
+		struct thread_group_info_t src_tginfo;
 
 		src_clid = arch_get_cluster_id(env->src_cpu);
 		dst_clid = arch_get_cluster_id(env->dst_cpu);
@@ -6656,14 +6668,13 @@ static int need_migrate_task_immediately(struct task_struct *p,
 		if (group_leader_is_empty(p))
 			return 0;
 
-		src_tginfo = &p->group_leader->thread_group_info[src_clid];
-		dst_tginfo = &p->group_leader->thread_group_info[dst_clid];
+		tg_info_fold(p->group_leader, src_clid, &src_tginfo);
 		src_nr_cpus = nr_cpus_in_cluster(src_clid, false);
 		mt_sched_printf(sched_cmp, "[%s] L.L arch", __func__);
 
 		if ((p->se.avg.loadwop_avg_contrib * 4 >= NICE_0_LOAD * 3) &&
-		    src_tginfo->nr_running > src_nr_cpus &&
-		    src_tginfo->loadwop_avg_contrib * 10 > NICE_0_LOAD * src_nr_cpus * 9) {
+		    src_tginfo.nr_running > src_nr_cpus &&
+		    src_tginfo.loadwop_avg_contrib * 10 > NICE_0_LOAD * src_nr_cpus * 9) {
 			/*pr_warn("[%s] hit rule0, candidate_load_move/load_move (%ld/%ld)\n",
 			      __func__, candidate_load_move, env->imbalance);*/
 			return 1;
@@ -7007,11 +7018,8 @@ static int tgs_detach_tasks(struct lb_env *env)
 
 			/* rule1, single thread */
 			mt_sched_printf(sched_cmp_info,
-				"check rule1: pid=%d p->comm=%s thread_group_cnt=%lu thread_group_empty(p)=%d",
-				p->pid, p->comm,
-				p->group_leader->thread_group_info[0].nr_running +
-				p->group_leader->thread_group_info[1].nr_running,
-				thread_group_empty(p));
+				"check rule1: pid=%d p->comm=%s thread_group_empty(p)=%d",
+				p->pid, p->comm, thread_group_empty(p));
 
 			if (thread_group_empty(p)) {
 				list_move_tail(&p->se.group_node, &tg_tasks);
@@ -7024,10 +7032,12 @@ static int tgs_detach_tasks(struct lb_env *env)
 
 			/* rule2 */
 			if (!group_leader_is_empty(p)) {
-				struct thread_group_info_t *src_tginfo, *dst_tginfo;
+				struct thread_group_info_t src_info, dst_info;
+				struct thread_group_info_t *src_tginfo = &src_info;
+				struct thread_group_info_t *dst_tginfo = &dst_info;
 
-				src_tginfo = &p->group_leader->thread_group_info[src_clid];
-				dst_tginfo = &p->group_leader->thread_group_info[dst_clid];
+				tg_info_fold(p->group_leader, src_clid, src_tginfo);
+				tg_info_fold(p->group_leader, dst_clid, dst_tginfo);
 
 				mt_sched_printf(sched_cmp_info, "check rule2:pid=%d p->comm=%s %ld, %ld, %ld, %ld, %ld",
 							p->pid, p->comm, src_tginfo->nr_running,
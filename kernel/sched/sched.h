@@ -1209,6 +1209,8 @@ static inline void idle_exit_fair(struct rq *rq) { }
 
 # ifdef CONFIG_MTK_SCHED_CMP_TGS
 extern int group_leader_is_empty(struct task_struct *p);
+extern void tg_info_fold(struct task_struct *tg, int cluster_id,
+			 struct thread_group_info_t *info);
 # endif /* CONFIG_MTK_SCHED_CMP_TGS */
 
 # ifdef CONFIG_MTK_SCHED_CMP
@@ -279,6 +279,7 @@ static int max_sched_tunable_scaling = SCHED_TUNABLESCALING_END-1;
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+static int max_compaction_proactive_orders = (1 << MAX_ORDER) - 1;
 #endif
 
 static struct ctl_table kern_table[] = {
@@ -1318,6 +1319,16 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &one,
 		.extra2		= &four,
 	},
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	{
+		.procname	= "smaps_rollup_cache_ms",
+		.data		= &sysctl_smaps_rollup_cache_ms,
+		.maxlen		= sizeof(sysctl_smaps_rollup_cache_ms),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+#endif
 #ifdef CONFIG_COMPACTION
 	{
 		.procname	= "compact_memory",
@@ -1335,6 +1346,40 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "compaction_proactive_orders",
+		.data		= &sysctl_compaction_proactive_orders,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &max_compaction_proactive_orders,
+	},
+	{
+		.procname	= "compaction_proactive_threshold",
+		.data		= &sysctl_compaction_proactive_threshold,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &min_extfrag_threshold,
+		.extra2		= &max_extfrag_threshold,
+	},
+	{
+		.procname	= "compaction_proactive_interval_ms",
+		.data		= &sysctl_compaction_proactive_interval,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "compaction_proactive_batch",
+		.data		= &sysctl_compaction_proactive_batch,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+	},
 
 #endif /* CONFIG_COMPACTION */
 	{
@@ -21,6 +21,8 @@
 void trace_begin(char *name);
 void trace_counter(char *name, int count);
 void trace_end(void);
+void mtk_marker_text(char type, const char *name, int value);
+bool mtk_marker_bin(char type, const char *name, int value);
 #else
 #define trace_begin(name)
 #define trace_counter(name, count)
@@ -33,6 +35,7 @@ int resize_ring_buffer_for_hibernation(int enable);
 #define resize_ring_buffer_for_hibernation(on) (0)
 #endif				/* CONFIG_MTK_HIBERNATION */
 
+struct trace_array;
 extern bool ring_buffer_expanded;
 ssize_t tracing_resize_ring_buffer(struct trace_array *tr,
 				   unsigned long size, int cpu_id);
@@ -17,6 +17,13 @@
 #include "trace.h"
 
 #ifdef CONFIG_MTK_KERNEL_MARKER
+#include <linux/hashtable.h>
+#include <linux/dcache.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/mtk_marker.h>
+#undef CREATE_TRACE_POINTS
+
 static unsigned long __read_mostly mark_addr;
 static int kernel_marker_on;
 
@@ -26,38 +33,222 @@ static inline void update_tracing_mark_write_addr(void)
 		mark_addr = kallsyms_lookup_name("tracing_mark_write");
 }
 
-inline void trace_begin(char *name)
+/*
+ * Marker names are interned once and then recorded by id. Names are never
+ * freed so that ids stay resolvable for as long as the buffer holds them;
+ * names that do not fit fall back to the text marker.
+ */
+#define MARKER_NAME_LEN		64
+#define MARKER_NAMES_MAX	4096
+#define MARKER_HASH_BITS	10
+
+struct marker_name {
+	struct hlist_node node;
+	u32 hash;
+	u32 id;
+	cycle_t epoch;		/* time_start of the buffer it was announced to,
+				 * written under marker_lock */
+	char name[];
+};
+
+static DEFINE_HASHTABLE(marker_hash, MARKER_HASH_BITS);
+static struct marker_name *marker_names[MARKER_NAMES_MAX];
+static unsigned int nr_marker_names;
+static DEFINE_RAW_SPINLOCK(marker_lock);
+static struct trace_array *marker_tr;
+static DEFINE_MUTEX(marker_events_lock);
+static bool marker_events_owned;	/* kernel_marker_on enabled mtk_marker */
+
+static struct marker_name *marker_lookup(const char *name, u32 len, u32 hash)
+{
+	struct marker_name *m;
+
+	hash_for_each_possible_rcu(marker_hash, m, node, hash) {
+		if (m->hash == hash && !strncmp(m->name, name, len) &&
+		    !m->name[len])
+			return m;
+	}
+	return NULL;
+}
+
+static struct marker_name *marker_intern(const char *name)
+{
+	struct marker_name *m;
+	unsigned long flags;
+	u32 len, hash;
+
+	len = strnlen(name, MARKER_NAME_LEN);
+	if (len == MARKER_NAME_LEN)
+		return NULL;
+	hash = full_name_hash(name, len);
+
+	m = marker_lookup(name, len, hash);
+	if (likely(m))
+		return m;
+
+	raw_spin_lock_irqsave(&marker_lock, flags);
+	m = marker_lookup(name, len, hash);
+	if (m || nr_marker_names >= MARKER_NAMES_MAX)
+		goto unlock;
+	m = kmalloc(sizeof(*m) + len + 1, GFP_ATOMIC);
+	if (!m)
+		goto unlock;
+	memcpy(m->name, name, len);
+	m->name[len] = 0;
+	m->hash = hash;
+	m->id = nr_marker_names;
+	m->epoch = 0;
+	marker_names[m->id] = m;
+	/* publish the slot before the id becomes printable */
+	smp_wmb();
+	nr_marker_names++;
+	hash_add_rcu(marker_hash, &m->node, hash);
+unlock:
+	raw_spin_unlock_irqrestore(&marker_lock, flags);
+	return m;
+}
+
+const char *mtk_marker_print(struct trace_seq *p, char type, int tgid,
+			     u32 id, int value)
+{
+	const char *ret = trace_seq_buffer_ptr(p);
+	const char *name = "<unknown>";
+
+	if (id < ACCESS_ONCE(nr_marker_names)) {
+		smp_rmb();
+		name = marker_names[id]->name;
+	}
+
+	switch (type) {
+	case 'B':
+		trace_seq_printf(p, "B|%d|%s", tgid, name);
+		break;
+	case 'C':
+		trace_seq_printf(p, "C|%d|%s|%d", tgid, name, value);
+		break;
+	default:
+		trace_seq_putc(p, type);
+		break;
+	}
+	trace_seq_putc(p, 0);
+
+	return ret;
+}
+EXPORT_SYMBOL(mtk_marker_print);
+
+void mtk_marker_text(char type, const char *name, int value)
 {
-	if (unlikely(kernel_marker_on) && name) {
-		preempt_disable();
+	update_tracing_mark_write_addr();
+
+	switch (type) {
+	case 'B':
 		event_trace_printk(mark_addr, "B|%d|%s\n",
 				   current->tgid, name);
-		preempt_enable();
+		break;
+	case 'C':
+		event_trace_printk(mark_addr, "C|%d|%s|%d\n",
+				   current->tgid, name, value);
+		break;
+	default:
+		event_trace_printk(mark_addr, "E\n");
+		break;
 	}
 }
+
+/*
+ * True if the caller is the one to announce m to the buffer started at
+ * epoch. The unlocked check may see a torn 64-bit value on 32-bit cpus,
+ * which only costs a trip through the lock.
+ */
+static bool marker_claim_epoch(struct marker_name *m, cycle_t epoch)
+{
+	unsigned long flags;
+	bool claimed;
+
+	if (READ_ONCE(m->epoch) == epoch)
+		return false;
+
+	raw_spin_lock_irqsave(&marker_lock, flags);
+	claimed = m->epoch != epoch;
+	if (claimed)
+		WRITE_ONCE(m->epoch, epoch);
+	raw_spin_unlock_irqrestore(&marker_lock, flags);
+
+	return claimed;
+}
+
+/* Returns false if the marker has to be recorded as text instead */
+bool mtk_marker_bin(char type, const char *name, int value)
+{
+	struct trace_array *tr = READ_ONCE(marker_tr);
+	struct marker_name *m = NULL;
+
+	if (!tr || !trace_tracing_mark_write_enabled())
+		return false;
+
+	if (type != 'E') {
+		m = marker_intern(name);
+		if (!m)
+			return false;
+		/* announce the name again after the buffer was reset */
+		if (marker_claim_epoch(m, READ_ONCE(tr->trace_buffer.time_start)))
+			trace_tracing_mark_name(m->id, m->name);
+	}
+	trace_tracing_mark_write(type, current->tgid, m ? m->id : 0, value);
+	return true;
+}
+
+static inline void kernel_marker(char type, const char *name, int value)
+{
+	preempt_disable();
+	if (!mtk_marker_bin(type, name, value))
+		mtk_marker_text(type, name, value);
+	preempt_enable();
+}
+
+inline void trace_begin(char *name)
+{
+	if (unlikely(kernel_marker_on) && name)
+		kernel_marker('B', name, 0);
+}
 EXPORT_SYMBOL(trace_begin);
 
 inline void trace_counter(char *name, int count)
 {
-	if (unlikely(kernel_marker_on) && name) {
-		preempt_disable();
-		event_trace_printk(mark_addr, "C|%d|%s|%d\n",
-				   current->tgid, name, count);
-		preempt_enable();
-	}
+	if (unlikely(kernel_marker_on) && name)
+		kernel_marker('C', name, count);
 }
 EXPORT_SYMBOL(trace_counter);
 
 inline void trace_end(void)
 {
-	if (unlikely(kernel_marker_on)) {
-		preempt_disable();
-		event_trace_printk(mark_addr, "E\n");
-		preempt_enable();
-	}
+	if (unlikely(kernel_marker_on))
+		kernel_marker('E', NULL, 0);
 }
 EXPORT_SYMBOL(trace_end);
 
+static int kernel_marker_names_show(struct seq_file *m, void *v)
+{
+	unsigned int i, nr = ACCESS_ONCE(nr_marker_names);
+
+	smp_rmb();
+	for (i = 0; i < nr; i++)
+		seq_printf(m, "%u %s\n", i, marker_names[i]->name);
+	return 0;
+}
+
+static int kernel_marker_names_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kernel_marker_names_show, NULL);
+}
+
+static const struct file_operations kernel_marker_names_fops = {
+	.open = kernel_marker_names_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static ssize_t
 kernel_marker_on_simple_read(struct file *filp, char __user *ubuf,
 			     size_t cnt, loff_t *ppos)
@@ -86,6 +277,20 @@ kernel_marker_on_simple_write(struct file *filp, const char __user *ubuf,
 	if (kernel_marker_on)
 		update_tracing_mark_write_addr();
 
+	/*
+	 * Record markers in binary form while they are on. Events someone
+	 * enabled through set_event are left as they are.
+	 */
+	mutex_lock(&marker_events_lock);
+	if (kernel_marker_on && !marker_events_owned &&
+	    !trace_tracing_mark_write_enabled()) {
+		marker_events_owned = !trace_set_clr_event("mtk_marker", NULL, 1);
+	} else if (!kernel_marker_on && marker_events_owned) {
+		trace_set_clr_event("mtk_marker", NULL, 0);
+		marker_events_owned = false;
+	}
+	mutex_unlock(&marker_events_lock);
+
 	(*ppos)++;
 
 	return cnt;
@@ -102,12 +307,16 @@ static __init int init_kernel_marker(void)
 {
 	struct dentry *d_tracer;
 
+	WRITE_ONCE(marker_tr, top_trace_array());
+
 	d_tracer = tracing_init_dentry();
 	if (!d_tracer)
 		return 0;
 
 	trace_create_file("kernel_marker_on", 0644, d_tracer, NULL,
 			  &kernel_marker_on_simple_fops);
+	trace_create_file("kernel_marker_names", 0444, d_tracer, NULL,
+			  &kernel_marker_names_fops);
 
 	return 0;
 }
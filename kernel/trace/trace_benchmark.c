@@ -5,6 +5,7 @@
 
 #define CREATE_TRACE_POINTS
 #include "trace_benchmark.h"
+#include "mtk_ftrace.h"
 
 static struct task_struct *bm_event_thread;
 
@@ -141,6 +142,66 @@ static void trace_do_benchmark(void)
 	bm_stddev = stddev;
 }
 
+#ifdef CONFIG_MTK_KERNEL_MARKER
+static u64 bm_marker_total[2];
+static u64 bm_marker_max[2];
+static u64 bm_marker_cnt[2];
+
+static void bm_marker_account(int bin, u64 delta)
+{
+	bm_marker_total[bin] += delta;
+	bm_marker_cnt[bin]++;
+	if (delta > bm_marker_max[bin])
+		bm_marker_max[bin] = delta;
+}
+
+/*
+ * Compare the cost of a counter marker recorded through
+ * event_trace_printk() with the binary tracing_mark_write event.
+ * Runs in the benchmark_event thread, so both benchmark events need to
+ * be enabled; enable mtk_marker:tracing_mark_write for the binary numbers.
+ */
+static void trace_do_marker_benchmark(void)
+{
+	u64 avg[2] = { 0, 0 };
+	u64 start;
+	bool bin;
+	int i;
+
+	if (!trace_benchmark_marker_enabled())
+		return;
+
+	local_irq_disable();
+	start = trace_clock_local();
+	mtk_marker_text('C', "benchmark_marker", bm_cnt);
+	bm_marker_account(0, trace_clock_local() - start);
+
+	start = trace_clock_local();
+	bin = mtk_marker_bin('C', "benchmark_marker", bm_cnt);
+	if (bin)
+		bm_marker_account(1, trace_clock_local() - start);
+	local_irq_enable();
+
+	if (bm_marker_cnt[0] < BENCHMARK_MARKER_LOOPS)
+		return;
+
+	for (i = 0; i < 2; i++) {
+		if (bm_marker_cnt[i]) {
+			avg[i] = bm_marker_total[i];
+			do_div(avg[i], (u32)bm_marker_cnt[i]);
+		}
+	}
+	trace_benchmark_marker(avg[0], bm_marker_max[0],
+			       avg[1], bm_marker_max[1]);
+
+	memset(bm_marker_total, 0, sizeof(bm_marker_total));
+	memset(bm_marker_max, 0, sizeof(bm_marker_max));
+	memset(bm_marker_cnt, 0, sizeof(bm_marker_cnt));
+}
+#else
+static inline void trace_do_marker_benchmark(void) { }
+#endif
+
 static int benchmark_event_kthread(void *arg)
 {
 	/* sleep a bit to make sure the tracepoint gets activated */
@@ -149,6 +210,7 @@ static int benchmark_event_kthread(void *arg)
 	while (!kthread_should_stop()) {
 
 		trace_do_benchmark();
+		trace_do_marker_benchmark();
 
 		/*
 		 * We don't go to sleep, but let others
@@ -10,6 +10,7 @@ extern void trace_benchmark_reg(void);
 extern void trace_benchmark_unreg(void);
 
 #define BENCHMARK_EVENT_STRLEN		128
+#define BENCHMARK_MARKER_LOOPS		1024
 
 TRACE_EVENT_FN(benchmark_event,
 
@@ -30,6 +31,36 @@ TRACE_EVENT_FN(benchmark_event,
 	trace_benchmark_reg, trace_benchmark_unreg
 );
 
+/*
+ * Cost of the text and the binary kernel marker, in ns per marker,
+ * averaged over the last BENCHMARK_MARKER_LOOPS markers of each kind.
+ * bin is zero while mtk_marker:tracing_mark_write is disabled.
+ */
+TRACE_EVENT(benchmark_marker,
+
+	TP_PROTO(u64 text_avg, u64 text_max, u64 bin_avg, u64 bin_max),
+
+	TP_ARGS(text_avg, text_max, bin_avg, bin_max),
+
+	TP_STRUCT__entry(
+		__field(	u64,	text_avg	)
+		__field(	u64,	text_max	)
+		__field(	u64,	bin_avg		)
+		__field(	u64,	bin_max		)
+	),
+
+	TP_fast_assign(
+		__entry->text_avg = text_avg;
+		__entry->text_max = text_max;
+		__entry->bin_avg = bin_avg;
+		__entry->bin_max = bin_max;
+	),
+
+	TP_printk("text avg=%llu max=%llu bin avg=%llu max=%llu",
+		  __entry->text_avg, __entry->text_max,
+		  __entry->bin_avg, __entry->bin_max)
+);
+
 #endif /* _TRACE_BENCHMARK_H */
 
 #undef TRACE_INCLUDE_FILE
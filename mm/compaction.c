@@ -16,6 +16,9 @@
 #include <linux/sysfs.h>
 #include <linux/balloon_compaction.h>
 #include <linux/page-isolation.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/timer.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -473,6 +476,7 @@ isolate_fail:
 	if (blockpfn == end_pfn)
 		update_pageblock_skip(cc, valid_page, total_isolated, false);
 
+	cc->total_free_scanned += nr_scanned;
 	count_compact_events(COMPACTFREE_SCANNED, nr_scanned);
 	if (total_isolated)
 		count_compact_events(COMPACTISOLATED, total_isolated);
@@ -776,6 +780,7 @@ isolate_success:
 
 	trace_mm_compaction_isolate_migratepages(nr_scanned, nr_isolated);
 
+	cc->total_migrate_scanned += nr_scanned;
 	count_compact_events(COMPACTMIGRATE_SCANNED, nr_scanned);
 	if (nr_isolated)
 		count_compact_events(COMPACTISOLATED, nr_isolated);
@@ -1236,6 +1241,8 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 
 	while ((ret = compact_finished(zone, cc, migratetype)) ==
 						COMPACT_CONTINUE) {
+		unsigned long nr_isolated;
+		struct page *page;
 		int err;
 
 		switch (isolate_migratepages(zone, cc)) {
@@ -1250,6 +1257,7 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 			;
 		}
 
+		nr_isolated = cc->nr_migratepages;
 		err = migrate_pages(&cc->migratepages, compaction_alloc,
 				compaction_free, (unsigned long)cc, cc->mode,
 				MR_COMPACTION);
@@ -1257,6 +1265,19 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 		trace_mm_compaction_migratepages(cc->nr_migratepages, err,
 							&cc->migratepages);
 
+		/*
+		 * migrate_pages() returns how many pages it failed to migrate,
+		 * some of which it has already put back. On an error the pages
+		 * it did not get to are left on the list.
+		 */
+		if (err >= 0) {
+			nr_isolated -= err;
+		} else {
+			list_for_each_entry(page, &cc->migratepages, lru)
+				nr_isolated--;
+		}
+		cc->nr_migrated += nr_isolated;
+
 		/* All pages were either migrated or will be released */
 		cc->nr_migratepages = 0;
 		if (err) {
@@ -1270,6 +1291,12 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 				goto out;
 			}
 		}
+
+		/* Background compaction works in bounded batches */
+		if (cc->budget && cc->nr_migrated >= cc->budget) {
+			ret = COMPACT_PARTIAL;
+			goto out;
+		}
 	}
 
 out:
@@ -1302,6 +1329,10 @@ static unsigned long compact_zone_order(struct zone *zone, int order,
 	VM_BUG_ON(!list_empty(&cc.freepages));
 	VM_BUG_ON(!list_empty(&cc.migratepages));
 
+	count_compact_events(COMPACTDIRECT_SCANNED,
+			     cc.total_migrate_scanned + cc.total_free_scanned);
+	count_compact_events(COMPACTDIRECT_MIGRATED, cc.nr_migrated);
+
 	*contended = cc.contended;
 	return ret;
 }
@@ -1498,6 +1529,229 @@ static void compact_nodes(void)
 		compact_node(nid);
 }
 
+/*
+ * Proactive compaction. kcompactd checks the fragmentation index of the
+ * orders in sysctl_compaction_proactive_orders every
+ * sysctl_compaction_proactive_interval ms, and whenever kswapd goes to
+ * sleep after reclaiming for a high-order allocation. If a free block of
+ * such an order is gone and the index says fragmentation rather than lack
+ * of memory is to blame, it compacts the zone for that order, migrating
+ * at most sysctl_compaction_proactive_batch pages per round so that the
+ * cost stays spread out. Scanners resume from the zone's cached positions
+ * and honour the pageblock skip hints, like kswapd's compaction.
+ *
+ * Zones where compaction keeps failing are deferred the way direct
+ * compaction defers them. The poll timer is deferrable, so it does not
+ * wake an idle CPU, and polls that find nothing to migrate double the
+ * interval, up to KCOMPACTD_MAX_BACKOFF doublings.
+ */
+int sysctl_compaction_proactive_orders = (1 << 3) | (1 << 4);
+int sysctl_compaction_proactive_threshold = 500;
+int sysctl_compaction_proactive_interval = 500;
+int sysctl_compaction_proactive_batch = 1024;
+
+#define KCOMPACTD_MAX_BACKOFF	6
+
+/* highest order in @orders that is worth compacting @zone for, or -1 */
+static int kcompactd_zone_order(struct zone *zone, unsigned long orders)
+{
+	int order, fragindex;
+
+	for (order = MAX_ORDER - 1; order > 0; order--) {
+		if (!(orders & (1UL << order)))
+			continue;
+
+		fragindex = fragmentation_index(zone, order);
+		if (fragindex <= sysctl_compaction_proactive_threshold)
+			continue;
+		if (compaction_suitable(zone, order) != COMPACT_CONTINUE)
+			continue;
+		return order;
+	}
+	return -1;
+}
+
+/* returns true if any page was migrated */
+static bool kcompactd_do_work(pg_data_t *pgdat, unsigned long orders)
+{
+	bool woken = false, progress = false;
+	int zoneid, order, ret;
+	struct zone *zone;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct compact_control cc = {
+			.mode = MIGRATE_SYNC_LIGHT,
+			.gfp_mask = GFP_KERNEL,
+			.budget = sysctl_compaction_proactive_batch,
+		};
+
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		order = kcompactd_zone_order(zone, orders);
+		if (order < 0 || compaction_deferred(zone, order))
+			continue;
+
+		if (!woken) {
+			count_compact_event(KCOMPACTD_WAKE);
+			/* Flush pending updates to the LRU lists */
+			lru_add_drain_all();
+			woken = true;
+		}
+
+		cc.order = order;
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		ret = compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		count_compact_events(KCOMPACTD_SCANNED,
+				     cc.total_migrate_scanned +
+				     cc.total_free_scanned);
+		count_compact_events(KCOMPACTD_MIGRATED, cc.nr_migrated);
+		if (cc.nr_migrated)
+			progress = true;
+
+		/*
+		 * A round that ran out of budget goes on next time; one that
+		 * finished or gave up short of the order defers the zone.
+		 */
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0))
+			compaction_defer_reset(zone, order, false);
+		else if (ret != COMPACT_PARTIAL || cc.nr_migrated < cc.budget)
+			defer_compaction(zone, order);
+
+		if (kthread_should_stop())
+			break;
+	}
+
+	return progress;
+}
+
+struct kcompactd_poll {
+	struct timer_list timer;
+	pg_data_t *pgdat;
+	bool expired;
+};
+
+static void kcompactd_poll_fn(unsigned long data)
+{
+	struct kcompactd_poll *poll = (struct kcompactd_poll *)data;
+
+	poll->expired = true;
+	wake_up_interruptible(&poll->pgdat->kcompactd_wait);
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	struct kcompactd_poll poll = { .pgdat = pgdat };
+	unsigned long orders;
+	int interval, backoff = 0, max_order;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+	setup_deferrable_timer_on_stack(&poll.timer, kcompactd_poll_fn,
+					(unsigned long)&poll);
+
+	while (!kthread_should_stop()) {
+		interval = ACCESS_ONCE(sysctl_compaction_proactive_interval);
+		poll.expired = false;
+		if (interval)
+			mod_timer(&poll.timer, jiffies +
+				  (msecs_to_jiffies(interval) << backoff));
+		wait_event_freezable(pgdat->kcompactd_wait,
+				pgdat->kcompactd_max_order || poll.expired ||
+				kthread_should_stop());
+		del_timer_sync(&poll.timer);
+
+		max_order = xchg(&pgdat->kcompactd_max_order, 0);
+		orders = ACCESS_ONCE(sysctl_compaction_proactive_orders);
+		if (!orders)
+			continue;
+
+		/* kswapd asking is always worth a full-rate look */
+		if (kcompactd_do_work(pgdat, orders | (1UL << max_order)) ||
+		    max_order)
+			backoff = 0;
+		else if (backoff < KCOMPACTD_MAX_BACKOFF)
+			backoff++;
+	}
+
+	destroy_timer_on_stack(&poll.timer);
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - ask kcompactd to compact for a high-order allocation
+ * @pgdat: node kswapd has just reclaimed on
+ * @order: order kswapd was woken for
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+	if (!order || !ACCESS_ONCE(sysctl_compaction_proactive_orders))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		pr_err("Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined. Caller must
+ * hold mem_hotplug_begin/end().
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 /* The written value is actually unused, all memory is compacted */
 int sysctl_compact_memory;
 
@@ -186,6 +186,12 @@ struct compact_control {
 					 * contention detected during
 					 * compaction
 					 */
+	unsigned long budget;		/* Stop after migrating this many
+					 * pages, 0 for no limit
+					 */
+	unsigned long nr_migrated;	/* Pages migrated */
+	unsigned long total_migrate_scanned;
+	unsigned long total_free_scanned;
 };
 
 unsigned long
@@ -234,6 +240,8 @@ void __vma_link_list(struct mm_struct *mm, struct vm_area_struct *vma,
 		struct vm_area_struct *prev, struct rb_node *rb_parent);
 
 #ifdef CONFIG_MMU
+extern unsigned long zap_private_vmas(struct mm_struct *mm);
+
 extern long __mlock_vma_pages_range(struct vm_area_struct *vma,
 		unsigned long start, unsigned long end, int *nonblocking);
 extern void munlock_vma_pages_range(struct vm_area_struct *vma,
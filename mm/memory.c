@@ -1402,6 +1402,53 @@ void zap_page_range(struct vm_area_struct *vma, unsigned long start,
 	tlb_finish_mmu(&tlb, start, end);
 }
 
+/**
+ * zap_private_vmas - remove the private pages of a dying mm
+ * @mm: the mm, with mmap_sem held for read
+ *
+ * Zaps what exit_mmap() would free of the anonymous and private file
+ * mappings, while the vmas stay in place for the exit path. A single
+ * mmu_gather covers all of them, so pages are freed and the TLB is
+ * flushed once per gather batch rather than per vma. Shared, locked,
+ * hugetlb and pfn mappings are left alone.
+ *
+ * The gather is not a full mm one: threads of the owner may still run
+ * and need their TLBs flushed.
+ *
+ * Returns the number of pages and swap entries given back.
+ */
+unsigned long zap_private_vmas(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	struct mmu_gather tlb;
+	unsigned long start, end, before, after;
+
+	if (!mm->mmap)
+		return 0;
+
+	start = mm->mmap->vm_start;
+	end = mm->highest_vm_end;
+	before = get_mm_rss(mm) + get_mm_counter(mm, MM_SWAPENTS);
+
+	lru_add_drain();
+	tlb_gather_mmu(&tlb, mm, start, end);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_SHARED | VM_LOCKED | VM_HUGETLB |
+				     VM_PFNMAP | VM_IO))
+			continue;
+
+		mmu_notifier_invalidate_range_start(mm, vma->vm_start,
+						    vma->vm_end);
+		unmap_page_range(&tlb, vma, vma->vm_start, vma->vm_end, NULL);
+		mmu_notifier_invalidate_range_end(mm, vma->vm_start,
+						  vma->vm_end);
+	}
+	tlb_finish_mmu(&tlb, start, end);
+
+	after = get_mm_rss(mm) + get_mm_counter(mm, MM_SWAPENTS);
+	return before > after ? before - after : 0;
+}
+
 /**
  * zap_page_range_single - remove user pages in a given range
  * @vma: vm_area_struct holding the applicable pages
@@ -2452,13 +2499,17 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
-	page = lookup_swap_cache(entry);
+	page = lookup_swap_cache(entry, vma, address);
 	if (!page) {
 		/* Trace event for swap-in */
 		trace_mm_swap_op_rd(swp_type(entry));
 
-		page = swapin_readahead(entry,
-					GFP_HIGHUSER_MOVABLE, vma, address);
+		if (swap_use_vma_readahead())
+			page = swap_vma_readahead(entry, GFP_HIGHUSER_MOVABLE,
+						  vma, address, pmd);
+		else
+			page = swapin_readahead(entry, GFP_HIGHUSER_MOVABLE,
+						vma, address);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte
@@ -3362,6 +3413,13 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	/* do counter updates before entering really critical section. */
 	check_sync_rss_stat(current);
 
+	/*
+	 * The oom reaper took the private memory of this dying mm, do not
+	 * hand out zero pages in its place to uaccess or get_user_pages().
+	 */
+	if (unlikely(test_bit(MMF_OOM_REAPED, &mm->flags)))
+		return VM_FAULT_SIGBUS;
+
 	/*
 	 * Enable the memcg OOM handling for faults triggered in user
 	 * space.  Kernel faults are handled more gracefully.
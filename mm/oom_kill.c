@@ -35,6 +35,9 @@
 #include <linux/freezer.h>
 #include <linux/ftrace.h>
 #include <linux/ratelimit.h>
+#include <linux/kthread.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/oom.h>
@@ -736,3 +739,275 @@ void pagefault_out_of_memory(void)
 		oom_zonelist_unlock(zonelist, GFP_KERNEL);
 	}
 }
+
+#ifdef CONFIG_MMU
+/*
+ * OOM reaper
+ *
+ * A killed task only gives its memory back once it gets to exit_mmap(),
+ * which can take seconds when the task is stuck or starved of cpu. The
+ * reaper zaps the private memory of the victim's mm right away from a
+ * SCHED_FIFO kthread, see zap_private_vmas(). The mm itself, the vmas
+ * and whatever is shared stay for the exit path.
+ *
+ * /proc/oom_reaper shows how fast the memory comes back, from the kill
+ * to the end of the zap. Any write clears the statistics.
+ */
+#define OOM_REAP_RETRIES	10
+#define OOM_REAP_HIST		8	/* < 1, 2, 4 ... 64, >= 64 ms */
+
+static struct task_struct *oom_reaper_th;
+static DECLARE_WAIT_QUEUE_HEAD(oom_reaper_wait);
+static struct task_struct *oom_reaper_list;
+static DEFINE_SPINLOCK(oom_reaper_lock);
+
+/* under oom_reaper_lock */
+static struct {
+	unsigned long reaped;
+	unsigned long skipped;	/* gone, shared or dumping core */
+	unsigned long failed;	/* mmap_sem stayed busy */
+	unsigned long pages;
+	u64 wait_ns;		/* kill to reaper start */
+	u64 reap_ns;
+	u64 max_ns;		/* kill to memory freed */
+	unsigned long hist[OOM_REAP_HIST];
+} oom_reap_stat;
+
+/* is @mm used by anyone but the thread group of @victim? */
+static bool oom_reap_mm_shared(struct mm_struct *mm,
+			       struct task_struct *victim)
+{
+	struct task_struct *p, *t;
+	bool shared = false;
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (same_thread_group(p, victim))
+			continue;
+		for_each_thread(p, t) {
+			if (ACCESS_ONCE(t->mm) == mm) {
+				shared = true;
+				goto out;
+			}
+		}
+	}
+out:
+	rcu_read_unlock();
+	return shared;
+}
+
+enum {
+	OOM_REAP_DONE,
+	OOM_REAP_SKIP,
+	OOM_REAP_BUSY,
+};
+
+static int __oom_reap_task(struct task_struct *tsk, unsigned long *freed)
+{
+	struct task_struct *p;
+	struct mm_struct *mm;
+	int ret = OOM_REAP_SKIP;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return OOM_REAP_SKIP;
+	mm = p->mm;
+	if (!atomic_inc_not_zero(&mm->mm_users)) {
+		task_unlock(p);
+		return OOM_REAP_SKIP;
+	}
+	task_unlock(p);
+
+	if (!down_read_trylock(&mm->mmap_sem)) {
+		mmput(mm);
+		return OOM_REAP_BUSY;
+	}
+
+	if (!test_bit(MMF_OOM_REAPED, &mm->flags) &&
+	    !(tsk->signal->flags & SIGNAL_GROUP_COREDUMP) &&
+	    !oom_reap_mm_shared(mm, tsk)) {
+		set_bit(MMF_OOM_REAPED, &mm->flags);
+		*freed = zap_private_vmas(mm);
+		ret = OOM_REAP_DONE;
+	}
+	up_read(&mm->mmap_sem);
+
+	/* the last reference runs exit_mmap() here, which is fine too */
+	mmput(mm);
+	return ret;
+}
+
+static void oom_reap_account(int ret, unsigned long freed, u64 queued,
+			     u64 start, u64 end)
+{
+	unsigned int ms = div_u64(end - queued, NSEC_PER_MSEC);
+	int bucket = ms ? min(ilog2(ms) + 1, OOM_REAP_HIST - 1) : 0;
+
+	spin_lock(&oom_reaper_lock);
+	switch (ret) {
+	case OOM_REAP_DONE:
+		oom_reap_stat.reaped++;
+		oom_reap_stat.pages += freed;
+		oom_reap_stat.wait_ns += start - queued;
+		oom_reap_stat.reap_ns += end - start;
+		oom_reap_stat.max_ns = max(oom_reap_stat.max_ns, end - queued);
+		oom_reap_stat.hist[bucket]++;
+		break;
+	case OOM_REAP_SKIP:
+		oom_reap_stat.skipped++;
+		break;
+	default:
+		oom_reap_stat.failed++;
+		break;
+	}
+	spin_unlock(&oom_reaper_lock);
+}
+
+static void oom_reap_task(struct task_struct *tsk)
+{
+	unsigned long freed = 0;
+	u64 start = ktime_get_ns();
+	int attempts = 0;
+	int ret;
+
+	/* the victim may hold mmap_sem for a while, e.g. in a page fault */
+	while ((ret = __oom_reap_task(tsk, &freed)) == OOM_REAP_BUSY &&
+	       ++attempts < OOM_REAP_RETRIES)
+		schedule_timeout_interruptible(HZ / 10);
+
+	oom_reap_account(ret, freed, tsk->oom_reaper_queued, start,
+			 ktime_get_ns());
+	if (ret == OOM_REAP_DONE)
+		pr_info("oom_reaper: reaped process %d (%s), %lukB freed\n",
+			task_pid_nr(tsk), tsk->comm, K(freed));
+	else if (ret == OOM_REAP_BUSY)
+		pr_info("oom_reaper: unable to reap process %d (%s)\n",
+			task_pid_nr(tsk), tsk->comm);
+
+	spin_lock(&oom_reaper_lock);
+	tsk->oom_reaper_queued = 0;
+	spin_unlock(&oom_reaper_lock);
+	put_task_struct(tsk);
+}
+
+static int oom_reaper(void *unused)
+{
+	set_freezable();
+
+	while (true) {
+		struct task_struct *tsk = NULL;
+
+		wait_event_freezable(oom_reaper_wait,
+				     ACCESS_ONCE(oom_reaper_list) != NULL);
+		spin_lock(&oom_reaper_lock);
+		if (oom_reaper_list) {
+			tsk = oom_reaper_list;
+			oom_reaper_list = tsk->oom_reaper_list;
+			tsk->oom_reaper_list = NULL;
+		}
+		spin_unlock(&oom_reaper_lock);
+
+		if (tsk)
+			oom_reap_task(tsk);
+	}
+
+	return 0;
+}
+
+/**
+ * wake_oom_reaper - have the private memory of a killed task zapped
+ * @tsk: the task, SIGKILL already sent
+ *
+ * May be called under rcu_read_lock() and spinlocks. A task that is
+ * still queued or being reaped is not queued again.
+ */
+void wake_oom_reaper(struct task_struct *tsk)
+{
+	if (!oom_reaper_th)
+		return;
+
+	spin_lock(&oom_reaper_lock);
+	if (tsk->oom_reaper_queued) {
+		spin_unlock(&oom_reaper_lock);
+		return;
+	}
+	get_task_struct(tsk);
+	tsk->oom_reaper_queued = ktime_get_ns();
+	tsk->oom_reaper_list = oom_reaper_list;
+	oom_reaper_list = tsk;
+	spin_unlock(&oom_reaper_lock);
+
+	wake_up(&oom_reaper_wait);
+}
+
+static int oom_reaper_show(struct seq_file *m, void *v)
+{
+	static const char * const hist_names[OOM_REAP_HIST] = {
+		"<1", "<2", "<4", "<8", "<16", "<32", "<64", ">=64",
+	};
+	unsigned long reaped;
+	int i;
+
+	spin_lock(&oom_reaper_lock);
+	reaped = oom_reap_stat.reaped;
+	seq_printf(m, "reaped:  %lu\nskipped: %lu\nfailed:  %lu\n",
+		   reaped, oom_reap_stat.skipped, oom_reap_stat.failed);
+	seq_printf(m, "freed:   %lu kB\n", K(oom_reap_stat.pages));
+	seq_printf(m, "avg wait:          %llu us\n",
+		   reaped ? div_u64(oom_reap_stat.wait_ns,
+				    reaped * NSEC_PER_USEC) : 0);
+	seq_printf(m, "avg reap:          %llu us\n",
+		   reaped ? div_u64(oom_reap_stat.reap_ns,
+				    reaped * NSEC_PER_USEC) : 0);
+	seq_printf(m, "max time to free:  %llu us\n",
+		   div_u64(oom_reap_stat.max_ns, NSEC_PER_USEC));
+	seq_puts(m, "time to free (ms):");
+	for (i = 0; i < OOM_REAP_HIST; i++)
+		seq_printf(m, " %s:%lu", hist_names[i], oom_reap_stat.hist[i]);
+	seq_putc(m, '\n');
+	spin_unlock(&oom_reaper_lock);
+
+	return 0;
+}
+
+static int oom_reaper_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, oom_reaper_show, NULL);
+}
+
+static ssize_t oom_reaper_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	spin_lock(&oom_reaper_lock);
+	memset(&oom_reap_stat, 0, sizeof(oom_reap_stat));
+	spin_unlock(&oom_reaper_lock);
+	return count;
+}
+
+static const struct file_operations oom_reaper_fops = {
+	.open		= oom_reaper_open,
+	.read		= seq_read,
+	.write		= oom_reaper_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init oom_reaper_init(void)
+{
+	struct sched_param param = { .sched_priority = 1 };
+	struct task_struct *th;
+
+	th = kthread_run(oom_reaper, NULL, "oom_reaper");
+	if (IS_ERR(th)) {
+		pr_err("Unable to start OOM reaper %ld\n", PTR_ERR(th));
+		return 0;
+	}
+	/* above every normal task, below the latency sensitive rt ones */
+	sched_setscheduler_nocheck(th, SCHED_FIFO, &param);
+	oom_reaper_th = th;
+
+	proc_create("oom_reaper", S_IRUGO | S_IWUSR, NULL, &oom_reaper_fops);
+	return 0;
+}
+subsys_initcall(oom_reaper_init);
+#endif /* CONFIG_MMU */
@@ -18,6 +18,7 @@
 #include <linux/pagevec.h>
 #include <linux/migrate.h>
 #include <linux/page_cgroup.h>
+#include <linux/vmstat.h>
 
 #include <asm/pgtable.h>
 
@@ -68,6 +69,30 @@ unsigned long total_swapcache_pages(void)
 
 static atomic_t swapin_readahead_hits = ATOMIC_INIT(4);
 
+/*
+ * VMA based readahead state, kept in vma->swap_readahead_info: the page
+ * aligned address of the last swap fault, the readahead window it used
+ * and the readahead hits seen in the VMA since then.
+ */
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/* the window is also bounded by page_cluster, and copied on the stack */
+#define SWAP_RA_ORDER_CEILING	5
+
+static bool enable_vma_readahead __read_mostly = true;
+
 void show_swap_cache_info(void)
 {
 	printk("%lu pages in swap cache\n", total_swapcache_pages());
@@ -279,7 +304,8 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
+			       unsigned long addr)
 {
 	struct page *page;
 
@@ -287,8 +313,24 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	if (page) {
 		INC_CACHE_INFO(find_success);
-		if (TestClearPageReadahead(page))
-			atomic_inc(&swapin_readahead_hits);
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			if (vma && swap_use_vma_readahead()) {
+				unsigned long ra_val;
+				int win, hits;
+
+				ra_val = atomic_long_read(&vma->swap_readahead_info);
+				win = SWAP_RA_WIN(ra_val);
+				hits = SWAP_RA_HITS(ra_val);
+				if (hits < SWAP_RA_HITS_MAX)
+					hits++;
+				atomic_long_set(&vma->swap_readahead_info,
+						SWAP_RA_VAL(SWAP_RA_ADDR(ra_val),
+							    win, hits));
+			} else {
+				atomic_inc(&swapin_readahead_hits);
+			}
+		}
 	}
 
 	INC_CACHE_INFO(find_total);
@@ -300,13 +342,16 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * and reading the disk if it is not already cached.
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
+ * @new_page_read is set when the page had to be read from the swap device.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *new_page_read)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_read = false;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -374,6 +419,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*new_page_read = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -391,22 +437,31 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
-static unsigned long swapin_nr_pages(unsigned long offset)
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
 {
-	static unsigned long prev_offset;
-	unsigned int pages, max_pages, last_ra;
-	static atomic_t last_readahead_pages;
+	bool new_page_read;
 
-	max_pages = 1 << ACCESS_ONCE(page_cluster);
-	if (max_pages <= 1)
-		return 1;
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &new_page_read);
+}
+
+/*
+ * @prev_offset and @offset are swap offsets for the cluster readahead and
+ * virtual page numbers for the VMA readahead.
+ */
+static unsigned int __swapin_nr_pages(unsigned long prev_offset,
+				      unsigned long offset,
+				      int hits, int max_pages, int prev_win)
+{
+	unsigned int pages, last_ra;
 
 	/*
 	 * This heuristic has been found to work well on both sequential and
 	 * random loads, swapping to hard disk or to SSD: please don't ask
 	 * what the "+ 2" means, it just happens to work well, that's all.
 	 */
-	pages = atomic_xchg(&swapin_readahead_hits, 0) + 2;
+	pages = hits + 2;
 	if (pages == 2) {
 		/*
 		 * We can have no readahead hits to judge by: but must not get
@@ -415,7 +470,6 @@ static unsigned long swapin_nr_pages(unsigned long offset)
 		 */
 		if (offset != prev_offset + 1 && offset != prev_offset - 1)
 			pages = 1;
-		prev_offset = offset;
 	} else {
 		unsigned int roundup = 4;
 		while (roundup < pages)
@@ -427,9 +481,28 @@ static unsigned long swapin_nr_pages(unsigned long offset)
 		pages = max_pages;
 
 	/* Don't shrink readahead too fast */
-	last_ra = atomic_read(&last_readahead_pages) / 2;
+	last_ra = prev_win / 2;
 	if (pages < last_ra)
 		pages = last_ra;
+
+	return pages;
+}
+
+static unsigned long swapin_nr_pages(unsigned long offset)
+{
+	static unsigned long prev_offset;
+	unsigned int hits, pages, max_pages;
+	static atomic_t last_readahead_pages;
+
+	max_pages = 1 << ACCESS_ONCE(page_cluster);
+	if (max_pages <= 1)
+		return 1;
+
+	hits = atomic_xchg(&swapin_readahead_hits, 0);
+	pages = __swapin_nr_pages(prev_offset, offset, hits, max_pages,
+				  atomic_read(&last_readahead_pages));
+	if (!hits)
+		prev_offset = offset;
 	atomic_set(&last_readahead_pages, pages);
 
 	return pages;
@@ -463,6 +536,7 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	unsigned long start_offset, end_offset;
 	unsigned long mask;
 	struct blk_plug plug;
+	bool page_read;
 
 	mask = swapin_nr_pages(offset) - 1;
 	if (!mask)
@@ -477,12 +551,14 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	blk_start_plug(&plug);
 	for (offset = start_offset; offset <= end_offset ; offset++) {
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		page = __read_swap_cache_async(swp_entry(swp_type(entry), offset),
+					       gfp_mask, vma, addr, &page_read);
 		if (!page)
 			continue;
-		if (offset != entry_offset)
+		if (page_read && offset != entry_offset) {
 			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
 		page_cache_release(page);
 	}
 	blk_finish_plug(&plug);
@@ -491,3 +567,175 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+bool swap_use_vma_readahead(void)
+{
+	return READ_ONCE(enable_vma_readahead) && !atomic_read(&nr_rotate_swap);
+}
+
+/* clamp [lpfn, rpfn) to the VMA and to the page table holding faddr */
+static void swap_ra_clamp_pfn(struct vm_area_struct *vma, unsigned long faddr,
+			      unsigned long lpfn, unsigned long rpfn,
+			      unsigned long *start, unsigned long *end)
+{
+	*start = max3(lpfn, PFN_DOWN(vma->vm_start),
+		      PFN_DOWN(faddr & PMD_MASK));
+	*end = min3(rpfn, PFN_DOWN(vma->vm_end),
+		    PFN_DOWN((faddr & PMD_MASK) + PMD_SIZE));
+}
+
+/**
+ * swap_vma_readahead - swap in pages in hope we need them soon
+ * @fentry: swap entry of the faulting page
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma the faulting address belongs to
+ * @faddr: faulting address
+ * @pmd: pmd covering @faddr
+ *
+ * Returns the struct page for @fentry, after queueing swapin.
+ *
+ * Unlike swapin_readahead(), read ahead the swap entries of the pages
+ * next to @faddr in the virtual address space of @vma. Neighbouring swap
+ * slots often belong to unrelated processes, so reading them wastes the
+ * I/O or, on zram, the decompression; neighbouring virtual pages are much
+ * more likely to be touched next. The window follows the direction of the
+ * faults and grows with the readahead hits seen in @vma since its last
+ * swap fault.
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+				struct vm_area_struct *vma, unsigned long faddr,
+				pmd_t *pmd)
+{
+	pte_t ptes[1 << SWAP_RA_ORDER_CEILING];
+	unsigned long ra_val, pfn, fpfn, start, end, left;
+	unsigned int max_win, win, prev_win, hits, i, nr;
+	struct blk_plug plug;
+	struct page *page;
+	swp_entry_t entry;
+	bool page_read;
+	pte_t *pte;
+
+	max_win = 1 << min_t(unsigned int, ACCESS_ONCE(page_cluster),
+			     SWAP_RA_ORDER_CEILING);
+	if (max_win == 1)
+		goto skip;
+
+	faddr &= PAGE_MASK;
+	fpfn = PFN_DOWN(faddr);
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
+	prev_win = SWAP_RA_WIN(ra_val);
+	hits = SWAP_RA_HITS(ra_val);
+	win = __swapin_nr_pages(pfn, fpfn, hits, max_win, prev_win);
+	atomic_long_set(&vma->swap_readahead_info,
+			SWAP_RA_VAL(faddr, win, 0));
+	if (win <= 1)
+		goto skip;
+
+	/*
+	 * Read ahead in the direction of the faults, else around faddr.
+	 * The window must not wrap below pfn 0.
+	 */
+	if (fpfn == pfn + 1) {
+		swap_ra_clamp_pfn(vma, faddr, fpfn, fpfn + win, &start, &end);
+	} else if (pfn == fpfn + 1) {
+		swap_ra_clamp_pfn(vma, faddr, max(fpfn, win - 1UL) - (win - 1),
+				  fpfn + 1, &start, &end);
+	} else {
+		left = (win - 1) / 2;
+		swap_ra_clamp_pfn(vma, faddr, max(fpfn, left) - left,
+				  fpfn + win - left, &start, &end);
+	}
+	if (end <= start + 1)
+		goto skip;
+	nr = end - start;
+
+	/*
+	 * Copy the ptes so the page table need not stay mapped while we
+	 * allocate; a stale entry only costs a wasted read, and
+	 * __read_swap_cache_async() checks that it is still in use.
+	 */
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	for (i = 0; i < nr; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	blk_start_plug(&plug);
+	for (i = 0; i < nr; i++) {
+		if (start + i == fpfn)
+			continue;
+		if (pte_none(ptes[i]) || pte_present(ptes[i]))
+			continue;
+		entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		page = __read_swap_cache_async(entry, gfp_mask, vma,
+					       (start + i) << PAGE_SHIFT,
+					       &page_read);
+		if (!page)
+			continue;
+		if (page_read) {
+			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
+		page_cache_release(page);
+	}
+	blk_finish_plug(&plug);
+	lru_add_drain();
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, faddr);
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t vma_ra_enabled_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n", enable_vma_readahead ? "true" : "false");
+}
+
+static ssize_t vma_ra_enabled_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	bool enable;
+
+	if (strtobool(buf, &enable))
+		return -EINVAL;
+	WRITE_ONCE(enable_vma_readahead, enable);
+	return count;
+}
+static struct kobj_attribute vma_ra_enabled_attr =
+	__ATTR(vma_ra_enabled, 0644, vma_ra_enabled_show,
+	       vma_ra_enabled_store);
+
+static struct attribute *swap_attrs[] = {
+	&vma_ra_enabled_attr.attr,
+	NULL,
+};
+
+static struct attribute_group swap_attr_group = {
+	.attrs = swap_attrs,
+};
+
+static int __init swap_init_sysfs(void)
+{
+	struct kobject *swap_kobj;
+	int err;
+
+	swap_kobj = kobject_create_and_add("swap", mm_kobj);
+	if (!swap_kobj) {
+		pr_err("failed to create swap kobject\n");
+		return -ENOMEM;
+	}
+	err = sysfs_create_group(swap_kobj, &swap_attr_group);
+	if (err) {
+		pr_err("failed to register swap group\n");
+		kobject_put(swap_kobj);
+		return err;
+	}
+	return 0;
+}
+subsys_initcall(swap_init_sysfs);
+#endif
@@ -48,6 +48,8 @@ static sector_t map_swap_entry(swp_entry_t, struct block_device**);
 DEFINE_SPINLOCK(swap_lock);
 static unsigned int nr_swapfiles;
 atomic_long_t nr_swap_pages;
+/* number of swap devices that are not solid state, see swap_use_vma_readahead() */
+atomic_t nr_rotate_swap = ATOMIC_INIT(0);
 /* protected with swap_lock. reading in vm_swap_full() doesn't need lock */
 long total_swap_pages;
 static int least_priority;
@@ -2127,6 +2129,8 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	 * can reuse this swap_info in alloc_swap_info() safely.  It is ok to
 	 * not hold p->lock after we cleared its SWP_WRITEOK.
 	 */
+	if (!(p->flags & SWP_SOLIDSTATE))
+		atomic_dec(&nr_rotate_swap);
 	spin_lock(&swap_lock);
 	p->flags = 0;
 	spin_unlock(&swap_lock);
@@ -2701,6 +2705,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 		prio =
 		  (swap_flags & SWAP_FLAG_PRIO_MASK) >> SWAP_FLAG_PRIO_SHIFT;
 	enable_swap_info(p, prio, swap_map, cluster_info, frontswap_map);
+	if (!(p->flags & SWP_SOLIDSTATE))
+		atomic_inc(&nr_rotate_swap);
 
 	pr_info("Adding %uk swap on %s.  "
 			"Priority:%d extents:%d across:%lluk %s%s%s%s%s\n",
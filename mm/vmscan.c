@@ -1972,6 +1972,87 @@ static unsigned long history[2] = {0};
 
 #endif /* CONFIG_ZRAM */
 
+#ifdef CONFIG_SWAP
+/*
+ * Refault driven file protection
+ *
+ * workingset_refault() counts, per lruvec, the file pages that are read
+ * back in soon after reclaim evicted them. Once those refaults amount to
+ * more than refault_protect_thresh per mille of the file LRUs per period,
+ * reclaiming cache only feeds the next read, as with APK and odex pages
+ * during an app cold start. Part of the file pressure is then moved to
+ * anon, which can go to zram, as long as a quarter of swap is free.
+ *
+ * The moved share grows from 0 at the threshold towards
+ * refault_protect_max percent. workingset_protect in /proc/vmstat counts
+ * the scan rounds that moved pressure, and workingset_protect_pct the
+ * percentages they moved, so their ratio is the mean balance point.
+ */
+#define REFAULT_PERIOD		(HZ / 10)
+
+static int vmscan_refault_protect = 1;
+module_param_named(refault_protect, vmscan_refault_protect, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(refault_protect, "move scan pressure off thrashing file LRUs");
+
+static unsigned int vmscan_refault_protect_thresh = 2;
+module_param_named(refault_protect_thresh, vmscan_refault_protect_thresh, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(refault_protect_thresh, "file refaults per mille of the file LRUs per 100ms to start protecting");
+
+static unsigned int vmscan_refault_protect_max = 90;
+module_param_named(refault_protect_max, vmscan_refault_protect_max, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(refault_protect_max, "largest percentage of file pressure moved to anon");
+
+static unsigned int lruvec_file_protect(struct lruvec *lruvec)
+{
+	struct zone *zone = lruvec_zone(lruvec);
+	unsigned long now = jiffies;
+	unsigned long periods, refaults, file, permille;
+	unsigned int thresh = vmscan_refault_protect_thresh;
+	unsigned int protect = 0;
+
+	if (!vmscan_refault_protect || !thresh)
+		return 0;
+
+	/* zram filling up, anon pages have nowhere to go */
+	if (get_nr_swap_pages() < total_swap_pages / 4)
+		return 0;
+
+	if (time_before(now, lruvec->refault_stamp + REFAULT_PERIOD))
+		return ACCESS_ONCE(lruvec->file_protect);
+
+	spin_lock_irq(&zone->lru_lock);
+	if (time_before(now, lruvec->refault_stamp + REFAULT_PERIOD)) {
+		protect = lruvec->file_protect;
+		goto out;
+	}
+
+	/* average over the last periods, halved for every idle one */
+	periods = (now - lruvec->refault_stamp) / REFAULT_PERIOD;
+	lruvec->refault_stamp = now;
+	if (periods > 1)
+		lruvec->refault_avg >>= min(periods - 1, BITS_PER_LONG - 1UL);
+	refaults = atomic_long_xchg(&lruvec->refaults, 0);
+	lruvec->refault_avg = (lruvec->refault_avg + refaults) / 2;
+
+	file = get_lru_size(lruvec, LRU_ACTIVE_FILE) +
+	       get_lru_size(lruvec, LRU_INACTIVE_FILE);
+	permille = lruvec->refault_avg * 1000 / (file + 1);
+	if (permille > thresh)
+		protect = vmscan_refault_protect_max * (permille - thresh) /
+			  permille;
+	lruvec->file_protect = min(protect, 100U);
+	protect = lruvec->file_protect;
+out:
+	spin_unlock_irq(&zone->lru_lock);
+	return protect;
+}
+#else
+static unsigned int lruvec_file_protect(struct lruvec *lruvec)
+{
+	return 0;
+}
+#endif /* CONFIG_SWAP */
+
 /*
  * Determine how aggressively the anon and file LRU lists should be
  * scanned.  The relative value of each set of LRU lists is determined
@@ -1991,6 +2072,7 @@ static void get_scan_count(struct lruvec *lruvec, int swappiness,
 	unsigned long anon_prio, file_prio;
 	enum scan_balance scan_balance;
 	unsigned long anon, file;
+	unsigned int file_protect;
 	bool force_scan = false;
 	unsigned long ap, fp;
 	enum lru_list lru;
@@ -2071,9 +2153,12 @@ static void get_scan_count(struct lruvec *lruvec, int swappiness,
 
 	/*
 	 * There is enough inactive page cache, do not reclaim
-	 * anything from the anonymous working set right now.
+	 * anything from the anonymous working set right now,
+	 * unless that cache is thrashing. With swappiness at 0 the
+	 * anonymous working set is never traded for the cache.
 	 */
-	if (!inactive_file_is_low(lruvec)) {
+	file_protect = vmscan_swappiness(sc) ? lruvec_file_protect(lruvec) : 0;
+	if (!file_protect && !inactive_file_is_low(lruvec)) {
 		scan_balance = SCAN_FILE;
 		goto out;
 	}
@@ -2151,6 +2236,15 @@ static void get_scan_count(struct lruvec *lruvec, int swappiness,
 	}
 #endif /* CONFIG_ZRAM */
 
+	if (file_protect) {
+		unsigned long moved = file_prio * file_protect / 100;
+
+		file_prio -= moved;
+		anon_prio += moved;
+		count_vm_event(WORKINGSET_PROTECT);
+		count_vm_events(WORKINGSET_PROTECT_PCT, file_protect);
+	}
+
 	/*
 	 * OK, so we have swap space and a fair amount of page cache
 	 * pages.  We use the recently rotated / recently scanned
@@ -3533,7 +3627,8 @@ out:
 	return order;
 }
 
-static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
+static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx,
+				int alloc_order)
 {
 	long remaining = 0;
 	DEFINE_WAIT(wait);
@@ -3545,6 +3640,12 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 
 	/* Try to sleep for a short interval */
 	if (prepare_kswapd_sleep(pgdat, order, remaining, classzone_idx)) {
+		/*
+		 * The memory is freed, now let kcompactd make the order
+		 * kswapd was woken for available.
+		 */
+		wakeup_kcompactd(pgdat, alloc_order);
+
 		remaining = schedule_timeout(HZ/10);
 		finish_wait(&pgdat->kswapd_wait, &wait);
 		prepare_to_wait(&pgdat->kswapd_wait, &wait, TASK_INTERRUPTIBLE);
@@ -3665,7 +3766,7 @@ static int kswapd(void *p)
 			classzone_idx = new_classzone_idx;
 		} else {
 			kswapd_try_to_sleep(pgdat, balanced_order,
-						balanced_classzone_idx);
+						balanced_classzone_idx, order);
 			order = pgdat->kswapd_max_order;
 			classzone_idx = pgdat->classzone_idx;
 			new_order = order;
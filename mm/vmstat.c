@@ -841,6 +841,14 @@ const char * const vmstat_text[] = {
 	"drop_pagecache",
 	"drop_slab",
 
+	"workingset_protect",
+	"workingset_protect_pct",
+
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+#endif
+
 #ifdef CONFIG_NUMA_BALANCING
 	"numa_pte_updates",
 	"numa_huge_pte_updates",
@@ -859,6 +867,11 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_direct_scanned",
+	"compact_direct_migrated",
+	"compact_proactive_wake",
+	"compact_proactive_scanned",
+	"compact_proactive_migrated",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
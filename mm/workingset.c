@@ -231,11 +231,24 @@ void *workingset_eviction(struct address_space *mapping, struct page *page)
 bool workingset_refault(void *shadow)
 {
 	unsigned long refault_distance;
+	struct lruvec *lruvec;
 	struct zone *zone;
 
 	unpack_shadow(shadow, &zone, &refault_distance);
 	inc_zone_state(zone, WORKINGSET_REFAULT);
 
+	/*
+	 * Charge the refault to the group of the task reading the page
+	 * back in, for the reclaim balance in get_scan_count(). The shadow
+	 * entry does not record the group that owned the evicted page, so
+	 * when a task faults in another group's cache, that other group's
+	 * file LRU is not the one protected.
+	 */
+	rcu_read_lock();
+	lruvec = mem_cgroup_zone_lruvec(zone, mem_cgroup_from_task(current));
+	atomic_long_inc(&lruvec->refaults);
+	rcu_read_unlock();
+
 	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
 		inc_zone_state(zone, WORKINGSET_ACTIVATE);
 		return true;
@@ -16,6 +16,7 @@
 
 #include <linux/file.h>
 #include <linux/inetdevice.h>
+#include <linux/jhash.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
@@ -127,6 +128,10 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
 static LIST_HEAD(iface_stat_list);
 static DEFINE_SPINLOCK(iface_stat_list_lock);
 
+static DEFINE_PER_CPU(struct qtu_pcpu_cache, qtu_pcpu_cache);
+/* see struct qtu_pcpu_lookup */
+static atomic_t qtu_tag_gen = ATOMIC_INIT(0);
+
 static struct rb_root sock_tag_tree = RB_ROOT;
 static DEFINE_SPINLOCK(sock_tag_list_lock);
 
@@ -166,8 +171,8 @@ static bool can_read_other_uid_stats(kuid_t uid)
 static inline void dc_add_byte_packets(struct data_counters *counters, int set,
 				  enum ifs_tx_rx direction,
 				  enum ifs_proto ifs_proto,
-				  int bytes,
-				  int packets)
+				  uint64_t bytes,
+				  uint64_t packets)
 {
 	counters->bpc[set][direction][ifs_proto].bytes += bytes;
 	counters->bpc[set][direction][ifs_proto].packets += packets;
@@ -1078,6 +1083,65 @@ static struct sock_tag *get_sock_stat(const struct sock *sk)
 	return sock_tag_entry;
 }
 
+/*
+ * Called after the sock_tag_tree or the tag_counter_set_tree changed,
+ * before the lock protecting it is dropped.
+ */
+static void qtu_tag_changed(void)
+{
+	smp_wmb();	/* the change before the new generation */
+	atomic_inc(&qtu_tag_gen);
+}
+
+/*
+ * Find the tag a packet of @sk is charged to, and the active counter set
+ * of its uid. The answer is kept per cpu until a sock tag or counter set
+ * changes, so a flow does not take sock_tag_list_lock and
+ * tag_counter_set_list_lock for every packet. A tagged sk holds a
+ * reference, so its address cannot be reused before it is untagged.
+ */
+static tag_t qtu_lookup_tag(const struct sock *sk, uid_t uid, int *set)
+{
+	struct sock_tag *sock_tag_entry;
+	struct qtu_pcpu_lookup *last;
+	int gen = atomic_read(&qtu_tag_gen) + 1;
+	tag_t tag;
+
+	smp_rmb();	/* the generation before the trees */
+
+	/* the OUTPUT hook runs with bh enabled */
+	local_bh_disable();
+	last = &this_cpu_ptr(&qtu_pcpu_cache)->last;
+	if (last->gen == gen && last->sk == sk && last->uid == uid) {
+		tag = last->tag;
+		*set = last->set;
+		local_bh_enable();
+		return tag;
+	}
+	local_bh_enable();
+
+	/*
+	 * Look for a tagged sock.
+	 * It will have an acct_uid.
+	 */
+	sock_tag_entry = get_sock_stat(sk);
+	if (sock_tag_entry)
+		tag = sock_tag_entry->tag;
+	else
+		tag = combine_atag_with_uid(make_atag_from_value(0), uid);
+	*set = get_active_counter_set(tag);
+
+	local_bh_disable();
+	last = &this_cpu_ptr(&qtu_pcpu_cache)->last;
+	last->sk = sk;
+	last->uid = uid;
+	last->tag = tag;
+	last->set = *set;
+	last->gen = gen;
+	local_bh_enable();
+	return tag;
+}
+
 static int ipx_proto(const struct sk_buff *skb,
 		     struct xt_action_param *par)
 {
@@ -1099,25 +1163,26 @@ static int ipx_proto(const struct sk_buff *skb,
 	return tproto;
 }
 
-static void
-data_counters_update(struct data_counters *dc, int set,
-		     enum ifs_tx_rx direction, int proto, int bytes)
+static enum ifs_proto ifs_proto_of(int proto)
 {
 	switch (proto) {
 	case IPPROTO_TCP:
-		dc_add_byte_packets(dc, set, direction, IFS_TCP, bytes, 1);
-		break;
+		return IFS_TCP;
 	case IPPROTO_UDP:
-		dc_add_byte_packets(dc, set, direction, IFS_UDP, bytes, 1);
-		break;
+		return IFS_UDP;
 	case IPPROTO_IP:
 	default:
-		dc_add_byte_packets(dc, set, direction, IFS_PROTO_OTHER, bytes,
-				    1);
-		break;
+		return IFS_PROTO_OTHER;
 	}
 }
 
+static void
+data_counters_update(struct data_counters *dc, int set,
+		     enum ifs_tx_rx direction, int proto, int bytes)
+{
+	dc_add_byte_packets(dc, set, direction, ifs_proto_of(proto), bytes, 1);
+}
+
 /*
  * Update stats for the specified interface. Do nothing if the entry
  * does not exist (when a device was never configured with an IP address).
@@ -1273,54 +1338,24 @@ done:
 	return new_tag_stat_entry;
 }
 
-static void if_tag_stat_update(const char *ifname, uid_t uid,
-			       const struct sock *sk, enum ifs_tx_rx direction,
-			       int proto, int bytes)
+/*
+ * Find the entry for {acct_tag, uid_tag} within the interface, creating
+ * it and its {0, uid_tag} parent as needed.
+ * iface_entry->tag_stat_list_lock should be held.
+ */
+static struct tag_stat *get_if_tag_stat(struct iface_stat *iface_entry,
+					tag_t tag)
 {
 	struct tag_stat *tag_stat_entry;
-	tag_t tag, acct_tag;
-	tag_t uid_tag;
+	tag_t acct_tag = get_atag_from_tag(tag);
+	tag_t uid_tag = get_utag_from_tag(tag);
 	struct data_counters *uid_tag_counters;
-	struct sock_tag *sock_tag_entry;
-	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
-	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
-		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
-		 ifname, uid, sk, direction, proto, bytes);
-
-	spin_lock_bh(&iface_stat_list_lock);
-	iface_entry = get_iface_entry(ifname);
-	if (!iface_entry) {
-		pr_err_ratelimited("qtaguid: iface_stat: stat_update() "
-				   "%s not found\n", ifname);
-		spin_unlock_bh(&iface_stat_list_lock);
-		return;
-	}
-	/* It is ok to process data when an iface_entry is inactive */
 
-	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
-		 ifname, iface_entry);
-
-	/*
-	 * Look for a tagged sock.
-	 * It will have an acct_uid.
-	 */
-	sock_tag_entry = get_sock_stat(sk);
-	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
-		acct_tag = get_atag_from_tag(tag);
-		uid_tag = get_utag_from_tag(tag);
-	} else {
-		acct_tag = make_atag_from_value(0);
-		tag = combine_atag_with_uid(acct_tag, uid);
-		uid_tag = make_tag_from_uid(uid);
-	}
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
 	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
-
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
 					      tag);
 	if (tag_stat_entry) {
@@ -1328,8 +1363,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
-		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		goto unlock;
+		return tag_stat_entry;
 	}
 
 	/* Loop over tag list under this interface for {0,uid_tag} */
@@ -1343,7 +1377,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
 		if (!new_tag_stat)
-			goto unlock;
+			return NULL;
 		uid_tag_counters = &new_tag_stat->counters;
 	} else {
 		uid_tag_counters = &tag_stat_entry->counters;
@@ -1353,7 +1387,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		/* Create the child {acct_tag, uid_tag} and hook up parent. */
 		new_tag_stat = create_if_tag_stat(iface_entry, tag);
 		if (!new_tag_stat)
-			goto unlock;
+			return NULL;
 		new_tag_stat->parent_counters = uid_tag_counters;
 	} else {
 		/*
@@ -1366,8 +1400,172 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		BUG_ON(!new_tag_stat);
 	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
-unlock:
+	return new_tag_stat;
+}
+
+static u32 qtu_pcpu_hash(const char *ifname, tag_t tag, int set)
+{
+	return jhash(ifname, strnlen(ifname, IFNAMSIZ),
+		     (u32)tag ^ (u32)(tag >> 32) ^ set);
+}
+
+/*
+ * Account a packet in this cpu's cache. Returns false when there is no
+ * room and the caller has to update the tag_stat_tree itself.
+ */
+static bool qtu_pcpu_update(const char *ifname, tag_t tag, int set,
+			    enum ifs_tx_rx direction, int proto, int bytes)
+{
+	struct qtu_pcpu_cache *cache;
+	struct qtu_pcpu_entry *entry;
+	struct byte_packet_counters *bpc;
+	u32 hash = qtu_pcpu_hash(ifname, tag, set);
+	bool found = false;
+	int i;
+
+	/* the OUTPUT hook runs with bh enabled */
+	local_bh_disable();
+	cache = this_cpu_ptr(&qtu_pcpu_cache);
+	spin_lock(&cache->lock);
+	for (i = 0; i < QTU_PCPU_PROBES; i++) {
+		entry = &cache->entries[(hash + i) & (QTU_PCPU_ENTRIES - 1)];
+		if (!entry->ifname[0]) {
+			strlcpy(entry->ifname, ifname, IFNAMSIZ);
+			entry->tag = tag;
+			entry->set = set;
+			found = true;
+			break;
+		}
+		if (entry->tag == tag && entry->set == set &&
+		    !strncmp(entry->ifname, ifname, IFNAMSIZ)) {
+			found = true;
+			break;
+		}
+	}
+	if (found) {
+		bpc = &entry->bpc[direction][ifs_proto_of(proto)];
+		bpc->bytes += bytes;
+		bpc->packets++;
+	}
+	spin_unlock(&cache->lock);
+	local_bh_enable();
+	return found;
+}
+
+static void tag_stat_add(struct data_counters *dc,
+			 const struct qtu_pcpu_entry *entry)
+{
+	int dir, proto;
+
+	for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+		for (proto = 0; proto < IFS_MAX_PROTOS; proto++)
+			dc_add_byte_packets(dc, entry->set, dir, proto,
+					    entry->bpc[dir][proto].bytes,
+					    entry->bpc[dir][proto].packets);
+}
+
+/*
+ * Move the per-cpu deltas into the tag_stat_trees.
+ * Caller must hold iface_stat_list_lock.
+ */
+static void qtu_pcpu_fold_locked(void)
+{
+	struct iface_stat *iface_entry;
+	struct qtu_pcpu_cache *cache;
+	struct qtu_pcpu_entry *entry;
+	struct tag_stat *ts_entry;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		cache = &per_cpu(qtu_pcpu_cache, cpu);
+		spin_lock(&cache->lock);
+		for (i = 0; i < QTU_PCPU_ENTRIES; i++) {
+			entry = &cache->entries[i];
+			if (!entry->ifname[0])
+				continue;
+
+			iface_entry = get_iface_entry(entry->ifname);
+			if (!iface_entry) {
+				pr_err_ratelimited("qtaguid: iface_stat: stat_update() "
+						   "%s not found\n", entry->ifname);
+				goto clear;
+			}
+			spin_lock_bh(&iface_entry->tag_stat_list_lock);
+			ts_entry = get_if_tag_stat(iface_entry, entry->tag);
+			if (ts_entry) {
+				tag_stat_add(&ts_entry->counters, entry);
+				if (ts_entry->parent_counters)
+					tag_stat_add(ts_entry->parent_counters,
+						     entry);
+			}
+			spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+clear:
+			memset(entry, 0, sizeof(*entry));
+		}
+		spin_unlock(&cache->lock);
+	}
+}
+
+/*
+ * Throw away the per-cpu deltas of a uid, only those of @tag if its
+ * acct_tag is not 0. A half emptied probe sequence only means that a
+ * key may get a second entry, the fold adds both.
+ * Caller must hold iface_stat_list_lock.
+ */
+static void qtu_pcpu_drop_locked(uid_t uid, tag_t tag)
+{
+	struct qtu_pcpu_cache *cache;
+	struct qtu_pcpu_entry *entry;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		cache = &per_cpu(qtu_pcpu_cache, cpu);
+		spin_lock(&cache->lock);
+		for (i = 0; i < QTU_PCPU_ENTRIES; i++) {
+			entry = &cache->entries[i];
+			if (!entry->ifname[0] ||
+			    get_uid_from_tag(entry->tag) != uid)
+				continue;
+			if (!get_atag_from_tag(tag) || entry->tag == tag)
+				memset(entry, 0, sizeof(*entry));
+		}
+		spin_unlock(&cache->lock);
+	}
+}
+
+static void if_tag_stat_update(const char *ifname, uid_t uid,
+			       const struct sock *sk, enum ifs_tx_rx direction,
+			       int proto, int bytes)
+{
+	struct tag_stat *tag_stat_entry;
+	tag_t tag;
+	int set;
+	struct iface_stat *iface_entry;
+	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
+		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
+		 ifname, uid, sk, direction, proto, bytes);
+
+	tag = qtu_lookup_tag(sk, uid, &set);
+	if (qtu_pcpu_update(ifname, tag, set, direction, proto, bytes))
+		return;
+
+	spin_lock_bh(&iface_stat_list_lock);
+	iface_entry = get_iface_entry(ifname);
+	if (!iface_entry) {
+		pr_err_ratelimited("qtaguid: iface_stat: stat_update() "
+				   "%s not found\n", ifname);
+		spin_unlock_bh(&iface_stat_list_lock);
+		return;
+	}
+	/* It is ok to process data when an iface_entry is inactive */
+
+	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
+		 ifname, iface_entry);
+
+	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+	tag_stat_entry = get_if_tag_stat(iface_entry, tag);
+	if (tag_stat_entry)
+		tag_stat_update(tag_stat_entry, direction, proto, bytes);
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 	spin_unlock_bh(&iface_stat_list_lock);
 }
@@ -2067,6 +2265,7 @@ static int ctrl_cmd_delete(const char *input)
 				list_del(&st_entry->list);
 		}
 	}
+	qtu_tag_changed();
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
 
@@ -2085,6 +2284,7 @@ static int ctrl_cmd_delete(const char *input)
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
 		kfree(tcs_entry);
+		qtu_tag_changed();
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -2093,6 +2293,7 @@ static int ctrl_cmd_delete(const char *input)
 	 * erased.
 	 */
 	spin_lock_bh(&iface_stat_list_lock);
+	qtu_pcpu_drop_locked(uid_int, tag);
 	list_for_each_entry(iface_entry, &iface_stat_list, list) {
 		spin_lock_bh(&iface_entry->tag_stat_list_lock);
 		node = rb_first(&iface_entry->tag_stat_tree);
@@ -2203,6 +2404,7 @@ static int ctrl_cmd_counter_set(const char *input)
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
 	tcs->active_set = counter_set;
+	qtu_tag_changed();
 	spin_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
@@ -2347,6 +2549,7 @@ static int ctrl_cmd_tag(const char *input)
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
+	qtu_tag_changed();
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
 	/* We keep the ref to the sk until it is untagged */
@@ -2450,6 +2653,7 @@ int qtaguid_untag(struct socket *el_socket, bool kernel)
 	 * only during a cmd_delete().
 	 */
 	tag_ref_entry->num_sock_tags--;
+	qtu_tag_changed();
 	spin_unlock_bh(&sock_tag_list_lock);
 	/*
 	 * Release the sock_fd that was grabbed at tag time.
@@ -2677,6 +2881,7 @@ static void *qtaguid_stats_proc_start(struct seq_file *m, loff_t *pos)
 	spin_lock_bh(&iface_stat_list_lock);
 
 	if (*pos == 0) {
+		qtu_pcpu_fold_locked();
 		ppi->item_index = 1;
 		ppi->tag_pos = 0;
 		if (list_empty(&iface_stat_list)) {
@@ -2886,6 +3091,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 	kfree(pqd_entry);
 	file->private_data = NULL;
 
+	qtu_tag_changed();
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
 
@@ -3015,6 +3221,11 @@ static struct xt_match qtaguid_mt_reg __read_mostly = {
 
 static int __init qtaguid_mt_init(void)
 {
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(qtu_pcpu_cache, cpu).lock);
+
 	if (qtaguid_proc_register(&xt_qtaguid_procdir)
 	    || iface_stat_init(xt_qtaguid_procdir)
 	    || xt_register_match(&qtaguid_mt_reg)
@@ -11,6 +11,7 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/if.h>
 #include <linux/rbtree.h>
 #include <linux/spinlock_types.h>
 #include <linux/workqueue.h>
@@ -241,6 +242,43 @@ struct iface_stat {
 	spinlock_t tag_stat_list_lock;
 };
 
+/*
+ * Per-cpu tag stat deltas. The per packet path adds to the entry of its
+ * cpu for {ifname, tag, counter set} and never touches the global
+ * iface_stat_list_lock. The deltas are moved into the tag_stat_tree of
+ * the iface when the stats are read. A packet that finds no entry within
+ * a few probes takes the iface_stat_list_lock path instead.
+ */
+#define QTU_PCPU_ENTRIES	64
+#define QTU_PCPU_PROBES		4
+
+struct qtu_pcpu_entry {
+	char ifname[IFNAMSIZ];	/* empty for a free entry */
+	tag_t tag;
+	int set;
+	struct byte_packet_counters bpc[IFS_MAX_DIRECTIONS][IFS_MAX_PROTOS];
+};
+
+/*
+ * The last sock tag and counter set lookup of a cpu. It is valid while
+ * gen matches qtu_tag_gen, which changes whenever a sock tag or a counter
+ * set does.
+ */
+struct qtu_pcpu_lookup {
+	const struct sock *sk;
+	uid_t uid;
+	int gen;		/* qtu_tag_gen + 1, 0 for none */
+	tag_t tag;
+	int set;
+};
+
+struct qtu_pcpu_cache {
+	/* only contended while the stats are folded */
+	spinlock_t lock;
+	struct qtu_pcpu_entry entries[QTU_PCPU_ENTRIES];
+	struct qtu_pcpu_lookup last;	/* only used with bh disabled */
+};
+
 /* This is needed to create proc_dir_entries from atomic context. */
 struct iface_stat_work {
 	struct work_struct iface_work;
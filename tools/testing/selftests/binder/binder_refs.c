@@ -0,0 +1,393 @@
+/*
+ * binder_refs - cost of binder ref lookup and insert with many refs
+ *
+ * A server process becomes the context manager of a binder device and a
+ * client sends it transactions carrying local binder objects, so the
+ * server ends up holding one ref per object. The server keeps each ref
+ * alive with BC_INCREFS. Reported per ref:
+ *
+ *   insert       new objects: node and ref creation, desc allocation
+ *   node lookup  the same objects again: ref found by node
+ *   desc lookup  BC_INCREFS/BC_DECREFS on every handle in the server:
+ *                ref found by desc
+ *
+ * Needs a binder device nobody else is context manager of, e.g. on a
+ * plain Linux box, or a spare device from binder.devices on Android.
+ *
+ * Usage: binder_refs [-d device] [-n refs] [-b objects per transaction]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/types.h>
+
+#define __packed __attribute__((packed))
+#include "binder.h"
+
+#define MAP_SIZE	(4 << 20)
+#define READ_SIZE	4096
+#define CMD_CHUNK	4096
+
+enum {
+	CODE_ADD = 1,		/* take a weak ref on every handle */
+	CODE_LOOKUP,		/* time desc lookups, reply with the ns */
+	CODE_EXIT,
+};
+
+static const char *dev = "/dev/binder";
+static int nr_refs = 50000;
+static int batch = 128;
+
+struct bctx {
+	int fd;
+	char rbuf[READ_SIZE];
+	size_t rpos, rlen;
+	/* handles held by the server */
+	uint32_t *handles;
+	int nr_handles;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	fprintf(stderr, "%s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static void bwrite(struct bctx *b, const void *buf, size_t len)
+{
+	struct binder_write_read bwr;
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_buffer = (uintptr_t)buf;
+	bwr.write_size = len;
+	while (bwr.write_consumed < len)
+		if (ioctl(b->fd, BINDER_WRITE_READ, &bwr) < 0 && errno != EINTR)
+			die("BINDER_WRITE_READ write");
+}
+
+static void bread(struct bctx *b)
+{
+	struct binder_write_read bwr;
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.read_buffer = (uintptr_t)b->rbuf;
+	bwr.read_size = sizeof(b->rbuf);
+	while (ioctl(b->fd, BINDER_WRITE_READ, &bwr) < 0)
+		if (errno != EINTR)
+			die("BINDER_WRITE_READ read");
+	b->rpos = 0;
+	b->rlen = bwr.read_consumed;
+}
+
+/* next return command, its payload is copied to @data */
+static uint32_t next_br(struct bctx *b, void *data)
+{
+	uint32_t cmd;
+
+	while (b->rpos >= b->rlen)
+		bread(b);
+	memcpy(&cmd, b->rbuf + b->rpos, sizeof(cmd));
+	b->rpos += sizeof(cmd);
+	if (_IOC_SIZE(cmd)) {
+		memcpy(data, b->rbuf + b->rpos, _IOC_SIZE(cmd));
+		b->rpos += _IOC_SIZE(cmd);
+	}
+	return cmd;
+}
+
+static void free_buffer(struct bctx *b, binder_uintptr_t buffer)
+{
+	struct {
+		uint32_t cmd;
+		binder_uintptr_t buffer;
+	} __packed c = { BC_FREE_BUFFER, buffer };
+
+	bwrite(b, &c, sizeof(c));
+}
+
+static void send_txn(struct bctx *b, uint32_t cmd, uint32_t code,
+		     const void *data, size_t size,
+		     const binder_size_t *offs, size_t nr_offs)
+{
+	struct {
+		uint32_t cmd;
+		struct binder_transaction_data tr;
+	} __packed c;
+
+	memset(&c, 0, sizeof(c));
+	c.cmd = cmd;
+	c.tr.target.handle = 0;
+	c.tr.code = code;
+	c.tr.data_size = size;
+	c.tr.offsets_size = nr_offs * sizeof(*offs);
+	c.tr.data.ptr.buffer = (uintptr_t)data;
+	c.tr.data.ptr.offsets = (uintptr_t)offs;
+	bwrite(b, &c, sizeof(c));
+}
+
+/* acknowledge node ref requests the way libbinder does */
+static int handle_node_cmd(struct bctx *b, uint32_t cmd, void *data)
+{
+	struct {
+		uint32_t cmd;
+		struct binder_ptr_cookie pc;
+	} __packed c;
+
+	switch (cmd) {
+	case BR_INCREFS:
+	case BR_ACQUIRE:
+		c.cmd = cmd == BR_INCREFS ? BC_INCREFS_DONE : BC_ACQUIRE_DONE;
+		memcpy(&c.pc, data, sizeof(c.pc));
+		bwrite(b, &c, sizeof(c));
+		return 1;
+	case BR_RELEASE:
+	case BR_DECREFS:
+	case BR_NOOP:
+	case BR_TRANSACTION_COMPLETE:
+	case BR_SPAWN_LOOPER:
+		return 1;
+	}
+	return 0;
+}
+
+static unsigned long long server_lookup(struct bctx *b)
+{
+	uint32_t *cmds;
+	unsigned long long start;
+	int i, n;
+
+	cmds = malloc(CMD_CHUNK * 2 * sizeof(uint32_t));
+	if (!cmds)
+		die("malloc");
+
+	start = now_ns();
+	for (i = 0; i < b->nr_handles; i += CMD_CHUNK / 2) {
+		for (n = 0; n < CMD_CHUNK / 2 && i + n < b->nr_handles; n++) {
+			cmds[4 * n] = BC_INCREFS;
+			cmds[4 * n + 1] = b->handles[i + n];
+			cmds[4 * n + 2] = BC_DECREFS;
+			cmds[4 * n + 3] = b->handles[i + n];
+		}
+		bwrite(b, cmds, n * 4 * sizeof(uint32_t));
+	}
+	free(cmds);
+	return now_ns() - start;
+}
+
+static void server(int ready)
+{
+	struct binder_transaction_data tr;
+	unsigned long long ns;
+	struct bctx *b;
+	uint32_t cmd, *cmds;
+	char data[128];
+	int i, n, done = 0;
+	binder_size_t *offs;
+
+	b = calloc(1, sizeof(*b));
+	b->handles = malloc(nr_refs * sizeof(uint32_t));
+	cmds = malloc(batch * 2 * sizeof(uint32_t));
+	if (!b || !b->handles || !cmds)
+		die("malloc");
+
+	b->fd = open(dev, O_RDWR | O_CLOEXEC);
+	if (b->fd < 0)
+		die(dev);
+	if (mmap(NULL, MAP_SIZE, PROT_READ, MAP_PRIVATE, b->fd, 0) == MAP_FAILED)
+		die("mmap");
+	if (ioctl(b->fd, BINDER_SET_CONTEXT_MGR, 0) < 0)
+		die("BINDER_SET_CONTEXT_MGR");
+	cmd = BC_ENTER_LOOPER;
+	bwrite(b, &cmd, sizeof(cmd));
+
+	if (write(ready, "r", 1) != 1)
+		die("write");
+	close(ready);
+
+	while (!done) {
+		cmd = next_br(b, data);
+		if (handle_node_cmd(b, cmd, data))
+			continue;
+		if (cmd != BR_TRANSACTION) {
+			fprintf(stderr, "server: unexpected return 0x%x\n", cmd);
+			exit(1);
+		}
+		memcpy(&tr, data, sizeof(tr));
+
+		ns = 0;
+		switch (tr.code) {
+		case CODE_ADD:
+			offs = (binder_size_t *)(uintptr_t)tr.data.ptr.offsets;
+			n = tr.offsets_size / sizeof(*offs);
+			for (i = 0; i < n; i++) {
+				struct flat_binder_object *obj;
+
+				obj = (void *)(uintptr_t)(tr.data.ptr.buffer + offs[i]);
+				cmds[2 * i] = BC_INCREFS;
+				cmds[2 * i + 1] = obj->handle;
+				/* the first pass hands out all the handles */
+				if (b->nr_handles < nr_refs)
+					b->handles[b->nr_handles++] = obj->handle;
+			}
+			bwrite(b, cmds, n * 2 * sizeof(uint32_t));
+			break;
+		case CODE_LOOKUP:
+			ns = server_lookup(b);
+			break;
+		case CODE_EXIT:
+			done = 1;
+			break;
+		}
+		free_buffer(b, tr.data.ptr.buffer);
+		send_txn(b, BC_REPLY, 0, &ns, sizeof(ns), NULL, 0);
+	}
+	/* let the last reply go out before the fd goes away */
+	do {
+		cmd = next_br(b, data);
+	} while (cmd != BR_TRANSACTION_COMPLETE);
+	_exit(0);
+}
+
+/* one call to the server, returns the 64 bit reply */
+static unsigned long long call(struct bctx *b, uint32_t code,
+			       const void *data, size_t size,
+			       const binder_size_t *offs, size_t nr_offs)
+{
+	struct binder_transaction_data tr;
+	unsigned long long ret = 0;
+	char buf[128];
+	uint32_t cmd;
+
+	send_txn(b, BC_TRANSACTION, code, data, size, offs, nr_offs);
+	for (;;) {
+		cmd = next_br(b, buf);
+		if (handle_node_cmd(b, cmd, buf))
+			continue;
+		if (cmd != BR_REPLY) {
+			fprintf(stderr, "client: unexpected return 0x%x\n", cmd);
+			exit(1);
+		}
+		memcpy(&tr, buf, sizeof(tr));
+		if (tr.data_size >= sizeof(ret))
+			memcpy(&ret, (void *)(uintptr_t)tr.data.ptr.buffer,
+			       sizeof(ret));
+		free_buffer(b, tr.data.ptr.buffer);
+		return ret;
+	}
+}
+
+/* send all objects once, returns the ns it took */
+static unsigned long long send_objects(struct bctx *b,
+				       struct flat_binder_object *objs,
+				       binder_size_t *offs)
+{
+	unsigned long long start = now_ns();
+	int i, n;
+
+	for (i = 0; i < nr_refs; i += batch) {
+		n = nr_refs - i < batch ? nr_refs - i : batch;
+		call(b, CODE_ADD, &objs[i], n * sizeof(*objs), offs, n);
+	}
+	return now_ns() - start;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long insert, relookup, lookup;
+	struct flat_binder_object *objs;
+	binder_size_t *offs;
+	struct bctx *b;
+	int opt, pipefd[2], status, i;
+	pid_t pid;
+	char c;
+
+	while ((opt = getopt(argc, argv, "d:n:b:")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'n':
+			nr_refs = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-d device] [-n refs] [-b objects per transaction]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (nr_refs < 1 || batch < 1 || batch > 1024) {
+		fprintf(stderr, "need at least one ref and 1..1024 per batch\n");
+		return 1;
+	}
+
+	if (pipe(pipefd))
+		die("pipe");
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		close(pipefd[0]);
+		server(pipefd[1]);
+	}
+	close(pipefd[1]);
+	if (read(pipefd[0], &c, 1) != 1) {
+		fprintf(stderr, "server failed to start\n");
+		return 1;
+	}
+
+	b = calloc(1, sizeof(*b));
+	objs = calloc(nr_refs, sizeof(*objs));
+	offs = calloc(batch, sizeof(*offs));
+	if (!b || !objs || !offs)
+		die("calloc");
+	for (i = 0; i < nr_refs; i++) {
+		objs[i].hdr.type = BINDER_TYPE_BINDER;
+		objs[i].flags = 0x7f;
+		/* never dereferenced, only has to be unique */
+		objs[i].binder = (i + 1) * 16;
+		objs[i].cookie = i;
+	}
+	for (i = 0; i < batch; i++)
+		offs[i] = i * sizeof(*objs);
+
+	b->fd = open(dev, O_RDWR | O_CLOEXEC);
+	if (b->fd < 0)
+		die(dev);
+	if (mmap(NULL, MAP_SIZE, PROT_READ, MAP_PRIVATE, b->fd, 0) == MAP_FAILED)
+		die("mmap");
+
+	insert = send_objects(b, objs, offs);
+	relookup = send_objects(b, objs, offs);
+	lookup = call(b, CODE_LOOKUP, NULL, 0, NULL, 0);
+	call(b, CODE_EXIT, NULL, 0, NULL, 0);
+	waitpid(pid, &status, 0);
+
+	printf("%d refs, %d per transaction\n", nr_refs, batch);
+	printf("insert:      %8.3f us/ref\n", insert / 1e3 / nr_refs);
+	printf("node lookup: %8.3f us/ref\n", relookup / 1e3 / nr_refs);
+	printf("desc lookup: %8.3f us/ref (increfs + decrefs)\n",
+	       lookup / 1e3 / nr_refs);
+	return 0;
+}
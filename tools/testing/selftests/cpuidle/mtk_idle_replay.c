@@ -0,0 +1,249 @@
+/*
+ * mtk_idle_replay - replay recorded idle periods through the MTK governor
+ *
+ * Reads the lines of /sys/kernel/debug/mtk_governor/record, "cpu
+ * next_timer_us residency_us nr_iowaiters first_state state", and runs
+ * each idle period through both pick policies of the governor: the
+ * platform pick (always the state mt_idle_select() returned) and the
+ * prediction in drivers/cpuidle/governors/mtk_idle_predict.h, built
+ * from the same source as the kernel.
+ *
+ * The idle period itself is taken to be the recorded residency less
+ * the exit latency of the state it was recorded in, so a deeper or
+ * shallower pick only changes the exit latency on top. For each policy
+ * it prints the per-state usage and hit/miss counts the governor keeps
+ * in debugfs, and the time spent per state.
+ *
+ * The state table is read from /sys/devices/system/cpu/cpu0/cpuidle, or
+ * given with -s name:exit_latency:target_residency,... deepest first.
+ *
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* what mtk_idle_predict.h needs from the kernel */
+typedef uint64_t u64;
+typedef int64_t s64;
+
+static inline u64 div_u64(u64 dividend, uint32_t divisor)
+{
+	return dividend / divisor;
+}
+
+static inline unsigned long int_sqrt(unsigned long x)
+{
+	unsigned long r = sqrt((double)x);
+
+	while (r * r > x)
+		r--;
+	while ((r + 1) * (r + 1) <= x)
+		r++;
+	return r;
+}
+
+#include "../../../../drivers/cpuidle/governors/mtk_idle_predict.h"
+
+#define MAX_STATES	10
+#define MAX_CPUS	32
+
+enum { POLICY_PLATFORM, POLICY_PREDICT, NR_POLICIES };
+
+static const char * const policy_name[NR_POLICIES] = {
+	"platform", "predict",
+};
+
+static struct mtk_idle_state_param states[MAX_STATES];
+static char state_name[MAX_STATES][16];
+static int nr_states;
+
+static struct mtk_idle_predict predictor[MAX_CPUS];
+static struct mtk_idle_state_stat stat[NR_POLICIES][MAX_STATES];
+
+static int read_sysfs(const char *path, char *buf, int len)
+{
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return -1;
+	if (!fgets(buf, len, f)) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+static int states_from_sysfs(void)
+{
+	char path[128], buf[64];
+	int i;
+
+	for (i = 0; i < MAX_STATES; i++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu0/cpuidle/state%d/name", i);
+		if (read_sysfs(path, buf, sizeof(buf)))
+			break;
+		snprintf(state_name[i], sizeof(state_name[i]), "%.15s", buf);
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu0/cpuidle/state%d/latency", i);
+		if (read_sysfs(path, buf, sizeof(buf)))
+			break;
+		states[i].exit_latency = strtoul(buf, NULL, 0);
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu0/cpuidle/state%d/residency", i);
+		if (read_sysfs(path, buf, sizeof(buf)))
+			break;
+		states[i].target_residency = strtoul(buf, NULL, 0);
+	}
+	nr_states = i;
+	return nr_states ? 0 : -1;
+}
+
+static int states_from_arg(char *arg)
+{
+	char *tok, *save;
+
+	for (tok = strtok_r(arg, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		struct mtk_idle_state_param *s = &states[nr_states];
+		char name[16];
+
+		if (nr_states == MAX_STATES)
+			return -1;
+		if (sscanf(tok, "%15[^:]:%u:%u", name, &s->exit_latency,
+			   &s->target_residency) != 3)
+			return -1;
+		strcpy(state_name[nr_states++], name);
+	}
+	return nr_states ? 0 : -1;
+}
+
+static void replay(unsigned int cpu, unsigned int next_timer_us,
+		   unsigned int residency_us, unsigned int nr_iowaiters,
+		   int first, int entered)
+{
+	struct mtk_idle_predict *p = &predictor[cpu];
+	unsigned int idle_us, latency_req;
+	int pick[NR_POLICIES], i;
+
+	/* the wakeup came this long after entry, whatever the state */
+	idle_us = residency_us;
+	if (idle_us > states[entered].exit_latency)
+		idle_us -= states[entered].exit_latency;
+
+	pick[POLICY_PLATFORM] = first;
+	latency_req = mtk_predict(p, next_timer_us, nr_iowaiters);
+	pick[POLICY_PREDICT] = mtk_predict_pick(states, nr_states, first,
+						p->predicted_us, latency_req);
+
+	for (i = 0; i < NR_POLICIES; i++) {
+		unsigned int res = idle_us + states[pick[i]].exit_latency;
+
+		if (i == POLICY_PREDICT)
+			mtk_predict_update(p, &states[pick[i]], res);
+		mtk_predict_account(stat[i], states, first, pick[i], res,
+				    UINT_MAX);
+	}
+}
+
+static void report(void)
+{
+	unsigned long usage, hit, deep, shallow;
+	int i, s;
+
+	for (i = 0; i < NR_POLICIES; i++) {
+		printf("%s:\n", policy_name[i]);
+		printf("  state        usage        hit   too_deep too_shallow    time_ms\n");
+		usage = hit = deep = shallow = 0;
+		for (s = 0; s < nr_states; s++) {
+			struct mtk_idle_state_stat *st = &stat[i][s];
+
+			printf("  %-8s %9lu %10lu %10lu %11lu %10llu\n",
+			       state_name[s], st->usage, st->hit, st->too_deep,
+			       st->too_shallow, st->time_us / 1000);
+			usage += st->usage;
+			hit += st->hit;
+			deep += st->too_deep;
+			shallow += st->too_shallow;
+		}
+		if (usage)
+			printf("  hit %.1f%% too_deep %.1f%% too_shallow %.1f%%\n",
+			       100.0 * hit / usage, 100.0 * deep / usage,
+			       100.0 * shallow / usage);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-s name:exit_latency:target_residency,...] [trace]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int cpu, next_timer_us, residency_us, nr_iowaiters;
+	int first, entered, opt, i;
+	unsigned long lines = 0, skipped = 0;
+	char *table = NULL;
+	char line[128];
+	FILE *in = stdin;
+
+	while ((opt = getopt(argc, argv, "s:")) != -1) {
+		switch (opt) {
+		case 's':
+			table = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind < argc) {
+		in = fopen(argv[optind], "r");
+		if (!in) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	if (table ? states_from_arg(table) : states_from_sysfs()) {
+		fprintf(stderr, "no idle state table, give one with -s\n");
+		return 1;
+	}
+	for (i = 0; i < MAX_CPUS; i++)
+		mtk_predict_init(&predictor[i]);
+
+	while (fgets(line, sizeof(line), in)) {
+		if (sscanf(line, "%u %u %u %u %d %d", &cpu, &next_timer_us,
+			   &residency_us, &nr_iowaiters, &first, &entered) != 6 ||
+		    cpu >= MAX_CPUS || first < 0 || first >= nr_states ||
+		    entered < 0 || entered >= nr_states) {
+			skipped++;
+			continue;
+		}
+		replay(cpu, next_timer_us, residency_us, nr_iowaiters, first,
+		       entered);
+		lines++;
+	}
+
+	printf("%lu idle periods replayed, %lu lines skipped\n", lines,
+	       skipped);
+	report();
+	return 0;
+}
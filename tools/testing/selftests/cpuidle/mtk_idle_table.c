@@ -0,0 +1,157 @@
+/*
+ * mtk_idle_table - check mtk_predict_table_ok() against the mt67xx table
+ *
+ * Reads the state table of drivers/cpuidle/cpuidle-mt67xx_v2.c from the
+ * source and runs the governor's table check from
+ * drivers/cpuidle/governors/mtk_idle_predict.h on it:
+ *
+ *  - the table is listed deepest first, dpidle to rgidle;
+ *  - as shipped it is rejected while its residencies are placeholders,
+ *    and accepted once they are filled in;
+ *  - with the smallest residencies a deepest-first table can have for
+ *    its exit latencies it is accepted, and the pick goes from the
+ *    deepest to the shallowest state as the prediction shrinks;
+ *  - the same table listed shallowest first is rejected.
+ *
+ * Usage: mtk_idle_table [path to cpuidle-mt67xx_v2.c]
+ *
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* what mtk_idle_predict.h needs from the kernel */
+typedef uint64_t u64;
+typedef int64_t s64;
+
+static inline u64 div_u64(u64 dividend, uint32_t divisor)
+{
+	return dividend / divisor;
+}
+
+static inline unsigned long int_sqrt(unsigned long x)
+{
+	unsigned long r = 0;
+
+	while ((r + 1) * (r + 1) <= x)
+		r++;
+	return r;
+}
+
+#include "../../../../drivers/cpuidle/governors/mtk_idle_predict.h"
+
+#define DRIVER_PATH	"../../../../drivers/cpuidle/cpuidle-mt67xx_v2.c"
+#define MAX_STATES	10
+
+static struct mtk_idle_state_param states[MAX_STATES];
+static char state_name[MAX_STATES][16];
+static int nr_states;
+static int failures;
+
+static void check(bool ok, const char *what)
+{
+	printf("[%s] %s\n", ok ? "PASS" : "FAIL", what);
+	if (!ok)
+		failures++;
+}
+
+/* the .states[n] initializers of the driver, in order */
+static int read_table(const char *path)
+{
+	char line[256], *p;
+	int cur = -1, n;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, " .states[%d]", &n) == 1) {
+			if (n != nr_states || n >= MAX_STATES)
+				break;
+			cur = nr_states++;
+			continue;
+		}
+		if (cur < 0)
+			continue;
+		p = strchr(line, '=');
+		if (!p)
+			continue;
+		if (strstr(line, ".exit_latency"))
+			states[cur].exit_latency = strtoul(p + 1, NULL, 0);
+		else if (strstr(line, ".target_residency"))
+			states[cur].target_residency = strtoul(p + 1, NULL, 0);
+		else if (strstr(line, ".name"))
+			sscanf(p + 1, " \"%15[^\"]\"", state_name[cur]);
+	}
+	fclose(f);
+	return nr_states ? 0 : -1;
+}
+
+static bool placeholder(const struct mtk_idle_state_param *s, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (s[i].target_residency > 1)
+			return false;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	struct mtk_idle_state_param s[MAX_STATES];
+	int i;
+
+	if (read_table(argc > 1 ? argv[1] : DRIVER_PATH)) {
+		fprintf(stderr, "no state table found\n");
+		return 1;
+	}
+	for (i = 0; i < nr_states; i++)
+		printf("state%d %-8s exit_latency %u target_residency %u\n", i,
+		       state_name[i], states[i].exit_latency,
+		       states[i].target_residency);
+
+	check(!strcmp(state_name[0], "dpidle") &&
+	      !strcmp(state_name[nr_states - 1], "rgidle"),
+	      "listed deepest first");
+
+	if (placeholder(states, nr_states))
+		check(!mtk_predict_table_ok(states, nr_states),
+		      "placeholder residencies rejected");
+	else
+		check(mtk_predict_table_ok(states, nr_states),
+		      "shipped residencies accepted");
+
+	/* the smallest residencies that cover the exit latencies */
+	memcpy(s, states, sizeof(s));
+	for (i = nr_states - 1; i >= 0; i--) {
+		s[i].target_residency = s[i].exit_latency;
+		if (i < nr_states - 1 &&
+		    s[i].target_residency <= s[i + 1].target_residency)
+			s[i].target_residency = s[i + 1].target_residency + 1;
+	}
+	check(mtk_predict_table_ok(s, nr_states), "filled in table accepted");
+	check(mtk_predict_pick(s, nr_states, 0, UINT_MAX, UINT_MAX) == 0,
+	      "long prediction picks the deepest state");
+	check(mtk_predict_pick(s, nr_states, 0, 0, UINT_MAX) ==
+	      nr_states - 1, "short prediction picks the shallowest state");
+
+	for (i = 0; i < nr_states; i++)
+		states[i] = s[nr_states - 1 - i];
+	check(!mtk_predict_table_ok(states, nr_states),
+	      "shallowest first rejected");
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * cmdq_sched_test - run the eMMC command queue dispatcher against a
+ * simulated card queue
+ *
+ * Builds drivers/mmc/card/cmdq_sched.c in user space on top of the
+ * simulated block layer in linux/blkdev.h, and feeds it the way
+ * mmc_cmdq_sched_fetch() in queue.c does: requests are pulled off the
+ * dispatch queue until the dispatcher is full, and the next one is
+ * dispatched only while the card has a free tag. Checks:
+ *
+ *  - requests are started when they are dispatched, not when queued;
+ *  - reads are dispatched ahead of queued writes;
+ *  - at most write_starve_max reads go ahead of a waiting write;
+ *  - contiguous small writes are merged, other writes are not;
+ *  - nothing is queued behind a flush or discard, and it goes last;
+ *  - at most max_pending requests are held;
+ *  - under constant writeback, reads wait less than in elevator order.
+ *
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../../../drivers/mmc/card/cmdq_sched.c"
+
+#define NR_REQS		1024
+#define CARD_DEPTH	32
+
+static struct request_queue queue = {
+	.max_hw_sectors = 1024,
+	.max_segments = 128,
+};
+static struct request reqs[NR_REQS];
+static int nr_reqs, start_seq, failures;
+static unsigned long now;
+
+static void check(bool ok, const char *what)
+{
+	printf("[%s] %s\n", ok ? "PASS" : "FAIL", what);
+	if (!ok)
+		failures++;
+}
+
+void blk_start_request(struct request *rq)
+{
+	/* the dispatcher puts the request back at the head first */
+	if (queue.queue_head.next != &rq->queuelist) {
+		printf("request %d started off the head of the queue\n", rq->id);
+		failures++;
+	}
+	list_del_init(&rq->queuelist);
+	rq->started = ++start_seq;
+}
+
+void __blk_end_request_all(struct request *rq, int error)
+{
+	if (!rq->started) {
+		printf("request %d completed before it was started\n", rq->id);
+		failures++;
+	}
+	rq->completed = 1;
+}
+
+static void reset(struct mmc_cmdq_sched *s)
+{
+	memset(reqs, 0, sizeof(reqs));
+	nr_reqs = 0;
+	start_seq = 0;
+	now = 0;
+	INIT_LIST_HEAD(&queue.queue_head);
+	mmc_cmdq_sched_init(s);
+}
+
+/* queue a request of @sectors at @sector on the elevator's dispatch queue */
+static struct request *submit(int dir, sector_t sector, unsigned int sectors,
+			      u64 flags)
+{
+	struct request *rq = &reqs[nr_reqs];
+
+	rq->id = nr_reqs++;
+	rq->q = &queue;
+	rq->cmd_flags = flags | (dir == WRITE ? REQ_WRITE : 0);
+	rq->__sector = sector;
+	rq->__data_len = sectors << 9;
+	rq->bio = rq->biotail = &rq->bios[0];
+	rq->nr_phys_segments = 1;
+	rq->start_time = now;
+	list_add_tail(&rq->queuelist, &queue.queue_head);
+	return rq;
+}
+
+/* what mmc_cmdq_sched_fetch() does, with @free_tags tags left on the card */
+static struct request *fetch(struct mmc_cmdq_sched *s, int free_tags)
+{
+	struct request *req;
+
+	while (!mmc_cmdq_sched_full(s) && !list_empty(&queue.queue_head)) {
+		req = list_first_entry(&queue.queue_head, struct request,
+				       queuelist);
+		list_del_init(&req->queuelist);
+		mmc_cmdq_sched_add(s, req);
+	}
+
+	req = mmc_cmdq_sched_peek(s);
+	if (!req || !free_tags)
+		return NULL;
+	mmc_cmdq_sched_dispatch(s, req);
+	return req;
+}
+
+/* dispatch everything, returns the number of requests dispatched */
+static int drain(struct mmc_cmdq_sched *s, struct request **order)
+{
+	struct request *req;
+	int n = 0;
+
+	while ((req = fetch(s, 1)))
+		order[n++] = req;
+	return n;
+}
+
+static void test_start_on_dispatch(void)
+{
+	struct mmc_cmdq_sched s;
+	int i, started = 0;
+
+	reset(&s);
+	for (i = 0; i < 4; i++)
+		submit(WRITE, i * 100, 8, 0);
+	submit(READ, 1000, 8, 0);
+	fetch(&s, 0);
+	for (i = 0; i < nr_reqs; i++)
+		started += reqs[i].started != 0;
+	check(!started && s.nr_reads == 1 && s.nr_writes == 4,
+	      "queued requests are not started without a free tag");
+
+	check(fetch(&s, 1) == &reqs[4] && reqs[4].started == 1,
+	      "a request is started when it is dispatched");
+}
+
+static void test_reads_first(void)
+{
+	struct request *order[NR_REQS];
+	struct mmc_cmdq_sched s;
+	bool ok = true;
+	int i, n;
+
+	reset(&s);
+	for (i = 0; i < 16; i++)
+		submit(WRITE, i * 100, 8, 0);
+	for (i = 0; i < 4; i++)
+		submit(READ, 10000 + i * 100, 8, 0);
+
+	n = drain(&s, order);
+	for (i = 0; i < 4; i++)
+		ok &= rq_data_dir(order[i]) == READ;
+	check(n == 20 && ok, "reads are dispatched ahead of queued writes");
+}
+
+static void test_starvation_bound(void)
+{
+	struct request *order[NR_REQS];
+	struct mmc_cmdq_sched s;
+	int i, n, run = 0, longest = 0, writes = 0;
+
+	reset(&s);
+	for (i = 0; i < 5; i++)
+		submit(WRITE, i * 100, 8, 0);
+	for (i = 0; i < 48; i++)
+		submit(READ, 10000 + i * 100, 8, 0);
+
+	n = drain(&s, order);
+	for (i = 0; i < n; i++) {
+		if (rq_data_dir(order[i]) == WRITE) {
+			writes++;
+			run = 0;
+		} else if (writes < 5 && ++run > longest) {
+			longest = run;
+		}
+	}
+	check(n == 53 && longest == (int)s.write_starve_max,
+	      "at most write_starve_max reads go ahead of a waiting write");
+	check(s.starved_writes == 5, "every write was counted as starved");
+}
+
+static void test_merge(void)
+{
+	struct request *order[NR_REQS];
+	struct mmc_cmdq_sched s;
+	struct request *a, *b, *c, *d, *e;
+	int n;
+
+	reset(&s);
+	a = submit(WRITE, 0, 8, 0);
+	b = submit(WRITE, 8, 8, 0);		/* contiguous with a */
+	c = submit(WRITE, 16, 128, 0);		/* contiguous, too large */
+	d = submit(WRITE, 1000, 8, 0);		/* not contiguous */
+	e = submit(WRITE, 1008, 8, REQ_FUA);	/* contiguous, FUA */
+	n = drain(&s, order);
+
+	check(b->completed && blk_rq_sectors(a) == 16,
+	      "a contiguous small write is merged into the previous one");
+	check(!c->completed && !d->completed && !e->completed &&
+	      s.merged_writes == 1 && n == 4,
+	      "large, distant and FUA writes are not merged");
+	check(a->bio->bi_next == &b->bios[0] && a->biotail == &b->bios[0],
+	      "the merged bios are chained");
+}
+
+static void test_barrier(void)
+{
+	struct request *order[NR_REQS];
+	struct mmc_cmdq_sched s;
+	struct request *w1, *r1, *f, *w2, *r2;
+	int n;
+
+	reset(&s);
+	w1 = submit(WRITE, 0, 8, 0);
+	r1 = submit(READ, 5000, 8, 0);
+	f = submit(WRITE, 0, 0, REQ_FLUSH);
+	w2 = submit(WRITE, 8, 8, 0);
+	r2 = submit(READ, 6000, 8, 0);
+
+	fetch(&s, 0);
+	check(s.nr_reads == 1 && s.nr_writes == 2 && mmc_cmdq_sched_full(&s),
+	      "nothing is queued behind a flush");
+
+	n = 0;
+	order[n++] = fetch(&s, 1);
+	order[n++] = fetch(&s, 1);
+	order[n++] = fetch(&s, 1);
+	check(order[0] == r1 && order[1] == w1 && order[2] == f,
+	      "requests held before a flush are dispatched before it");
+
+	n = drain(&s, order);
+	check(n == 2 && order[0] == r2 && order[1] == w2 && !w2->completed,
+	      "requests after a flush follow it and are not merged across it");
+}
+
+static void test_max_pending(void)
+{
+	struct mmc_cmdq_sched s;
+	int i;
+
+	reset(&s);
+	for (i = 0; i < 100; i++)
+		submit(WRITE, i * 100, 8, 0);
+	fetch(&s, 0);
+	check(s.nr_writes == s.max_pending,
+	      "at most max_pending requests are held");
+}
+
+/*
+ * A card with CARD_DEPTH tags, holding a write for four ticks and a read
+ * for one. Writeback keeps 96 writes outstanding while a read arrives
+ * every third tick. Returns the mean number of ticks a read waited for
+ * its tag.
+ */
+static double read_wait(bool read_first)
+{
+	unsigned long done_at[NR_REQS] = { 0 };
+	int inflight[CARD_DEPTH], nr_inflight = 0;
+	unsigned long waited = 0;
+	int reads = 0, queued_writes = 0, i;
+	sector_t wpos = 0;
+	struct mmc_cmdq_sched s;
+	struct request *req;
+
+	reset(&s);
+	for (now = 1; nr_reqs < NR_REQS - 1; now++) {
+		/* retire finished requests */
+		for (i = 0; i < nr_inflight; i++) {
+			if (done_at[inflight[i]] <= now) {
+				if (rq_data_dir(&reqs[inflight[i]]) == WRITE)
+					queued_writes--;
+				inflight[i--] = inflight[--nr_inflight];
+			}
+		}
+
+		while (queued_writes < 96 && nr_reqs < NR_REQS - 1) {
+			submit(WRITE, wpos, 512, 0);
+			wpos += 1024;
+			queued_writes++;
+		}
+		if (!(now % 3))
+			submit(READ, 1 << 30 | now << 4, 8, 0);
+
+		while (nr_inflight < CARD_DEPTH) {
+			if (read_first) {
+				req = fetch(&s, CARD_DEPTH - nr_inflight);
+			} else if (!list_empty(&queue.queue_head)) {
+				req = list_first_entry(&queue.queue_head,
+						       struct request, queuelist);
+				blk_start_request(req);
+			} else {
+				req = NULL;
+			}
+			if (!req)
+				break;
+			done_at[req->id] = now + (rq_data_dir(req) == WRITE ? 4 : 1);
+			inflight[nr_inflight++] = req->id;
+			if (rq_data_dir(req) == READ) {
+				waited += now - req->start_time;
+				reads++;
+			}
+		}
+	}
+	return reads ? (double)waited / reads : 0;
+}
+
+static void test_read_latency(void)
+{
+	double fifo = read_wait(false);
+	double first = read_wait(true);
+
+	printf("mean read wait under writeback: %.1f ticks in elevator order, "
+	       "%.1f ticks read first\n", fifo, first);
+	check(first < fifo, "reads wait less than in elevator order");
+}
+
+int main(void)
+{
+	test_start_on_dispatch();
+	test_reads_first();
+	test_starvation_bound();
+	test_merge();
+	test_barrier();
+	test_max_pending();
+	test_read_latency();
+
+	return failures ? 1 : 0;
+}
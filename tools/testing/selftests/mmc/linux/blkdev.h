@@ -0,0 +1,87 @@
+/*
+ * A simulated block layer for cmdq_sched.c: just the request fields and
+ * helpers the dispatcher uses. Starting and completing a request only
+ * records it, so the test can check when the dispatcher did either.
+ */
+#ifndef _CMDQ_TEST_LINUX_BLKDEV_H
+#define _CMDQ_TEST_LINUX_BLKDEV_H
+
+#include <linux/list.h>
+
+#define READ		0
+#define WRITE		1
+
+#define REQ_WRITE	(1ULL << 0)
+#define REQ_FUA		(1ULL << 1)
+#define REQ_DISCARD	(1ULL << 2)
+#define REQ_FLUSH	(1ULL << 3)
+#define REQ_META	(1ULL << 4)
+#define REQ_NOMERGE	(1ULL << 5)
+#define REQ_SECURE	(1ULL << 6)
+
+struct bio {
+	struct bio *bi_next;
+};
+
+struct gendisk;
+
+struct request_queue {
+	struct list_head queue_head;
+	unsigned int max_hw_sectors;
+	unsigned short max_segments;
+};
+
+struct request {
+	struct list_head queuelist;
+	struct request_queue *q;
+	u64 cmd_flags;
+	sector_t __sector;
+	unsigned int __data_len;
+	struct bio *bio;
+	struct bio *biotail;
+	struct gendisk *rq_disk;
+	unsigned short nr_phys_segments;
+	unsigned short ioprio;
+	unsigned long start_time;
+
+	/* simulation only */
+	int id;
+	int started;		/* order in which it was started, 0 if not */
+	int completed;
+	struct bio bios[8];
+};
+
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+
+#define rq_data_dir(rq)		((int)((rq)->cmd_flags & REQ_WRITE))
+#define req_get_ioprio(rq)	((rq)->ioprio)
+
+static inline sector_t blk_rq_pos(const struct request *rq)
+{
+	return rq->__sector;
+}
+
+static inline unsigned int blk_rq_bytes(const struct request *rq)
+{
+	return rq->__data_len;
+}
+
+static inline unsigned int blk_rq_sectors(const struct request *rq)
+{
+	return rq->__data_len >> 9;
+}
+
+static inline unsigned int queue_max_hw_sectors(struct request_queue *q)
+{
+	return q->max_hw_sectors;
+}
+
+static inline unsigned short queue_max_segments(struct request_queue *q)
+{
+	return q->max_segments;
+}
+
+extern void blk_start_request(struct request *rq);
+extern void __blk_end_request_all(struct request *rq, int error);
+
+#endif
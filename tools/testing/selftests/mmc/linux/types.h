@@ -0,0 +1,13 @@
+/* the parts of <linux/types.h> cmdq_sched.c needs, for a user space build */
+#ifndef _CMDQ_TEST_LINUX_TYPES_H
+#define _CMDQ_TEST_LINUX_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint64_t u64;
+typedef uint64_t sector_t;
+
+#endif
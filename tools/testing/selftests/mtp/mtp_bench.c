@@ -0,0 +1,289 @@
+/*
+ * mtp_bench - time MTP file transfers over a dummy_hcd loopback
+ *
+ * Plays both ends: the device side hands a file to /dev/mtp_usb with
+ * MTP_SEND_FILE or MTP_RECEIVE_FILE, the host side moves the data
+ * through usbfs with several bulk URBs in flight, so that the gadget is
+ * the bottleneck.
+ *
+ *   mtp_bench -d /dev/bus/usb/BBB/DDD -f file [-s MB] [-r] [-c]
+ *		[-u urbs] [-b urb bytes]
+ *
+ *   -r	receive the file from the host instead of sending it
+ *   -c	drop the file from the page cache before sending it
+ *
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+
+/* from include/uapi/linux/usb/f_mtp.h */
+struct mtp_file_range {
+	int		fd;
+	int64_t		offset;
+	int64_t		length;
+	uint16_t	command;
+	uint32_t	transaction_id;
+};
+
+#define MTP_SEND_FILE		_IOW('M', 0, struct mtp_file_range)
+#define MTP_RECEIVE_FILE	_IOW('M', 1, struct mtp_file_range)
+
+static const char *usb_path, *file_path;
+static uint64_t size = 256ULL << 20;
+static int nr_urbs = 16;
+static size_t urb_size = 256 * 1024;
+static int receive, cold;
+
+static int usb_fd, ifnum = -1;
+static unsigned char ep_in, ep_out;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* find the MTP or PTP interface and its bulk endpoints */
+static void find_interface(void)
+{
+	unsigned char desc[4096], *p;
+	ssize_t len;
+	int in_if = 0;
+
+	len = read(usb_fd, desc, sizeof(desc));
+	if (len < 18)
+		die("reading descriptors");
+
+	for (p = desc; p + 2 <= desc + len && p[0]; p += p[0]) {
+		if (p[1] == 4) {	/* interface */
+			in_if = (p[5] == 0xff && p[6] == 0xff) ||
+				(p[5] == 6 && p[6] == 1);
+			if (in_if)
+				ifnum = p[2];
+		} else if (p[1] == 5 && in_if && (p[3] & 3) == 2) {
+			if (p[2] & 0x80)
+				ep_in = p[2];
+			else
+				ep_out = p[2];
+		}
+	}
+	if (ifnum < 0 || !ep_in || !ep_out) {
+		fprintf(stderr, "%s: no MTP interface\n", usb_path);
+		exit(1);
+	}
+	if (ioctl(usb_fd, USBDEVFS_CLAIMINTERFACE, &ifnum))
+		die("USBDEVFS_CLAIMINTERFACE");
+}
+
+/*
+ * Keep nr_urbs bulk URBs going until @size bytes moved. Reading stops at
+ * the first short URB, the end of the data from the device.
+ */
+static void host_xfer(void)
+{
+	struct usbdevfs_urb *urbs, *urb;
+	uint64_t queued = 0, moved = 0;
+	int i, j, active = 0, done = 0;
+
+	urbs = calloc(nr_urbs, sizeof(*urbs));
+	if (!urbs)
+		die("calloc");
+
+	for (i = 0; i < nr_urbs; i++) {
+		urb = &urbs[i];
+		urb->type = USBDEVFS_URB_TYPE_BULK;
+		urb->endpoint = receive ? ep_out : ep_in;
+		urb->buffer = calloc(1, urb_size);
+		if (!urb->buffer)
+			die("calloc");
+	}
+
+	i = 0;
+	while (!done || active) {
+		while (!done && active < nr_urbs &&
+		       (!receive || queued < size)) {
+			urb = &urbs[i];
+			urb->buffer_length = urb_size;
+			if (receive && size - queued < urb_size)
+				urb->buffer_length = size - queued;
+			if (ioctl(usb_fd, USBDEVFS_SUBMITURB, urb))
+				die("USBDEVFS_SUBMITURB");
+			queued += urb->buffer_length;
+			active++;
+			i = (i + 1) % nr_urbs;
+		}
+
+		if (ioctl(usb_fd, USBDEVFS_REAPURB, &urb))
+			die("USBDEVFS_REAPURB");
+		active--;
+		if (done)
+			continue;
+		if (urb->status) {
+			fprintf(stderr, "urb status %d\n", urb->status);
+			exit(1);
+		}
+		moved += urb->actual_length;
+		if (receive ? moved >= size :
+			      urb->actual_length < urb->buffer_length)
+			done = 1;
+		if (done) {
+			/* take back the URBs beyond the end of the data */
+			for (j = 0; j < nr_urbs; j++)
+				ioctl(usb_fd, USBDEVFS_DISCARDURB, &urbs[j]);
+		}
+	}
+
+	if (moved != size)
+		fprintf(stderr, "host moved %llu of %llu bytes\n",
+			(unsigned long long)moved, (unsigned long long)size);
+	for (i = 0; i < nr_urbs; i++)
+		free(urbs[i].buffer);
+	free(urbs);
+}
+
+static void *host_thread(void *arg)
+{
+	host_xfer();
+	return NULL;
+}
+
+/* make sure there is a file of @size to send */
+static void make_file(int fd)
+{
+	char *buf = malloc(1 << 20);
+	uint64_t left;
+	ssize_t n;
+
+	if (lseek(fd, 0, SEEK_END) >= (off_t)size)
+		return;
+	if (!buf)
+		die("malloc");
+	memset(buf, 0x5a, 1 << 20);
+	lseek(fd, 0, SEEK_SET);
+	for (left = size; left; left -= n) {
+		n = write(fd, buf, left < (1 << 20) ? left : (1 << 20));
+		if (n <= 0)
+			die("write");
+	}
+	fsync(fd);
+	free(buf);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -d /dev/bus/usb/BBB/DDD -f file [-s MB] [-r] [-c]\n"
+		"	[-u urbs] [-b urb bytes]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct mtp_file_range mfr;
+	pthread_t host;
+	int opt, mtp_fd, fd;
+	double start, elapsed;
+
+	while ((opt = getopt(argc, argv, "d:f:s:rcu:b:")) != -1) {
+		switch (opt) {
+		case 'd':
+			usb_path = optarg;
+			break;
+		case 'f':
+			file_path = optarg;
+			break;
+		case 's':
+			size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'r':
+			receive = 1;
+			break;
+		case 'c':
+			cold = 1;
+			break;
+		case 'u':
+			nr_urbs = atoi(optarg);
+			break;
+		case 'b':
+			urb_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!usb_path || !file_path || !size || nr_urbs <= 0 || !urb_size)
+		usage(argv[0]);
+
+	usb_fd = open(usb_path, O_RDWR);
+	if (usb_fd < 0)
+		die(usb_path);
+	find_interface();
+
+	mtp_fd = open("/dev/mtp_usb", O_RDWR);
+	if (mtp_fd < 0)
+		die("/dev/mtp_usb");
+
+	if (receive) {
+		fd = open(file_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			die(file_path);
+	} else {
+		fd = open(file_path, O_RDWR | O_CREAT, 0644);
+		if (fd < 0)
+			die(file_path);
+		make_file(fd);
+		if (cold) {
+			fdatasync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		}
+	}
+
+	memset(&mfr, 0, sizeof(mfr));
+	mfr.fd = fd;
+	mfr.length = size;
+
+	start = now();
+	if (pthread_create(&host, NULL, host_thread, NULL))
+		die("pthread_create");
+	if (ioctl(mtp_fd, receive ? MTP_RECEIVE_FILE : MTP_SEND_FILE, &mfr))
+		die(receive ? "MTP_RECEIVE_FILE" : "MTP_SEND_FILE");
+	pthread_join(host, NULL);
+	if (receive)
+		fsync(fd);
+	elapsed = now() - start;
+
+	printf("%s%s %llu MB: %.2f s, %.1f MB/s\n",
+	       receive ? "receive" : "send", cold ? " (cold)" : "",
+	       (unsigned long long)(size >> 20), elapsed,
+	       (size >> 20) / elapsed);
+
+	close(fd);
+	close(mtp_fd);
+	ioctl(usb_fd, USBDEVFS_RELEASEINTERFACE, &ifnum);
+	close(usb_fd);
+	return 0;
+}
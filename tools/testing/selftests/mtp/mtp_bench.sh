@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# Loop an MTP gadget back to the host through dummy_hcd and time file
+# transfers both ways, with the plain transfers and in deep queue mode.
+#
+#   ./mtp_bench.sh [size in MB]
+#
+# FILE picks the file to send and receive, on the storage to measure,
+# /data/local/tmp/mtp_bench by default.
+
+SIZE=${1:-256}
+FILE=${FILE:-/data/local/tmp/mtp_bench}
+G=/sys/kernel/config/usb_gadget/mtp_bench
+PARAMS=/sys/module/usb_f_mtp/parameters
+DIR=$(dirname "$0")
+
+cleanup()
+{
+	[ -e $G/UDC ] && echo "" > $G/UDC
+	rm -f $G/configs/c.1/mtp.gs0
+	rmdir $G/configs/c.1/strings/0x409 $G/configs/c.1 \
+	      $G/functions/mtp.gs0 $G/strings/0x409 $G 2>/dev/null
+	rm -f "$FILE"
+}
+trap cleanup EXIT
+
+modprobe dummy_hcd 2>/dev/null
+UDC=$(ls /sys/class/udc | grep dummy_udc | head -n 1)
+if [ -z "$UDC" ]; then
+	echo "no dummy_udc"
+	exit 1
+fi
+mountpoint -q /sys/kernel/config || mount -t configfs none /sys/kernel/config
+
+set -e
+mkdir $G
+echo 0x18d1 > $G/idVendor
+echo 0x4ee1 > $G/idProduct
+mkdir $G/strings/0x409
+echo mtp_bench > $G/strings/0x409/serialnumber
+mkdir $G/configs/c.1 $G/configs/c.1/strings/0x409
+mkdir $G/functions/mtp.gs0
+ln -s $G/functions/mtp.gs0 $G/configs/c.1
+echo "$UDC" > $G/UDC
+set +e
+
+# wait for the host side to enumerate the gadget
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	for d in /sys/bus/usb/devices/*; do
+		[ "$(cat "$d/serial" 2>/dev/null)" = mtp_bench ] || continue
+		DEV=$(printf "/dev/bus/usb/%03d/%03d" "$(cat "$d/busnum")" \
+			"$(cat "$d/devnum")")
+	done
+	[ -n "$DEV" ] && break
+	sleep 1
+done
+if [ -z "$DEV" ]; then
+	echo "gadget did not show up on the host side"
+	exit 1
+fi
+
+for dq in 0 1; do
+	echo $dq > $PARAMS/deep_queue
+	echo "deep_queue=$dq queue_depth=$(cat $PARAMS/queue_depth)" \
+	     "req_size=$(cat $PARAMS/req_size)"
+	"$DIR/mtp_bench" -d "$DEV" -f "$FILE" -s "$SIZE"
+	"$DIR/mtp_bench" -d "$DEV" -f "$FILE" -s "$SIZE" -c
+	"$DIR/mtp_bench" -d "$DEV" -f "$FILE" -s "$SIZE" -r
+done
+echo 0 > $PARAMS/deep_queue
@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# Push TCP traffic from several threads over a veth pair through the
+# qtaguid accounting rules, the way bw_INPUT/bw_OUTPUT do on Android, and
+# report the throughput and how long reading the stats takes. Compare the
+# numbers of two kernels, or of one kernel with and without the rules
+# (NO_RULES=1).
+#
+#   ./qtaguid_bench.sh [threads] [seconds]
+
+THREADS=${1:-4}
+SECS=${2:-10}
+NS=qtu_bench
+DIR=$(dirname "$0")
+
+if [ ! -e /proc/net/xt_qtaguid/stats ]; then
+	echo "no xt_qtaguid"
+	exit 1
+fi
+
+cleanup()
+{
+	[ -n "$SINK" ] && kill "$SINK" 2>/dev/null
+	if [ -z "$NO_RULES" ]; then
+		iptables -D OUTPUT -o qtu0 -m owner --socket-exists 2>/dev/null
+		iptables -D INPUT -i qtu0 -m owner --socket-exists 2>/dev/null
+	fi
+	ip link del qtu0 2>/dev/null
+	ip netns del $NS 2>/dev/null
+}
+trap cleanup EXIT
+
+set -e
+ip netns add $NS
+ip link add qtu0 type veth peer name qtu1
+ip link set qtu1 netns $NS
+# qtaguid tracks an iface once it has an address
+ip addr add 10.99.0.1/24 dev qtu0
+ip link set qtu0 up
+ip netns exec $NS ip addr add 10.99.0.2/24 dev qtu1
+ip netns exec $NS ip link set qtu1 up
+
+if [ -z "$NO_RULES" ]; then
+	iptables -I OUTPUT -o qtu0 -m owner --socket-exists
+	iptables -I INPUT -i qtu0 -m owner --socket-exists
+fi
+
+ip netns exec $NS "$DIR/qtaguid_blast" -s &
+SINK=$!
+sleep 1
+
+"$DIR/qtaguid_blast" -c 10.99.0.2 -t "$THREADS" -d "$SECS" -T
+
+start=$(date +%s%N)
+lines=$(grep -c qtu0 /proc/net/xt_qtaguid/stats || true)
+end=$(date +%s%N)
+echo "stats: $lines qtu0 lines read in $(( (end - start) / 1000 )) us"
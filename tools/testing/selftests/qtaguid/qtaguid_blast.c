@@ -0,0 +1,195 @@
+/*
+ * qtaguid_blast - iperf style TCP blaster for qtaguid_bench.sh
+ *
+ *   qtaguid_blast -s [-p port]
+ *	sink: accept connections and throw the data away
+ *   qtaguid_blast -c addr [-p port] [-t threads] [-d seconds] [-T]
+ *	send from -t threads for -d seconds and print the throughput, -T
+ *	tags each socket with its own acct tag so that every thread has
+ *	its own tag stats
+ *
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define BUF_SIZE	(64 * 1024)
+
+static struct sockaddr_in addr;
+static unsigned int seconds = 10;
+static int tag;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void *sink_conn(void *arg)
+{
+	int fd = (long)arg;
+	char *buf = malloc(BUF_SIZE);
+
+	if (!buf)
+		die("malloc");
+	while (read(fd, buf, BUF_SIZE) > 0)
+		;
+	close(fd);
+	free(buf);
+	return NULL;
+}
+
+static void sink(void)
+{
+	pthread_t tid;
+	int fd, conn, one = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		die("socket");
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(fd, 64))
+		die("bind");
+	for (;;) {
+		conn = accept(fd, NULL, NULL);
+		if (conn < 0)
+			die("accept");
+		if (pthread_create(&tid, NULL, sink_conn, (void *)(long)conn))
+			die("pthread_create");
+		pthread_detach(tid);
+	}
+}
+
+/* "t <fd> <tag>" on the ctrl file, the acct tag is the upper 32 bits */
+static void tag_socket(int fd, unsigned int n)
+{
+	FILE *ctrl = fopen("/proc/net/xt_qtaguid/ctrl", "w");
+
+	if (!ctrl)
+		die("/proc/net/xt_qtaguid/ctrl");
+	fprintf(ctrl, "t %d %llu", fd, (unsigned long long)(n + 1) << 32);
+	if (fclose(ctrl))
+		die("tag");
+}
+
+struct blaster {
+	pthread_t tid;
+	unsigned int n;
+	uint64_t sent;
+};
+
+static void *blast(void *arg)
+{
+	struct blaster *b = arg;
+	struct timespec now, end;
+	char *buf;
+	ssize_t n;
+	int fd;
+
+	buf = calloc(1, BUF_SIZE);
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (!buf || fd < 0)
+		die("socket");
+	if (tag)
+		tag_socket(fd, b->n);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+		die("connect");
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_sec += seconds;
+	do {
+		n = write(fd, buf, BUF_SIZE);
+		if (n <= 0)
+			die("write");
+		b->sent += n;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (now.tv_sec < end.tv_sec ||
+		 (now.tv_sec == end.tv_sec && now.tv_nsec < end.tv_nsec));
+
+	close(fd);
+	free(buf);
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -s [-p port]\n"
+		"       %s -c addr [-p port] [-t threads] [-d seconds] [-T]\n",
+		prog, prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int threads = 4, i;
+	const char *server = NULL;
+	struct blaster *b;
+	uint64_t total = 0;
+	int opt, is_sink = 0;
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(5201);
+
+	while ((opt = getopt(argc, argv, "sc:p:t:d:T")) != -1) {
+		switch (opt) {
+		case 's':
+			is_sink = 1;
+			break;
+		case 'c':
+			server = optarg;
+			break;
+		case 'p':
+			addr.sin_port = htons(atoi(optarg));
+			break;
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			tag = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (is_sink)
+		sink();
+	if (!server || !threads || inet_pton(AF_INET, server, &addr.sin_addr) != 1)
+		usage(argv[0]);
+
+	b = calloc(threads, sizeof(*b));
+	if (!b)
+		die("calloc");
+	for (i = 0; i < threads; i++) {
+		b[i].n = i;
+		if (pthread_create(&b[i].tid, NULL, blast, &b[i]))
+			die("pthread_create");
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(b[i].tid, NULL);
+		total += b[i].sent;
+	}
+
+	printf("%u threads, %u s: %.2f Gbit/s\n", threads, seconds,
+	       total * 8.0 / seconds / 1e9);
+	return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * tg_hackbench - wakeup storm from processes with many threads
+ *
+ * Like hackbench in thread mode: each of -p processes runs -t threads
+ * that ping-pong a byte over pipes in pairs for -l round trips, so every
+ * thread sleeps and wakes, and is dequeued and enqueued, all the time.
+ * With CONFIG_MTK_SCHED_CMP_TGS each of those updates the thread group
+ * counters of the process, which is what this stresses.
+ *
+ * Prints round trips per second. With -L it clears /proc/lock_stat
+ * first and prints its thread_group_info_lock and rq->lock lines at the
+ * end, for a CONFIG_LOCK_STAT kernel, to compare the contention before
+ * and after the thread group counters went per cpu.
+ *
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static unsigned int loops = 10000;
+
+struct pair {
+	int ping[2];
+	int pong[2];
+};
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void *pinger(void *arg)
+{
+	struct pair *pair = arg;
+	unsigned int i;
+	char c = 0;
+
+	for (i = 0; i < loops; i++) {
+		if (write(pair->ping[1], &c, 1) != 1 ||
+		    read(pair->pong[0], &c, 1) != 1)
+			die("pinger");
+	}
+	return NULL;
+}
+
+static void *ponger(void *arg)
+{
+	struct pair *pair = arg;
+	unsigned int i;
+	char c;
+
+	for (i = 0; i < loops; i++) {
+		if (read(pair->ping[0], &c, 1) != 1 ||
+		    write(pair->pong[1], &c, 1) != 1)
+			die("ponger");
+	}
+	return NULL;
+}
+
+static void process(unsigned int threads)
+{
+	unsigned int npairs = threads / 2, i;
+	struct pair *pairs;
+	pthread_t *tids;
+
+	pairs = calloc(npairs, sizeof(*pairs));
+	tids = calloc(npairs * 2, sizeof(*tids));
+	if (!pairs || !tids)
+		die("calloc");
+
+	for (i = 0; i < npairs; i++) {
+		if (pipe(pairs[i].ping) || pipe(pairs[i].pong))
+			die("pipe");
+		if (pthread_create(&tids[2 * i], NULL, ponger, &pairs[i]) ||
+		    pthread_create(&tids[2 * i + 1], NULL, pinger, &pairs[i]))
+			die("pthread_create");
+	}
+	for (i = 0; i < npairs * 2; i++)
+		pthread_join(tids[i], NULL);
+	exit(0);
+}
+
+static void lock_stat_clear(void)
+{
+	FILE *f = fopen("/proc/lock_stat", "w");
+
+	if (!f) {
+		perror("/proc/lock_stat");
+		return;
+	}
+	fputs("0\n", f);
+	fclose(f);
+}
+
+static void lock_stat_show(void)
+{
+	FILE *f = fopen("/proc/lock_stat", "r");
+	char line[512];
+	int header = 0;
+
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		/* version, rule, column names, rule */
+		if (header++ < 4) {
+			fputs(line, stdout);
+			continue;
+		}
+		if (strstr(line, "thread_group_info_lock:") ||
+		    strstr(line, "&rq->lock:"))
+			fputs(line, stdout);
+	}
+	fclose(f);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-p processes] [-t threads] [-l loops] [-L]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int procs = 4, threads = 60, i;
+	struct timespec t0, t1;
+	int opt, lock_stat = 0;
+	double secs;
+
+	while ((opt = getopt(argc, argv, "p:t:l:L")) != -1) {
+		switch (opt) {
+		case 'p':
+			procs = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			loops = strtoul(optarg, NULL, 0);
+			break;
+		case 'L':
+			lock_stat = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!procs || threads < 2 || !loops)
+		usage(argv[0]);
+
+	if (lock_stat)
+		lock_stat_clear();
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < procs; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			die("fork");
+		if (!pid)
+			process(threads);
+	}
+	for (i = 0; i < procs; i++)
+		wait(NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	printf("%u processes x %u threads: %.3f s, %.0f round trips/s\n",
+	       procs, threads / 2 * 2, secs,
+	       (double)procs * (threads / 2) * loops / secs);
+
+	if (lock_stat)
+		lock_stat_show();
+	return 0;
+}
@@ -0,0 +1,252 @@
+/*
+ * pkg_storm - time package install/uninstall storms on sdcardfs
+ *
+ * Populates <storage>/Android/data with package directories, then adds and
+ * removes those packages through the sdcardfs configfs package list while a
+ * second thread keeps stat()ing files inside the tree.  Reports how long
+ * each package list update took and how lookups were delayed meanwhile.
+ *
+ * Run it once with lazy_fixup=0 and once with lazy_fixup=1 to compare the
+ * eager tree walk with the generation based lazy revalidation.
+ *
+ * Usage: pkg_storm -s <sdcardfs storage dir> [-c <configfs dir>]
+ *                  [-p packages] [-f files per package] [-r rounds]
+ *                  [-l 0|1]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PKG_PREFIX	"com.example.pkgstorm"
+#define FIRST_APPID	19000
+
+static const char *storage;
+static const char *configfs = "/config/sdcardfs";
+static int nr_pkgs = 200;
+static int nr_files = 50;
+static int nr_rounds = 5;
+static int lazy = -1;
+
+static volatile int stop;
+
+struct lat {
+	unsigned long long count;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void lat_add(struct lat *l, unsigned long long ns)
+{
+	l->count++;
+	l->total_ns += ns;
+	if (ns > l->max_ns)
+		l->max_ns = ns;
+}
+
+static void lat_print(const char *what, struct lat *l)
+{
+	printf("%-10s %8llu ops  avg %8llu us  max %8llu us\n", what,
+	       l->count, l->count ? l->total_ns / l->count / 1000 : 0,
+	       l->max_ns / 1000);
+}
+
+static int write_str(const char *path, const char *val)
+{
+	int fd, ret = 0;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	if (write(fd, val, strlen(val)) < 0)
+		ret = -errno;
+	close(fd);
+	return ret;
+}
+
+static int mkdir_p(const char *path)
+{
+	if (mkdir(path, 0770) && errno != EEXIST)
+		return -errno;
+	return 0;
+}
+
+static int populate(void)
+{
+	char path[PATH_MAX];
+	int i, j, fd;
+
+	snprintf(path, sizeof(path), "%s/Android", storage);
+	if (mkdir_p(path))
+		return -1;
+	snprintf(path, sizeof(path), "%s/Android/data", storage);
+	if (mkdir_p(path))
+		return -1;
+
+	for (i = 0; i < nr_pkgs; i++) {
+		snprintf(path, sizeof(path), "%s/Android/data/%s%d",
+			 storage, PKG_PREFIX, i);
+		if (mkdir_p(path))
+			return -1;
+		snprintf(path, sizeof(path), "%s/Android/data/%s%d/files",
+			 storage, PKG_PREFIX, i);
+		if (mkdir_p(path))
+			return -1;
+		for (j = 0; j < nr_files; j++) {
+			snprintf(path, sizeof(path),
+				 "%s/Android/data/%s%d/files/f%d",
+				 storage, PKG_PREFIX, i, j);
+			fd = open(path, O_CREAT | O_WRONLY, 0660);
+			if (fd < 0)
+				return -1;
+			close(fd);
+		}
+	}
+	return 0;
+}
+
+static void *lookup_thread(void *arg)
+{
+	struct lat *l = arg;
+	char path[PATH_MAX];
+	unsigned int seed = 1;
+	unsigned long long t;
+	struct stat st;
+
+	while (!stop) {
+		snprintf(path, sizeof(path), "%s/Android/data/%s%d/files/f%d",
+			 storage, PKG_PREFIX, rand_r(&seed) % nr_pkgs,
+			 rand_r(&seed) % nr_files);
+		t = now_ns();
+		stat(path, &st);
+		lat_add(l, now_ns() - t);
+	}
+	return NULL;
+}
+
+static int pkg_install(int i)
+{
+	char path[PATH_MAX], val[16];
+
+	snprintf(path, sizeof(path), "%s/%s%d", configfs, PKG_PREFIX, i);
+	if (mkdir_p(path))
+		return -1;
+	snprintf(path, sizeof(path), "%s/%s%d/appid", configfs, PKG_PREFIX, i);
+	snprintf(val, sizeof(val), "%d", FIRST_APPID + i);
+	return write_str(path, val);
+}
+
+static int pkg_uninstall(int i)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s%d", configfs, PKG_PREFIX, i);
+	return rmdir(path) ? -errno : 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct lat install = { 0 }, uninstall = { 0 }, lookup = { 0 };
+	char path[PATH_MAX];
+	unsigned long long t;
+	pthread_t thread;
+	int opt, r, i;
+
+	while ((opt = getopt(argc, argv, "s:c:p:f:r:l:")) != -1) {
+		switch (opt) {
+		case 's':
+			storage = optarg;
+			break;
+		case 'c':
+			configfs = optarg;
+			break;
+		case 'p':
+			nr_pkgs = atoi(optarg);
+			break;
+		case 'f':
+			nr_files = atoi(optarg);
+			break;
+		case 'r':
+			nr_rounds = atoi(optarg);
+			break;
+		case 'l':
+			lazy = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s -s <storage> [-c configfs] "
+				"[-p pkgs] [-f files] [-r rounds] [-l 0|1]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (!storage || nr_pkgs <= 0 || nr_files <= 0) {
+		fprintf(stderr, "%s: need -s <sdcardfs storage dir>\n", argv[0]);
+		return 1;
+	}
+	if (access(configfs, F_OK)) {
+		printf("%s not found, is configfs mounted? [SKIP]\n", configfs);
+		return 0;
+	}
+	if (lazy >= 0) {
+		snprintf(path, sizeof(path), "%s/lazy_fixup", configfs);
+		if (write_str(path, lazy ? "1" : "0")) {
+			printf("no lazy_fixup support in this kernel [SKIP]\n");
+			return 0;
+		}
+	}
+
+	if (populate()) {
+		perror("populate");
+		return 1;
+	}
+	printf("tree: %d packages x %d files, %d rounds, lazy_fixup=%d\n",
+	       nr_pkgs, nr_files, nr_rounds, lazy);
+
+	if (pthread_create(&thread, NULL, lookup_thread, &lookup)) {
+		perror("pthread_create");
+		return 1;
+	}
+
+	for (r = 0; r < nr_rounds; r++) {
+		for (i = 0; i < nr_pkgs; i++) {
+			t = now_ns();
+			if (pkg_install(i)) {
+				perror("install");
+				goto out;
+			}
+			lat_add(&install, now_ns() - t);
+		}
+		for (i = 0; i < nr_pkgs; i++) {
+			t = now_ns();
+			if (pkg_uninstall(i)) {
+				perror("uninstall");
+				goto out;
+			}
+			lat_add(&uninstall, now_ns() - t);
+		}
+	}
+out:
+	stop = 1;
+	pthread_join(thread, NULL);
+
+	lat_print("install", &install);
+	lat_print("uninstall", &uninstall);
+	lat_print("lookup", &lookup);
+	return 0;
+}
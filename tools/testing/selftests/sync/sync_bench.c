@@ -0,0 +1,186 @@
+/*
+ * sync_bench - time the sync fence paths a compositor hits every frame
+ *
+ * Each step on a sw_sync timeline creates a fence, merges it with the
+ * fence of the previous step, waits on a fence that already signaled,
+ * advances the timeline by one and closes the oldest fences. -d keeps
+ * that many fences outstanding, like a display with that many layers
+ * times buffers in flight, so signalling has that many active points
+ * to look at.
+ *
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "sync.h"
+#include "sw_sync.h"
+
+struct bench {
+	unsigned long long create, merge, wait, inc, close;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static int fence_create(int timeline, unsigned int value)
+{
+	struct sw_sync_create_fence_data data;
+
+	memset(&data, 0, sizeof(data));
+	data.value = value;
+	snprintf(data.name, sizeof(data.name), "bench%u", value);
+	if (ioctl(timeline, SW_SYNC_IOC_CREATE_FENCE, &data))
+		die("SW_SYNC_IOC_CREATE_FENCE");
+	return data.fence;
+}
+
+static int fence_merge(int a, int b)
+{
+	struct sync_merge_data data;
+
+	memset(&data, 0, sizeof(data));
+	data.fd2 = b;
+	strcpy(data.name, "merged");
+	if (ioctl(a, SYNC_IOC_MERGE, &data))
+		die("SYNC_IOC_MERGE");
+	return data.fence;
+}
+
+static void run(const char *dev, unsigned int steps, unsigned int depth,
+		struct bench *b)
+{
+	int *fences, *merged, timeline, signaled, prev = -1;
+	unsigned long long t0, t1;
+	unsigned int i, slot;
+	__s32 timeout = 0;
+	__u32 one = 1;
+
+	fences = calloc(depth, sizeof(*fences));
+	merged = calloc(depth, sizeof(*merged));
+	if (!fences || !merged)
+		die("calloc");
+
+	timeline = open(dev, O_RDWR);
+	if (timeline < 0)
+		die(dev);
+
+	/* point 0 is passed already, waiting on it takes the fast path */
+	signaled = fence_create(timeline, 0);
+
+	/* keep depth points ahead of the timeline */
+	for (i = 0; i < depth; i++) {
+		fences[i] = fence_create(timeline, i + 1);
+		merged[i] = -1;
+	}
+
+	memset(b, 0, sizeof(*b));
+	for (i = 0; i < steps; i++) {
+		slot = i % depth;
+
+		t0 = now_ns();
+		close(fences[slot]);
+		if (merged[slot] >= 0)
+			close(merged[slot]);
+		t1 = now_ns();
+		b->close += t1 - t0;
+
+		fences[slot] = fence_create(timeline, i + depth + 1);
+		t0 = now_ns();
+		b->create += t0 - t1;
+
+		merged[slot] = prev >= 0 ? fence_merge(fences[slot], prev) : -1;
+		prev = fences[slot];
+		t1 = now_ns();
+		b->merge += t1 - t0;
+
+		if (ioctl(signaled, SYNC_IOC_WAIT, &timeout))
+			die("SYNC_IOC_WAIT");
+		t0 = now_ns();
+		b->wait += t0 - t1;
+
+		if (ioctl(timeline, SW_SYNC_IOC_INC, &one))
+			die("SW_SYNC_IOC_INC");
+		b->inc += now_ns() - t0;
+	}
+
+	for (i = 0; i < depth; i++) {
+		close(fences[i]);
+		if (merged[i] >= 0)
+			close(merged[i]);
+	}
+	close(signaled);
+	close(timeline);
+	free(fences);
+	free(merged);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s /dev/sw_sync] [-n steps] [-d depth]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = "/dev/sw_sync";
+	unsigned int steps = 100000;
+	unsigned int depths[] = { 1, 6, 64 };
+	unsigned int depth = 0, i;
+	struct bench b;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:n:d:")) != -1) {
+		switch (opt) {
+		case 's':
+			dev = optarg;
+			break;
+		case 'n':
+			steps = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!steps)
+		usage(argv[0]);
+
+	printf("depth\tcreate\tmerge\twait\tinc\tclose\t(ns/op)\n");
+	for (i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+		unsigned int d = depth ? depth : depths[i];
+
+		run(dev, steps, d, &b);
+		printf("%u\t%llu\t%llu\t%llu\t%llu\t%llu\n", d,
+		       b.create / steps, b.merge / steps, b.wait / steps,
+		       b.inc / steps, b.close / steps);
+		if (depth)
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * smaps-rollup-bench - cost of reading a process' Pss through smaps and
+ * through smaps_rollup
+ *
+ * Maps a number of small anonymous areas with alternating protections, so
+ * that they cannot be merged, and touches every page. The Pss total is then
+ * read repeatedly from /proc/self/smaps, from /proc/self/smaps_rollup and,
+ * when vm.smaps_rollup_cache_ms can be set, from smaps_rollup with the
+ * cache on. The mean time per read and the Pss found are reported.
+ *
+ * Usage: smaps-rollup-bench [-n vmas] [-p pages per vma] [-i iterations]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_PATH	"/proc/sys/vm/smaps_rollup_cache_ms"
+
+static int nr_vmas = 5000;
+static int vma_pages = 4;
+static int nr_iters = 20;
+static long page_size;
+
+/* read into a static buffer, malloc would change what is measured */
+static char buf[1 << 16];
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int read_str(const char *path, char *val, size_t len)
+{
+	int fd;
+	ssize_t n;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	n = read(fd, val, len - 1);
+	close(fd);
+	if (n < 0)
+		return -errno;
+	val[n] = '\0';
+	return 0;
+}
+
+static int write_str(const char *path, const char *val)
+{
+	int fd, ret = 0;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	if (write(fd, val, strlen(val)) < 0)
+		ret = -errno;
+	close(fd);
+	return ret;
+}
+
+/* sum of the "Pss:" lines, a line may straddle two reads */
+static unsigned long read_pss(const char *path)
+{
+	static const char key[] = "Pss:";
+	char line[128];
+	size_t len = 0;
+	unsigned long pss = 0;
+	ssize_t n, i;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		for (i = 0; i < n; i++) {
+			if (buf[i] != '\n') {
+				if (len < sizeof(line) - 1)
+					line[len++] = buf[i];
+				continue;
+			}
+			line[len] = '\0';
+			if (!strncmp(line, key, sizeof(key) - 1))
+				pss += strtoul(line + sizeof(key) - 1, NULL, 10);
+			len = 0;
+		}
+	}
+	if (n < 0) {
+		perror(path);
+		exit(1);
+	}
+	close(fd);
+	return pss;
+}
+
+static void run(const char *name, const char *path)
+{
+	unsigned long long start, ns;
+	unsigned long pss = 0;
+	int i;
+
+	start = now_ns();
+	for (i = 0; i < nr_iters; i++)
+		pss = read_pss(path);
+	ns = (now_ns() - start) / nr_iters;
+
+	printf("%-16s %10.3f ms/read %10lu kB Pss\n", name, ns / 1e6, pss);
+}
+
+static void map_vmas(void)
+{
+	long len = vma_pages * page_size;
+	char *p;
+	int i, j;
+
+	for (i = 0; i < nr_vmas; i++) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			perror("mmap");
+			exit(1);
+		}
+		for (j = 0; j < vma_pages; j++)
+			p[j * page_size] = 1;
+		/* neighbours with other protections do not merge */
+		if ((i & 1) && mprotect(p, len, PROT_READ)) {
+			perror("mprotect");
+			exit(1);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	char old[32];
+	int c;
+
+	while ((c = getopt(argc, argv, "n:p:i:")) != -1) {
+		switch (c) {
+		case 'n':
+			nr_vmas = atoi(optarg);
+			break;
+		case 'p':
+			vma_pages = atoi(optarg);
+			break;
+		case 'i':
+			nr_iters = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n vmas] [-p pages per vma] "
+				"[-i iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (nr_vmas < 1 || vma_pages < 1 || nr_iters < 1) {
+		fprintf(stderr, "bad arguments\n");
+		return 1;
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	map_vmas();
+	printf("%d vmas of %d pages, %d reads each\n", nr_vmas, vma_pages,
+	       nr_iters);
+
+	if (access("/proc/self/smaps_rollup", R_OK)) {
+		perror("/proc/self/smaps_rollup");
+		return 1;
+	}
+
+	/* Pss in smaps is rounded down per vma, so it may be a bit lower */
+	run("smaps", "/proc/self/smaps");
+
+	if (read_str(CACHE_PATH, old, sizeof(old)) ||
+	    write_str(CACHE_PATH, "0")) {
+		run("smaps_rollup", "/proc/self/smaps_rollup");
+		printf("cannot set %s, skipping the cached run\n", CACHE_PATH);
+		return 0;
+	}
+	run("smaps_rollup", "/proc/self/smaps_rollup");
+	write_str(CACHE_PATH, "60000");
+	run("smaps_rollup/c", "/proc/self/smaps_rollup");
+	write_str(CACHE_PATH, old);
+
+	return 0;
+}
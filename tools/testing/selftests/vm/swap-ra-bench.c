@@ -0,0 +1,350 @@
+/*
+ * swap-ra-bench - app switching under memory pressure, cluster vs VMA
+ * based swap readahead
+ *
+ * Forks a number of "apps" whose anonymous heaps together exceed the
+ * available memory, then brings them to the foreground one after the
+ * other. A foreground app walks a few object runs of its heap and touches
+ * some random pages, like an app redrawing after a switch, while the
+ * others sit in the background and get swapped out. The run is done once
+ * per readahead mode, with a fresh set of apps each time, and the
+ * /proc/vmstat deltas are reported:
+ *
+ *   pgmajfault   major faults
+ *   pswpin       pages read from swap, i.e. decompressions on zram
+ *   swap_ra      pages read ahead
+ *   swap_ra_hit  read ahead pages that were used
+ *
+ * Needs root, swap (zram) enabled and /sys/kernel/mm/swap/vma_ra_enabled.
+ *
+ * Usage: swap-ra-bench [-a apps] [-m MB per app] [-s switches]
+ *                      [-r runs per switch] [-p random pages per switch]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define VMA_RA_PATH	"/sys/kernel/mm/swap/vma_ra_enabled"
+#define RUN_PAGES	64
+
+static int nr_apps = 8;
+static long app_mb;
+static int nr_switches = 64;
+static int nr_runs = 16;
+static int nr_random = 256;
+static long page_size;
+
+static const char * const counters[] = {
+	"pgmajfault", "pswpin", "swap_ra", "swap_ra_hit",
+};
+#define NR_COUNTERS	(sizeof(counters) / sizeof(counters[0]))
+
+struct app {
+	pid_t pid;
+	int cmd;	/* parent -> app */
+	int done;	/* app -> parent */
+};
+
+struct result {
+	unsigned long long vmstat[NR_COUNTERS];
+	unsigned long long majflt;
+	unsigned long long ns;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int write_str(const char *path, const char *val)
+{
+	int fd, ret = 0;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	if (write(fd, val, strlen(val)) < 0)
+		ret = -errno;
+	close(fd);
+	return ret;
+}
+
+static void read_vmstat(unsigned long long *val)
+{
+	char name[64];
+	unsigned long long v;
+	unsigned int i;
+	FILE *f;
+
+	memset(val, 0, NR_COUNTERS * sizeof(*val));
+	f = fopen("/proc/vmstat", "r");
+	if (!f) {
+		perror("/proc/vmstat");
+		exit(1);
+	}
+	while (fscanf(f, "%63s %llu", name, &v) == 2)
+		for (i = 0; i < NR_COUNTERS; i++)
+			if (!strcmp(name, counters[i]))
+				val[i] = v;
+	fclose(f);
+}
+
+static long mem_available_mb(void)
+{
+	char name[64];
+	long kb, ret = 0;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %ld kB\n", name, &kb) == 2)
+		if (!strcmp(name, "MemAvailable:"))
+			ret = kb / 1024;
+	fclose(f);
+	return ret;
+}
+
+/* compressible but not same-filled, so zram has to store every page */
+static void fill_page(char *p, unsigned int seed)
+{
+	unsigned int i;
+
+	for (i = 0; i < page_size / 4 / sizeof(seed); i++) {
+		seed = seed * 1103515245 + 12345;
+		((unsigned int *)p)[i] = seed;
+	}
+}
+
+static void app_touch(char *heap, long npages, unsigned int *seed)
+{
+	volatile char *p;
+	long i, j, start;
+
+	/* object runs: arrays, bitmaps, view trees laid out together */
+	for (i = 0; i < nr_runs; i++) {
+		start = rand_r(seed) % (npages - RUN_PAGES);
+		for (j = 0; j < RUN_PAGES; j++) {
+			p = heap + (start + j) * page_size;
+			p[0]++;
+		}
+	}
+	/* pointer chasing across the heap */
+	for (i = 0; i < nr_random; i++) {
+		p = heap + (rand_r(seed) % npages) * page_size;
+		(void)p[0];
+	}
+}
+
+static void app_main(int idx, int cmd, int done)
+{
+	long npages = app_mb * 1024 * 1024 / page_size;
+	unsigned int seed = idx + 1;
+	char *heap;
+	char c;
+	long i;
+
+	heap = mmap(NULL, npages * page_size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (heap == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	for (i = 0; i < npages; i++)
+		fill_page(heap + i * page_size, seed + i);
+
+	c = 0;
+	if (write(done, &c, 1) != 1)
+		exit(1);
+	while (read(cmd, &c, 1) == 1) {
+		app_touch(heap, npages, &seed);
+		if (write(done, &c, 1) != 1)
+			break;
+	}
+	exit(0);
+}
+
+static void start_apps(struct app *apps)
+{
+	int cmd[2], done[2], i;
+	char c;
+
+	for (i = 0; i < nr_apps; i++) {
+		if (pipe(cmd) || pipe(done)) {
+			perror("pipe");
+			exit(1);
+		}
+		apps[i].pid = fork();
+		if (apps[i].pid < 0) {
+			perror("fork");
+			exit(1);
+		}
+		if (!apps[i].pid) {
+			close(cmd[1]);
+			close(done[0]);
+			app_main(i, cmd[0], done[1]);
+		}
+		close(cmd[0]);
+		close(done[1]);
+		apps[i].cmd = cmd[1];
+		apps[i].done = done[0];
+		/* launch one app at a time, like a user would */
+		if (read(apps[i].done, &c, 1) != 1) {
+			fprintf(stderr, "app %d died while starting\n", i);
+			exit(1);
+		}
+	}
+}
+
+static void stop_apps(struct app *apps, struct result *res)
+{
+	struct rusage ru;
+	int i, status;
+
+	for (i = 0; i < nr_apps; i++) {
+		close(apps[i].cmd);
+		close(apps[i].done);
+	}
+	for (i = 0; i < nr_apps; i++) {
+		if (wait4(apps[i].pid, &status, 0, &ru) < 0)
+			continue;
+		res->majflt += ru.ru_majflt;
+	}
+}
+
+static int run(int vma_ra, struct result *res)
+{
+	unsigned long long before[NR_COUNTERS], after[NR_COUNTERS], start;
+	struct app *apps;
+	unsigned int i;
+	char c = 0;
+	int n;
+
+	if (write_str(VMA_RA_PATH, vma_ra ? "1" : "0")) {
+		fprintf(stderr, "cannot set %s\n", VMA_RA_PATH);
+		return -1;
+	}
+
+	apps = calloc(nr_apps, sizeof(*apps));
+	if (!apps)
+		return -1;
+	memset(res, 0, sizeof(*res));
+	start_apps(apps);
+
+	read_vmstat(before);
+	start = now_ns();
+	for (n = 0; n < nr_switches; n++) {
+		struct app *app = &apps[n % nr_apps];
+
+		if (write(app->cmd, &c, 1) != 1 ||
+		    read(app->done, &c, 1) != 1) {
+			fprintf(stderr, "app %d died\n", n % nr_apps);
+			exit(1);
+		}
+	}
+	res->ns = now_ns() - start;
+	read_vmstat(after);
+
+	stop_apps(apps, res);
+	free(apps);
+
+	for (i = 0; i < NR_COUNTERS; i++)
+		res->vmstat[i] = after[i] - before[i];
+	return 0;
+}
+
+static void print_result(const char *mode, struct result *res)
+{
+	unsigned int i;
+
+	printf("%-8s %10.1f ms  app majflt %8llu", mode, res->ns / 1e6,
+	       res->majflt);
+	for (i = 0; i < NR_COUNTERS; i++)
+		printf("  %s %8llu", counters[i], res->vmstat[i]);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct result cluster, vma;
+	long long saved_maj, saved_in;
+	char orig[8] = "1";
+	int opt, fd;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	while ((opt = getopt(argc, argv, "a:m:s:r:p:")) != -1) {
+		switch (opt) {
+		case 'a':
+			nr_apps = atoi(optarg);
+			break;
+		case 'm':
+			app_mb = atol(optarg);
+			break;
+		case 's':
+			nr_switches = atoi(optarg);
+			break;
+		case 'r':
+			nr_runs = atoi(optarg);
+			break;
+		case 'p':
+			nr_random = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-a apps] [-m MB per app] [-s switches] [-r runs] [-p random pages]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (nr_apps < 2 || nr_switches < 1) {
+		fprintf(stderr, "need at least 2 apps and 1 switch\n");
+		return 1;
+	}
+	/* by default oversubscribe the available memory by half */
+	if (!app_mb)
+		app_mb = mem_available_mb() * 3 / 2 / nr_apps;
+	if (app_mb * 1024 * 1024 / page_size <= RUN_PAGES) {
+		fprintf(stderr, "apps too small, use -m\n");
+		return 1;
+	}
+
+	fd = open(VMA_RA_PATH, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", VMA_RA_PATH, strerror(errno));
+		return 1;
+	}
+	if (read(fd, orig, sizeof(orig) - 1) > 0 && orig[0] == 't')
+		strcpy(orig, "1");
+	else if (orig[0] == 'f')
+		strcpy(orig, "0");
+	close(fd);
+
+	printf("%d apps x %ld MB, %d switches\n", nr_apps, app_mb,
+	       nr_switches);
+
+	if (run(0, &cluster) || run(1, &vma))
+		return 1;
+	write_str(VMA_RA_PATH, orig);
+
+	print_result("cluster", &cluster);
+	print_result("vma", &vma);
+
+	saved_maj = (long long)cluster.vmstat[0] - (long long)vma.vmstat[0];
+	saved_in = (long long)cluster.vmstat[1] - (long long)vma.vmstat[1];
+	printf("major faults avoided: %lld, decompressions avoided: %lld\n",
+	       saved_maj, saved_in);
+	return 0;
+}